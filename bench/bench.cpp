@@ -0,0 +1,472 @@
+#include "placement/placement_pipeline.hpp"
+
+#include "bench_common.hpp"
+
+#include "../example/external/json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace placement;
+using namespace placement::bench;
+
+namespace {
+
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+const char *const usage = R"(Usage: pplib-bench [options]
+
+Runs placement over every combination of the swept parameters, on each backend, and reports the time spent in each
+stage together with candidate and instance throughput.
+
+Sweeps (comma separated lists):
+  --sizes <list>         side of the square placement region, in world units      (default: 100,500,1000)
+  --footprints <list>    footprint of the layer                                    (default: 1)
+  --classes <list>       number of placement classes                               (default: 1,10)
+  --fill <list>          accumulated density of all classes, in [0, 1]             (default: 0.25,1)
+  --seeds <list>         random seeds                                              (default: 0)
+  --backends <list>      any of gl, cpu, cpu-parallel                              (default: all available)
+
+Options:
+  --repetitions <n>      timed runs of each case                                   (default: 10)
+  --warmup <n>           untimed runs before each case                             (default: 2)
+  --output <path>        write the report as JSON
+  --baseline <path>      compare against a report written by a previous run
+  --threshold <ratio>    relative slowdown of the median time counted as a regression (default: 0.1)
+
+Exit status is 0 on success, 1 on errors and 2 if any regression was found.
+)";
+
+struct Options
+{
+    std::vector<float> sizes {100.0f, 500.0f, 1000.0f};
+    std::vector<float> footprints {1.0f};
+    std::vector<uint> class_counts {1, 10};
+    std::vector<float> fill_ratios {0.25f, 1.0f};
+    std::vector<uint> seeds {0};
+#ifdef PLACEMENT_BENCHMARK_MULTITHREAD
+    std::vector<std::string> backends {"gl", "cpu", "cpu-parallel"};
+#else
+    std::vector<std::string> backends {"gl", "cpu"};
+#endif
+    uint repetitions {10};
+    uint warmup {2};
+    std::string output_path;
+    std::string baseline_path;
+    double threshold {0.1};
+};
+
+template<typename T>
+std::vector<T> parseList(const std::string &text)
+{
+    std::vector<T> values;
+    std::istringstream stream {text};
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        std::istringstream item_stream {item};
+        T value;
+        if (!(item_stream >> value))
+            throw std::invalid_argument("invalid list item: " + item);
+        values.push_back(value);
+    }
+
+    if (values.empty())
+        throw std::invalid_argument("empty list");
+
+    return values;
+}
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string name = argv[i];
+
+        if (name == "--help" || name == "-h")
+        {
+            std::cout << usage;
+            std::exit(0);
+        }
+
+        if (i + 1 == argc)
+            throw std::invalid_argument("missing value for option " + name);
+
+        const std::string value = argv[++i];
+
+        if (name == "--sizes")
+            options.sizes = parseList<float>(value);
+        else if (name == "--footprints")
+            options.footprints = parseList<float>(value);
+        else if (name == "--classes")
+            options.class_counts = parseList<uint>(value);
+        else if (name == "--fill")
+            options.fill_ratios = parseList<float>(value);
+        else if (name == "--seeds")
+            options.seeds = parseList<uint>(value);
+        else if (name == "--backends")
+            options.backends = parseList<std::string>(value);
+        else if (name == "--repetitions")
+            options.repetitions = std::max(1u, parseList<uint>(value).front());
+        else if (name == "--warmup")
+            options.warmup = parseList<uint>(value).front();
+        else if (name == "--output")
+            options.output_path = value;
+        else if (name == "--baseline")
+            options.baseline_path = value;
+        else if (name == "--threshold")
+            options.threshold = parseList<double>(value).front();
+        else
+            throw std::invalid_argument("unknown option " + name);
+    }
+
+    for (const auto &backend : options.backends)
+    {
+#ifdef PLACEMENT_BENCHMARK_MULTITHREAD
+        if (backend != "gl" && backend != "cpu" && backend != "cpu-parallel")
+#else
+        if (backend != "gl" && backend != "cpu")
+#endif
+            throw std::invalid_argument("unknown or unavailable backend " + backend);
+    }
+
+    return options;
+}
+
+/// Parameters of a single point of the sweep.
+struct BenchmarkCase
+{
+    std::string backend;
+    float size;
+    float footprint;
+    uint class_count;
+    float fill_ratio;
+    uint seed;
+};
+
+/// Timings of one stage of one case.
+struct Measurement
+{
+    BenchmarkCase parameters;
+    std::string stage;
+    double median_ms {0.0};
+    double min_ms {0.0};
+    double max_ms {0.0};
+    double candidate_count {0.0};
+    double instance_count {0.0};
+    std::size_t working_memory {0};     ///< Bytes of memory allocated by placement, host or device.
+    std::size_t peak_memory {0};        ///< Peak resident memory of the process after the case.
+
+    [[nodiscard]] double getCandidateThroughput() const
+    { return median_ms > 0.0 ? candidate_count / (median_ms * 1e-3) : 0.0; }
+
+    [[nodiscard]] double getInstanceThroughput() const
+    { return median_ms > 0.0 ? instance_count / (median_ms * 1e-3) : 0.0; }
+
+    /// Identifies the same measurement across reports.
+    [[nodiscard]] std::string getKey() const
+    {
+        std::ostringstream key;
+        key << parameters.backend << '/' << stage << "/size=" << parameters.size
+            << "/footprint=" << parameters.footprint << "/classes=" << parameters.class_count
+            << "/fill=" << parameters.fill_ratio << "/seed=" << parameters.seed;
+        return key.str();
+    }
+};
+
+/// Accumulates the samples of each stage of a case.
+class StageTimer
+{
+public:
+    void add(const std::string &stage, Milliseconds time)
+    {
+        auto it = std::find(m_stages.begin(), m_stages.end(), stage);
+        if (it == m_stages.end())
+        {
+            m_stages.push_back(stage);
+            m_samples.emplace_back();
+            it = m_stages.end() - 1;
+        }
+        m_samples[it - m_stages.begin()].push_back(time.count());
+    }
+
+    /// One measurement per stage, in the order stages were first added.
+    [[nodiscard]] std::vector<Measurement> getMeasurements(const BenchmarkCase &parameters) const
+    {
+        std::vector<Measurement> measurements;
+        for (std::size_t i = 0; i < m_stages.size(); i++)
+        {
+            std::vector<double> samples = m_samples[i];
+            std::sort(samples.begin(), samples.end());
+
+            Measurement &measurement = measurements.emplace_back();
+            measurement.parameters = parameters;
+            measurement.stage = m_stages[i];
+            measurement.min_ms = samples.front();
+            measurement.max_ms = samples.back();
+            measurement.median_ms = samples.size() % 2 == 1
+                                    ? samples[samples.size() / 2]
+                                    : 0.5 * (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]);
+        }
+        return measurements;
+    }
+
+private:
+    std::vector<std::string> m_stages;
+    std::vector<std::vector<double>> m_samples;
+};
+
+std::vector<Measurement> runGPUCase(PlacementPipeline &pipeline, const BenchmarkScene &scene,
+                                    const BenchmarkCase &parameters, const Options &options, float world_size)
+{
+    using clock = std::chrono::steady_clock;
+
+    const WorldData world_data = scene.getWorldData(world_size);
+    const LayerData layer_data = scene.getLayerData(parameters.footprint, parameters.class_count,
+                                                    parameters.fill_ratio);
+    const glm::vec2 upper_bound {parameters.size};
+
+    pipeline.setRandomSeed(parameters.seed);
+
+    StageTimer timer;
+    double candidate_count = 0.0;
+    double instance_count = 0.0;
+    std::size_t working_memory = 0;
+
+    for (uint i = 0; i < options.warmup + options.repetitions; i++)
+    {
+        const auto start_time = clock::now();
+        FutureResult future_result = pipeline.computePlacement(world_data, layer_data, {0.0f, 0.0f}, upper_bound);
+        const auto dispatch_time = clock::now();
+        future_result.wait(std::chrono::nanoseconds::max());
+        const auto end_time = clock::now();
+
+        Result result = future_result.readResult();
+
+        if (i < options.warmup)
+            continue;
+
+        timer.add("dispatch", dispatch_time - start_time);
+        timer.add("execution", end_time - dispatch_time);
+        timer.add("total", end_time - start_time);
+
+        instance_count = result.getElementArrayLength();
+        const ResultBuffer buffer = result.moveBuffer();
+        candidate_count = static_cast<double>(buffer.getElementBufferSize() / ResultBuffer::element_ssize);
+        working_memory = static_cast<std::size_t>(buffer.size);
+    }
+
+    auto measurements = timer.getMeasurements(parameters);
+    for (auto &measurement : measurements)
+    {
+        measurement.candidate_count = candidate_count;
+        measurement.instance_count = instance_count;
+        measurement.working_memory = working_memory;
+        measurement.peak_memory = getPeakMemoryUsage();
+    }
+
+    return measurements;
+}
+
+template<typename ExecutionPolicy>
+std::vector<Measurement> runCPUCase(const ExecutionPolicy &policy, cpu::PlacementPipeline &pipeline,
+                                    const BenchmarkScene &scene, const BenchmarkCase &parameters,
+                                    const Options &options, float world_size)
+{
+    const cpu::WorldData world_data = scene.getCPUWorldData(scene.getWorldData(world_size).scale);
+    const cpu::LayerData layer_data = scene.getCPULayerData(scene.getLayerData(parameters.footprint,
+                                                                               parameters.class_count,
+                                                                               parameters.fill_ratio));
+
+    pipeline.setRandomSeed(parameters.seed);
+
+    StageTimer timer;
+    ClassBins<cpu::ResultElement> bins;
+    PlacementStatistics statistics;
+
+    for (uint i = 0; i < options.warmup + options.repetitions; i++)
+    {
+        cpu::PlacementPipeline::StageTimes times;
+        bins = pipeline.computePlacement(policy, world_data, layer_data, {0.0f, 0.0f}, glm::vec2(parameters.size),
+                                         statistics, &times);
+
+        if (i < options.warmup)
+            continue;
+
+        timer.add("evaluation", times.evaluation);
+        timer.add("compaction", times.compaction);
+        timer.add("total", times.evaluation + times.compaction);
+    }
+
+    auto measurements = timer.getMeasurements(parameters);
+    for (auto &measurement : measurements)
+    {
+        measurement.candidate_count = static_cast<double>(statistics.candidate_count);
+        measurement.instance_count = static_cast<double>(bins.elements.size());
+        measurement.working_memory = getCPUWorkingMemory(statistics);
+        measurement.peak_memory = getPeakMemoryUsage();
+    }
+
+    return measurements;
+}
+
+void writeReport(std::ostream &out, const std::vector<Measurement> &measurements, const Options &options)
+{
+    nlohmann::ordered_json results = nlohmann::ordered_json::array();
+    for (const Measurement &m : measurements)
+        results.push_back({{"key", m.getKey()},
+                           {"backend", m.parameters.backend},
+                           {"stage", m.stage},
+                           {"size", m.parameters.size},
+                           {"footprint", m.parameters.footprint},
+                           {"classes", m.parameters.class_count},
+                           {"fill", m.parameters.fill_ratio},
+                           {"seed", m.parameters.seed},
+                           {"median_ms", m.median_ms},
+                           {"min_ms", m.min_ms},
+                           {"max_ms", m.max_ms},
+                           {"candidates", m.candidate_count},
+                           {"instances", m.instance_count},
+                           {"candidates_per_s", m.getCandidateThroughput()},
+                           {"instances_per_s", m.getInstanceThroughput()},
+                           {"working_memory_bytes", m.working_memory},
+                           {"peak_memory_bytes", m.peak_memory}});
+
+    const nlohmann::ordered_json report {{"version", 1}, {"repetitions", options.repetitions}, {"results", results}};
+    out << report.dump(2) << '\n';
+}
+
+/// Print regressions against a baseline report. @return the number of regressions.
+std::size_t compareWithBaseline(const std::vector<Measurement> &measurements, const std::string &baseline_path,
+                                double threshold)
+{
+    std::ifstream file {baseline_path};
+    if (!file)
+        throw std::runtime_error("could not open baseline " + baseline_path);
+
+    const nlohmann::json baseline = nlohmann::json::parse(file);
+
+    std::map<std::string, double> baseline_times;
+    for (const auto &result : baseline.value("results", nlohmann::json::array()))
+        baseline_times[result.value("key", "")] = result.value("median_ms", 0.0);
+
+    std::size_t regression_count = 0;
+    std::size_t missing_count = 0;
+
+    std::cout << "\nComparison with " << baseline_path << " (threshold " << threshold * 100.0 << "%)\n";
+    for (const auto &measurement : measurements)
+    {
+        const auto it = baseline_times.find(measurement.getKey());
+        if (it == baseline_times.end() || it->second <= 0.0)
+        {
+            missing_count++;
+            continue;
+        }
+
+        const double ratio = measurement.median_ms / it->second;
+        if (ratio > 1.0 + threshold)
+        {
+            regression_count++;
+            std::cout << "  REGRESSION " << measurement.getKey() << ": " << it->second << " ms -> "
+                      << measurement.median_ms << " ms (+" << (ratio - 1.0) * 100.0 << "%)\n";
+        }
+    }
+
+    std::cout << "  " << regression_count << " regressions, " << missing_count << " cases not in the baseline\n";
+
+    return regression_count;
+}
+
+void printMeasurement(const Measurement &m)
+{
+    std::cout << std::left << std::setw(14) << m.parameters.backend << std::setw(12) << m.stage << std::right
+              << std::setw(8) << m.parameters.size << std::setw(8) << m.parameters.footprint
+              << std::setw(8) << m.parameters.class_count << std::setw(7) << m.parameters.fill_ratio
+              << std::setw(6) << m.parameters.seed << std::fixed << std::setprecision(3)
+              << std::setw(12) << m.median_ms << std::setprecision(0)
+              << std::setw(16) << m.getCandidateThroughput() << std::setw(16) << m.getInstanceThroughput()
+              << std::setw(10) << m.peak_memory / (1024 * 1024) << std::defaultfloat << std::setprecision(6) << '\n';
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+        const float world_size = *std::max_element(options.sizes.begin(), options.sizes.end());
+
+        GLFWContext context {"pplib-bench"};
+        BenchmarkScene scene;
+        PlacementPipeline pipeline;
+        cpu::PlacementPipeline cpu_pipeline;
+
+        std::cout << std::left << std::setw(14) << "backend" << std::setw(12) << "stage" << std::right
+                  << std::setw(8) << "size" << std::setw(8) << "fprint" << std::setw(8) << "classes"
+                  << std::setw(7) << "fill" << std::setw(6) << "seed" << std::setw(12) << "median ms"
+                  << std::setw(16) << "candidates/s" << std::setw(16) << "instances/s" << std::setw(10) << "peak MiB"
+                  << '\n';
+
+        std::vector<Measurement> measurements;
+
+        for (const auto &backend : options.backends)
+            for (float size : options.sizes)
+                for (float footprint : options.footprints)
+                    for (uint class_count : options.class_counts)
+                        for (float fill_ratio : options.fill_ratios)
+                            for (uint seed : options.seeds)
+                            {
+                                const BenchmarkCase parameters {backend, size, footprint, class_count, fill_ratio, seed};
+
+                                std::vector<Measurement> case_measurements;
+                                if (backend == "gl")
+                                    case_measurements = runGPUCase(pipeline, scene, parameters, options, world_size);
+                                else if (backend == "cpu")
+                                    case_measurements = runCPUCase(std::execution::seq, cpu_pipeline, scene,
+                                                                   parameters, options, world_size);
+#ifdef PLACEMENT_BENCHMARK_MULTITHREAD
+                                else
+                                    case_measurements = runCPUCase(std::execution::par_unseq, cpu_pipeline, scene,
+                                                                   parameters, options, world_size);
+#endif
+
+                                for (const auto &measurement : case_measurements)
+                                    printMeasurement(measurement);
+
+                                measurements.insert(measurements.end(), case_measurements.begin(),
+                                                    case_measurements.end());
+                            }
+
+        if (!options.output_path.empty())
+        {
+            std::ofstream file {options.output_path};
+            if (!file)
+                throw std::runtime_error("could not open output file " + options.output_path);
+            writeReport(file, measurements, options);
+        }
+
+        if (!options.baseline_path.empty()
+            && compareWithBaseline(measurements, options.baseline_path, options.threshold) > 0)
+            return 2;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "pplib-bench: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "bench_common.hpp"
+
+#include "placement/placement.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+GladGLContext gl;
+
+namespace placement::bench {
+
+std::size_t getPeakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::size_t getCPUWorkingMemory(const PlacementStatistics &statistics)
+{
+    return static_cast<std::size_t>(statistics.candidate_count + statistics.getElementCount())
+           * sizeof(cpu::ResultElement);
+}
+
+GLFWContext::GLFWContext(const char *window_title)
+{
+    if (!glfwInit())
+    {
+        const char *msg = nullptr;
+        glfwGetError(&msg);
+        throw std::runtime_error(msg);
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    m_window = glfwCreateWindow(1, 1, window_title, nullptr, nullptr);
+    if (!m_window)
+    {
+        const char *msg = nullptr;
+        glfwGetError(&msg);
+        glfwTerminate();
+        throw std::runtime_error(msg);
+    }
+    glfwMakeContextCurrent(m_window);
+
+    if (!gladLoadGLContext(&gl, glfwGetProcAddress) or !placement::loadGLContext(glfwGetProcAddress))
+        throw std::runtime_error("OpenGL context loading failed");
+}
+
+GLFWContext::~GLFWContext()
+{
+    glfwDestroyWindow(m_window);
+    glfwTerminate();
+}
+
+} // placement::bench
@@ -0,0 +1,134 @@
+#ifndef PROCEDURALPLACEMENTLIB_BENCH_COMMON_HPP
+#define PROCEDURALPLACEMENTLIB_BENCH_COMMON_HPP
+
+#include "placement/placement_pipeline.hpp"
+
+#include "../example/cpu-placement.hpp"
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/// GL functions of the benchmark executables, as opposed to those loaded by the library.
+extern GladGLContext gl;
+
+namespace placement::bench {
+
+/// Peak resident set size of the process so far, in bytes.
+std::size_t getPeakMemoryUsage();
+
+/// Bytes of host memory used by a CPU placement operation, for its candidates and its binned elements.
+std::size_t getCPUWorkingMemory(const PlacementStatistics &statistics);
+
+/// Synthetic terrain shared by all backends, so that results don't depend on asset files.
+class BenchmarkScene
+{
+public:
+    static constexpr glm::uvec2 heightmap_size {512, 512};
+
+    BenchmarkScene()
+            : m_heightmap_image(heightmap_size, s_makeHeightmap()),
+              m_density_image({1, 1}, {1.0f})
+    {
+        m_heightmap_texture = s_makeTexture(m_heightmap_image);
+        m_density_texture = s_makeTexture(m_density_image);
+    }
+
+    ~BenchmarkScene()
+    {
+        gl.DeleteTextures(1, &m_heightmap_texture);
+        gl.DeleteTextures(1, &m_density_texture);
+    }
+
+    BenchmarkScene(const BenchmarkScene&) = delete;
+    BenchmarkScene &operator=(const BenchmarkScene&) = delete;
+
+    /// The world covers the largest region of the sweep, so every case samples the same terrain.
+    [[nodiscard]] WorldData getWorldData(float world_size) const
+    { return {{world_size, world_size, 100.0f}, m_heightmap_texture}; }
+
+    [[nodiscard]] WorldData getWorldData(glm::vec3 world_scale) const
+    { return {world_scale, m_heightmap_texture}; }
+
+    /// A constant density of 1.
+    [[nodiscard]] GLuint getDensityTexture() const { return m_density_texture; }
+
+    /// Every class gets the same constant density, adding up to @p fill_ratio.
+    [[nodiscard]] LayerData getLayerData(float footprint, uint class_count, float fill_ratio) const
+    {
+        LayerData layer_data {footprint, {}};
+        for (uint i = 0; i < class_count; i++)
+        {
+            auto &density_map = layer_data.densitymaps.emplace_back();
+            density_map.texture = m_density_texture;
+            density_map.scale = fill_ratio / static_cast<float>(class_count);
+        }
+        return layer_data;
+    }
+
+    /// The world of getWorldData() for the CPU pipeline.
+    [[nodiscard]] cpu::WorldData getCPUWorldData(glm::vec3 world_scale) const
+    { return {world_scale, &m_heightmap_image}; }
+
+    /// @p layer_data for the CPU pipeline, with the constant density image in place of the textures.
+    [[nodiscard]] cpu::LayerData getCPULayerData(const LayerData &layer_data) const
+    {
+        cpu::LayerData cpu_layer_data {layer_data.footprint, {}};
+        for (const auto &density_map : layer_data.densitymaps)
+            cpu_layer_data.densitymaps.push_back({&m_density_image, density_map.scale, density_map.offset,
+                                                  density_map.min_value, density_map.max_value});
+        return cpu_layer_data;
+    }
+
+private:
+    cpu::GrayscaleImage m_heightmap_image;
+    cpu::GrayscaleImage m_density_image;
+    GLuint m_heightmap_texture {0};
+    GLuint m_density_texture {0};
+
+    static std::vector<float> s_makeHeightmap()
+    {
+        std::vector<float> values;
+        values.reserve(heightmap_size.x * heightmap_size.y);
+        for (uint y = 0; y < heightmap_size.y; y++)
+            for (uint x = 0; x < heightmap_size.x; x++)
+            {
+                const glm::vec2 uv = glm::vec2(x, y) / glm::vec2(heightmap_size);
+                values.push_back(0.5f + 0.25f * std::sin(uv.x * 25.0f) * std::cos(uv.y * 17.0f));
+            }
+        return values;
+    }
+
+    static GLuint s_makeTexture(const cpu::GrayscaleImage &image)
+    {
+        GLuint texture;
+        gl.CreateTextures(GL_TEXTURE_2D, 1, &texture);
+        gl.TextureStorage2D(texture, 1, GL_R32F, image.getSize().x, image.getSize().y);
+        gl.TextureSubImage2D(texture, 0, 0, 0, image.getSize().x, image.getSize().y, GL_RED, GL_FLOAT, image.data());
+        gl.TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gl.TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+};
+
+class GLFWContext
+{
+public:
+    /// Create a hidden window with a current context, and load the GL functions of the application and of the library.
+    explicit GLFWContext(const char *window_title);
+
+    ~GLFWContext();
+
+    GLFWContext(const GLFWContext&) = delete;
+    GLFWContext &operator=(const GLFWContext&) = delete;
+
+private:
+    GLFWwindow *m_window {nullptr};
+};
+
+} // placement::bench
+
+#endif //PROCEDURALPLACEMENTLIB_BENCH_COMMON_HPP
@@ -0,0 +1,478 @@
+#include "placement/placement_pipeline.hpp"
+
+#include "bench_common.hpp"
+
+#include "../example/external/json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace placement;
+using namespace placement::bench;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+const char *const usage = R"(Usage: pplib-replay <recording> [options]
+
+Replays the placement requests of a recording made with RequestRecorder, issuing each one at its recorded time, and
+reports request latency percentiles, throughput and memory high-water marks. Latency is measured from the time a request
+was due, so requests delayed by earlier ones, e.g. in a burst, count the wait. Density maps sample a constant density,
+with the recorded scale, offset and range, and the heightmap is synthetic.
+
+Options:
+  --backends LIST     Backends to replay on, among gl, cpu and, if available, cpu-parallel. Default: gl
+  --speed X           Time scale of the recording; 2 replays it twice as fast, 0 issues requests as soon as possible.
+                      Default: 1
+  --max-in-flight N   Maximum number of GL requests in flight, i.e. issued but not read. Default: 4
+  --repetitions N     Number of times to replay the recording on each backend. Default: 1
+  --output FILE       Write a JSON report to FILE.
+)";
+
+struct Options
+{
+    std::string recording_path;
+    std::vector<std::string> backends {"gl"};
+    double speed {1.0};
+    uint max_in_flight {4};
+    uint repetitions {1};
+    std::string output_path;
+};
+
+std::vector<std::string> parseBackends(const std::string &text)
+{
+    std::vector<std::string> backends;
+    std::istringstream stream {text};
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+#ifdef PLACEMENT_BENCHMARK_MULTITHREAD
+        if (item != "gl" && item != "cpu" && item != "cpu-parallel")
+#else
+        if (item != "gl" && item != "cpu")
+#endif
+            throw std::invalid_argument("unknown or unavailable backend " + item);
+        backends.push_back(item);
+    }
+
+    if (backends.empty())
+        throw std::invalid_argument("empty list");
+
+    return backends;
+}
+
+template<typename T>
+T parseValue(const std::string &name, const std::string &text)
+{
+    std::istringstream stream {text};
+    T value;
+    if (!(stream >> value))
+        throw std::invalid_argument("invalid value for option " + name + ": " + text);
+    return value;
+}
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string name = argv[i];
+
+        if (name == "--help" || name == "-h")
+        {
+            std::cout << usage;
+            std::exit(0);
+        }
+
+        if (name.rfind("--", 0) != 0)
+        {
+            if (!options.recording_path.empty())
+                throw std::invalid_argument("more than one recording");
+            options.recording_path = name;
+            continue;
+        }
+
+        if (i + 1 == argc)
+            throw std::invalid_argument("missing value for option " + name);
+
+        const std::string value = argv[++i];
+
+        if (name == "--backends")
+            options.backends = parseBackends(value);
+        else if (name == "--speed")
+            options.speed = std::max(0.0, parseValue<double>(name, value));
+        else if (name == "--max-in-flight")
+            options.max_in_flight = std::max(1u, parseValue<uint>(name, value));
+        else if (name == "--repetitions")
+            options.repetitions = std::max(1u, parseValue<uint>(name, value));
+        else if (name == "--output")
+            options.output_path = value;
+        else
+            throw std::invalid_argument("unknown option " + name);
+    }
+
+    if (options.recording_path.empty())
+        throw std::invalid_argument("no recording, see --help");
+
+    return options;
+}
+
+/// RequestRecorder writes NaN as null, since JSON has no literal for it.
+float readFloat(const nlohmann::json &value, float default_value)
+{
+    if (value.is_null())
+        return std::numeric_limits<float>::quiet_NaN();
+
+    return value.is_number() ? value.get<float>() : default_value;
+}
+
+float readFloat(const nlohmann::json &object, const char *key, float default_value = 0.0f)
+{
+    const auto it = object.find(key);
+    return it != object.end() ? readFloat(*it, default_value) : default_value;
+}
+
+template<typename Vector>
+Vector readVector(const nlohmann::json &object, const char *key)
+{
+    Vector v {0.0f};
+    const auto it = object.find(key);
+    if (it != object.end() && it->is_array())
+        for (int i = 0; i < Vector::length() && i < static_cast<int>(it->size()); i++)
+            v[i] = readFloat((*it)[i], 0.0f);
+    return v;
+}
+
+/// The elements of the array member named @p key, or an empty array if there is no such member.
+const nlohmann::json &readArray(const nlohmann::json &object, const char *key)
+{
+    static const nlohmann::json empty = nlohmann::json::array();
+    const auto it = object.find(key);
+    return it != object.end() && it->is_array() ? *it : empty;
+}
+
+/// The requests of a recording written by RequestRecorder::write().
+std::vector<RecordedRequest> loadRecording(const std::string &path)
+{
+    std::ifstream file {path};
+    if (!file)
+        throw std::runtime_error("could not open recording " + path);
+
+    const nlohmann::json document = nlohmann::json::parse(file);
+
+    if (!document.is_object() || document.value("version", 0) != 1)
+        throw std::runtime_error("not a request recording, or unsupported version: " + path);
+
+    std::vector<RecordedRequest> requests;
+    for (const auto &value : readArray(document, "requests"))
+    {
+        RecordedRequest &request = requests.emplace_back();
+        request.time = std::chrono::duration_cast<Clock::duration>(Milliseconds(value.value("time_ms", 0.0)));
+        request.world_scale = readVector<glm::vec3>(value, "world_scale");
+        request.lower_bound = readVector<glm::vec2>(value, "lower_bound");
+        request.upper_bound = readVector<glm::vec2>(value, "upper_bound");
+        request.morton = value.value("morton", false);
+
+        for (const auto &layer_value : readArray(value, "layers"))
+        {
+            RecordedLayer &layer = request.layers.emplace_back();
+            layer.footprint = readFloat(layer_value, "footprint");
+            layer.seed = layer_value.value("seed", std::uint32_t{0});
+
+            for (const auto &map_value : readArray(layer_value, "density_maps"))
+                layer.density_maps.push_back({map_value.value("texture", GLuint{0}),
+                                              readFloat(map_value, "scale", 1.0f),
+                                              readFloat(map_value, "offset"),
+                                              readFloat(map_value, "min_value"),
+                                              readFloat(map_value, "max_value", 1.0f),
+                                              map_value.value("virtual_texture", false),
+                                              map_value.value("expression", false)});
+        }
+
+        if (request.layers.empty())
+            throw std::runtime_error("request without layers in " + path);
+    }
+
+    // requests recorded from several threads may be slightly out of order
+    std::stable_sort(requests.begin(), requests.end(), [](const RecordedRequest &a, const RecordedRequest &b)
+    {
+        return a.time < b.time;
+    });
+
+    return requests;
+}
+
+/// Layers of a request, with the constant density texture of the scene in place of the recorded textures.
+std::vector<LayerData> makeLayers(const BenchmarkScene &scene, const RecordedRequest &request)
+{
+    std::vector<LayerData> layers;
+    for (const auto &recorded_layer : request.layers)
+    {
+        LayerData &layer = layers.emplace_back();
+        layer.footprint = recorded_layer.footprint;
+        layer.seed = recorded_layer.seed;
+
+        for (const auto &recorded_map : recorded_layer.density_maps)
+        {
+            DensityMap &density_map = layer.densitymaps.emplace_back();
+            density_map.texture = scene.getDensityTexture();
+            density_map.scale = recorded_map.scale;
+            density_map.offset = recorded_map.offset;
+            density_map.min_value = recorded_map.min_value;
+            density_map.max_value = recorded_map.max_value;
+        }
+    }
+    return layers;
+}
+
+/// Measurements of a replay of the whole recording on one backend.
+struct ReplayReport
+{
+    std::string backend;
+    uint repetition {0};
+    std::vector<double> latencies_ms;   ///< one per request, in order of issue.
+    double wall_time_ms {0.0};
+    double element_count {0.0};
+    std::size_t working_memory_high_water {0};  ///< Bytes of placement buffers alive at once, host or device.
+    std::size_t peak_memory {0};                ///< Peak resident memory of the process after the replay.
+
+    /// Nearest rank percentile of the latencies, @p p in [0, 1].
+    [[nodiscard]] double getLatencyPercentile(double p) const
+    {
+        if (latencies_ms.empty())
+            return 0.0;
+
+        std::vector<double> sorted = latencies_ms;
+        std::sort(sorted.begin(), sorted.end());
+        const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    [[nodiscard]] double getRequestThroughput() const
+    { return wall_time_ms > 0.0 ? static_cast<double>(latencies_ms.size()) / (wall_time_ms * 1e-3) : 0.0; }
+
+    [[nodiscard]] double getElementThroughput() const
+    { return wall_time_ms > 0.0 ? element_count / (wall_time_ms * 1e-3) : 0.0; }
+};
+
+/// When request @p request is due, relative to the start of the replay.
+Clock::duration getDueTime(const RecordedRequest &request, const Options &options)
+{
+    if (options.speed == 0.0)
+        return Clock::duration::zero();
+
+    return std::chrono::duration_cast<Clock::duration>(request.time / options.speed);
+}
+
+ReplayReport replayGL(PlacementPipeline &pipeline, const BenchmarkScene &scene,
+                      const std::vector<RecordedRequest> &requests, const Options &options)
+{
+    struct PendingRequest
+    {
+        Clock::time_point due_time;
+        FutureResult future_result;
+        GLsizeiptr buffer_size;
+    };
+
+    ReplayReport report;
+    std::deque<PendingRequest> pending;
+    std::size_t in_flight_memory = 0;
+
+    const auto start_time = Clock::now();
+    std::size_t next = 0;
+
+    while (next < requests.size() || !pending.empty())
+    {
+        // issue the requests that are due, as long as there is room in flight
+        while (next < requests.size() && pending.size() < options.max_in_flight
+               && Clock::now() >= start_time + getDueTime(requests[next], options))
+        {
+            const RecordedRequest &request = requests[next];
+            pipeline.setElementOrder(request.morton ? PlacementPipeline::ElementOrder::morton
+                                                    : PlacementPipeline::ElementOrder::unspecified);
+
+            FutureResult future_result = pipeline.computePlacement(scene.getWorldData(request.world_scale),
+                                                                   makeLayers(scene, request),
+                                                                   request.lower_bound, request.upper_bound);
+            const GLsizeiptr buffer_size = future_result.getResultBuffer().size;
+            pending.push_back({start_time + getDueTime(request, options), std::move(future_result), buffer_size});
+
+            in_flight_memory += static_cast<std::size_t>(buffer_size);
+            report.working_memory_high_water = std::max(report.working_memory_high_water,
+                                                        in_flight_memory + pipeline.getTransientBufferSize());
+            next++;
+        }
+
+        // operations complete in order of submission
+        bool completed = false;
+        while (!pending.empty() && pending.front().future_result.isReady())
+        {
+            const Result result = pending.front().future_result.readResult();
+            report.latencies_ms.push_back(Milliseconds(Clock::now() - pending.front().due_time).count());
+            report.element_count += result.getElementArrayLength();
+
+            in_flight_memory -= static_cast<std::size_t>(pending.front().buffer_size);
+            pending.pop_front();
+            completed = true;
+        }
+
+        if (!completed)
+            std::this_thread::yield();
+    }
+
+    report.wall_time_ms = Milliseconds(Clock::now() - start_time).count();
+    return report;
+}
+
+template<typename ExecutionPolicy>
+ReplayReport replayCPU(const ExecutionPolicy &policy, cpu::PlacementPipeline &pipeline, const BenchmarkScene &scene,
+                       const std::vector<RecordedRequest> &requests, const Options &options)
+{
+    ReplayReport report;
+
+    const auto start_time = Clock::now();
+
+    for (const auto &request : requests)
+    {
+        const auto due_time = start_time + getDueTime(request, options);
+        std::this_thread::sleep_until(due_time);
+
+        const cpu::WorldData world_data = scene.getCPUWorldData(request.world_scale);
+        std::size_t working_memory = 0;
+
+        // the CPU pipeline computes one layer at a time
+        for (const LayerData &layer_data : makeLayers(scene, request))
+        {
+            pipeline.setRandomSeed(*layer_data.seed);
+
+            PlacementStatistics statistics;
+            const auto bins = pipeline.computePlacement(policy, world_data, scene.getCPULayerData(layer_data),
+                                                        request.lower_bound, request.upper_bound, statistics);
+
+            report.element_count += static_cast<double>(bins.elements.size());
+            working_memory += getCPUWorkingMemory(statistics);
+        }
+
+        report.latencies_ms.push_back(Milliseconds(Clock::now() - due_time).count());
+        report.working_memory_high_water = std::max(report.working_memory_high_water, working_memory);
+    }
+
+    report.wall_time_ms = Milliseconds(Clock::now() - start_time).count();
+    return report;
+}
+
+void writeReport(std::ostream &out, const std::vector<ReplayReport> &reports, const Options &options,
+                 std::size_t request_count)
+{
+    nlohmann::ordered_json results = nlohmann::ordered_json::array();
+    for (const ReplayReport &r : reports)
+        results.push_back({{"backend", r.backend},
+                           {"repetition", r.repetition},
+                           {"wall_time_ms", r.wall_time_ms},
+                           {"latency_p50_ms", r.getLatencyPercentile(0.5)},
+                           {"latency_p90_ms", r.getLatencyPercentile(0.9)},
+                           {"latency_p99_ms", r.getLatencyPercentile(0.99)},
+                           {"latency_max_ms", r.getLatencyPercentile(1.0)},
+                           {"requests_per_s", r.getRequestThroughput()},
+                           {"instances", r.element_count},
+                           {"instances_per_s", r.getElementThroughput()},
+                           {"working_memory_high_water_bytes", r.working_memory_high_water},
+                           {"peak_memory_bytes", r.peak_memory}});
+
+    const nlohmann::ordered_json report {{"version", 1},
+                                         {"recording", options.recording_path},
+                                         {"requests", request_count},
+                                         {"speed", options.speed},
+                                         {"max_in_flight", options.max_in_flight},
+                                         {"results", results}};
+    out << report.dump(2) << '\n';
+}
+
+void printReport(const ReplayReport &r)
+{
+    std::cout << std::left << std::setw(14) << r.backend << std::right << std::setw(5) << r.repetition
+              << std::fixed << std::setprecision(3)
+              << std::setw(12) << r.getLatencyPercentile(0.5) << std::setw(12) << r.getLatencyPercentile(0.9)
+              << std::setw(12) << r.getLatencyPercentile(0.99) << std::setw(12) << r.getLatencyPercentile(1.0)
+              << std::setprecision(1) << std::setw(12) << r.getRequestThroughput() << std::setprecision(0)
+              << std::setw(16) << r.getElementThroughput()
+              << std::setw(10) << r.working_memory_high_water / (1024 * 1024)
+              << std::setw(10) << r.peak_memory / (1024 * 1024) << std::defaultfloat << std::setprecision(6) << '\n';
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+        const std::vector<RecordedRequest> requests = loadRecording(options.recording_path);
+
+        GLFWContext context {"pplib-replay"};
+        BenchmarkScene scene;
+        PlacementPipeline pipeline;
+        pipeline.waitUntilReady();
+        cpu::PlacementPipeline cpu_pipeline;
+
+        std::cout << requests.size() << " requests, "
+                  << (requests.empty() ? 0.0 : Milliseconds(requests.back().time).count()) << " ms recorded\n";
+        std::cout << std::left << std::setw(14) << "backend" << std::right << std::setw(5) << "rep"
+                  << std::setw(12) << "p50 ms" << std::setw(12) << "p90 ms" << std::setw(12) << "p99 ms"
+                  << std::setw(12) << "max ms" << std::setw(12) << "requests/s" << std::setw(16) << "instances/s"
+                  << std::setw(10) << "work MiB" << std::setw(10) << "peak MiB" << '\n';
+
+        std::vector<ReplayReport> reports;
+
+        for (const auto &backend : options.backends)
+            for (uint repetition = 0; repetition < options.repetitions; repetition++)
+            {
+                ReplayReport report;
+                if (backend == "gl")
+                    report = replayGL(pipeline, scene, requests, options);
+                else if (backend == "cpu")
+                    report = replayCPU(std::execution::seq, cpu_pipeline, scene, requests, options);
+#ifdef PLACEMENT_BENCHMARK_MULTITHREAD
+                else
+                    report = replayCPU(std::execution::par_unseq, cpu_pipeline, scene, requests, options);
+#endif
+
+                report.backend = backend;
+                report.repetition = repetition;
+                report.peak_memory = getPeakMemoryUsage();
+
+                printReport(report);
+                reports.push_back(std::move(report));
+            }
+
+        if (!options.output_path.empty())
+        {
+            std::ofstream file {options.output_path};
+            if (!file)
+                throw std::runtime_error("could not open output file " + options.output_path);
+            writeReport(file, reports, options, requests.size());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "pplib-replay: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -7,6 +7,7 @@
 #endif
 
 #include "example-common.hpp"
+#include "placement/placement_trace.hpp"
 
 #include "simple-renderer/renderer.hpp"
 #include "simple-renderer/instanced_mesh.hpp"
@@ -758,8 +759,12 @@ int main(int argc, char* argv[])
 
     GL::Texture::bindTextureUnit(color_texture_unit, color_texture.getGLObject());
 
+    // frames and placement operations on one timeline, to correlate placement with frame time spikes
+    const auto trace_writer = std::make_shared<placement::ChromeTraceWriter>();
+
     placement::PlacementPipeline pipeline;
 #ifndef CPU_PLACEMENT
+    pipeline.setTraceSink(trace_writer);
     pipeline.setBaseTextureUnit(glm::max(heightmap_texture_unit, color_texture_unit) + 1);
 #endif
 
@@ -927,6 +932,7 @@ int main(int argc, char* argv[])
 
     while (!glfwWindowShouldClose(window.get()))
     {
+        placement::ScopedTraceSpan frame_span {trace_writer.get(), "frame"};
         log_event("frame_start");
 
         glfwPollEvents();
@@ -1172,4 +1178,9 @@ int main(int argc, char* argv[])
 
     std::ofstream log_file { std::filesystem::path(argv[0]).stem() += ".json" };
     log_file << log_json;
+
+#ifndef CPU_PLACEMENT
+    pipeline.flushTrace();
+#endif
+    trace_writer->writeFile(std::filesystem::path(argv[0]).stem() += ".trace.json");
 }
\ No newline at end of file
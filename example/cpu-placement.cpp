@@ -1,56 +1,58 @@
 #include "cpu-placement.hpp"
 
-#include "placement/kernel/generation_kernel.hpp"
 #include "placement/kernel/evaluation_kernel.hpp"
-#include "../src/disk_distribution_generator.hpp"
+#include "placement/work_group_pattern_library.hpp"
+
+#include "glm/glm.hpp"
 
 #include "stb_image.h"
 
 #include <array>
 #include <algorithm>
-#include <execution>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 
-namespace placement {
+namespace placement::cpu {
 
-GrayscaleImage::GrayscaleImage(const char *filename) : m_data(stbi_load(filename, &m_size.x, &m_size.y, nullptr, 1))
+GrayscaleImage::GrayscaleImage(const char *filename)
 {
-    if (!m_data)
+    glm::ivec2 size {0};
+    const std::unique_ptr<stbi_uc[], void (*)(void*)> data {stbi_load(filename, &size.x, &size.y, nullptr, 1),
+                                                            stbi_image_free};
+    if (!data)
         throw std::runtime_error(stbi_failure_reason());
+
+    m_size = glm::uvec2(size);
+    m_values.resize(m_size.x * m_size.y);
+    for (std::size_t i = 0; i < m_values.size(); i++)
+        m_values[i] = static_cast<float>(data[i]) / static_cast<float>(std::numeric_limits<stbi_uc>::max());
 }
 
-float GrayscaleImage::sample(glm::vec2 tex_coord) const
+GrayscaleImage::GrayscaleImage(glm::uvec2 size, std::vector<float> values) : m_size(size), m_values(std::move(values))
 {
-    const glm::ivec2 pixel_index = glm::clamp(tex_coord, {0, 0}, {1, 1}) * glm::vec2(m_size);
-    const stbi_uc value = m_data[pixel_index.y * m_size.x + pixel_index.x];
-    return static_cast<float>(value) / static_cast<float>(std::numeric_limits<stbi_uc>::max());
+    if (m_values.size() != std::size_t(m_size.x) * m_size.y)
+        throw std::invalid_argument("the number of values doesn't match the size of the image");
 }
 
-void GrayscaleImage::DataDeleter::operator()(void *ptr) const
+float GrayscaleImage::sample(glm::vec2 tex_coord) const
 {
-    stbi_image_free(ptr);
+    const glm::uvec2 texel = glm::min(glm::uvec2(glm::clamp(tex_coord, 0.0f, 1.0f) * glm::vec2(m_size)), m_size - 1u);
+    return m_values[texel.y * m_size.x + texel.x];
 }
 
-Result::Result(std::vector<Element> elements) : m_elements(std::move(elements))
+Result::Result(std::vector<Element> elements, const std::vector<std::size_t> &class_offsets,
+               PlacementStatistics statistics)
+    : m_elements(std::move(elements)), m_statistics(std::move(statistics))
 {
-    const auto findLayerStart = [](uint layer_index, auto begin, auto end)
-    {
-        return std::find_if(begin, end,
-                            [layer_index](const Element &e)
-                            { return e.class_index == layer_index; });
-    };
-
-    for (auto iter = m_elements.cbegin(); iter != m_elements.cend();
-         iter = findLayerStart(m_layer_iters.size(), iter, m_elements.cend()))
-    {
-        m_layer_iters.emplace_back(iter);
-    }
-
-    m_layer_iters.emplace_back(m_elements.cend());
+    for (const auto offset : class_offsets)
+        m_layer_iters.emplace_back(m_elements.cbegin() + offset);
 }
 
 auto Result::getClassElements(uint layer_index) const -> std::pair<ConstElementIterator, ConstElementIterator>
 {
-    if (layer_index >= m_layer_iters.size())
+    if (layer_index >= getNumClasses())
         throw std::out_of_range("layer index out of range");
 
     return std::make_pair(m_layer_iters[layer_index], m_layer_iters[layer_index + 1]);
@@ -65,10 +67,10 @@ uint Result::getClassElementCount(uint layer_index) const
 
 const Result::Element *Result::getClassElementData(uint layer_index) const
 {
-    if (layer_index >= m_layer_iters.size())
+    if (layer_index >= getNumClasses())
         throw std::out_of_range("layer index out of range");
 
-    return &(*m_layer_iters[layer_index]);
+    return m_elements.data() + (m_layer_iters[layer_index] - m_elements.cbegin());
 }
 
 FutureResult::FutureResult(std::shared_ptr<ResultBuffer> result_buffer) : m_buffer(std::move(result_buffer))
@@ -85,23 +87,39 @@ Result FutureResult::readResult()
         m_buffer->m_cond.wait(lock, [this]
         { return isReady(); });
 
-    return Result(std::move(m_buffer->m_values));
+    return Result(std::move(m_buffer->m_values), m_buffer->m_class_offsets, m_buffer->m_statistics);
 }
 
-PlacementPipeline::PlacementPattern PlacementPipeline::generatePlacementPattern(uint seed)
+PlacementStatistics PlacementPipeline::s_makeStatistics(std::size_t candidate_count,
+                                                        PlacementStatistics::uint64 out_of_bounds_count,
+                                                        const std::vector<std::size_t> &class_offsets)
 {
-    WorkGroupPattern pattern;
+    PlacementStatistics statistics;
+    statistics.operation_count = 1;
+    statistics.candidate_count = candidate_count;
+    statistics.out_of_bounds_count = out_of_bounds_count;
+    statistics.element_capacity = candidate_count;
 
-    placement::DiskDistributionGenerator generator{1.0f, glm::uvec2(16)};
-    generator.setSeed(seed);
-    generator.setMaxAttempts(100);
+    for (std::size_t i = 0; i + 1 < class_offsets.size(); i++)
+        statistics.class_element_counts.push_back(class_offsets[i + 1] - class_offsets[i]);
 
-    for (auto &column: pattern)
-        for (auto &cell: column)
-            cell = generator.generate();
+    statistics.rejected_count = candidate_count - out_of_bounds_count - statistics.getElementCount();
+    return statistics;
+}
 
-    //auto [bounds, pattern] = generateWorkGroupPattern(seed);
-    return {generator.getGrid().getBounds(), pattern};
+PlacementPipeline::PlacementPattern PlacementPipeline::s_getPlacementPattern(uint seed)
+{
+    const auto &library = WorkGroupPatternLibrary::getDefault();
+    return {library.getBounds(), library.getSeedPattern(seed)};
+}
+
+void PlacementPipeline::setRandomSeed(uint seed)
+{
+    const PlacementPattern pattern = s_getPlacementPattern(seed);
+
+    std::lock_guard<std::mutex> lock {m_mutex};
+    m_random_seed = seed;
+    m_pattern = pattern;
 }
 
 PlacementPipeline::~PlacementPipeline()
@@ -118,7 +136,8 @@ FutureResult PlacementPipeline::computePlacement(WorldData world_data, LayerData
 
     {
         std::lock_guard<std::mutex> queue_lock {m_mutex};
-        m_queue.emplace_back(Request{world_data, std::move(layer_data), lower_bound, upper_bound, result_buffer});
+        m_queue.emplace_back(Request{world_data, std::move(layer_data), lower_bound, upper_bound, m_pattern,
+                                     result_buffer});
     }
     m_cond.notify_one();
 
@@ -148,111 +167,192 @@ void PlacementPipeline::threadLoop()
         constexpr auto execution_policy = std::execution::seq;
 #endif
 
-        auto result_values = computePlacement(execution_policy,
+        PlacementStatistics statistics;
+        auto result_bins = s_computePlacement(execution_policy, request.pattern,
                                               request.world_data, request.layer_data,
-                                              request.lower_bound, request.upper_bound);
+                                              request.lower_bound, request.upper_bound, statistics, nullptr);
+
+        {
+            std::lock_guard<std::mutex> statistics_lock {m_mutex};
+            m_statistics += statistics;
+        }
 
         auto &result_buffer = *request.result_buffer;
         {
             std::lock_guard<std::mutex> r_lock(result_buffer.m_mutex);
-            result_buffer.m_values = std::move(result_values);
+            result_buffer.m_values = std::move(result_bins.elements);
+            result_buffer.m_class_offsets = std::move(result_bins.class_offsets);
+            result_buffer.m_statistics = std::move(statistics);
             result_buffer.m_ready = true;
         }
         result_buffer.m_cond.notify_all();
     }
 }
 
-template<class ExecutionPolicy>
-std::vector<placement::Result::Element>
-PlacementPipeline::computePlacement(const ExecutionPolicy &policy, const WorldData &world_data,
-                                    const LayerData &layer_data, glm::vec2 lower_bound, glm::vec2 upper_bound)
+std::pair<glm::uvec2, glm::uvec2> PlacementPipeline::s_getWorkGroupRange(const PlacementPattern &pattern,
+                                                                         float footprint, glm::vec2 lower_bound,
+                                                                         glm::vec2 upper_bound)
 {
-    if (!world_data.heightmap)
-        throw std::logic_error("invalid world height map");
-
-    const glm::vec2 work_group_footprint{m_pattern.bounds * layer_data.footprint};
+    const glm::vec2 work_group_footprint{pattern.bounds * footprint};
     const glm::uvec2 base_offset{lower_bound / work_group_footprint};
     const glm::uvec2 num_work_groups{glm::uvec2((upper_bound - lower_bound) / work_group_footprint) + 1u};
 
-    const glm::uvec2 wg_size{m_pattern.array.size(), m_pattern.array.front().size()};
-
-    constexpr uint invalid_index = -1u;
-
-    std::vector<placement::Result::Element> candidates;
-    candidates.resize(num_work_groups.x * num_work_groups.y * wg_size.x * wg_size.y, {{0, 0, 0}, invalid_index});
+    return {base_offset, num_work_groups};
+}
 
-    std::vector<glm::uvec2> work_group_indices;
-    for (uint i = 0; i < num_work_groups.x; i++)
-        for (uint j = 0; j < num_work_groups.y; j++)
-            work_group_indices.emplace_back(i, j);
+PlacementStatistics PlacementPipeline::getStatistics()
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    return m_statistics;
+}
 
-    std::vector<glm::uvec2> invocation_indices;
-    for (uint i = 0; i < m_pattern.array.size(); i++)
-        for (uint j = 0; j < m_pattern.array.front().size(); j++)
-            invocation_indices.emplace_back(i, j);
+uint PlacementPipeline::s_evaluateWorkGroup(const PlacementPattern &pattern, const WorldData &world_data,
+                                            const LayerData &layer_data, glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                            glm::uvec2 work_group, ResultElement *candidates)
+{
+    constexpr uint invalid_index = -1u;
 
-    std::for_each(policy, work_group_indices.cbegin(), work_group_indices.cend(),
-                  [&, work_group_footprint, base_offset, num_work_groups, wg_size](glm::uvec2 wg_id)
-                  {
-                      const uint wg_array_index = (wg_id.x * num_work_groups.y + wg_id.y) * wg_size.x * wg_size.y;
-                      const glm::vec2 wg_offset = glm::vec2(base_offset + wg_id) * work_group_footprint;
+    const glm::uvec2 wg_size{pattern.array.size(), pattern.array.front().size()};
+    const glm::vec2 wg_offset = glm::vec2(work_group) * pattern.bounds * layer_data.footprint;
+    uint out_of_bounds_count = 0;
 
-                      std::for_each(policy, invocation_indices.cbegin(), invocation_indices.cend(),
-                                    [&, wg_array_index, wg_offset](glm::uvec2 inv_id)
-                                    {
-                                        const uint inv_array_index = wg_array_index + inv_id.x * wg_size.y + inv_id.y;
-                                        const glm::vec2 inv_position = wg_offset + m_pattern[inv_id.x][inv_id.y] * layer_data.footprint;
+    for (uint x = 0; x < wg_size.x; x++)
+        for (uint y = 0; y < wg_size.y; y++)
+        {
+            const glm::vec2 position = wg_offset + pattern.array[x][y] * layer_data.footprint;
+            const glm::vec2 candidate_uv{position / glm::vec2(world_data.scale)};
+
+            auto &candidate = candidates[x * wg_size.y + y];
+            candidate.position = {position, world_data.heightmap->sample(candidate_uv) * world_data.scale.z};
+            candidate.class_index = invalid_index;
+
+            if (glm::any(glm::lessThan(position, lower_bound))
+                || glm::any(glm::greaterThanEqual(position, upper_bound)))
+            {
+                out_of_bounds_count++;
+                continue;
+            }
+
+            const auto threshold = placement::EvaluationKernel::default_dithering_matrix[x][y];
+            float acc_density = 0.0f;
+
+            for (uint i = 0; i < layer_data.densitymaps.size(); i++)
+            {
+                const auto &d_map = layer_data.densitymaps[i];
+
+                if (!d_map.texture)
+                    throw std::logic_error("invalid density map!");
+
+                acc_density += glm::clamp(d_map.texture->sample(candidate_uv) * d_map.scale + d_map.offset,
+                                          d_map.min_value, d_map.max_value);
+                if (acc_density > threshold)
+                {
+                    candidate.class_index = i;
+                    break;
+                }
+            }
+        }
 
-                                        const glm::vec2 candidate_uv{inv_position / glm::vec2(world_data.scale)};
+    return out_of_bounds_count;
+}
 
-                                        auto &candidate = candidates[inv_array_index];
-                                        candidate.position = {inv_position,
-                                                              world_data.heightmap->sample(candidate_uv) * world_data.scale.z};
+PlacementStatistics PlacementPipeline::forEachTile(const WorldData &world_data, const LayerData &layer_data,
+                                                   glm::vec2 lower_bound, glm::vec2 upper_bound, const TileSink &sink,
+                                                   glm::uvec2 tile_size, uint thread_count) const
+{
+    if (!world_data.heightmap)
+        throw std::logic_error("invalid world height map");
 
-                                        if (glm::any(glm::lessThan(glm::vec2(candidate.position), lower_bound)) ||
-                                            glm::any(glm::greaterThanEqual(glm::vec2(candidate.position),
-                                                                           upper_bound)))
-                                            return;
+    if (glm::any(glm::equal(tile_size, glm::uvec2(0u))))
+        throw std::invalid_argument("tiles must contain at least one work group");
 
-                                        float acc_density = 0.0f;
+    const auto [base_offset, num_work_groups] = s_getWorkGroupRange(m_pattern, layer_data.footprint, lower_bound,
+                                                                    upper_bound);
+    const uint wg_candidate_count = m_pattern.array.size() * m_pattern.array.front().size();
+    const glm::uvec2 tile_count = (num_work_groups + tile_size - 1u) / tile_size;
 
-                                        const auto& dithering_matrix = placement::EvaluationKernel::default_dithering_matrix;
-                                        const auto threshold = dithering_matrix[inv_id.x][inv_id.y];
+    std::atomic<uint> next_tile {0};
+    std::atomic<bool> failed {false};
+    std::exception_ptr error;
+    std::mutex sink_mutex;
 
-                                        for (uint i = 0; i < layer_data.densitymaps.size(); i++)
-                                        {
-                                            const auto &d_map = layer_data.densitymaps[i];
+    PlacementStatistics statistics;
 
-                                            const auto *density_map = layer_data.densitymaps[i].texture;
+    const auto work = [&]()
+    {
+        // scratch memory of this thread, reused by all of its tiles
+        std::vector<ResultElement> candidates;
+        candidates.reserve(tile_size.x * tile_size.y * wg_candidate_count);
+        ClassBins<ResultElement> bins;
+        PlacementStatistics thread_statistics;
 
-                                            if (!density_map)
-                                                throw std::logic_error("invalid density map!");
+        try
+        {
+            for (uint i = next_tile++; i < tile_count.x * tile_count.y && !failed; i = next_tile++)
+            {
+                const glm::uvec2 tile {i % tile_count.x, i / tile_count.x};
+                const glm::uvec2 first_wg = tile * tile_size;
+                const glm::uvec2 wg_count = glm::min(first_wg + tile_size, num_work_groups) - first_wg;
+
+                candidates.resize(wg_count.x * wg_count.y * wg_candidate_count);
+                uint out_of_bounds_count = 0;
+                for (uint x = 0; x < wg_count.x; x++)
+                    for (uint y = 0; y < wg_count.y; y++)
+                        out_of_bounds_count += s_evaluateWorkGroup(m_pattern, world_data, layer_data, lower_bound,
+                                                                   upper_bound,
+                                                                   base_offset + first_wg + glm::uvec2(x, y),
+                                                                   &candidates[(x * wg_count.y + y)
+                                                                               * wg_candidate_count]);
+
+                binByClass(std::execution::seq, candidates, layer_data.densitymaps.size(), bins);
+                thread_statistics += s_makeStatistics(candidates.size(), out_of_bounds_count, bins.class_offsets);
+
+                std::lock_guard<std::mutex> lock {sink_mutex};
+                sink(tile, bins);
+            }
+
+            std::lock_guard<std::mutex> lock {sink_mutex};
+            statistics += thread_statistics;
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock {sink_mutex};
+            if (!error)
+                error = std::current_exception();
+            failed = true;
+        }
+    };
 
-                                            const float layer_density = glm::clamp(density_map->sample(candidate_uv)
-                                                                                   * d_map.scale + d_map.offset,
-                                                                                   d_map.min_value,
-                                                                                   d_map.max_value);
+    // the calling thread computes tiles as well
+    std::vector<std::thread> threads;
+    const auto join = [&]()
+    {
+        for (auto &thread : threads)
+            thread.join();
+    };
 
-                                            acc_density += layer_density;
-                                            if (acc_density > threshold && candidate.class_index == invalid_index)
-                                            {
-                                                candidate.class_index = i;
-                                                return;
-                                            }
-                                        }
-                                    });
-                  });
+    try
+    {
+        for (uint i = 1; i < thread_count; i++)
+            threads.emplace_back(work);
+    }
+    catch (...)
+    {
+        // threads that are still joinable when destroyed terminate the program
+        failed = true;
+        join();
+        throw;
+    }
 
-    std::sort(policy, candidates.begin(), candidates.end(),
-              [](const placement::Result::Element &l, const placement::Result::Element &r)
-              { return l.class_index < r.class_index; });
+    work();
+    join();
 
-    const auto invalid_begin = std::find_if(candidates.begin(), candidates.end(), [](const auto &candidate)
-    {
-        return candidate.class_index == invalid_index;
-    });
-    candidates.erase(invalid_begin, candidates.end());
+    if (error)
+        std::rethrow_exception(error);
 
-    return candidates;
+    // a single operation, however many tiles
+    statistics.operation_count = 1;
+    return statistics;
 }
-} // namespace placement
+
+} // placement::cpu
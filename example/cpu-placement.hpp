@@ -1,6 +1,9 @@
 #ifndef PROCEDURALPLACEMENTLIB_CPU_PLACEMENT_HPP
 #define PROCEDURALPLACEMENTLIB_CPU_PLACEMENT_HPP
 
+#include "../src/class_binning.hpp"
+#include "placement/placement_statistics.hpp"
+
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 
@@ -10,9 +13,19 @@
 #include <condition_variable>
 #include <thread>
 #include <array>
-
-namespace placement
-{
+#include <chrono>
+#include <execution>
+#include <functional>
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * A reference implementation of the placement pipeline running on the CPU, with the same algorithm and candidate
+ * patterns as the compute shaders. Its names mirror those of the library, in their own namespace so that both can be
+ * used by a single program, e.g. to compare them.
+ */
+namespace placement::cpu {
 
 struct ResultElement
 {
@@ -20,21 +33,25 @@ struct ResultElement
     uint class_index;
 };
 
+/// A single channel image sampled with nearest filtering, standing in for a GL texture.
 class GrayscaleImage
 {
 public:
     explicit GrayscaleImage(const char* filename);
 
+    /// An image of @p size texels, from its values in row-major order.
+    GrayscaleImage(glm::uvec2 size, std::vector<float> values);
+
     [[nodiscard]] glm::uvec2 getSize() const { return m_size; }
 
+    /// The values of the texels in row-major order, in [0, 1] for images loaded from a file.
+    [[nodiscard]] const float *data() const { return m_values.data(); }
+
     [[nodiscard]] float sample(glm::vec2 tex_coord) const;
 
 private:
-    using uchar = unsigned char;
-    struct DataDeleter { void operator() (void*) const; };
-
-    glm::ivec2 m_size {0};
-    std::unique_ptr<uchar[], DataDeleter> m_data;
+    glm::uvec2 m_size {0};
+    std::vector<float> m_values;
 };
 
 struct WorldData
@@ -64,6 +81,8 @@ struct ResultBuffer
     std::mutex m_mutex;
     std::condition_variable m_cond;
     std::vector<ResultElement> m_values;
+    std::vector<std::size_t> m_class_offsets;
+    PlacementStatistics m_statistics;
 };
 
 class Result
@@ -73,7 +92,9 @@ public:
     using ElementIterator = std::vector<Element>::iterator;
     using ConstElementIterator = std::vector<Element>::const_iterator;
 
-    explicit Result(std::vector<Element> elements);
+    /// @param class_offsets index of the first element of each class, followed by the number of elements.
+    Result(std::vector<Element> elements, const std::vector<std::size_t> &class_offsets,
+           PlacementStatistics statistics = {});
 
     [[nodiscard]] std::pair<ConstElementIterator, ConstElementIterator> getClassElements(uint layer_index) const;
 
@@ -87,9 +108,13 @@ public:
 
     [[nodiscard]] uint getElementArrayLength() const { return m_elements.size(); }
 
+    /// What happened to the candidates of the operation.
+    [[nodiscard]] const PlacementStatistics &getStatistics() const { return m_statistics; }
+
 private:
     std::vector<Element> m_elements;
     std::vector<std::vector<Element>::const_iterator> m_layer_iters;
+    PlacementStatistics m_statistics;
 };
 
 class FutureResult
@@ -115,15 +140,95 @@ public:
     FutureResult computePlacement(WorldData world_data, LayerData layer_data,
                                   glm::vec2 lower_bound, glm::vec2 upper_bound);
 
+    /// Receives the elements of a tile, grouped by class, which are only valid during the call.
+    using TileSink = std::function<void(glm::uvec2 tile, const ClassBins<ResultElement> &elements)>;
+
+    /**
+     * @brief Compute placement over a region tile by tile, without storing all of its candidates at once.
+     * Tiles of @p tile_size work groups are computed by @p thread_count threads, including the calling one, each
+     * reusing its own scratch memory, so peak memory depends on the number of threads and on the tile size rather than
+     * on the size of the region. Tiles are passed to @p sink one at a time, in no particular order, as they complete.
+     * Calls to @p sink are serialized, so the other threads wait for it once they finish their own tile: a sink that
+     * does more than copy the elements it needs slows down the whole operation. The threads are started by each call.
+     * @return the statistics of the whole region, counted by each thread separately.
+     */
+    PlacementStatistics forEachTile(const WorldData &world_data, const LayerData &layer_data,
+                                    glm::vec2 lower_bound, glm::vec2 upper_bound, const TileSink &sink,
+                                    glm::uvec2 tile_size = {8, 8},
+                                    uint thread_count = std::thread::hardware_concurrency()) const;
+
+    /// Time spent in each stage of a placement operation.
+    struct StageTimes
+    {
+        std::chrono::nanoseconds evaluation {0};    ///< generation and evaluation of the candidates.
+        std::chrono::nanoseconds compaction {0};    ///< binning by class and removal of rejected candidates.
+    };
+
+    /**
+     * @brief Compute placement on the calling thread.
+     * @param policy A standard execution policy, e.g. std::execution::par_unseq to distribute the work groups over
+     * multiple threads.
+     * @param statistics Receives the statistics of the operation, which are not added to getStatistics().
+     * @param times If not null, receives the time spent in each stage.
+     * @return the elements, grouped by class.
+     */
+    template<class ExecutionPolicy>
+    [[nodiscard]]
+    ClassBins<ResultElement> computePlacement(const ExecutionPolicy &policy,
+                                              const WorldData &world_data, const LayerData &layer_data,
+                                              glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                              PlacementStatistics &statistics, StageTimes *times = nullptr) const;
+
+    /// Statistics of all the operations computed by computePlacement() so far.
+    [[nodiscard]] PlacementStatistics getStatistics();
+
+    /**
+     * @brief Set the seed selecting the candidate pattern of the work groups, among those of the default
+     * WorkGroupPatternLibrary, as PlacementPipeline::setRandomSeed() does on the GPU. Operations already requested keep
+     * the seed they were requested with.
+     */
+    void setRandomSeed(uint seed);
+
+    [[nodiscard]] uint getRandomSeed() const { return m_random_seed; }
+
 private:
+    using WorkGroupPattern = std::array<std::array<glm::vec2, 8>, 8>;
+
+    struct PlacementPattern
+    {
+        glm::vec2 bounds;
+        WorkGroupPattern array;
+    };
+
     void threadLoop();
 
+    /// First work group of a region, and number of work groups along each axis.
+    [[nodiscard]] static std::pair<glm::uvec2, glm::uvec2> s_getWorkGroupRange(const PlacementPattern &pattern,
+                                                                               float footprint, glm::vec2 lower_bound,
+                                                                               glm::vec2 upper_bound);
+
+    /**
+     * @brief Generate and evaluate the candidates of a single work group, writing them to @p candidates.
+     * @return the number of candidates outside of the bounds.
+     */
+    static uint s_evaluateWorkGroup(const PlacementPattern &pattern, const WorldData &world_data,
+                                    const LayerData &layer_data, glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                    glm::uvec2 work_group, ResultElement *candidates);
+
+    /// Compute placement on the calling thread with the candidate pattern @p pattern.
     template<class ExecutionPolicy>
     [[nodiscard]]
-    std::vector<placement::Result::Element> computePlacement(const ExecutionPolicy &policy,
-                                                             const WorldData &world_data,
-                                                             const LayerData &layer_data,
-                                                             glm::vec2 lower_bound, glm::vec2 upper_bound);
+    static ClassBins<ResultElement> s_computePlacement(const ExecutionPolicy &policy, const PlacementPattern &pattern,
+                                                       const WorldData &world_data, const LayerData &layer_data,
+                                                       glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                                       PlacementStatistics &statistics, StageTimes *times);
+
+    /// Statistics of a set of candidates, from the number of candidates outside of the bounds and the binned elements.
+    [[nodiscard]] static PlacementStatistics s_makeStatistics(std::size_t candidate_count,
+                                                              PlacementStatistics::uint64 out_of_bounds_count,
+                                                              const std::vector<std::size_t> &class_offsets);
+
+    static PlacementPattern s_getPlacementPattern(uint seed);
 
     struct Request
     {
@@ -131,33 +236,85 @@ private:
         LayerData layer_data;
         glm::vec2 lower_bound;
         glm::vec2 upper_bound;
+        PlacementPattern pattern;
         std::shared_ptr<ResultBuffer> result_buffer;
     };
 
-    using WorkGroupPattern = std::array<std::array<glm::vec2, 8>, 8>;
-
-    struct PlacementPattern
-    {
-        glm::vec2 bounds;
-        WorkGroupPattern array;
-
-        auto& operator[] (std::size_t i)
-        {
-            return array[i];
-        }
-    };
-
-    static PlacementPattern generatePlacementPattern(uint seed);
-
     bool m_destructor_flag = false;
     std::vector<Request> m_queue;
     std::mutex m_mutex;
     std::condition_variable m_cond;
+    PlacementStatistics m_statistics;
+    uint m_random_seed {0};
+    PlacementPattern m_pattern = s_getPlacementPattern(m_random_seed);
     std::thread m_thread{&PlacementPipeline::threadLoop, this};
-    PlacementPattern m_pattern = generatePlacementPattern(123);
 };
 
+template<class ExecutionPolicy>
+ClassBins<ResultElement> PlacementPipeline::computePlacement(const ExecutionPolicy &policy,
+                                                             const WorldData &world_data, const LayerData &layer_data,
+                                                             glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                                             PlacementStatistics &statistics, StageTimes *times) const
+{
+    return s_computePlacement(policy, m_pattern, world_data, layer_data, lower_bound, upper_bound, statistics, times);
+}
+
+template<class ExecutionPolicy>
+ClassBins<ResultElement>
+PlacementPipeline::s_computePlacement(const ExecutionPolicy &policy, const PlacementPattern &pattern,
+                                      const WorldData &world_data, const LayerData &layer_data,
+                                      glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                      PlacementStatistics &statistics, StageTimes *times)
+{
+    using clock = std::chrono::steady_clock;
+
+    if (!world_data.heightmap)
+        throw std::logic_error("invalid world height map");
+
+    const auto start_time = clock::now();
+
+    const auto [base_offset, num_work_groups] = s_getWorkGroupRange(pattern, layer_data.footprint, lower_bound,
+                                                                    upper_bound);
+    const uint wg_candidate_count = pattern.array.size() * pattern.array.front().size();
+
+    std::vector<ResultElement> candidates;
+    candidates.resize(num_work_groups.x * num_work_groups.y * wg_candidate_count);
+
+    std::vector<glm::uvec2> work_group_indices;
+    for (uint i = 0; i < num_work_groups.x; i++)
+        for (uint j = 0; j < num_work_groups.y; j++)
+            work_group_indices.emplace_back(i, j);
+
+    // counted per work group, so the shared counter is only updated once per 64 candidates
+    std::atomic<PlacementStatistics::uint64> out_of_bounds_count {0};
+
+    std::for_each(policy, work_group_indices.cbegin(), work_group_indices.cend(), [&](glm::uvec2 wg_id)
+    {
+        const uint wg_array_index = (wg_id.x * num_work_groups.y + wg_id.y) * wg_candidate_count;
+        if (const uint count = s_evaluateWorkGroup(pattern, world_data, layer_data, lower_bound, upper_bound,
+                                                   base_offset + wg_id, &candidates[wg_array_index]))
+            out_of_bounds_count.fetch_add(count, std::memory_order_relaxed);
+    });
+
+    const auto evaluation_time = clock::now();
+
+    auto bins = binByClass(policy, candidates, layer_data.densitymaps.size());
+    statistics = s_makeStatistics(candidates.size(), out_of_bounds_count, bins.class_offsets);
+
+    if (times)
+    {
+        times->evaluation = evaluation_time - start_time;
+        times->compaction = clock::now() - evaluation_time;
+    }
+
+    return bins;
+}
+
+} // placement::cpu
 
-} // placement
+#ifdef CPU_PLACEMENT
+// the examples built with CPU_PLACEMENT use this implementation in place of the library
+namespace placement { using namespace cpu; }
+#endif
 
 #endif //PROCEDURALPLACEMENTLIB_CPU_PLACEMENT_HPP
\ No newline at end of file
@@ -0,0 +1,168 @@
+#ifndef PROCEDURALPLACEMENTLIB_BAKED_PLACEMENT_FILE_HPP
+#define PROCEDURALPLACEMENTLIB_BAKED_PLACEMENT_FILE_HPP
+
+#include "placement_result.hpp"
+
+#include "glm/vec2.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace placement {
+
+class MappedFile;
+
+/**
+ * @brief Header of a baked placement file.
+ *
+ * A baked placement file stores precomputed placement results for a rectangular grid of tiles. It starts with this
+ * structure, followed by the tile directory, an array of tile_count.x * tile_count.y BakedTileEntry structures in row
+ * major order, and then the data of each tile.
+ *
+ * The data of a tile has exactly the layout of the count and element sections of a ResultBuffer: num_classes 32-bit
+ * element counts, followed by the elements of the tile as ResultElement structures, sorted by class. This allows
+ * loading a tile into a Result, or copying its elements into a GL buffer, straight from the mapped file. Tile data
+ * starts at offsets that are multiples of 16 bytes. Values are stored in native byte order.
+ */
+struct BakedPlacementHeader
+{
+    static constexpr std::uint32_t magic_value = 0x4B425050; // "PPBK"
+    static constexpr std::uint32_t current_version = 1;
+
+    std::uint32_t magic {magic_value};
+    std::uint32_t version {current_version};
+    std::uint32_t num_classes {0};
+    std::uint32_t reserved {0};
+    glm::vec2 origin {0.0f};        ///< World space lower corner of tile (0, 0).
+    glm::vec2 tile_size {0.0f};     ///< World space dimensions of a single tile.
+    glm::uvec2 tile_count {0u};     ///< Number of tiles along each axis.
+
+    [[nodiscard]] std::uint32_t getTileIndex(glm::uvec2 tile) const
+    { return tile.y * tile_count.x + tile.x; }
+};
+
+static_assert(sizeof(BakedPlacementHeader) == 40, "BakedPlacementHeader must not have padding");
+
+/// Location of the data of a tile within a baked placement file.
+struct BakedTileEntry
+{
+    std::uint64_t offset;   ///< Byte offset from the start of the file.
+    std::uint64_t size;     ///< Size in bytes of the counts and elements of the tile.
+};
+
+/// Collects placement results tile by tile, and writes them into a baked placement file.
+class BakedPlacementWriter
+{
+public:
+    /**
+     * @param num_classes Number of placement classes of every tile.
+     * @param origin World space lower corner of tile (0, 0).
+     * @param tile_size World space dimensions of a single tile.
+     * @param tile_count Number of tiles along each axis. Tiles that are not set are stored as empty.
+     */
+    BakedPlacementWriter(std::uint32_t num_classes, glm::vec2 origin, glm::vec2 tile_size, glm::uvec2 tile_count);
+
+    /// Set the elements of a tile from a placement result, usually one computed over the bounds of the tile.
+    void setTile(glm::uvec2 tile, const Result &result);
+
+    /// Set the elements of a tile. Elements may be in any order; their relative order within each class is preserved.
+    void setTile(glm::uvec2 tile, std::vector<ResultElement> elements);
+
+    /// Write all tiles into a file. Throws std::runtime_error on failure.
+    void write(const std::string &path) const;
+
+private:
+    BakedPlacementHeader m_header;
+    std::vector<std::vector<ResultElement>> m_tiles;
+};
+
+/**
+ * @brief Read-only access to a baked placement file.
+ * The file is mapped into memory, so opening it does not read any tile, and tile data is accessed without copies or
+ * parsing. See BakedPlacementHeader for the file layout.
+ */
+class BakedPlacementFile
+{
+public:
+    /// The elements of a single tile, pointing into the mapped file.
+    class TileView
+    {
+    public:
+        TileView(std::uint32_t num_classes, const std::uint32_t *counts, const ResultElement *elements);
+
+        [[nodiscard]] std::uint32_t getNumClasses() const { return m_num_classes; }
+
+        /// Total number of elements in the tile.
+        [[nodiscard]] std::uint32_t getElementCount() const { return m_class_offsets.back(); }
+
+        [[nodiscard]] std::uint32_t getClassElementCount(std::uint32_t class_index) const
+        { return m_class_offsets[class_index + 1] - m_class_offsets[class_index]; }
+
+        /// Index of the first element of a class within the tile.
+        [[nodiscard]] std::uint32_t getClassIndexOffset(std::uint32_t class_index) const
+        { return m_class_offsets[class_index]; }
+
+        [[nodiscard]] const ResultElement *begin() const { return m_elements; }
+        [[nodiscard]] const ResultElement *end() const { return m_elements + getElementCount(); }
+
+        /// Begin and end pointers of the elements of a class.
+        [[nodiscard]] std::pair<const ResultElement*, const ResultElement*> getClassElements(std::uint32_t class_index) const
+        { return {m_elements + m_class_offsets[class_index], m_elements + m_class_offsets[class_index + 1]}; }
+
+    private:
+        std::uint32_t m_num_classes;
+        const ResultElement *m_elements;
+        std::vector<std::uint32_t> m_class_offsets;
+    };
+
+    /// Map a baked placement file into memory. Throws std::runtime_error if the file can't be read or is invalid.
+    explicit BakedPlacementFile(const std::string &path);
+    ~BakedPlacementFile();
+
+    BakedPlacementFile(BakedPlacementFile&&) noexcept;
+    BakedPlacementFile &operator=(BakedPlacementFile&&) noexcept;
+
+    [[nodiscard]] const BakedPlacementHeader &getHeader() const { return *m_header; }
+
+    [[nodiscard]] std::uint32_t getNumClasses() const { return m_header->num_classes; }
+
+    [[nodiscard]] glm::uvec2 getTileCount() const { return m_header->tile_count; }
+
+    /// Index of the tile containing @p position. Positions outside of the grid are clamped to the nearest tile.
+    [[nodiscard]] glm::uvec2 getTile(glm::vec2 position) const;
+
+    /// World space lower and upper bounds of a tile.
+    [[nodiscard]] std::pair<glm::vec2, glm::vec2> getTileBounds(glm::uvec2 tile) const;
+
+    /// Directory entry of a tile. Throws std::out_of_range if the tile is outside of the grid.
+    [[nodiscard]] const BakedTileEntry &getTileEntry(glm::uvec2 tile) const;
+
+    /// Access the elements of a tile directly in the mapped file.
+    [[nodiscard]] TileView getTileView(glm::uvec2 tile) const;
+
+    /**
+     * @brief Upload a tile into a new result buffer.
+     * The tile data is copied as is into GPU memory; the returned result behaves like one computed by the pipeline,
+     * without a cell index.
+     */
+    [[nodiscard]] Result loadTile(glm::uvec2 tile) const;
+
+    /**
+     * @brief Copy the elements of a tile into a GL buffer.
+     * @param offset Byte offset into @p buffer at which to start writing.
+     * @return The number of elements copied.
+     */
+    std::uint32_t uploadTile(glm::uvec2 tile, GL::BufferHandle buffer, GLintptr offset = 0) const;
+
+private:
+    std::unique_ptr<MappedFile> m_file;
+    const BakedPlacementHeader *m_header;
+    const BakedTileEntry *m_directory;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_BAKED_PLACEMENT_FILE_HPP
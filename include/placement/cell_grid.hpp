@@ -0,0 +1,91 @@
+#ifndef PROCEDURALPLACEMENTLIB_CELL_GRID_HPP
+#define PROCEDURALPLACEMENTLIB_CELL_GRID_HPP
+
+#include "glm/vec2.hpp"
+#include "glm/common.hpp"
+#include "glm/vector_relational.hpp"
+
+#include <cstdint>
+
+namespace placement {
+
+/**
+ * @brief Get the position of a cell along the Z-order (Morton) curve, restricted to a rectangular grid.
+ * Cells outside of the grid are skipped, so ranks are dense: for a grid of size (w, h) every cell is assigned a unique
+ * value in the range [0, w * h). This function mirrors the one used by the placement compute shaders.
+ * @param cell Index of a cell within the grid.
+ * @param grid_size Number of cells along each axis of the grid.
+ */
+inline std::uint32_t getMortonRank(glm::uvec2 cell, glm::uvec2 grid_size)
+{
+    // number of cells of the grid that fall inside the square [lower, lower + side)
+    const auto count_cells = [grid_size](glm::uvec2 lower, std::uint32_t side)
+    {
+        const glm::uvec2 upper = glm::max(glm::min(lower + side, grid_size), lower);
+        const glm::uvec2 extent = upper - lower;
+        return extent.x * extent.y;
+    };
+
+    std::uint32_t side = 1;
+    while (side < grid_size.x || side < grid_size.y)
+        side <<= 1;
+
+    std::uint32_t rank = 0;
+    glm::uvec2 origin {0u};
+
+    while (side > 1)
+    {
+        side >>= 1;
+
+        // quadrants are visited in the order (0, 0), (1, 0), (0, 1), (1, 1)
+        const glm::uvec2 quadrant {glm::greaterThanEqual(cell - origin, glm::uvec2(side))};
+        const std::uint32_t quadrant_index = quadrant.x + 2 * quadrant.y;
+
+        for (std::uint32_t i = 0; i < quadrant_index; i++)
+            rank += count_cells(origin + glm::uvec2(i & 1u, i >> 1u) * side, side);
+
+        origin += quadrant * side;
+    }
+
+    return rank;
+}
+
+/// A uniform grid of square cells over a placement region, used to index the results of a placement operation.
+struct CellGrid
+{
+    /// World space position of the lower corner of cell (0, 0).
+    glm::vec2 origin {0.0f};
+
+    /// Dimensions of a single cell, in world space.
+    glm::vec2 cell_size {0.0f};
+
+    /// Number of cells along each axis.
+    glm::uvec2 size {0u};
+
+    /// Total number of cells in the grid.
+    [[nodiscard]] std::uint32_t getCellCount() const
+    { return size.x * size.y; }
+
+    /// Index of the cell containing @p position. Positions outside of the grid are clamped to the nearest cell.
+    [[nodiscard]] glm::uvec2 getCell(glm::vec2 position) const
+    {
+        const glm::vec2 cell = glm::floor((position - origin) / cell_size);
+        return glm::uvec2(glm::clamp(cell, glm::vec2(0.0f), glm::vec2(size) - 1.0f));
+    }
+
+    /// Position of @p cell along the Z-order curve. Results are sorted by this value within each class.
+    [[nodiscard]] std::uint32_t getCellRank(glm::uvec2 cell) const
+    { return getMortonRank(cell, size); }
+
+    /// World space lower corner of @p cell.
+    [[nodiscard]] glm::vec2 getCellLowerBound(glm::uvec2 cell) const
+    { return origin + glm::vec2(cell) * cell_size; }
+
+    /// World space upper corner of @p cell.
+    [[nodiscard]] glm::vec2 getCellUpperBound(glm::uvec2 cell) const
+    { return getCellLowerBound(cell + 1u); }
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_CELL_GRID_HPP
@@ -0,0 +1,110 @@
+#ifndef PROCEDURALPLACEMENTLIB_COMPLETION_QUEUE_HPP
+#define PROCEDURALPLACEMENTLIB_COMPLETION_QUEUE_HPP
+
+#include "placement_result.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define PLACEMENT_COROUTINES
+#endif
+
+namespace placement {
+
+/**
+ * @brief Runs continuations when the results of placement operations become available.
+ * Instead of waiting on, or polling, each FutureResult separately, pending results are added to the queue and their
+ * fences are all checked in a single pass by pollCompletions(), e.g. once per frame. Continuations run on the thread
+ * that calls pollCompletions(), which needs a current GL context sharing objects with the one results are computed in.
+ */
+class CompletionQueue
+{
+public:
+    using Continuation = std::function<void(Result)>;
+
+    /// Call @p continuation with the result of @p future_result once it is available. @see FutureResult::then()
+    void push(FutureResult &&future_result, Continuation continuation);
+
+    /**
+     * @brief Check the fences of all pending results, and run the continuations of the completed ones in the order
+     * they were pushed. Continuations may push new results, which are checked by the next call.
+     * @return the number of continuations run.
+     */
+    std::size_t pollCompletions();
+
+    /// Block until all pending results are available, running their continuations.
+    void drain();
+
+    [[nodiscard]] bool empty() const noexcept { return m_pending.empty(); }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_pending.size(); }
+
+#ifdef PLACEMENT_COROUTINES
+    /// Awaitable returned by awaitResult().
+    class Awaiter
+    {
+    public:
+        Awaiter(CompletionQueue &queue, FutureResult &&future_result)
+            : m_queue(queue), m_future_result(std::move(future_result)) {}
+
+        [[nodiscard]] bool await_ready() const { return m_future_result.isReady(); }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            m_queue.push(std::move(m_future_result), [this, handle](Result result)
+            {
+                m_result.emplace(std::move(result));
+                handle.resume();
+            });
+        }
+
+        Result await_resume()
+        { return m_result ? std::move(*m_result) : m_future_result.readResult(); }
+
+    private:
+        CompletionQueue &m_queue;
+        FutureResult m_future_result;
+        std::optional<Result> m_result;
+    };
+
+    /**
+     * @brief Suspend a coroutine until a result is available, resuming it from pollCompletions().
+     * `Result result = co_await queue.awaitResult(pipeline.computePlacement(...));`
+     */
+    [[nodiscard]] Awaiter awaitResult(FutureResult &&future_result)
+    { return {*this, std::move(future_result)}; }
+#endif
+
+private:
+    struct PendingResult
+    {
+        FutureResult future_result;
+        Continuation continuation;
+    };
+
+    std::vector<PendingResult> m_pending;
+};
+
+/**
+ * @brief Wait until any of @p future_results is available, or until the timeout expires.
+ * All the fences are checked in one pass before blocking; while none is signaled, the first future is waited on,
+ * since commands of a single context complete in submission order.
+ * @return the index of the first available result in @p future_results, if any.
+ */
+[[nodiscard]]
+std::optional<std::size_t> waitAny(const std::vector<FutureResult> &future_results,
+                                   std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+/// Wait until all of @p future_results are available or until the timeout expires, returning true in the former case.
+[[nodiscard]]
+bool waitAll(const std::vector<FutureResult> &future_results,
+             std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_COMPLETION_QUEUE_HPP
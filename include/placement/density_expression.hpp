@@ -0,0 +1,163 @@
+#ifndef PROCEDURALPLACEMENTLIB_DENSITY_EXPRESSION_HPP
+#define PROCEDURALPLACEMENTLIB_DENSITY_EXPRESSION_HPP
+
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace placement {
+
+/**
+ * @brief A procedural density function, computed from terrain properties instead of read from a texture.
+ *
+ * An expression is a graph of nodes built with the member functions of this class, each one returning a handle to the
+ * new node that can be passed as input to later nodes. The value of the expression is the value of its output node,
+ * by default the last one added. For example, "pines above 800 m on slopes under 30 degrees" could be written as:
+ * @code
+ * DensityExpression pines;
+ * pines.multiply(pines.remap(pines.altitude(), 780.0f, 820.0f), pines.remap(pines.slope(), 30.0f, 25.0f));
+ * @endcode
+ *
+ * When attached to a DensityMap, the expression is compiled into the evaluation compute shader, replacing the density
+ * texture; its value then goes through the scale, offset and clamping of the density map, like a texture sample would.
+ * Parameters are compiled in as constants, so each distinct expression results in a separate shader program, built
+ * the first time it is used. evaluate() computes the same function on the CPU. Parameters must be finite: nodes with
+ * infinite or NaN parameters are rejected with std::invalid_argument when they are added.
+ */
+class DensityExpression
+{
+public:
+    /// Handle to a node of the expression.
+    struct Node
+    {
+        std::uint32_t index;
+    };
+
+    enum class Operation : std::uint32_t
+    {
+        constant,
+        altitude,
+        slope,
+        curvature,
+        noise,
+        texture,
+        remap,
+        clamp,
+        add,
+        multiply,
+        minimum,
+        maximum
+    };
+
+    /// A constant value.
+    Node constant(float value);
+
+    /// World space height of the candidate.
+    Node altitude();
+
+    /// Steepness of the terrain at the candidate, in degrees, computed from the heightmap.
+    Node slope();
+
+    /// Laplacian of the terrain height at the candidate, computed from the heightmap. Positive in valleys and
+    /// negative on ridges, in inverse world units.
+    Node curvature();
+
+    /**
+     * @brief Fractal sum of 2D simplex noise over world space positions, in the range [0, 1].
+     * @param frequency Frequency of the first octave, in cycles per world unit.
+     * @param octaves Number of octaves. Each one doubles the frequency and halves the amplitude of the previous one.
+     */
+    Node noise(float frequency, std::uint32_t octaves = 1, std::uint32_t seed = 0);
+
+    /// Value of the texture of the density map the expression is attached to, before scale and offset.
+    Node texture();
+
+    /**
+     * @brief Map [in_min, in_max] linearly to [out_min, out_max], clamping the result to the output range.
+     * in_min may be greater than in_max, e.g. remap(slope(), 30, 25) is 0 above 30 degrees and 1 below 25.
+     */
+    Node remap(Node x, float in_min, float in_max, float out_min = 0.0f, float out_max = 1.0f);
+
+    Node clamp(Node x, float min_value, float max_value);
+    Node add(Node a, Node b);
+    Node multiply(Node a, Node b);
+    Node minimum(Node a, Node b);
+    Node maximum(Node a, Node b);
+
+    /// Set the node whose value is the value of the expression.
+    void setOutput(Node node);
+
+    /// The output node. Throws std::logic_error if the expression is empty.
+    [[nodiscard]] Node getOutput() const;
+
+    [[nodiscard]] bool empty() const { return m_nodes.empty(); }
+
+    /// Check if the expression needs to sample the heightmap, i.e. if it contains slope or curvature nodes.
+    [[nodiscard]] bool usesHeightmap() const;
+
+    /// Check if the expression contains texture nodes.
+    [[nodiscard]] bool usesTexture() const;
+
+    /**
+     * @brief The GLSL source of the function `float evaluateDensityExpression(vec3 position, vec2 world_uv)`.
+     * Only the nodes the output depends on are included. The source is generated whenever the expression is edited,
+     * so this is cheap enough to be called for every placement operation.
+     * @throw std::logic_error if the expression is empty.
+     */
+    [[nodiscard]] const std::string &compileGLSL() const;
+
+    /// Inputs of a CPU evaluation of the expression at a single position.
+    struct Inputs
+    {
+        glm::vec3 position;         ///< World space position of the candidate.
+        glm::vec2 world_uv;         ///< Texture coordinates of the candidate, i.e. position / world scale.
+        glm::vec3 world_scale;      ///< Dimensions of the world, as in WorldData.
+        glm::vec2 heightmap_size;   ///< Texels of the heightmap along each axis.
+    };
+
+    using Sampler = std::function<float(glm::vec2)>;
+
+    /**
+     * @brief Evaluate the expression on the CPU.
+     * @param sample_height Sample the heightmap at some uv coordinates, returning a value in [0, 1] that is scaled by
+     *      world_scale.z. Only called if usesHeightmap().
+     * @param sample_texture Sample the density map texture. Only called if usesTexture().
+     */
+    [[nodiscard]] float evaluate(const Inputs &inputs, const Sampler &sample_height = {},
+                                 const Sampler &sample_texture = {}) const;
+
+private:
+    static constexpr std::uint32_t no_input = ~0u;
+
+    struct NodeData
+    {
+        Operation operation;
+        std::array<std::uint32_t, 2> inputs {no_input, no_input};
+        std::array<float, 4> parameters {};
+    };
+
+    Node m_addNode(NodeData node);
+    void m_checkInput(Node node) const;
+    [[nodiscard]] std::vector<bool> m_getReachableNodes() const;
+    [[nodiscard]] std::string m_generateGLSL() const;
+
+    std::vector<NodeData> m_nodes;
+    std::optional<std::uint32_t> m_output;
+    std::string m_source;   // compileGLSL(), kept up to date by the functions that edit the expression
+};
+
+/// 2D simplex noise in the range [-1, 1], matching the noise computed by the placement compute shaders.
+[[nodiscard]] float simplexNoise(glm::vec2 position, std::uint32_t seed);
+
+/// Fractal sum of simplex noise in the range [0, 1]. @see DensityExpression::noise()
+[[nodiscard]] float fractalNoise(glm::vec2 position, float frequency, std::uint32_t octaves, std::uint32_t seed);
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_DENSITY_EXPRESSION_HPP
@@ -5,6 +5,9 @@
 
 namespace placement {
 
+class VirtualTexture;
+class DensityExpression;
+
 /// A density map specifies the probability distribution of a single class of object over the landscape.
 struct DensityMap
 {
@@ -20,6 +23,15 @@ struct DensityMap
     /// Values in texture will be clamped to the range [min_value, max_value], after scaling and offset.
     float min_value{0};
     float max_value{1};
+
+    /// If set, densities are sampled from this virtual texture instead of @ref texture. @see VirtualTexture
+    VirtualTexture *virtual_texture{nullptr};
+
+    /**
+     * If set, densities are computed with this expression instead of read from the texture; the texture is only
+     * sampled by texture nodes of the expression. Scale, offset and clamping still apply. @see DensityExpression
+     */
+    const DensityExpression *expression{nullptr};
 };
 
 } // placement
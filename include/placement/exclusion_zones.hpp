@@ -0,0 +1,85 @@
+#ifndef PROCEDURALPLACEMENTLIB_EXCLUSION_ZONES_HPP
+#define PROCEDURALPLACEMENTLIB_EXCLUSION_ZONES_HPP
+
+#include "glm/vec2.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+namespace placement {
+
+/// A single exclusion shape, laid out as in the shader storage buffer read by the placement compute shaders.
+struct ExclusionShape
+{
+    enum Type : std::uint32_t
+    {
+        /// All points within a distance of @ref radius from the segment [a, b]. Circles have a == b.
+        capsule = 0,
+        /// An oriented box centered at @ref a, with half of its first axis given by @ref b, and @ref radius the half
+        /// extent along the second axis.
+        box = 1
+    };
+
+    glm::vec2 a;
+    glm::vec2 b;
+    float radius;
+    std::uint32_t type;
+};
+
+static_assert(sizeof(ExclusionShape) == 24, "ExclusionShape must match the std430 layout of the shader struct");
+
+/**
+ * @brief A set of shapes in which no objects are placed, such as roads or buildings.
+ * Exclusion zones are applied on top of the density maps of a layer, so they can be edited without touching any
+ * texture. Positions are in world space, like the placement region. Shapes with non-finite coordinates or sizes are
+ * rejected with std::invalid_argument.
+ */
+class ExclusionZones
+{
+public:
+    void addCircle(glm::vec2 center, float radius);
+
+    /**
+     * @brief Add an oriented box.
+     * @param half_extents Half of the dimensions of the box along its own axes, before rotation.
+     * @param rotation Counterclockwise rotation of the box around its center, in radians.
+     */
+    void addBox(glm::vec2 center, glm::vec2 half_extents, float rotation = 0.0f);
+
+    /// Add a strip of the given width around a sequence of connected segments.
+    void addPolyline(const std::vector<glm::vec2> &points, float width);
+
+    void clear()
+    { m_shapes.clear(); }
+
+    [[nodiscard]] bool empty() const
+    { return m_shapes.empty(); }
+
+    /// Number of shapes. Polylines are made of one shape per segment.
+    [[nodiscard]] std::size_t size() const
+    { return m_shapes.size(); }
+
+    [[nodiscard]] const std::vector<ExclusionShape> &getShapes() const
+    { return m_shapes; }
+
+    /// Check if @p position is inside any of the shapes. This mirrors the test done on the GPU.
+    [[nodiscard]] bool isExcluded(glm::vec2 position) const;
+
+    /**
+     * @brief Get the bounding box of the shapes starting at index @p first_shape.
+     * Storing size() before an edit and passing it here gives the region that has to be recomputed to apply the edit.
+     * @return The lower and upper bounds of the box. If there are no such shapes, lower > upper.
+     */
+    [[nodiscard]] std::pair<glm::vec2, glm::vec2> getBounds(std::size_t first_shape = 0) const;
+
+    /// Get the bounding box of a single shape.
+    [[nodiscard]] static std::pair<glm::vec2, glm::vec2> getBounds(const ExclusionShape &shape);
+
+private:
+    std::vector<ExclusionShape> m_shapes;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_EXCLUSION_ZONES_HPP
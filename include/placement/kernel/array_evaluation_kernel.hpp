@@ -0,0 +1,119 @@
+#ifndef PROCEDURALPLACEMENTLIB_ARRAY_EVALUATION_KERNEL_HPP
+#define PROCEDURALPLACEMENTLIB_ARRAY_EVALUATION_KERNEL_HPP
+
+#include "compute_kernel.hpp"
+#include "parameter_buffer.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+namespace placement {
+
+/**
+ * @brief Evaluates all the classes of a layer in a single dispatch, sampling the density maps from the slices of a 2D
+ * array texture.
+ * Produces the same results as one EvaluationKernel dispatch per class, in order, with the density map of class i in
+ * slice i. The scale, offset and clamping range of each class are read from a buffer of vec4 (scale, offset,
+ * min_value, max_value), one per class.
+ */
+class ArrayEvaluationKernel final
+{
+public:
+    static constexpr glm::uvec3 work_group_size{8, 8, 1};
+
+    ArrayEvaluationKernel();
+
+    /// Submit the program of the kernel for compilation, without waiting for it. @see PendingComputeShaderProgram
+    [[nodiscard]] static PendingComputeShaderProgram compile();
+
+    /// Construct the kernel from a program returned by compile(), blocking until it is linked.
+    explicit ArrayEvaluationKernel(PendingComputeShaderProgram &&program);
+
+    /**
+     * @param class_index_offset Class index assigned to candidates of slice 0, and entry of the class parameter buffer
+     *      read for it. Slice i corresponds to class class_index_offset + i.
+     * @param class_count Number of classes, i.e. of slices of the density map array.
+     * @param density_map_array_texture_unit Texture unit of a GL_TEXTURE_2D_ARRAY with the density map of each class.
+     * @param class_parameter_buffer_binding_index Binding of the per-class density map parameters.
+     * @param statistics_buffer_binding_index Binding of the candidate counters. @see EvaluationKernel
+     */
+    void operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset, uint class_index_offset,
+                    uint class_count, glm::vec2 lower_bound, glm::vec2 upper_bound,
+                    GLuint density_map_array_texture_unit, GLuint class_parameter_buffer_binding_index,
+                    GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                    GLuint density_buffer_binding_index,
+                    std::optional<GLuint> statistics_buffer_binding_index = std::nullopt);
+
+    /// Dispatch the kernel, additionally testing candidates against exclusion zones. @see EvaluationKernel
+    void operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset, uint class_index_offset,
+                    uint class_count, glm::vec2 lower_bound, glm::vec2 upper_bound,
+                    GLuint density_map_array_texture_unit, GLuint class_parameter_buffer_binding_index,
+                    GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                    GLuint density_buffer_binding_index,
+                    GLuint exclusion_shape_buffer_binding_index, GLuint exclusion_bin_buffer_binding_index,
+                    std::optional<GLuint> exclusion_mask_texture_unit,
+                    std::optional<GLuint> statistics_buffer_binding_index = std::nullopt);
+
+    static constexpr GLuint default_parameter_binding_index = 0;
+
+    /// Set the uniform buffer binding point the per-dispatch parameters are bound to. @see ParameterBuffer
+    void setParameterBindingIndex(GLuint binding_index);
+
+    [[nodiscard]] GLuint getParameterBindingIndex() const
+    { return m_parameter_block.getBindingIndex(); }
+
+    template<typename NestedArrayLike>
+    void setDitheringMatrixColumns(const NestedArrayLike &columns)
+    {
+        for (uint i = 0; i < work_group_size.x; i++)
+            setDitheringMatrixColumn(i, columns[i]);
+    }
+
+    template<typename ArrayLike>
+    void setDitheringMatrixColumn(uint column_index, const ArrayLike &column_values)
+    {
+        m_program.setUniform(m_dithering_matrix[column_index], column_values);
+    }
+
+private:
+    /// Per-dispatch parameters, laid out like the std140 ArrayEvaluationParameters uniform block.
+    struct Parameters
+    {
+        glm::vec2 lower_bound;
+        glm::vec2 upper_bound;
+        glm::uvec2 work_group_index_offset;
+        std::uint32_t class_count;
+        std::uint32_t test_exclusion_zones;
+        std::uint32_t use_exclusion_mask;
+        std::uint32_t class_index_offset;
+        std::uint32_t collect_statistics;
+        std::uint32_t padding;
+    };
+
+    void m_dispatch(glm::uvec2 num_work_groups, const Parameters &parameters, GLuint density_map_array_texture_unit,
+                    GLuint class_parameter_buffer_binding_index, GLuint candidate_buffer_binding_index,
+                    GLuint world_uv_buffer_binding_index, GLuint density_buffer_binding_index,
+                    std::optional<GLuint> statistics_buffer_binding_index);
+
+    ComputeShaderProgram m_program;
+
+    using CS = ComputeShaderProgram;
+
+    CS::TypedUniform<float[work_group_size.x][work_group_size.y]> m_dithering_matrix;
+    CS::CachedUniform<int> m_density_map_array;
+    CS::CachedUniform<int> m_exclusion_mask;
+    CS::UniformBlock m_parameter_block;
+    ParameterBuffer m_parameter_buffer;
+    CS::ShaderStorageBlock m_class_parameter_buffer;
+    CS::ShaderStorageBlock m_candidate_buffer;
+    CS::ShaderStorageBlock m_world_uv_buffer;
+    CS::ShaderStorageBlock m_density_buffer;
+    CS::ShaderStorageBlock m_exclusion_shape_buffer;
+    CS::ShaderStorageBlock m_exclusion_bin_buffer;
+    CS::ShaderStorageBlock m_statistics_buffer;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_ARRAY_EVALUATION_KERNEL_HPP
@@ -0,0 +1,39 @@
+#ifndef PROCEDURALPLACEMENTLIB_CELL_SCAN_KERNEL_HPP
+#define PROCEDURALPLACEMENTLIB_CELL_SCAN_KERNEL_HPP
+
+#include "compute_kernel.hpp"
+
+namespace placement {
+
+/**
+ * @brief Computes the offsets of the cell index from the cell counts written by IndexationKernel.
+ * Each work group performs an exclusive scan over the cells of a single class, so the kernel must be dispatched with
+ * one work group per class.
+ */
+class CellScanKernel final
+{
+public:
+    static constexpr glm::uvec3 work_group_size{64, 1, 1};
+
+    CellScanKernel();
+
+    /// Submit the program of the kernel for compilation, without waiting for it. @see PendingComputeShaderProgram
+    [[nodiscard]] static PendingComputeShaderProgram compile();
+
+    /// Construct the kernel from a program returned by compile(), blocking until it is linked.
+    explicit CellScanKernel(PendingComputeShaderProgram &&program);
+
+    void operator()(uint class_count, uint cell_count, GLuint cell_index_buffer_binding_index);
+
+private:
+    ComputeShaderProgram m_program;
+
+    using CS = ComputeShaderProgram;
+
+    CS::TypedUniform<uint> m_cell_count;
+    CS::ShaderStorageBlock m_cell_index_buffer;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_CELL_SCAN_KERNEL_HPP
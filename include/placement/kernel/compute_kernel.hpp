@@ -2,6 +2,7 @@
 #define PROCEDURALPLACEMENTLIB_COMPUTE_KERNEL_HPP
 
 #include "glutils/program.hpp"
+#include "glutils/shader.hpp"
 #include "glutils/guard.hpp"
 #include "glutils/gl_types.hpp"
 
@@ -12,6 +13,36 @@
 
 namespace placement {
 
+/**
+ * @brief A compute shader program submitted for compilation and linking, whose status hasn't been checked yet.
+ * With GL_KHR_parallel_shader_compile the driver compiles it in the background, so programs submitted one after the
+ * other compile in parallel. Constructing a ComputeShaderProgram from it blocks until it is linked.
+ */
+class PendingComputeShaderProgram
+{
+public:
+    PendingComputeShaderProgram(unsigned int count, const char **source_strings);
+
+    explicit PendingComputeShaderProgram(const char *source_string) : PendingComputeShaderProgram(1, &source_string)
+    {}
+
+    explicit PendingComputeShaderProgram(const std::vector<const char *> &strings)
+            : PendingComputeShaderProgram(strings.size(), const_cast<const char **>(strings.data()))
+    {}
+
+    /**
+     * @brief Check, without blocking, whether compilation and linking have completed, successfully or not.
+     * Always true without GL_KHR_parallel_shader_compile, as there is no way to tell.
+     */
+    [[nodiscard]] bool isReady() const;
+
+private:
+    friend class ComputeShaderProgram;
+
+    GL::Shader m_shader;
+    GL::Program m_program;
+};
+
 class ComputeShaderProgram
 {
 public:
@@ -39,6 +70,12 @@ public:
 
     ComputeShaderProgram(unsigned int count, const char **source_strings);
 
+    /**
+     * @brief Check the status of a program submitted for compilation, blocking until it is linked.
+     * @throw GL::GLError with the info log if compilation or linking failed.
+     */
+    explicit ComputeShaderProgram(PendingComputeShaderProgram &&pending);
+
     // Various utility classes
 
     using Interface = GL::Program::Interface;
@@ -171,6 +208,13 @@ public:
     [[nodiscard]]
     UniformLocation getUniformLocation(const char *name) const;
 
+    /**
+     * @brief Same as getUniformLocation(), but returns an invalid location instead of throwing if there is no active
+     * uniform called @p name, e.g. because it was optimized out. Setting an invalid location has no effect.
+     */
+    [[nodiscard]]
+    UniformLocation findUniformLocation(const char *name) const;
+
     template<typename T>
     void setUniform(UniformLocation location, T value) const
     {
@@ -2,6 +2,9 @@
 #define PROCEDURALPLACEMENTLIB_COPY_KERNEL_HPP
 
 #include "compute_kernel.hpp"
+#include "../placement_result.hpp"
+
+#include <optional>
 
 namespace placement {
 
@@ -13,20 +16,58 @@ public:
 
     CopyKernel();
 
+    /// Submit the program of the kernel for compilation, without waiting for it. @see PendingComputeShaderProgram
+    [[nodiscard]] static PendingComputeShaderProgram compile();
+
+    /// Construct the kernel from a program returned by compile(), blocking until it is linked.
+    explicit CopyKernel(PendingComputeShaderProgram &&program);
+
+    /**
+     * @brief Dispatch the kernel.
+     * @param bounds_buffer_binding_index Binding of a BoundsBuffer, whose boxes are grown to contain the elements that
+     * are copied, or nullopt not to compute bounds. The boxes must be cleared to empty beforehand.
+     */
     void operator() (uint num_work_groups, GLuint candidate_buffer_binding_index, GLuint count_buffer_binding_index,
-            GLuint index_buffer_binding_index, GLuint output_buffer_binding_index);
+            GLuint index_buffer_binding_index, GLuint output_buffer_binding_index,
+            std::optional<GLuint> bounds_buffer_binding_index = std::nullopt);
+
+    /**
+     * @brief Dispatch the kernel using the cell index produced by IndexationKernel and CellScanKernel.
+     * Indices in the index buffer are interpreted as relative to the start of the cell the candidate belongs to, so
+     * that the elements of each class are written sorted by the Z-order rank of their cell. If
+     * @p bounds_buffer_binding_index is set, the boxes of each class in each cell are computed too.
+     */
+    void operator() (uint num_work_groups, glm::uvec2 cell_grid_size, GLuint candidate_buffer_binding_index,
+            GLuint count_buffer_binding_index, GLuint index_buffer_binding_index,
+            GLuint cell_index_buffer_binding_index, GLuint output_buffer_binding_index,
+            std::optional<GLuint> bounds_buffer_binding_index = std::nullopt);
+
+    /// Set the arrangement of the elements written into the output buffer by subsequent dispatches.
+    void setResultLayout(ResultLayout layout) { m_layout = layout; }
+
+    [[nodiscard]] ResultLayout getResultLayout() const { return m_layout; }
 
     [[nodiscard]]
     static constexpr uint calculateNumWorkGroups(uint candidate_count)
     { return 1u + candidate_count / work_group_size.x; }
 
 private:
+    void m_setBoundsBuffer(std::optional<GLuint> bounds_buffer_binding_index);
+
     ComputeShaderProgram m_program;
     using CS = ComputeShaderProgram;
+    CS::TypedUniform<int> m_read_cell_index;
+    CS::TypedUniform<glm::uvec2> m_cell_grid_size;
+    CS::TypedUniform<int> m_structure_of_arrays;
+    CS::TypedUniform<int> m_compute_bounds;
     CS::ShaderStorageBlock m_candidate_buffer;
     CS::ShaderStorageBlock m_count_buffer;
     CS::ShaderStorageBlock m_index_buffer;
     CS::ShaderStorageBlock m_output_buffer;
+    CS::ShaderStorageBlock m_output_array_buffer;
+    CS::ShaderStorageBlock m_cell_index_buffer;
+    CS::ShaderStorageBlock m_bounds_buffer;
+    ResultLayout m_layout {ResultLayout::array_of_structures};
 };
 
 } // placement
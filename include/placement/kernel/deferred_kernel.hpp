@@ -0,0 +1,58 @@
+#ifndef PROCEDURALPLACEMENTLIB_DEFERRED_KERNEL_HPP
+#define PROCEDURALPLACEMENTLIB_DEFERRED_KERNEL_HPP
+
+#include "compute_kernel.hpp"
+
+#include <optional>
+#include <utility>
+
+namespace placement {
+
+/**
+ * @brief A kernel constructed in two steps: its program is submitted for compilation, and the kernel is constructed
+ * from it on first use, so that compilation doesn't block the thread that submits it.
+ * @tparam Kernel provides a static compile(), and a constructor from the PendingComputeShaderProgram it returns.
+ */
+template<class Kernel>
+class DeferredKernel
+{
+public:
+    /// Submit the program of the kernel for compilation, unless it already was.
+    void submit()
+    {
+        if (!m_kernel && !m_program)
+            m_program.emplace(Kernel::compile());
+    }
+
+    /// Check if get() would return without waiting for the compiler. False if the program hasn't been submitted.
+    [[nodiscard]] bool isReady() const
+    { return m_kernel || (m_program && m_program->isReady()); }
+
+    /**
+     * @brief The kernel, submitting its program if needed, and blocking until it is linked.
+     * @throw GL::GLError if the program fails to compile or link.
+     */
+    Kernel &get()
+    {
+        if (!m_kernel)
+        {
+            submit();
+            PendingComputeShaderProgram program = std::move(*m_program);
+            m_program.reset();
+            m_kernel.emplace(std::move(program));
+        }
+        return *m_kernel;
+    }
+
+    /// The kernel, if it has been constructed already.
+    [[nodiscard]] Kernel *find()
+    { return m_kernel ? &*m_kernel : nullptr; }
+
+private:
+    std::optional<PendingComputeShaderProgram> m_program;
+    std::optional<Kernel> m_kernel;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_DEFERRED_KERNEL_HPP
@@ -2,12 +2,16 @@
 #define PROCEDURALPLACEMENTLIB_EVALUATION_KERNEL_HPP
 
 #include "compute_kernel.hpp"
+#include "parameter_buffer.hpp"
 
 #include <array>
+#include <cstdint>
+#include <optional>
 
 namespace placement {
 
 class DensityMap;
+class DensityExpression;
 
 class EvaluationKernel final
 {
@@ -17,11 +21,77 @@ public:
 
     EvaluationKernel();
 
+    /**
+     * @brief Create a kernel that computes densities with a density expression instead of sampling density maps.
+     * DensityMap::texture is still sampled by texture nodes of the expression. The heightmap read by slope and
+     * curvature nodes is set with setExpressionInputs().
+     */
+    explicit EvaluationKernel(const DensityExpression &expression);
+
+    /// Submit the program of the kernel for compilation, without waiting for it. @see PendingComputeShaderProgram
+    [[nodiscard]] static PendingComputeShaderProgram compile();
+
+    /// Same as compile(), for the program of a density expression.
+    [[nodiscard]] static PendingComputeShaderProgram compile(const DensityExpression &expression);
+
+    /// Construct the kernel from a program returned by compile(), blocking until it is linked.
+    explicit EvaluationKernel(PendingComputeShaderProgram &&program);
+
+    /**
+     * @param statistics_buffer_binding_index Binding of two uint counters, to which the numbers of candidates outside
+     *      of the bounds, and of candidates inside them but excluded, are added. Only needs to be set for the first
+     *      class.
+     */
     void operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset, uint class_index,
                     glm::vec2 lower_bound, glm::vec2 upper_bound,
                     GLuint density_map_texture_unit, const DensityMap& density_map,
                     GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
-                    GLuint density_buffer_binding_index);
+                    GLuint density_buffer_binding_index,
+                    std::optional<GLuint> statistics_buffer_binding_index = std::nullopt);
+
+    /**
+     * @brief Dispatch the kernel, additionally testing candidates against exclusion zones.
+     * Candidates inside an exclusion shape, or where the exclusion mask is set, get a large negative density so they
+     * are rejected by this and all later class evaluations. The test only needs to be enabled for the first class.
+     * @param exclusion_shape_buffer_binding_index Binding of an array of ExclusionShape.
+     * @param exclusion_bin_buffer_binding_index Binding of the shapes binned by work group: an array of uint where
+     *      entries [i] and [i + 1] are the begin and end of the range of entries holding the indices of the shapes
+     *      that overlap work group i.
+     * @param exclusion_mask_texture_unit Texture unit of an optional exclusion mask, sampled with the same uv
+     *      coordinates as density maps. Candidates are excluded where its red channel is at least 0.5.
+     */
+    void operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset, uint class_index,
+                    glm::vec2 lower_bound, glm::vec2 upper_bound,
+                    GLuint density_map_texture_unit, const DensityMap& density_map,
+                    GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                    GLuint density_buffer_binding_index, GLuint exclusion_shape_buffer_binding_index,
+                    GLuint exclusion_bin_buffer_binding_index, std::optional<GLuint> exclusion_mask_texture_unit,
+                    std::optional<GLuint> statistics_buffer_binding_index = std::nullopt);
+
+    /**
+     * @brief Set the inputs of the density expression of the kernel. Has no effect on kernels without one.
+     * @param heightmap_texture_unit Texture unit of the heightmap, which must differ from the density map unit.
+     * @param world_scale Dimensions of the world, as in WorldData.
+     */
+    void setExpressionInputs(GLuint heightmap_texture_unit, glm::vec3 world_scale);
+
+    static constexpr GLuint default_page_table_texture_unit = 2;
+    static constexpr GLuint default_page_cache_texture_unit = 3;
+
+    /**
+     * @brief Set the texture units read when the density map is a virtual texture.
+     * If DensityMap::virtual_texture is set, its page table and page cache must be bound to these units instead of
+     * binding DensityMap::texture to the density map texture unit. They must differ from all other texture units.
+     */
+    void setVirtualTextureUnits(GLuint page_table_texture_unit, GLuint page_cache_texture_unit);
+
+    static constexpr GLuint default_parameter_binding_index = 0;
+
+    /// Set the uniform buffer binding point the per-dispatch parameters are bound to. @see ParameterBuffer
+    void setParameterBindingIndex(GLuint binding_index);
+
+    [[nodiscard]] GLuint getParameterBindingIndex() const
+    { return m_parameter_block.getBindingIndex(); }
 
     template<typename ArrayLike>
     void setDitheringMatrix(const ArrayLike &values)
@@ -44,20 +114,48 @@ public:
     }
 
 private:
+    /// Per-dispatch parameters, laid out like the std140 EvaluationParameters uniform block.
+    struct Parameters
+    {
+        glm::vec4 density_map_params;
+        glm::vec2 lower_bound;
+        glm::vec2 upper_bound;
+        glm::uvec2 work_group_index_offset;
+        glm::vec2 density_map_size;
+        glm::vec3 world_scale;
+        std::uint32_t class_index;
+        std::uint32_t virtual_density_map;
+        std::uint32_t test_exclusion_zones;
+        std::uint32_t use_exclusion_mask;
+        std::uint32_t collect_statistics;
+    };
+
+    void m_dispatch(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset, uint class_index,
+                    glm::vec2 lower_bound, glm::vec2 upper_bound,
+                    GLuint density_map_texture_unit, const DensityMap& density_map,
+                    GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                    GLuint density_buffer_binding_index, bool test_exclusion_zones, bool use_exclusion_mask,
+                    std::optional<GLuint> statistics_buffer_binding_index);
+
     ComputeShaderProgram m_program;
 
     using CS = ComputeShaderProgram;
 
-    CS::TypedUniform<uint> m_class_index;
-    CS::TypedUniform<glm::vec2> m_lower_bound;
-    CS::TypedUniform<glm::vec2> m_upper_bound;
-    CS::TypedUniform<glm::uvec2> m_work_group_index_offset;
     CS::TypedUniform<float[work_group_size.x][work_group_size.y]> m_dithering_matrix;
-    CS::TypedUniform<glm::vec4> m_density_map_params;
     CS::CachedUniform<int> m_density_map;
+    CS::TypedUniform<int> m_density_map_page_table;
+    CS::TypedUniform<int> m_density_map_page_cache;
+    CS::CachedUniform<int> m_exclusion_mask;
+    CS::CachedUniform<int> m_heightmap;
+    CS::UniformBlock m_parameter_block;
+    ParameterBuffer m_parameter_buffer;
+    glm::vec3 m_world_scale {1.0f};
     CS::ShaderStorageBlock m_candidate_buffer;
     CS::ShaderStorageBlock m_world_uv_buffer;
     CS::ShaderStorageBlock m_density_buffer;
+    CS::ShaderStorageBlock m_exclusion_shape_buffer;
+    CS::ShaderStorageBlock m_exclusion_bin_buffer;
+    CS::ShaderStorageBlock m_statistics_buffer;
 };
 
 } // placement
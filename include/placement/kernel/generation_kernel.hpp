@@ -2,12 +2,17 @@
 #define PROCEDURALPLACEMENTLIB_GENERATION_KERNEL_HPP
 
 #include "compute_kernel.hpp"
+#include "parameter_buffer.hpp"
 
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 
+#include <cstdint>
+
 namespace placement {
 
+class VirtualTexture;
+
 class GenerationKernel final
 {
 public:
@@ -15,32 +20,48 @@ public:
 
     GenerationKernel();
 
-    /// Dispatch the compute kernel with the specified arguments.
+    /// Submit the program of the kernel for compilation, without waiting for it. @see PendingComputeShaderProgram
+    [[nodiscard]] static PendingComputeShaderProgram compile();
+
+    /// Construct the kernel from a program returned by compile(), blocking until it is linked.
+    explicit GenerationKernel(PendingComputeShaderProgram &&program);
+
+    /**
+     * @brief Dispatch the compute kernel with the specified arguments.
+     * @param seed selects the pattern of the work groups, and how it is mirrored and shifted.
+     * @param pattern_buffer_binding_index binding of the patterns of a WorkGroupPatternLibrary, as laid out by
+     *      WorkGroupPatternLibrary::getPatterns(). Their bounds must be set with setWorkGroupPatternBoundaries().
+     */
     void operator()(glm::uvec2 num_work_groups, glm::uvec2 group_offset, float footprint, glm::vec3 world_scale,
-                    GLuint heightmap_texture_unit, GLuint candidate_buffer_binding_index,
-                    GLuint world_uv_buffer_binding_index, GLuint density_buffer_binding_index);
+                    std::uint32_t seed, GLuint heightmap_texture_unit, GLuint pattern_buffer_binding_index,
+                    GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                    GLuint density_buffer_binding_index);
+
+    /**
+     * @brief Dispatch the compute kernel, sampling heights from a virtual texture.
+     * The page table and page cache of @p heightmap must be bound to the units set with setVirtualTextureUnits(), and
+     * the pages covering the dispatch must be resident.
+     */
+    void operator()(glm::uvec2 num_work_groups, glm::uvec2 group_offset, float footprint, glm::vec3 world_scale,
+                    std::uint32_t seed, const VirtualTexture &heightmap, GLuint pattern_buffer_binding_index,
+                    GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                    GLuint density_buffer_binding_index);
 
-    template<typename ArrayLike>
-    void setWorkGroupPattern(const ArrayLike &values)
-    {
-        for (uint i = 0; i < work_group_size.x; i++)
-            setWorkGroupPatternColumn(i, values[i * work_group_size.y]);
-    }
+    static constexpr GLuint default_page_table_texture_unit = 2;
+    static constexpr GLuint default_page_cache_texture_unit = 3;
 
-    template<typename NestedArrayLike>
-    void setWorkGroupPatternColumns(const NestedArrayLike &columns)
-    {
-        for (uint i = 0; i < work_group_size.x; i++)
-            setWorkGroupPatternColumn(i, columns[i]);
-    }
+    /// Set the texture units read when sampling a virtual texture. These must differ from the heightmap texture unit.
+    void setVirtualTextureUnits(GLuint page_table_texture_unit, GLuint page_cache_texture_unit);
 
-    template<typename ArrayLike>
-    void setWorkGroupPatternColumn(uint column_index, const ArrayLike &column_values)
-    {
-        m_program.setUniform(m_work_group_pattern[column_index], column_values);
-    }
+    static constexpr GLuint default_parameter_binding_index = 0;
+
+    /// Set the uniform buffer binding point the per-dispatch parameters are bound to. @see ParameterBuffer
+    void setParameterBindingIndex(GLuint binding_index);
 
-    /// How much space does the pattern specified with setWorkGroupPattern() occupies.
+    [[nodiscard]] GLuint getParameterBindingIndex() const
+    { return m_parameter_block.getBindingIndex(); }
+
+    /// How much space the patterns of the pattern buffer occupy. @see WorkGroupPatternLibrary::getBounds()
     void setWorkGroupPatternBoundaries(glm::vec2 boundaries)
     {
         m_program.setUniform(m_work_group_scale, boundaries);
@@ -71,6 +92,22 @@ public:
     }
 
 private:
+    /// Per-dispatch parameters, laid out like the std140 GenerationParameters uniform block.
+    struct Parameters
+    {
+        glm::vec3 world_scale;
+        float footprint;
+        glm::uvec2 work_group_offset;
+        glm::vec2 heightmap_size;
+        std::uint32_t virtual_heightmap;
+        std::uint32_t seed;
+        std::uint32_t padding[2];
+    };
+
+    void m_dispatch(glm::uvec2 num_work_groups, const Parameters &parameters, GLuint pattern_buffer_binding_index,
+                    GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                    GLuint density_buffer_binding_index);
+
     [[nodiscard]]
     static constexpr GLsizeiptr s_calculateBufferSize(glm::uvec3 num_work_groups, GLsizeiptr element_size)
     {
@@ -82,12 +119,13 @@ private:
 
     using CS = ComputeShaderProgram;
 
-    CS::TypedUniform<float> m_footprint;
-    CS::TypedUniform<glm::vec3> m_world_scale;
-    CS::TypedUniform<glm::vec2[work_group_size.x][work_group_size.y]> m_work_group_pattern;
-    CS::TypedUniform<glm::uvec2> m_work_group_offset;
     CS::CachedUniform<glm::vec2> m_work_group_scale;
     CS::CachedUniform<int> m_heightmap_tex;
+    CS::TypedUniform<int> m_heightmap_page_table;
+    CS::TypedUniform<int> m_heightmap_page_cache;
+    CS::UniformBlock m_parameter_block;
+    ParameterBuffer m_parameter_buffer;
+    CS::ShaderStorageBlock m_pattern_buf;
     CS::ShaderStorageBlock m_candidate_buf;
     CS::ShaderStorageBlock m_world_uv_buf;
     CS::ShaderStorageBlock m_density_buf;
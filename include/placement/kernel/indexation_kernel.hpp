@@ -13,9 +13,30 @@ public:
 
     IndexationKernel();
 
+    /// Submit the program of the kernel for compilation, without waiting for it. @see PendingComputeShaderProgram
+    [[nodiscard]] static PendingComputeShaderProgram compile();
+
+    /// Construct the kernel from a program returned by compile(), blocking until it is linked.
+    explicit IndexationKernel(PendingComputeShaderProgram &&program);
+
     void operator()(uint num_work_groups, uint candidate_buffer_binding_index, uint count_buffer_binding_index,
                     uint index_buffer_binding_index);
 
+    /**
+     * @brief Dispatch the kernel, additionally writing the element count of each class within each cell.
+     * Candidates are grouped into cells of cell_capacity consecutive elements (the candidates of one generation
+     * work group), laid out in row major order over a grid of @p cell_grid_size cells. In this mode the values
+     * written to the index buffer are relative to the first element of the cell, and the count of every
+     * (class, cell) pair is written into the second component of the matching cell index entry. The first component
+     * must then be computed with CellScanKernel.
+     */
+    void operator()(uint num_work_groups, glm::uvec2 cell_grid_size, uint candidate_buffer_binding_index,
+                    uint count_buffer_binding_index, uint index_buffer_binding_index,
+                    uint cell_index_buffer_binding_index);
+
+    /// Number of consecutive candidates that make up a single cell.
+    static constexpr uint cell_capacity = 2 * work_group_size.x;
+
     [[nodiscard]]
     static constexpr GLsizeiptr getCountBufferMemoryRequirement(uint class_count)
     {
@@ -28,6 +49,12 @@ public:
         return candidate_count * static_cast<GLsizeiptr>(sizeof(uint));
     }
 
+    [[nodiscard]]
+    static constexpr GLsizeiptr getCellIndexBufferMemoryRequirement(uint class_count, uint cell_count)
+    {
+        return class_count * static_cast<GLsizeiptr>(cell_count) * 2 * static_cast<GLsizeiptr>(sizeof(uint));
+    }
+
     [[nodiscard]]
     static constexpr uint calculateNumWorkGroups(uint candidate_count)
     {
@@ -39,9 +66,12 @@ private:
 
     using CS = ComputeShaderProgram;
 
+    CS::TypedUniform<int> m_write_cell_index;
+    CS::TypedUniform<glm::uvec2> m_cell_grid_size;
     CS::ShaderStorageBlock m_candidate_buffer;
     CS::ShaderStorageBlock m_count_buffer;
     CS::ShaderStorageBlock m_index_buffer;
+    CS::ShaderStorageBlock m_cell_index_buffer;
 };
 
 } // placement
@@ -0,0 +1,60 @@
+#ifndef PROCEDURALPLACEMENTLIB_PARAMETER_BUFFER_HPP
+#define PROCEDURALPLACEMENTLIB_PARAMETER_BUFFER_HPP
+
+#include "glutils/buffer.hpp"
+#include "glutils/sync.hpp"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+namespace placement {
+
+/**
+ * @brief Ring buffer of per-dispatch kernel parameters, bound as uniform buffer ranges.
+ * Parameters are written straight into persistently mapped memory, so a dispatch only costs a copy and a single
+ * glBindBufferRange() call instead of one glProgramUniform*() call per parameter. The buffer is split into segments;
+ * a fence is placed when writing moves past a segment, and reusing it waits for the dispatches that read it.
+ */
+class ParameterBuffer
+{
+public:
+    static constexpr GLsizeiptr default_size = 1 << 16;
+    static constexpr std::size_t segment_count = 4;
+
+    explicit ParameterBuffer(GLsizeiptr size = default_size);
+
+    /**
+     * @brief Copy a block of parameters into the buffer and bind it to a uniform buffer binding point.
+     * @throw std::length_error if @p size exceeds the size of a segment.
+     */
+    void bind(GLuint binding_index, const void *data, GLsizeiptr size);
+
+    template<typename T>
+    void bind(GLuint binding_index, const T &parameters)
+    { bind(binding_index, &parameters, static_cast<GLsizeiptr>(sizeof(T))); }
+
+    /// Offset of the last block written, relative to the start of the buffer.
+    [[nodiscard]] GLintptr getLastOffset() const noexcept { return m_last_offset; }
+
+    [[nodiscard]] GLsizeiptr getSize() const noexcept { return m_size; }
+
+    [[nodiscard]] GL::BufferHandle getBuffer() const { return m_buffer; }
+
+private:
+    GL::Buffer m_buffer;
+    std::byte *m_mapped_ptr {nullptr};
+    GLsizeiptr m_size;
+    GLsizeiptr m_segment_size;
+    GLintptr m_alignment;
+    std::size_t m_segment {0};
+    GLintptr m_head {0};
+    GLintptr m_last_offset {0};
+    std::array<std::optional<GL::Sync>, segment_count> m_segment_fences;
+
+    void m_advanceSegment();
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_PARAMETER_BUFFER_HPP
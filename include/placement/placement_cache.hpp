@@ -0,0 +1,63 @@
+#ifndef PROCEDURALPLACEMENTLIB_PLACEMENT_CACHE_HPP
+#define PROCEDURALPLACEMENTLIB_PLACEMENT_CACHE_HPP
+
+#include "placement_pipeline.hpp"
+
+#include <vector>
+
+namespace placement {
+
+/**
+ * @brief Keeps the result of a placement region up to date while the textures it depends on are edited.
+ * Edits are reported with markDirty(), and update() recomputes only the work groups they touch, splicing the new
+ * elements into the cached result. See PlacementPipeline::updatePlacement().
+ *
+ * The cache stores copies of the world and layer data; textures are referenced by name, so changes to their contents
+ * are picked up as long as they are reported. The pipeline must outlive the cache, and its random seed and exclusion
+ * zones should not change, except for edits reported as dirty regions.
+ */
+class PlacementCache
+{
+public:
+    using Rectangle = PlacementPipeline::Rectangle;
+
+    /// Compute the initial result, with PlacementPipeline::ElementOrder::morton regardless of the pipeline settings.
+    PlacementCache(PlacementPipeline &pipeline, const WorldData &world_data, const LayerData &layer_data,
+                   glm::vec2 lower_bound, glm::vec2 upper_bound);
+
+    /**
+     * @brief Report an edit to the texels of a texture covering a world space rectangle.
+     * Edits to textures the cached result doesn't depend on are ignored. The heightmap, the density maps and the
+     * exclusion mask of the pipeline are taken into account.
+     */
+    void markDirty(GLuint texture, glm::vec2 lower_bound, glm::vec2 upper_bound);
+
+    /// Report a change that affects all placement in a world space rectangle, e.g. new exclusion zones.
+    void markDirty(glm::vec2 lower_bound, glm::vec2 upper_bound);
+
+    [[nodiscard]] bool isDirty() const noexcept { return !m_dirty_regions.empty(); }
+
+    /// Recompute the dirty regions, if any, and return the up-to-date result. Blocks until the update is complete.
+    const Result &update();
+
+    /// The cached result, which may be out of date if isDirty().
+    [[nodiscard]] const Result &getResult() const noexcept { return m_result; }
+
+    [[nodiscard]] glm::vec2 getLowerBound() const noexcept { return m_lower_bound; }
+    [[nodiscard]] glm::vec2 getUpperBound() const noexcept { return m_upper_bound; }
+
+private:
+    PlacementPipeline &m_pipeline;
+    WorldData m_world_data;
+    LayerData m_layer_data;
+    glm::vec2 m_lower_bound;
+    glm::vec2 m_upper_bound;
+    Result m_result;
+    std::vector<Rectangle> m_dirty_regions;
+
+    [[nodiscard]] bool m_usesTexture(GLuint texture) const;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_PLACEMENT_CACHE_HPP
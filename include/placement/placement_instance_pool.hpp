@@ -0,0 +1,164 @@
+#ifndef PROCEDURALPLACEMENTLIB_PLACEMENT_INSTANCE_POOL_HPP
+#define PROCEDURALPLACEMENTLIB_PLACEMENT_INSTANCE_POOL_HPP
+
+#include "placement_result.hpp"
+
+#include "glutils/buffer.hpp"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace placement {
+
+/// Layout of the commands read by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand
+{
+    std::uint32_t count;
+    std::uint32_t instance_count;
+    std::uint32_t first_index;
+    std::int32_t base_vertex;
+    std::uint32_t base_instance;
+};
+
+/**
+ * @brief Keeps the elements of many results, e.g. the tiles around the camera, in a single GPU buffer, and draws each
+ * class with a single multi-draw-indirect call.
+ *
+ * The pool buffer is an array of ResultElement structures allocated once. Each inserted result gets a contiguous range
+ * of it, exactly as large as its element count, from a free list of ranges; erasing the result returns the range to
+ * the free list, merged with its free neighbours, for the next tiles to reuse. Elements are copied from the result
+ * buffer on the GPU, without a round trip through the host, and keep the order of the result, so the elements of each
+ * class are contiguous within each range.
+ *
+ * Draw commands index instances with their base instance, so a vertex array that reads the pool buffer as instanced
+ * attributes at offset 0 serves every command. Their mesh, i.e. the range of indices drawn for the elements of each
+ * class, is set with setClassMesh().
+ *
+ * Only one thread may use a pool, the one with its GL context.
+ */
+class PlacementInstancePool
+{
+public:
+    using uint = std::uint32_t;
+
+    /// Identifies the elements of an inserted result. Ids are never reused.
+    using TileId = std::uint64_t;
+
+    /// Indices of the mesh drawn for each element of a class, as in glDrawElementsBaseVertex.
+    struct MeshRange
+    {
+        uint index_count {0};
+        uint first_index {0};
+        std::int32_t base_vertex {0};
+    };
+
+    /// Commands of a single class in the draw command buffer. @see updateDrawCommands()
+    struct DrawCommandList
+    {
+        GLintptr offset;    ///< Byte offset of the first command, to pass as the indirect pointer.
+        GLsizei count;      ///< Number of commands, to pass as the draw count.
+    };
+
+    /**
+     * @brief Allocate a pool with room for @p element_capacity elements of @p num_classes classes.
+     * @throw std::invalid_argument if either is 0.
+     */
+    PlacementInstancePool(uint element_capacity, uint num_classes);
+
+    /**
+     * @brief Copy the elements of @p result into the pool.
+     * @return The id of the new tile, or nullopt if no free range can hold the elements, in which case tiles have to
+     * be erased first.
+     * @throw std::invalid_argument if the result doesn't have the classes of the pool, or its layout is not
+     * ResultLayout::array_of_structures.
+     */
+    [[nodiscard]] std::optional<TileId> insert(const Result &result);
+
+    /// Release the range of a tile. Does nothing if there is no such tile.
+    void erase(TileId tile);
+
+    /// Release all ranges.
+    void clear();
+
+    [[nodiscard]] bool contains(TileId tile) const { return m_tiles.count(tile) > 0; }
+
+    [[nodiscard]] std::size_t getTileCount() const noexcept { return m_tiles.size(); }
+
+    /// Index of the first element of @p tile in the pool buffer. @throw std::out_of_range if there is no such tile.
+    [[nodiscard]] uint getTileElementOffset(TileId tile) const;
+
+    /// Index offsets of the classes of @p tile, as in Result::getIndexOffsets(), relative to getTileElementOffset().
+    [[nodiscard]] const std::vector<uint> &getTileIndexOffsets(TileId tile) const;
+
+    [[nodiscard]] uint getElementCapacity() const noexcept { return m_element_capacity; }
+
+    /// Number of elements in the pool, i.e. of allocated elements.
+    [[nodiscard]] uint getElementCount() const noexcept { return m_element_count; }
+
+    /// Size of the largest free range. Smaller than the free element count if the pool is fragmented.
+    [[nodiscard]] uint getLargestFreeRange() const;
+
+    [[nodiscard]] uint getNumClasses() const noexcept { return m_num_classes; }
+
+    /// The pool buffer, an array of getElementCapacity() ResultElement structures.
+    [[nodiscard]] GL::BufferHandle getBuffer() const noexcept { return m_buffer; }
+
+    /// Set the mesh drawn for the elements of a class.
+    void setClassMesh(uint class_index, MeshRange mesh);
+
+    [[nodiscard]] const MeshRange &getClassMesh(uint class_index) const { return m_meshes.at(class_index); }
+
+    /**
+     * @brief The draw commands of a class: one per tile with elements of the class, in order of insertion.
+     * Classes with no mesh have no commands.
+     */
+    [[nodiscard]] std::vector<DrawElementsIndirectCommand> makeDrawCommands(uint class_index) const;
+
+    /**
+     * @brief Write the commands of all the classes to the draw command buffer, if tiles or meshes have changed since the
+     * last update. The buffer is reallocated only if it grows.
+     * @return true if the commands were written.
+     */
+    bool updateDrawCommands();
+
+    /// The buffer written by updateDrawCommands(), to bind to GL_DRAW_INDIRECT_BUFFER.
+    [[nodiscard]] GL::BufferHandle getDrawCommandBuffer() const noexcept { return m_command_buffer; }
+
+    /// Range of the commands of a class in the draw command buffer, as of the last updateDrawCommands().
+    [[nodiscard]] DrawCommandList getDrawCommandList(uint class_index) const { return m_command_lists.at(class_index); }
+
+private:
+    struct Tile
+    {
+        uint element_offset;
+        std::vector<uint> index_offsets;
+    };
+
+    uint m_element_capacity;
+    uint m_num_classes;
+    uint m_element_count {0};
+    GL::Buffer m_buffer;
+
+    /// Free ranges, as element count by element offset. Adjacent ranges are always merged.
+    std::map<uint, uint> m_free_ranges;
+
+    std::map<TileId, Tile> m_tiles;
+    TileId m_next_tile_id {1};
+
+    std::vector<MeshRange> m_meshes;
+    std::vector<DrawCommandList> m_command_lists;
+    GL::Buffer m_command_buffer;
+    GLsizeiptr m_command_buffer_size {0};
+    bool m_commands_dirty {true};
+
+    /// Best fit allocation, to keep large ranges for large tiles.
+    [[nodiscard]] std::optional<uint> m_allocate(uint element_count);
+
+    void m_free(uint element_offset, uint element_count);
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_PLACEMENT_INSTANCE_POOL_HPP
@@ -2,10 +2,19 @@
 #define PROCEDURALPLACEMENTLIB_PLACEMENT_PIPELINE_HPP
 
 #include "placement_result.hpp"
+#include "exclusion_zones.hpp"
+#include "virtual_texture.hpp"
+#include "tile_grid.hpp"
+#include "density_expression.hpp"
+#include "work_group_pattern_library.hpp"
+#include "request_recorder.hpp"
 #include "kernel/generation_kernel.hpp"
 #include "kernel/evaluation_kernel.hpp"
+#include "kernel/array_evaluation_kernel.hpp"
 #include "kernel/indexation_kernel.hpp"
 #include "kernel/copy_kernel.hpp"
+#include "kernel/cell_scan_kernel.hpp"
+#include "kernel/deferred_kernel.hpp"
 
 #include "glutils/sync.hpp"
 #include "glutils/buffer.hpp"
@@ -16,6 +25,10 @@
 #include <vector>
 #include <chrono>
 #include <optional>
+#include <map>
+#include <string>
+#include <utility>
+#include <memory>
 
 namespace placement {
 
@@ -27,6 +40,19 @@ struct LayerData
 
     /// An array of density maps, each one representing a different "object class".
     std::vector<DensityMap> densitymaps;
+
+    /**
+     * If set, name of a GL_TEXTURE_2D_ARRAY holding the density map of class i in slice i. All classes are then
+     * evaluated in a single dispatch; the texture of each density map is ignored, but its scale, offset and clamping
+     * range still apply. Density maps must not use virtual textures or expressions in this case.
+     */
+    GLuint density_map_array {0};
+
+    /**
+     * If set, the random seed of this layer, used instead of the one of the pipeline. Layers of a single operation,
+     * and consecutive operations, may each use a different seed at no extra cost. @see PlacementPipeline::setRandomSeed()
+     */
+    std::optional<std::uint32_t> seed;
 };
 
 /// World data contains information about the landscape objects are placed on.
@@ -37,26 +63,140 @@ struct WorldData
 
     /// Name of an OpenGL texture object to be used as the heightmap of the terrain.
     GLuint heightmap;
+
+    /// If set, heights are sampled from this virtual texture instead of @ref heightmap. @see VirtualTexture
+    VirtualTexture *virtual_heightmap {nullptr};
 };
 
+/**
+ * @brief Range [begin, end) of the class indices of layer @p layer_index in the result of a multi-layer placement.
+ * @see PlacementPipeline::computePlacement(const WorldData&, const std::vector<LayerData>&, glm::vec2, glm::vec2)
+ */
+[[nodiscard]]
+inline std::pair<std::uint32_t, std::uint32_t> getLayerClassRange(const std::vector<LayerData> &layers,
+                                                                  std::size_t layer_index)
+{
+    std::uint32_t begin = 0;
+    for (std::size_t i = 0; i < layer_index; i++)
+        begin += layers[i].densitymaps.size();
+
+    return {begin, begin + static_cast<std::uint32_t>(layers[layer_index].densitymaps.size())};
+}
+
 class PlacementPipeline
 {
 public:
+    /**
+     * @brief Submit the kernels used by every placement operation for compilation, without waiting for them.
+     * With GL_KHR_parallel_shader_compile they compile in parallel in the background; see isReady(). The first
+     * placement operation, or waitUntilReady(), blocks until they are linked. The kernels of optional stages, i.e.
+     * density map arrays, ElementOrder::morton and density expressions, are only compiled once they are used.
+     */
     PlacementPipeline();
 
-    /// Multiclass placement.
+    /// Check, without blocking, whether the kernels submitted by the constructor have finished compiling.
+    [[nodiscard]] bool isReady() const;
+
+    /**
+     * @brief Block until the kernels submitted by the constructor are linked.
+     * @throw GL::GLError with the info logs of all the kernels that failed to compile or link.
+     */
+    void waitUntilReady();
+
+    /**
+     * @brief Multiclass placement.
+     * If the world or layer data use virtual textures, this call blocks until the pages covering the placement region
+     * are resident. Use requestResidency() beforehand to avoid waiting.
+     * @throw std::logic_error if a density expression uses the heightmap, i.e. DensityExpression::usesHeightmap(), and
+     *      the world uses a virtual heightmap.
+     */
     [[nodiscard]]
     FutureResult computePlacement(const WorldData &world_data, const LayerData &layer_data,
                                   glm::vec2 lower_bound, glm::vec2 upper_bound);
 
     /**
-     * @brief set the seed for the random number generator.
-     * For a given set of heightmap, densitymap and world scale, the random seed completely determines placement.
+     * @brief Placement of several layers, with different footprints, in a single submission.
+     * All layers share the transient buffers and the indexation and copy dispatches, and produce a single result with
+     * a single fence. The classes of the layers are numbered consecutively: the classes of layer i start after those
+     * of layers [0, i), see getLayerClassRange().
+     * @throw std::invalid_argument if @p layers is empty, or has more than one layer with ElementOrder::morton, since a
+     *      cell index is built for the work groups of a single footprint.
+     */
+    [[nodiscard]]
+    FutureResult computePlacement(const WorldData &world_data, const std::vector<LayerData> &layers,
+                                  glm::vec2 lower_bound, glm::vec2 upper_bound);
+
+    /// An axis aligned rectangle in world space, as a (lower bound, upper bound) pair.
+    using Rectangle = std::pair<glm::vec2, glm::vec2>;
+
+    /**
+     * @brief Incrementally recompute a previous result after edits to the textures it was computed from.
+     * Only the work groups that overlap @p dirty_regions are recomputed, and their elements are spliced into a copy of
+     * @p previous, updating the per-class offsets and the cell index. Overlapping regions are merged, so each work group
+     * is computed at most once. Placement work, i.e. generation and evaluation of candidates, grows with the dirty area
+     * rather than with the region; the splice doesn't, see spliceResults(), but it is much cheaper than recomputing.
+     *
+     * The call doesn't block: the work groups are dispatched right away, and their elements are spliced by
+     * FutureResult::readResult() once they are all computed. @p previous must stay alive until then.
+     *
+     * Each dirty region must cover every texel changed by the edit, plus the texels that filtering may blend with them.
+     * The other arguments, the random seed and the exclusion zones must be the same as when @p previous was computed,
+     * unless the changes only affect the dirty regions.
+     *
+     * @param previous A result computed for the same placement region with ElementOrder::morton. The new result uses
+     *      the same element order and layout, regardless of the current settings of the pipeline.
+     * @throw std::invalid_argument if @p previous has no cell index, or doesn't match the placement region.
+     */
+    [[nodiscard]]
+    FutureResult updatePlacement(const WorldData &world_data, const LayerData &layer_data,
+                                 glm::vec2 lower_bound, glm::vec2 upper_bound, const Result &previous,
+                                 const std::vector<Rectangle> &dirty_regions);
+
+    /**
+     * @brief Split a placement region into tiles of @p tile_size work groups along each axis. @see TileGrid
+     * The grid depends on the footprint and on the random seed, which must not change before its tiles are computed.
+     * @throw std::invalid_argument if @p tile_size is zero along any axis.
+     */
+    [[nodiscard]] TileGrid makeTileGrid(float footprint, glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                        glm::uvec2 tile_size) const;
+
+    /**
+     * @brief Compute placement in a single tile of a TileGrid.
+     * Uses the current element order and layout; with ElementOrder::morton, the cell grid of the result covers exactly
+     * the work groups of the tile. Combine tiles with mergeResults().
+     * @throw std::invalid_argument if @p grid was made for a different footprint or random seed, or if @p tile is
+     *      outside of it.
+     */
+    [[nodiscard]]
+    FutureResult computeTile(const WorldData &world_data, const LayerData &layer_data, const TileGrid &grid,
+                             glm::uvec2 tile);
+
+    /**
+     * @brief Request the pages of all the virtual textures needed to compute placement in a region.
+     * Pages loaded since the last call are made resident, and missing ones are queued to be loaded in the background.
+     * @return true if all pages are resident, i.e. if computePlacement() would not block for the same arguments.
      */
-    void setRandomSeed(uint seed);
+    bool requestResidency(const WorldData &world_data, const LayerData &layer_data,
+                          glm::vec2 lower_bound, glm::vec2 upper_bound);
+
+    /**
+     * @brief set the seed for the random number generator, used by the layers that don't set LayerData::seed.
+     * For a given set of heightmap, densitymap and world scale, the random seed and the pattern library completely
+     * determine placement. The seed selects a pattern of the library on the GPU, so changing it costs nothing.
+     */
+    void setRandomSeed(uint seed) { m_random_seed = seed; }
+
+    [[nodiscard]] uint getRandomSeed() const { return m_random_seed; }
+
+    /**
+     * @brief Upload the candidate patterns that seeds select from. Pipelines start with
+     * WorkGroupPatternLibrary::getDefault(). Tile grids made before the call are invalid if the bounds of the patterns
+     * change.
+     */
+    void setPatternLibrary(const WorkGroupPatternLibrary &library);
 
     /// The number of different texture units used by the placement compute shaders
-    static constexpr auto required_texture_units = 2u;
+    static constexpr auto required_texture_units = 5u;
 
     /**
      * @brief Configures the texture units the pipeline will use
@@ -66,7 +206,7 @@ public:
     void setBaseTextureUnit(GLuint index);
 
     /// The number of different shader storage buffer binding points used by the placement compute shaders.
-    static constexpr auto required_shader_storage_binding_points = 6u;
+    static constexpr auto required_shader_storage_binding_points = 13u;
 
     /**
      * @brief Configures the shader storage buffer binding points the pipeline will use.
@@ -75,17 +215,269 @@ public:
      */
     void setBaseShaderStorageBindingPoint(GLuint index);
 
+    /// The number of different uniform buffer binding points used by the placement compute shaders.
+    static constexpr auto required_uniform_buffer_binding_points = 1u;
+
+    /**
+     * @brief Configures the uniform buffer binding points the pipeline will use.
+     * Per-dispatch kernel parameters are written to a persistently mapped ring buffer and bound to these points.
+     * @param index An index such that elements in the range [index, index + required_uniform_buffer_binding_points)
+     *      are valid uniform buffer binding points.
+     */
+    void setBaseUniformBufferBindingPoint(GLuint index);
+
+    /**
+     * @brief Free the GPU memory used between the stages of placement operations.
+     * The pipeline keeps this buffer, sized for the largest operation so far, and reuses it for subsequent ones.
+     */
+    void releaseTransientBuffer();
+
+    /// Size of the buffer used between the stages of placement operations, in bytes.
+    [[nodiscard]] GLsizeiptr getTransientBufferSize() const { return m_transient_buffer_size; }
+
+    /**
+     * @brief Count what happens to the candidates of subsequent placement operations. @see PlacementStatistics
+     * The evaluation kernels add their counts to a small buffer per operation with one atomic operation per work
+     * group and counter, so the cost is low but not zero. Results of these operations have statistics.
+     */
+    void setStatisticsEnabled(bool enabled) { m_collect_statistics = enabled; }
+
+    [[nodiscard]] bool getStatisticsEnabled() const { return m_collect_statistics; }
+
+    /**
+     * @brief Compute the bounding box of each class in subsequent placement operations, and of each class in each cell
+     * if the element order is ElementOrder::morton. @see Result::getClassBounds(), Result::getCellBounds()
+     * The copy kernel reduces the positions of each class within a work group and then grows the boxes of the operation
+     * with atomic operations, so that they can be used to cull the elements without reading them.
+     */
+    void setBoundsEnabled(bool enabled) { m_compute_bounds = enabled; }
+
+    [[nodiscard]] bool getBoundsEnabled() const { return m_compute_bounds; }
+
+    /**
+     * @brief Statistics of all the operations computed with statistics enabled since the last resetStatistics().
+     * Operations the GPU hasn't finished yet are added by a later call, once they complete.
+     */
+    [[nodiscard]] const PlacementStatistics &getStatistics();
+
+    /// Clear the aggregated statistics, including those of operations that haven't completed yet.
+    void resetStatistics();
+
+    /**
+     * @brief Record the spans of subsequent placement operations to @p sink, or stop tracing with nullptr.
+     * Each traced operation gets a request id, see FutureResult::getRequestId(). On the CPU, the pipeline records
+     * making virtual textures resident, allocating buffers, uploading parameters and submitting the dispatches, and
+     * FutureResult::readResult() the fence wait and the read. On the GPU, each stage is timed with timestamp queries;
+     * these spans reach the sink from a later operation or flushTrace(), once available, so tracing never stalls.
+     * Changing the sink drops the GPU spans that are not available yet.
+     */
+    void setTraceSink(std::shared_ptr<TraceSink> sink);
+
+    [[nodiscard]] const std::shared_ptr<TraceSink> &getTraceSink() const { return m_trace_sink; }
+
+    /// Pass the GPU spans of the operations that have completed to the trace sink.
+    void flushTrace();
+
+    /**
+     * @brief Record the parameters and issue time of subsequent computePlacement() calls to @p recorder, e.g. to replay
+     * them later with pplib-replay, or stop recording with nullptr. @see RequestRecorder
+     */
+    void setRequestRecorder(std::shared_ptr<RequestRecorder> recorder) { m_request_recorder = std::move(recorder); }
+
+    [[nodiscard]] const std::shared_ptr<RequestRecorder> &getRequestRecorder() const { return m_request_recorder; }
+
+    /// Order of the elements of each class within the result buffer.
+    enum class ElementOrder
+    {
+        /// Order is determined by the scheduling of the compute shaders, and may vary between calls.
+        unspecified,
+        /**
+         * Elements are sorted by the Z-order (Morton) rank of the work group cell they fall in, so that spatially
+         * close elements are close in memory, and a cell index is appended to the result buffer.
+         * @see ResultBuffer, CellGrid
+         */
+        morton
+    };
+
+    /// Set the order in which subsequent calls to computePlacement() will write the elements of each class.
+    void setElementOrder(ElementOrder order);
+
+    [[nodiscard]] ElementOrder getElementOrder() const { return m_element_order; }
+
+    /**
+     * @brief Set the arrangement of the elements in the result buffers of subsequent calls to computePlacement().
+     * With ResultLayout::structure_of_arrays the copy stage writes the coordinates of the elements of each class as
+     * separate blocks, which can be read on the host through Result::getElementArrays() without any conversion.
+     */
+    void setResultLayout(ResultLayout layout) { m_result_layout = layout; }
+
+    [[nodiscard]] ResultLayout getResultLayout() const { return m_result_layout; }
+
+    /**
+     * @brief Set the exclusion zones applied by subsequent calls to computePlacement().
+     * No objects are placed inside exclusion zones, regardless of the density maps. The shapes are uploaded to GPU
+     * memory once, here; each call to computePlacement() only tests a work group against the shapes that overlap it.
+     */
+    void setExclusionZones(ExclusionZones exclusion_zones);
+
+    [[nodiscard]] const ExclusionZones &getExclusionZones() const { return m_exclusion_zones; }
+
+    /**
+     * @brief Set a texture that marks additional excluded areas, or 0 to disable it.
+     * The texture covers the whole world, like density maps. Objects are excluded where its red channel is at least
+     * 0.5. It is bound to texture unit base + 1, see setBaseTextureUnit().
+     */
+    void setExclusionMask(GLuint texture) { m_exclusion_mask = texture; }
+
+    [[nodiscard]] GLuint getExclusionMask() const { return m_exclusion_mask; }
+
+    /**
+     * @brief Delete the evaluation kernels compiled for density expressions.
+     * A kernel is compiled for each distinct expression used by computePlacement(), and kept until this is called, so
+     * applications that keep editing their expressions should call it once the old versions are no longer needed.
+     * Kernels of expressions that are still used are compiled again on their next use.
+     */
+    void clearExpressionKernels() { m_expression_kernels.clear(); }
+
+    /// The number of evaluation kernels compiled for density expressions, @see clearExpressionKernels()
+    [[nodiscard]] std::size_t getExpressionKernelCount() const { return m_expression_kernels.size(); }
+
 private:
-    [[nodiscard]] static ResultBuffer s_makeResultBuffer(uint candidate_count, uint class_count);
+    /// Times the stages of placement operations on the GPU with pairs of timestamp queries.
+    class GPUTraceRecorder
+    {
+    public:
+        GPUTraceRecorder() = default;
+        GPUTraceRecorder(GPUTraceRecorder &&other) noexcept;
+        GPUTraceRecorder &operator=(GPUTraceRecorder &&other) noexcept;
+        ~GPUTraceRecorder();
+
+        /// Pair the GPU clock with the host clock, for the spans that begin after this call.
+        void calibrate();
+
+        /// Issue the timestamp of the beginning of a span, to be ended by end() after the commands of the stage.
+        [[nodiscard]] std::size_t begin(const char *name, std::uint64_t request_id);
+
+        void end(std::size_t span);
+
+        /// Pass the spans whose timestamps are available to @p sink, in submission order.
+        void collect(TraceSink &sink);
+
+        /// Drop the pending spans.
+        void clear();
+
+    private:
+        struct PendingSpan
+        {
+            const char *name;
+            std::uint64_t request_id;
+            GLuint begin_query;
+            GLuint end_query;
+            TraceSpan::Clock::time_point cpu_reference;
+            std::int64_t gpu_reference;
+        };
+
+        [[nodiscard]] GLuint m_acquireQuery();
+
+        std::vector<PendingSpan> m_pending_spans;
+        std::vector<GLuint> m_free_queries;
+        TraceSpan::Clock::time_point m_cpu_reference;
+        std::int64_t m_gpu_reference {0};
+    };
+
+    [[nodiscard]] static ResultBuffer s_makeResultBuffer(uint candidate_count, uint class_count,
+                                                         const CellGrid &cell_grid);
     [[nodiscard]] uint m_getBindingIndex(uint buffer_index) const;
 
+    /// The evaluation kernel compiled for a density expression, built on first use.
+    [[nodiscard]] EvaluationKernel &m_getExpressionKernel(const DensityExpression &expression);
+
+    /// A kernel, constructed and configured with the current settings on first use.
+    template<class Kernel>
+    [[nodiscard]] Kernel &m_getKernel(DeferredKernel<Kernel> &kernel);
+
+    /// Apply the texture units, uniform buffer binding and pattern bounds of the pipeline to a kernel.
+    void m_configure(GenerationKernel &kernel) const;
+    void m_configure(EvaluationKernel &kernel) const;
+    void m_configure(ArrayEvaluationKernel &kernel) const;
+
+    /// The other kernels have no settings.
+    template<class Kernel>
+    void m_configure(Kernel&) const {}
+
+    /// m_configure() the kernels constructed so far, after a change of settings.
+    void m_configureKernels();
+
+    /// A layer and the range of work groups dispatched for it.
+    struct LayerDispatch
+    {
+        const LayerData *layer_data;
+        glm::uvec2 work_group_offset;
+        glm::uvec2 work_group_count;
+    };
+
+    /**
+     * Dispatch a placement operation over a range of work groups of each layer, rejecting candidates outside the
+     * placement region. A cell index can only be built for a single layer.
+     */
+    [[nodiscard]]
+    FutureResult m_computePlacement(const WorldData &world_data, const std::vector<LayerDispatch> &layers,
+                                    glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                    bool use_cell_index, ResultLayout result_layout);
+
+    /// Generate the candidates of a layer in the currently bound candidate buffers.
+    void m_generateCandidates(const WorldData &world_data, const LayerData &layer_data, glm::uvec2 work_group_offset,
+                              glm::uvec2 work_group_count);
+
+    /// Assign the candidates of a layer to its classes, numbered from @p class_offset.
+    void m_evaluateCandidates(const WorldData &world_data, const LayerData &layer_data, uint class_offset,
+                              glm::vec2 lower_bound, glm::vec2 upper_bound, glm::uvec2 work_group_offset,
+                              glm::uvec2 work_group_count, bool test_exclusion_zones);
+
+    /// Add the statistics of the operations that have completed to the aggregate.
+    void m_collectStatistics();
+
+    /// Pass a computePlacement() call to the request recorder, if any.
+    void m_recordRequest(const WorldData &world_data, const LayerData *layers, std::size_t layer_count,
+                         glm::vec2 lower_bound, glm::vec2 upper_bound) const;
+
+    /// Offset and number of the work groups dispatched to compute placement in [lower_bound, upper_bound).
+    [[nodiscard]] std::pair<glm::uvec2, glm::uvec2> m_getWorkGroupRange(float footprint, glm::vec2 lower_bound,
+                                                                        glm::vec2 upper_bound) const;
+
+    /// World space bounds of the candidates generated to compute placement in [lower_bound, upper_bound).
+    [[nodiscard]] std::pair<glm::vec2, glm::vec2> m_getDispatchBounds(float footprint, glm::vec2 lower_bound,
+                                                                      glm::vec2 upper_bound) const;
+
     uint m_base_tex_unit {0};
     uint m_base_binding_index {0};
+    uint m_base_uniform_binding_index {0};
+    ElementOrder m_element_order {ElementOrder::unspecified};
+    ResultLayout m_result_layout {ResultLayout::array_of_structures};
+    ExclusionZones m_exclusion_zones;
+    GL::Buffer m_exclusion_shape_buffer;
+    bool m_collect_statistics {false};
+    bool m_compute_bounds {false};
+    PlacementStatistics m_statistics;
+    std::vector<std::pair<std::shared_ptr<const StatisticsBuffer>, GL::Sync>> m_pending_statistics;
+    std::shared_ptr<TraceSink> m_trace_sink;
+    std::uint64_t m_request_count {0};
+    GPUTraceRecorder m_gpu_trace;
+    std::shared_ptr<RequestRecorder> m_request_recorder;
+    GL::Buffer m_transient_buffer;
+    GLsizeiptr m_transient_buffer_size {0};
+    GLuint m_exclusion_mask {0};
     glm::vec2 m_work_group_scale;
-    GenerationKernel m_generation_kernel;
-    EvaluationKernel m_evaluation_kernel;
-    IndexationKernel m_indexation_kernel;
-    CopyKernel m_copy_kernel;
+    GL::Buffer m_pattern_buffer;
+    GLsizeiptr m_pattern_buffer_size {0};
+    uint m_random_seed {0};
+    DeferredKernel<GenerationKernel> m_generation_kernel;
+    DeferredKernel<EvaluationKernel> m_evaluation_kernel;
+    std::map<std::string, EvaluationKernel> m_expression_kernels; // keyed by the GLSL source of the expression
+    DeferredKernel<ArrayEvaluationKernel> m_array_evaluation_kernel;
+    DeferredKernel<IndexationKernel> m_indexation_kernel;
+    DeferredKernel<CopyKernel> m_copy_kernel;
+    DeferredKernel<CellScanKernel> m_cell_scan_kernel;
 };
 
 } // placement
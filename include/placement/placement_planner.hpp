@@ -0,0 +1,66 @@
+#ifndef PROCEDURALPLACEMENTLIB_PLACEMENT_PLANNER_HPP
+#define PROCEDURALPLACEMENTLIB_PLACEMENT_PLANNER_HPP
+
+#include "placement_pipeline.hpp"
+
+#include <functional>
+
+namespace placement {
+
+/**
+ * @brief Computes placement over regions too large to be computed at once, within a GPU memory budget.
+ * The region is split into chunks of whole work groups, a TileGrid as large as the budget allows, which are computed
+ * one after the other by the pipeline. At most max_chunks_in_flight chunk results exist at a time, and the buffer used
+ * between the stages of placement is shared by all the chunks. @see PlacementPipeline::getTransientBufferSize()
+ *
+ * The results are the same as those of a single computePlacement() call over the whole region.
+ */
+class PlacementPlanner
+{
+public:
+    /**
+     * @param pipeline The pipeline chunks are computed with. Its settings must not change during an operation.
+     * @param memory_budget Maximum amount of GPU memory, in bytes, used by the buffers of the chunks in flight.
+     * @param max_chunks_in_flight Number of chunks the GPU may work on while the results of earlier ones are read.
+     */
+    PlacementPlanner(PlacementPipeline &pipeline, GLsizeiptr memory_budget, uint max_chunks_in_flight = 2);
+
+    /**
+     * @brief Split a region into chunks that fit the memory budget.
+     * @throw std::invalid_argument if the budget is too small for a single work group.
+     */
+    [[nodiscard]] TileGrid plan(const LayerData &layer_data, glm::vec2 lower_bound, glm::vec2 upper_bound) const;
+
+    /// GPU memory, in bytes, used to compute a chunk of @p work_group_count work groups with @p class_count classes.
+    [[nodiscard]] GLsizeiptr getChunkMemoryRequirement(glm::uvec2 work_group_count, uint class_count) const;
+
+    /// Receives the results of the chunks, in row-major order, along with their index in the grid.
+    using Sink = std::function<void(glm::uvec2 chunk, Result result)>;
+
+    /**
+     * @brief Compute the chunks of a region, and pass each result to @p sink as soon as it is available.
+     * Results retained by the sink don't count against the memory budget.
+     */
+    void computePlacement(const WorldData &world_data, const LayerData &layer_data,
+                          glm::vec2 lower_bound, glm::vec2 upper_bound, const Sink &sink);
+
+    /**
+     * @brief Compute the chunks of a region, and assemble them into a single result. @see mergeResults()
+     * Each chunk result is compacted to the size of its elements as soon as it is available.
+     */
+    [[nodiscard]] Result computePlacement(const WorldData &world_data, const LayerData &layer_data,
+                                          glm::vec2 lower_bound, glm::vec2 upper_bound);
+
+    [[nodiscard]] GLsizeiptr getMemoryBudget() const { return m_memory_budget; }
+
+    [[nodiscard]] uint getMaxChunksInFlight() const { return m_max_chunks_in_flight; }
+
+private:
+    PlacementPipeline &m_pipeline;
+    GLsizeiptr m_memory_budget;
+    uint m_max_chunks_in_flight;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_PLACEMENT_PLANNER_HPP
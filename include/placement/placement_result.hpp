@@ -1,15 +1,22 @@
 #ifndef PROCEDURALPLACEMENTLIB_PLACEMENT_RESULT_HPP
 #define PROCEDURALPLACEMENTLIB_PLACEMENT_RESULT_HPP
 
+#include "cell_grid.hpp"
+#include "placement_statistics.hpp"
+#include "placement_trace.hpp"
+
 #include "glutils/buffer.hpp"
 #include "glutils/sync.hpp"
 
 #include "glm/vec3.hpp"
 
 #include <chrono>
+#include <functional>
 #include <utility>
 #include <vector>
 #include <memory>
+#include <optional>
+#include <cassert>
 
 namespace placement {
 
@@ -21,6 +28,55 @@ struct ResultElement
     static constexpr GLsizeiptr ssize = sizeof(position) + sizeof(class_index);
 };
 
+/// Arrangement of the elements within the value section of a result buffer.
+enum class ResultLayout
+{
+    /// An array of ResultElement structures.
+    array_of_structures,
+    /**
+     * Four arrays with one value per element: x coordinates, y coordinates, z coordinates and class indices, each one
+     * as long as the element capacity of the buffer. The elements of a class occupy the same index range in every
+     * array, so each class forms a contiguous block within each of them.
+     */
+    structure_of_arrays
+};
+
+/// A read-only view of a contiguous array, such as a section of a mapped result buffer.
+template<typename T>
+class ArrayView
+{
+public:
+    using value_type = T;
+    using const_iterator = const T*;
+
+    constexpr ArrayView() noexcept = default;
+
+    constexpr ArrayView(const T *data, std::size_t size) noexcept : m_data(data), m_size(size)
+    {}
+
+    [[nodiscard]] constexpr const T *data() const noexcept { return m_data; }
+    [[nodiscard]] constexpr std::size_t size() const noexcept { return m_size; }
+    [[nodiscard]] constexpr bool empty() const noexcept { return m_size == 0; }
+
+    [[nodiscard]] constexpr const T *begin() const noexcept { return m_data; }
+    [[nodiscard]] constexpr const T *end() const noexcept { return m_data + m_size; }
+
+    [[nodiscard]] constexpr const T &operator[](std::size_t index) const noexcept { return m_data[index]; }
+
+private:
+    const T *m_data {nullptr};
+    std::size_t m_size {0};
+};
+
+/// Views of the component arrays of a range of elements, stored with ResultLayout::structure_of_arrays.
+struct ElementArrays
+{
+    ArrayView<float> x;
+    ArrayView<float> y;
+    ArrayView<float> z;
+    ArrayView<std::uint32_t> class_index;
+};
+
 /**
  * @brief Wraps a buffer containing placement results.
  * A result buffer is composed of "count" and "value" sections. The count section specifies the number of valid elements
@@ -37,6 +93,16 @@ struct ResultElement
  * This means that the first element of class 0 is at position 0 and the last element is at position count[0] - 1 of the
  * array. Elements of class 1 are located in the range [count[0], count[0] + count[1]), and so on for each additional
  * class.
+ *
+ * With ResultLayout::structure_of_arrays, the value section has the same size, but holds the x, y and z coordinates and
+ * the class indices in four separate arrays instead, each with room for as many elements as the value section can hold.
+ * Element i of the array above is then made of the values at position i of each array.
+ *
+ * If the results were computed with PlacementPipeline::ElementOrder::morton, the buffer ends with a third section, the
+ * cell index. It is an array of CellIndexEntry structures (pairs of 32-bit unsigned integers) containing
+ * num_classes * cell_grid.getCellCount() elements. The entry at position (class_index * cell_count + cell_rank) holds the
+ * offset, relative to the first element of the class, and the number of elements of that class located inside the cell
+ * whose Z-order rank is cell_rank. Within each class, elements are then sorted by the rank of the cell they fall in.
  */
 struct ResultBuffer
 {
@@ -44,6 +110,8 @@ struct ResultBuffer
     GLsizeiptr size;        ///< Total size of the buffer, in bytes.
     GL::Buffer gl_object;       ///< GL buffer object.
     const std::byte* mapped_ptr; // a persistently mapped pointer.
+    CellGrid cell_grid {};      ///< Grid used by the cell index section. Contains zero cells if there is no cell index.
+    ResultLayout layout {ResultLayout::array_of_structures}; ///< Arrangement of the value section.
 
     static constexpr auto uint_ssize = static_cast<GLsizeiptr>(sizeof(std::uint32_t));
     static constexpr auto element_ssize = static_cast<GLsizeiptr>(sizeof(ResultElement));
@@ -58,13 +126,103 @@ struct ResultBuffer
     [[nodiscard]] const std::uint32_t* getCountDataEnd() const { return getCountDataBegin() + num_classes; }
 
     [[nodiscard]] constexpr GLintptr getElementBufferOffset() const { return getCountBufferOffset() + getCountBufferSize(); }
-    [[nodiscard]] constexpr GLsizeiptr getElementBufferSize() const { return size - getElementBufferOffset(); }
+    [[nodiscard]] constexpr GLsizeiptr getElementBufferSize() const { return getCellIndexBufferOffset() - getElementBufferOffset(); }
     [[nodiscard]] const ResultElement* getElementDataBegin() const { return reinterpret_cast<const ResultElement*>(mapped_ptr + getElementBufferOffset()); }
-    [[nodiscard]] const ResultElement* getElementDataEnd() const { return reinterpret_cast<const ResultElement*>(mapped_ptr + size); }
+    [[nodiscard]] const ResultElement* getElementDataEnd() const { return reinterpret_cast<const ResultElement*>(mapped_ptr + getCellIndexBufferOffset()); }
     [[nodiscard]] constexpr GL::Buffer::Range getElementRange() const
     {
         return {getElementBufferOffset(), getElementBufferSize()};
     }
+    /// Maximum number of elements the value section can hold.
+    [[nodiscard]] constexpr std::size_t getElementCapacity() const { return getElementBufferSize() / element_ssize; }
+    /// First value of the component array @p component (0: x, 1: y, 2: z, 3: class index) of the value section.
+    [[nodiscard]] const std::uint32_t* getComponentDataBegin(unsigned int component) const
+    { return reinterpret_cast<const std::uint32_t*>(mapped_ptr + getElementBufferOffset()) + component * getElementCapacity(); }
+
+    [[nodiscard]] static constexpr GLsizeiptr getCellIndexBufferSize(unsigned int num_classes, const CellGrid& grid)
+    { return num_classes * static_cast<GLsizeiptr>(grid.size.x * grid.size.y) * 2 * uint_ssize; }
+    [[nodiscard]] constexpr GLsizeiptr getCellIndexBufferSize() const { return getCellIndexBufferSize(num_classes, cell_grid); }
+    [[nodiscard]] constexpr GLintptr getCellIndexBufferOffset() const { return size - getCellIndexBufferSize(); }
+    [[nodiscard]] const std::uint32_t* getCellIndexDataBegin() const { return reinterpret_cast<const std::uint32_t*>(mapped_ptr + getCellIndexBufferOffset()); }
+    [[nodiscard]] constexpr GL::Buffer::Range getCellIndexRange() const
+    {
+        return {getCellIndexBufferOffset(), getCellIndexBufferSize()};
+    }
+};
+
+/**
+ * @brief Allocate a persistently mapped result buffer.
+ * @param size Total size of the buffer in bytes, including the count section and the cell index, if any.
+ * @param data Initial contents of the whole buffer. If null, the count section is zeroed and the rest is undefined.
+ */
+[[nodiscard]] ResultBuffer makeResultBuffer(unsigned int num_classes, GLsizeiptr size, const void *data = nullptr,
+                                            const CellGrid &cell_grid = {});
+
+/**
+ * @brief Candidate counters of a placement operation. @see PlacementPipeline::setStatisticsEnabled()
+ * A persistently mapped buffer holding the numbers of candidates outside of the region and excluded, written by the
+ * evaluation kernels, followed by a copy of the count section of the result buffer.
+ */
+struct StatisticsBuffer
+{
+    GL::Buffer gl_object;               ///< GL buffer object.
+    const std::uint32_t *mapped_ptr;    ///< A persistently mapped pointer.
+    PlacementStatistics issued;         ///< Statistics known when the operation was issued.
+
+    /// Byte offset of the copy of the count section.
+    static constexpr GLintptr count_offset = 2 * static_cast<GLintptr>(sizeof(std::uint32_t));
+
+    /// Statistics of the operation, which must have completed.
+    [[nodiscard]] PlacementStatistics read() const;
+};
+
+/// Allocate a zeroed statistics buffer for an operation with the classes of @p issued.
+[[nodiscard]] std::shared_ptr<StatisticsBuffer> makeStatisticsBuffer(PlacementStatistics issued);
+
+/// Axis aligned bounding box of a set of elements. The box of an empty set has min = +inf and max = -inf.
+struct ElementBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    [[nodiscard]] bool isEmpty() const { return min.x > max.x; }
+};
+
+/**
+ * @brief Bounding boxes of the elements of a placement operation, reduced by the copy stage.
+ * @see PlacementPipeline::setBoundsEnabled()
+ * A persistently mapped buffer holding a box for each class, followed, if the result has a cell index, by a box for
+ * each class within each cell, at index (class_count + class_index * cell_count + cell_rank). The minimum corners of
+ * all the boxes come first, as three floats each, followed by the maximum corners in the same order, so that culling
+ * shaders can read them as two float arrays starting at 0 and getMaxCornerOffset().
+ */
+struct BoundsBuffer
+{
+    GL::Buffer gl_object;           ///< GL buffer object.
+    const float *mapped_ptr;        ///< A persistently mapped pointer.
+    std::uint32_t class_count;
+    std::uint32_t cell_count;       ///< Cells of the cell index, or 0 if there is none.
+
+    [[nodiscard]] std::uint32_t getBoxCount() const { return class_count * (1 + cell_count); }
+
+    /// Byte offset of the maximum corners.
+    [[nodiscard]] GLintptr getMaxCornerOffset() const
+    { return static_cast<GLintptr>(getBoxCount() * 3 * sizeof(float)); }
+
+    [[nodiscard]] GLsizeiptr getSize() const { return 2 * getMaxCornerOffset(); }
+
+    /// Box @p box_index, which the operation must have completed.
+    [[nodiscard]] ElementBounds read(std::uint32_t box_index) const;
+};
+
+/// Allocate a bounds buffer with empty boxes for @p class_count classes in @p cell_count cells.
+[[nodiscard]] std::shared_ptr<BoundsBuffer> makeBoundsBuffer(std::uint32_t class_count, std::uint32_t cell_count);
+
+/// Location of the elements of a single class within a single cell of the cell index.
+struct CellIndexEntry
+{
+    std::uint32_t offset;   ///< Index of the first element in the cell, relative to the start of the class.
+    std::uint32_t count;    ///< Number of elements in the cell.
 };
 
 /**
@@ -77,7 +235,8 @@ public:
 
     using Element = ResultElement;
 
-    explicit Result(ResultBuffer &&buffer);
+    explicit Result(ResultBuffer &&buffer, std::shared_ptr<const StatisticsBuffer> statistics = nullptr,
+                    std::shared_ptr<const BoundsBuffer> bounds = nullptr);
 
     /// Get the number of placement classes in the result buffer.
     [[nodiscard]]
@@ -132,6 +291,8 @@ public:
 
     /**
      * @brief Copy elements of classes in range [begin_class, end_class) from the element array to another buffer.
+     * With ResultLayout::structure_of_arrays, the x, y and z coordinates and the class indices of the range are
+     * written one after the other, as four arrays of getClassRangeElementCount() values.
      * @param begin_class The start of the class range.
      * @param end_class The end of the class range, not included in it.
      * @param buffer A handle to a GL buffer object.
@@ -157,6 +318,15 @@ public:
         const uint index_offset = getClassIndexOffset(begin_class);
         const uint element_count = getClassRangeElementCount(begin_class, end_class);
 
+        if (m_buffer.layout == ResultLayout::structure_of_arrays)
+        {
+            const ElementArrays arrays = getElementArrays(begin_class, end_class);
+            for (uint i = 0; i < element_count; i++)
+                *out_iter++ = Element{{arrays.x[i], arrays.y[i], arrays.z[i]}, arrays.class_index[i]};
+
+            return element_count;
+        }
+
         const ResultElement* begin = m_buffer.getElementDataBegin() + index_offset;
         const ResultElement* end = begin + element_count;
 
@@ -168,6 +338,46 @@ public:
         return element_count;
     }
 
+    /**
+     * @brief Bulk copy of the elements of classes in range [begin_class, end_class) to contiguous CPU memory.
+     * Faster than the iterator overload, as the elements are copied as a single block of memory.
+     */
+    uint copyClassRangeToHost(uint begin_class, uint end_class, Element *out) const;
+
+    /**
+     * @brief Bulk copy of the coordinates of the elements of classes in range [begin_class, end_class) into separate
+     * arrays, each with room for getClassRangeElementCount() values.
+     * The copy uses streaming stores where available, to avoid evicting the consumer's data from the cache. Works with
+     * both layouts, but with ResultLayout::array_of_structures the coordinates have to be deinterleaved.
+     */
+    uint copyClassRangeToHost(uint begin_class, uint end_class, float *x, float *y, float *z) const;
+
+    /**
+     * @brief Direct access to the elements of classes in range [begin_class, end_class) in the mapped result buffer.
+     * @throw std::logic_error if the result layout is not ResultLayout::array_of_structures.
+     */
+    [[nodiscard]] ArrayView<Element> getElements(uint begin_class, uint end_class) const;
+
+    [[nodiscard]] ArrayView<Element> getElements() const
+    { return getElements(0, m_buffer.num_classes); }
+
+    /**
+     * @brief Direct access to the component arrays of classes in range [begin_class, end_class) in the mapped result
+     * buffer.
+     * @throw std::logic_error if the result layout is not ResultLayout::structure_of_arrays.
+     */
+    [[nodiscard]] ElementArrays getElementArrays(uint begin_class, uint end_class) const;
+
+    [[nodiscard]] ElementArrays getElementArrays() const
+    { return getElementArrays(0, m_buffer.num_classes); }
+
+    /// Same as getElementArrays(class_index, class_index + 1).
+    [[nodiscard]] ElementArrays getClassElementArrays(uint class_index) const
+    { return getElementArrays(class_index, class_index + 1); }
+
+    [[nodiscard]] ResultLayout getLayout() const noexcept
+    { return m_buffer.layout; }
+
     /**
      * @brief Copy all valid elements from the result buffer to another GPU buffer.
      * @param buffer A handle to a GL buffer object.
@@ -202,6 +412,54 @@ public:
 
     [[nodiscard]] std::vector<Element> copyClassToHost(uint class_index) const;
 
+    /// Check if the result buffer contains a cell index, i.e. if elements are sorted in Z-order within each class.
+    [[nodiscard]]
+    bool hasCellIndex() const noexcept
+    { return m_buffer.cell_grid.getCellCount() > 0; }
+
+    /// The grid used to build the cell index. Its cell count is zero if there is no cell index.
+    [[nodiscard]]
+    const CellGrid &getCellGrid() const noexcept
+    { return m_buffer.cell_grid; }
+
+    /**
+     * @brief Look up the elements of a class that fall inside a given cell.
+     * @param class_index index of a placement class.
+     * @param cell_rank Z-order rank of the cell, as returned by CellGrid::getCellRank().
+     * @return the offset, relative to getClassIndexOffset(class_index), and number of elements in the cell.
+     */
+    [[nodiscard]] CellIndexEntry getCellIndexEntry(uint class_index, uint cell_rank) const;
+
+    /// Byte offset within the result buffer at which the cell index starts.
+    [[nodiscard]]
+    GLintptr getCellIndexBufferOffset() const noexcept
+    { return m_buffer.getCellIndexBufferOffset(); }
+
+    /// What happened to the candidates of the operation, if it was computed with statistics enabled.
+    [[nodiscard]] std::optional<PlacementStatistics> getStatistics() const;
+
+    /// Check if the result has bounding boxes, i.e. if it was computed with bounds enabled.
+    [[nodiscard]]
+    bool hasBounds() const noexcept
+    { return m_bounds != nullptr; }
+
+    /**
+     * @brief Bounding box of the elements of a class, e.g. to cull all of them at once.
+     * @throw std::logic_error if the result has no bounds.
+     */
+    [[nodiscard]] ElementBounds getClassBounds(uint class_index) const;
+
+    /**
+     * @brief Bounding box of the elements of a class inside a cell, whose range is given by getCellIndexEntry().
+     * @throw std::logic_error if the result has no bounds or no cell index.
+     */
+    [[nodiscard]] ElementBounds getCellBounds(uint class_index, uint cell_rank) const;
+
+    /// The buffer holding the bounds, to cull on the GPU, or null if the result has no bounds. @see BoundsBuffer
+    [[nodiscard]]
+    const std::shared_ptr<const BoundsBuffer> &getBoundsBuffer() const noexcept
+    { return m_bounds; }
+
     /// Direct access to the results.
     [[nodiscard]] const ResultBuffer& getBuffer() const { return m_buffer; }
 
@@ -211,13 +469,31 @@ public:
 private:
     ResultBuffer m_buffer;
     std::vector<uint> m_index_offset;
+    std::shared_ptr<const StatisticsBuffer> m_statistics;
+    std::shared_ptr<const BoundsBuffer> m_bounds;
 };
 
+class CompletionQueue;
+
 /// Contains the results of a placement operation which may not have finished execution yet.
 class FutureResult final
 {
 public:
-    FutureResult(ResultBuffer &&result_buffer, GL::Sync &&sync);
+    FutureResult(ResultBuffer &&result_buffer, GL::Sync &&sync,
+                 std::shared_ptr<const StatisticsBuffer> statistics = nullptr,
+                 std::shared_ptr<const BoundsBuffer> bounds = nullptr, TraceContext trace = {});
+
+    /**
+     * @brief A result combined on the host from the results of other operations, e.g. by spliceResults().
+     * Nothing is combined before all of @p dependencies are ready: readResult() then calls @p combine with their
+     * results, in order, and reads the operation it returns. Until then, the result buffer is empty.
+     */
+    FutureResult(std::vector<FutureResult> &&dependencies, std::function<FutureResult(std::vector<Result>)> combine);
+
+    /// Identifies the operation in the spans passed to a TraceSink, or 0 if it wasn't traced.
+    [[nodiscard]]
+    std::uint64_t getRequestId() const noexcept
+    { return m_trace.request_id; }
 
     /// Check if results are available.
     [[nodiscard]]
@@ -230,11 +506,18 @@ public:
 
     /**
      * @brief Read results, if available, or block execution until they are.
-     * This operation moves out the ResultBuffer, leaving this object in an empty state.
+     * This operation moves out the ResultBuffer, leaving this object in an empty state. If the operation is traced, the
+     * wait and the read are recorded as "fence wait" and "read result" spans.
      * @return a Result structure that contains the buffer and information about the layout of the data.
      */
     [[nodiscard]] Result readResult();
 
+    /**
+     * @brief Call @p continuation with the results once they are available, from CompletionQueue::pollCompletions().
+     * This operation moves this object into @p queue, leaving it in an empty state.
+     */
+    void then(CompletionQueue &queue, std::function<void(Result)> continuation);
+
     /**
      * @brief Access the results of the placement operation.
      * Assuming that the appropriate memory barriers have been issued, it is valid behavior to operate on the result
@@ -255,9 +538,74 @@ public:
 
 private:
     ResultBuffer m_buffer;
-    GL::Sync m_sync;
+    std::optional<GL::Sync> m_sync; // none if this result is combined on the host
+    std::shared_ptr<const StatisticsBuffer> m_statistics;
+    std::shared_ptr<const BoundsBuffer> m_bounds;
+    TraceContext m_trace;
+
+    /// Operations whose results are passed to m_combine, if this result is combined on the host.
+    std::vector<FutureResult> m_dependencies;
+    std::function<FutureResult(std::vector<Result>)> m_combine;
+};
+
+/// A result whose cells replace a rectangle of cells of another result. @see spliceResults()
+struct ResultPatch
+{
+    /// Result with a cell index, covering the cells [lower_cell, lower_cell + patch cell grid size) of the base result.
+    const Result *result;
+
+    /// Cell of the base result that corresponds to cell (0, 0) of the patch.
+    glm::uvec2 lower_cell;
+};
+
+/**
+ * @brief Replace the elements of some cells of a result with those of the same cells in other results.
+ * All the results must have a cell index, the same number of classes, the same layout and the same cell size. The new
+ * result keeps the cell grid of @p base; the elements and cell index entries of each class are rebuilt so that offsets
+ * stay consistent. Where patches overlap, the last one in @p patches wins.
+ *
+ * Element data never leaves GPU memory: unchanged runs of cells are copied from @p base, and patched cells from their
+ * patch, with a buffer copy per contiguous run. Only the count section and the cell index are built on the host.
+ *
+ * The new result is a separate buffer, since patches shift the elements that follow them, so the cost of a splice is
+ * proportional to the size of @p base rather than to the patched area: every element is copied on the GPU, and the
+ * cell index entries of every class and cell are rebuilt on the host. Only the number of copies grows with the number
+ * of patched cells.
+ *
+ * @throw std::invalid_argument if the results don't meet the requirements above, or a patch lies outside @p base.
+ */
+[[nodiscard]] FutureResult spliceResults(const Result &base, const std::vector<ResultPatch> &patches);
+
+/// A patch whose result may not be available yet. @see ResultPatch
+struct FutureResultPatch
+{
+    FutureResult result;
+    glm::uvec2 lower_cell;
 };
 
+/**
+ * @brief Splice patches that may still be computing, without blocking.
+ * The returned result waits for all the patches, then splices them as above when it is read, so @p base must stay alive
+ * until then.
+ * @throw std::invalid_argument if @p base has no cell index. Patches are only checked once they are ready, by
+ *      FutureResult::readResult().
+ */
+[[nodiscard]] FutureResult spliceResults(const Result &base, std::vector<FutureResultPatch> patches);
+
+/**
+ * @brief Combine the results of adjacent regions, such as the tiles of a TileGrid, into a single result.
+ * Elements are never compared: the results must not share any element, which holds for tiles computed with
+ * PlacementPipeline::computeTile(). All the results must have the same number of classes and layout.
+ *
+ * Without a cell index, the elements of each class are concatenated in the order of @p results. With one, the cell
+ * grids must have the same cell size, be aligned, i.e. their origins are a whole number of cells apart, and not
+ * overlap; the new result has a cell grid covering all of them, and cells not covered by any result are empty. Like
+ * spliceResults(), elements are copied on the GPU, in runs.
+ *
+ * @throw std::invalid_argument if the results don't meet the requirements above.
+ */
+[[nodiscard]] FutureResult mergeResults(const std::vector<const Result*> &results);
+
 } // placement
 
 #endif //PROCEDURALPLACEMENTLIB_PLACEMENT_RESULT_HPP
@@ -0,0 +1,65 @@
+#ifndef PROCEDURALPLACEMENTLIB_PLACEMENT_STATISTICS_HPP
+#define PROCEDURALPLACEMENTLIB_PLACEMENT_STATISTICS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace placement {
+
+/**
+ * @brief What happened to the candidates of one or more placement operations.
+ * Each candidate is either outside of the placement region, excluded by an exclusion zone, rejected because its
+ * density is below its threshold for every class, or accepted as an element of a class. The first counts tell whether
+ * the region is much larger than the area of interest, and the fill ratio whether the footprint is too small for the
+ * densities in use, in which case most of the work and memory of an operation is spent on discarded candidates.
+ */
+struct PlacementStatistics
+{
+    using uint64 = std::uint64_t;
+
+    uint64 operation_count {0};     ///< Number of placement operations these statistics cover.
+    uint64 candidate_count {0};     ///< Candidates generated, i.e. 64 per work group dispatched.
+    uint64 out_of_bounds_count {0}; ///< Candidates outside of the placement region.
+    uint64 excluded_count {0};      ///< Candidates inside the region rejected by exclusion zones.
+    uint64 rejected_count {0};      ///< Candidates not accepted by any class.
+    uint64 element_capacity {0};    ///< Number of elements the result buffers can hold.
+
+    /// Elements accepted by each class. Operations with fewer classes don't contribute to the last entries.
+    std::vector<uint64> class_element_counts;
+
+    [[nodiscard]] uint64 getElementCount() const
+    { return std::accumulate(class_element_counts.begin(), class_element_counts.end(), uint64(0)); }
+
+    /// Fraction of the element capacity of the result buffers holding elements.
+    [[nodiscard]] double getFillRatio() const
+    { return element_capacity ? static_cast<double>(getElementCount()) / static_cast<double>(element_capacity) : 0.0; }
+
+    /// Fraction of the candidates inside the region, and not excluded, that became elements.
+    [[nodiscard]] double getAcceptanceRatio() const
+    {
+        const uint64 evaluated_count = candidate_count - out_of_bounds_count - excluded_count;
+        return evaluated_count ? static_cast<double>(getElementCount()) / static_cast<double>(evaluated_count) : 0.0;
+    }
+
+    PlacementStatistics &operator+=(const PlacementStatistics &other)
+    {
+        operation_count += other.operation_count;
+        candidate_count += other.candidate_count;
+        out_of_bounds_count += other.out_of_bounds_count;
+        excluded_count += other.excluded_count;
+        rejected_count += other.rejected_count;
+        element_capacity += other.element_capacity;
+
+        class_element_counts.resize(std::max(class_element_counts.size(), other.class_element_counts.size()), 0);
+        for (std::size_t i = 0; i < other.class_element_counts.size(); i++)
+            class_element_counts[i] += other.class_element_counts[i];
+
+        return *this;
+    }
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_PLACEMENT_STATISTICS_HPP
@@ -0,0 +1,126 @@
+#ifndef PROCEDURALPLACEMENTLIB_PLACEMENT_TRACE_HPP
+#define PROCEDURALPLACEMENTLIB_PLACEMENT_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace placement {
+
+/// A span of time spent on a placement request, either by a host thread or by the GPU.
+struct TraceSpan
+{
+    using Clock = std::chrono::steady_clock;
+
+    enum class Timeline
+    {
+        cpu,
+        gpu
+    };
+
+    /// Name of the stage, a string literal.
+    const char *name;
+
+    /// Request the span belongs to, see FutureResult::getRequestId(), or 0 for spans outside of any request.
+    std::uint64_t request_id;
+
+    Timeline timeline;
+
+    /// Thread that recorded a CPU span.
+    std::thread::id thread;
+
+    /// GPU spans are converted to the host clock, so that both timelines can be compared.
+    Clock::time_point begin;
+    Clock::time_point end;
+};
+
+/**
+ * @brief Receives the spans recorded by a PlacementPipeline, e.g. to forward them to a profiler.
+ * CPU spans are passed from the threads that record them, which may be several, e.g. with a ThreadedPlacementPipeline;
+ * implementations must be thread safe.
+ */
+class TraceSink
+{
+public:
+    virtual ~TraceSink() = default;
+
+    virtual void addSpan(const TraceSpan &span) = 0;
+};
+
+/// The sink and request of a placement operation, passed on to its FutureResult.
+struct TraceContext
+{
+    std::shared_ptr<TraceSink> sink;
+    std::uint64_t request_id {0};
+};
+
+/// Records a CPU span from construction to end() or destruction. Does nothing without a sink.
+class ScopedTraceSpan
+{
+public:
+    ScopedTraceSpan(TraceSink *sink, const char *name, std::uint64_t request_id = 0)
+        : m_sink(sink), m_name(name), m_request_id(request_id),
+          m_begin(sink ? TraceSpan::Clock::now() : TraceSpan::Clock::time_point())
+    {}
+
+    ScopedTraceSpan(const TraceContext &context, const char *name)
+        : ScopedTraceSpan(context.sink.get(), name, context.request_id)
+    {}
+
+    ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+    ScopedTraceSpan &operator=(const ScopedTraceSpan&) = delete;
+
+    ~ScopedTraceSpan()
+    { end(); }
+
+    /// End the span before the end of the scope.
+    void end()
+    {
+        if (!m_sink)
+            return;
+
+        m_sink->addSpan({m_name, m_request_id, TraceSpan::Timeline::cpu, std::this_thread::get_id(), m_begin,
+                         TraceSpan::Clock::now()});
+        m_sink = nullptr;
+    }
+
+private:
+    TraceSink *m_sink;
+    const char *m_name;
+    std::uint64_t m_request_id;
+    TraceSpan::Clock::time_point m_begin;
+};
+
+/**
+ * @brief Collects spans in memory and writes them in the Chrome trace event format.
+ * The output opens in chrome://tracing and in Perfetto, with the GPU as one track and each host thread as another.
+ * Times are relative to the creation of the writer.
+ */
+class ChromeTraceWriter final : public TraceSink
+{
+public:
+    void addSpan(const TraceSpan &span) override;
+
+    [[nodiscard]] std::size_t getSpanCount() const;
+
+    void clear();
+
+    void write(std::ostream &out) const;
+
+    /// @throw std::runtime_error if the file can't be written.
+    void writeFile(const std::filesystem::path &path) const;
+
+private:
+    TraceSpan::Clock::time_point m_time_zero {TraceSpan::Clock::now()};
+    mutable std::mutex m_mutex;
+    std::vector<TraceSpan> m_spans;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_PLACEMENT_TRACE_HPP
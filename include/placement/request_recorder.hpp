@@ -0,0 +1,100 @@
+#ifndef PROCEDURALPLACEMENTLIB_REQUEST_RECORDER_HPP
+#define PROCEDURALPLACEMENTLIB_REQUEST_RECORDER_HPP
+
+#include "gl_types.hpp"
+
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+namespace placement {
+
+/// Parameters of a density map of a recorded request.
+struct RecordedDensityMap
+{
+    /// Name of the texture in the recording process. Replays substitute their own textures.
+    GLuint texture;
+    float scale;
+    float offset;
+    float min_value;
+    float max_value;
+    bool virtual_texture;
+    bool expression;
+};
+
+/// Parameters of a layer of a recorded request.
+struct RecordedLayer
+{
+    float footprint;
+
+    /// The seed of the layer, or the seed of the pipeline if the layer had none.
+    std::uint32_t seed;
+
+    std::vector<RecordedDensityMap> density_maps;
+};
+
+/// A placement request, as passed to PlacementPipeline::computePlacement().
+struct RecordedRequest
+{
+    /// Time the request was issued, since the creation of the recorder.
+    std::chrono::steady_clock::duration time;
+
+    glm::vec3 world_scale;
+    glm::vec2 lower_bound;
+    glm::vec2 upper_bound;
+
+    /// Whether the pipeline used PlacementPipeline::ElementOrder::morton.
+    bool morton;
+
+    std::vector<RecordedLayer> layers;
+};
+
+/**
+ * @brief Records the placement requests of a pipeline with their timing, so that a realistic streaming workload can be
+ * replayed deterministically, e.g. by the pplib-replay tool. @see PlacementPipeline::setRequestRecorder()
+ *
+ * Textures are recorded by name only, as their contents can't be captured without reading them back; a replay samples
+ * its own textures with the recorded scale, offset and range of each density map. Requests may be recorded from
+ * several threads.
+ */
+class RequestRecorder
+{
+public:
+    void record(RecordedRequest request);
+
+    [[nodiscard]] std::size_t getRequestCount() const;
+
+    /// A copy of the requests recorded so far, in order.
+    [[nodiscard]] std::vector<RecordedRequest> getRequests() const;
+
+    void clear();
+
+    /**
+     * @brief Write the requests as a JSON document: {"version": 1, "requests": [...]}, with the time of each request
+     * in milliseconds as "time_ms". JSON has no infinities or NaN: infinite values are written as the largest finite
+     * floats of the same sign, and NaN as null.
+     */
+    void write(std::ostream &out) const;
+
+    /// @throw std::runtime_error if the file can't be written.
+    void writeFile(const std::filesystem::path &path) const;
+
+    /// Time since the creation of the recorder, which requests are timed against.
+    [[nodiscard]] std::chrono::steady_clock::duration getTime() const
+    { return std::chrono::steady_clock::now() - m_time_zero; }
+
+private:
+    std::chrono::steady_clock::time_point m_time_zero {std::chrono::steady_clock::now()};
+    mutable std::mutex m_mutex;
+    std::vector<RecordedRequest> m_requests;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_REQUEST_RECORDER_HPP
@@ -0,0 +1,159 @@
+#ifndef PROCEDURALPLACEMENTLIB_SPATIAL_INDEX_HPP
+#define PROCEDURALPLACEMENTLIB_SPATIAL_INDEX_HPP
+
+#include "glm/vec2.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+namespace placement {
+
+class Result;
+
+/**
+ * @brief A uniform grid over the 2D positions of placed objects, used to answer spatial queries on the host.
+ *
+ * Since all objects placed by a single layer are at least one footprint apart, a grid with cells of that size holds at
+ * most four objects per cell, so lookups touch a small, fixed number of elements regardless of density. Cells are
+ * stored in compressed sparse row (CSR) form: an array of per-cell offsets into a single array of positions sorted by
+ * cell.
+ *
+ * Queries return indices into the array the index was built from. When built from a Result, these are indices into the
+ * element array, i.e. the vector returned by Result::copyAllToHost(); the class of an element can be found by
+ * comparing its index against Result::getIndexOffsets().
+ */
+class SpatialIndex
+{
+public:
+    using Index = std::uint32_t;
+
+    /// Build an index over all the elements of a placement result. @p footprint must be that of the placement layer.
+    SpatialIndex(const Result &result, float footprint);
+
+    /**
+     * @brief Build an index over a range of elements, such as the output of the CPU placement engine.
+     * @tparam Iter An input iterator to a type with a `position` data member convertible to glm::vec2.
+     */
+    template<typename Iter>
+    SpatialIndex(Iter begin, Iter end, float footprint)
+    {
+        std::vector<glm::vec2> positions;
+        for (auto iter = begin; iter != end; ++iter)
+            positions.emplace_back(iter->position);
+
+        m_build(positions, footprint);
+    }
+
+    /**
+     * @brief Build an index over an array of positions.
+     * @throw std::invalid_argument if @p footprint is not greater than zero, or a position is not finite.
+     */
+    SpatialIndex(const std::vector<glm::vec2> &positions, float footprint);
+
+    /// Number of indexed elements.
+    [[nodiscard]] std::size_t size() const
+    { return m_indices.size(); }
+
+    /// Side of the square cells of the grid. This is the footprint, unless that would make the grid too large.
+    [[nodiscard]] float getCellSize() const
+    { return m_cell_size; }
+
+    /// Number of cells along each axis of the grid.
+    [[nodiscard]] glm::uvec2 getGridSize() const
+    { return m_grid_size; }
+
+    /// Append the indices of all elements at a distance less than or equal to @p radius from @p center to @p out.
+    void queryRadius(glm::vec2 center, float radius, std::vector<Index> &out) const;
+
+    [[nodiscard]] std::vector<Index> queryRadius(glm::vec2 center, float radius) const
+    {
+        std::vector<Index> indices;
+        queryRadius(center, radius, indices);
+        return indices;
+    }
+
+    /// Append the indices of all elements such that lower_bound <= position < upper_bound to @p out.
+    void queryBox(glm::vec2 lower_bound, glm::vec2 upper_bound, std::vector<Index> &out) const;
+
+    [[nodiscard]] std::vector<Index> queryBox(glm::vec2 lower_bound, glm::vec2 upper_bound) const
+    {
+        std::vector<Index> indices;
+        queryBox(lower_bound, upper_bound, indices);
+        return indices;
+    }
+
+    /// Find the element closest to @p point, ignoring those further away than @p max_distance.
+    [[nodiscard]] std::optional<Index> nearest(glm::vec2 point,
+                                               float max_distance = std::numeric_limits<float>::infinity()) const;
+
+    /**
+     * @brief Batched version of queryRadius().
+     * @param policy A standard execution policy, e.g. std::execution::par to distribute queries over multiple threads.
+     *      This header doesn't include <execution>, so that its includers don't depend on a parallel backend.
+     * @return The results of each query, in the same order as @p centers.
+     */
+    template<typename ExecutionPolicy>
+    [[nodiscard]] std::vector<std::vector<Index>> queryRadius(ExecutionPolicy &&policy,
+                                                              const std::vector<glm::vec2> &centers,
+                                                              float radius) const
+    {
+        std::vector<std::vector<Index>> results(centers.size());
+
+        std::for_each(std::forward<ExecutionPolicy>(policy), centers.begin(), centers.end(),
+                      [&](const glm::vec2 &center)
+                      { queryRadius(center, radius, results[&center - centers.data()]); });
+
+        return results;
+    }
+
+    /// Batched version of queryBox(). Each pair holds the lower and upper bound of a query.
+    template<typename ExecutionPolicy>
+    [[nodiscard]] std::vector<std::vector<Index>> queryBox(ExecutionPolicy &&policy,
+                                                           const std::vector<std::pair<glm::vec2, glm::vec2>> &boxes)
+                                                           const
+    {
+        std::vector<std::vector<Index>> results(boxes.size());
+
+        std::for_each(std::forward<ExecutionPolicy>(policy), boxes.begin(), boxes.end(),
+                      [&](const std::pair<glm::vec2, glm::vec2> &box)
+                      { queryBox(box.first, box.second, results[&box - boxes.data()]); });
+
+        return results;
+    }
+
+    /// Batched version of nearest().
+    template<typename ExecutionPolicy>
+    [[nodiscard]] std::vector<std::optional<Index>> nearest(ExecutionPolicy &&policy,
+                                                            const std::vector<glm::vec2> &points,
+                                                            float max_distance = std::numeric_limits<float>::infinity())
+                                                            const
+    {
+        std::vector<std::optional<Index>> results(points.size());
+
+        std::for_each(std::forward<ExecutionPolicy>(policy), points.begin(), points.end(),
+                      [&](const glm::vec2 &point)
+                      { results[&point - points.data()] = nearest(point, max_distance); });
+
+        return results;
+    }
+
+private:
+    void m_build(const std::vector<glm::vec2> &positions, float footprint);
+
+    [[nodiscard]] glm::ivec2 m_getCell(glm::vec2 position) const;
+
+    glm::vec2 m_origin {0.0f};
+    float m_cell_size {1.0f};
+    glm::uvec2 m_grid_size {0u};
+    std::vector<Index> m_cell_offsets;  // CSR row offsets, one per cell plus one
+    std::vector<glm::vec2> m_positions; // positions, sorted by cell
+    std::vector<Index> m_indices;       // original indices, sorted by cell
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_SPATIAL_INDEX_HPP
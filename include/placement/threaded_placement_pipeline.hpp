@@ -0,0 +1,102 @@
+#ifndef PROCEDURALPLACEMENTLIB_THREADED_PLACEMENT_PIPELINE_HPP
+#define PROCEDURALPLACEMENTLIB_THREADED_PLACEMENT_PIPELINE_HPP
+
+#include "placement_pipeline.hpp"
+#include "completion_queue.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace placement {
+
+/**
+ * @brief A PlacementPipeline that runs on a worker thread, with its own GL context.
+ * Requests are queued from any thread and executed in submission order by the worker, so buffer creation, parameter
+ * uploads and dispatches don't cost any time on the submitting thread. Each request returns a std::future that becomes
+ * ready once the GPU has finished computing its result, which the worker checks with the fence of the operation.
+ *
+ * The worker context must share objects with the contexts the textures passed in requests were created in, and those
+ * the results are used in. Textures must be complete, e.g. created and uploaded followed by glFinish(), before a
+ * request that uses them is submitted. Virtual textures and density expressions referenced by a request must outlive
+ * it, and virtual textures must not be used by any other pipeline.
+ */
+class ThreadedPlacementPipeline
+{
+public:
+    using ContextFunction = std::function<void()>;
+
+    /**
+     * @brief Start the worker thread.
+     * The PlacementPipeline is constructed on the worker, so shaders are compiled there as well. loadGLContext() must
+     * have been called before.
+     * @param make_context_current Called on the worker thread before any GL call, to make current a context that
+     *      shares objects with the contexts of the caller. If it throws, the exception is reported by the futures of
+     *      all requests, like errors constructing the pipeline.
+     * @param release_context If set, called on the worker thread after its last GL call, if the context was made
+     *      current.
+     */
+    explicit ThreadedPlacementPipeline(ContextFunction make_context_current, ContextFunction release_context = {});
+
+    /// Finish all submitted requests and join the worker thread.
+    ~ThreadedPlacementPipeline();
+
+    ThreadedPlacementPipeline(const ThreadedPlacementPipeline&) = delete;
+    ThreadedPlacementPipeline& operator=(const ThreadedPlacementPipeline&) = delete;
+
+    /**
+     * @brief Queue a placement operation. @see PlacementPipeline::computePlacement()
+     * The world and layer data are copied, so they may be modified as soon as this call returns.
+     * @return the result, once computed. Errors, such as exceptions thrown by the pipeline, are stored in the future.
+     */
+    [[nodiscard]]
+    std::future<Result> computePlacement(const WorldData &world_data, const LayerData &layer_data,
+                                         glm::vec2 lower_bound, glm::vec2 upper_bound);
+
+    /// A GPU operation run by the worker, which returns as soon as it has been issued.
+    using Operation = std::function<FutureResult(PlacementPipeline&)>;
+
+    /// Queue an arbitrary operation on the pipeline of the worker thread, such as an incremental update.
+    [[nodiscard]] std::future<Result> submit(Operation operation);
+
+    /**
+     * @brief Queue a change to the settings of the pipeline, such as its random seed or exclusion zones.
+     * It applies to all the requests submitted after it.
+     */
+    std::future<void> configure(std::function<void(PlacementPipeline&)> function);
+
+    /// Interval at which the worker checks the fences of pending results when no requests are queued.
+    static constexpr std::chrono::microseconds poll_interval {200};
+
+private:
+    /// Runs on the worker, and stores its outcome, including errors, in its own promise.
+    using Task = std::function<void()>;
+
+    void m_push(Task task);
+    void m_workerMain(ContextFunction make_context_current, ContextFunction release_context);
+
+    /// The pipeline of the worker. @throw the error that prevented its construction, if any.
+    [[nodiscard]] PlacementPipeline &m_getPipeline();
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_tasks;
+    bool m_stop {false};
+
+    // only accessed by the worker
+    std::optional<PlacementPipeline> m_pipeline;
+    std::exception_ptr m_construction_error;
+    CompletionQueue m_completions;
+
+    std::thread m_worker;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_THREADED_PLACEMENT_PIPELINE_HPP
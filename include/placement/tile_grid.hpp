@@ -0,0 +1,75 @@
+#ifndef PROCEDURALPLACEMENTLIB_TILE_GRID_HPP
+#define PROCEDURALPLACEMENTLIB_TILE_GRID_HPP
+
+#include "glm/vec2.hpp"
+#include "glm/common.hpp"
+
+#include <limits>
+#include <utility>
+
+namespace placement {
+
+/**
+ * @brief Partition of a placement region into tiles made of whole work groups. @see PlacementPipeline::makeTileGrid()
+ * Each candidate is generated by exactly one work group, and each work group belongs to exactly one tile, so tiles
+ * computed independently, in any order and on any thread, never share or miss an element. Their results are the same
+ * as those of a single computePlacement() call over the region, and can be combined with mergeResults().
+ *
+ * Halo: the candidates of a tile lie within the bounds of its work groups, getTileDispatchBounds(). Computing a tile
+ * only reads textures inside these bounds, plus the texels blended with them by filtering, and the exclusion shapes
+ * that overlap them. Streamed texture data must cover that halo when the tile is computed.
+ */
+struct TileGrid
+{
+    /// Placement region, as passed to makeTileGrid().
+    glm::vec2 lower_bound {0.0f};
+    glm::vec2 upper_bound {0.0f};
+
+    /// World space dimensions of a single work group.
+    glm::vec2 work_group_bounds {0.0f};
+
+    /// Global index of the first work group of the region, and number of work groups along each axis.
+    glm::uvec2 work_group_offset {0u};
+    glm::uvec2 work_group_count {0u};
+
+    /// Number of work groups along each side of a tile. Tiles on the upper edges of the region may be smaller.
+    glm::uvec2 tile_size {1u};
+
+    /// Number of tiles along each axis.
+    [[nodiscard]] glm::uvec2 getTileCount() const
+    { return (work_group_count + tile_size - 1u) / tile_size; }
+
+    /// Global index of the first work group of @p tile, and number of work groups along each axis.
+    [[nodiscard]] std::pair<glm::uvec2, glm::uvec2> getTileWorkGroupRange(glm::uvec2 tile) const
+    {
+        const glm::uvec2 lower = tile * tile_size;
+        const glm::uvec2 upper = glm::min(lower + tile_size, work_group_count);
+        return {work_group_offset + lower, upper - lower};
+    }
+
+    /// World space bounds of the work groups of @p tile, which contain all of its candidates.
+    [[nodiscard]] std::pair<glm::vec2, glm::vec2> getTileDispatchBounds(glm::uvec2 tile) const
+    {
+        const auto [offset, count] = getTileWorkGroupRange(tile);
+        return {glm::vec2(offset) * work_group_bounds, glm::vec2(offset + count) * work_group_bounds};
+    }
+
+    /**
+     * @brief Bounds the candidates of @p tile are tested against.
+     * Sides of the tile on the edges of the region use the bounds of the region; elsewhere, candidates belong to the
+     * tile of the work group that generates them, regardless of their position, so the bounds are unlimited.
+     */
+    [[nodiscard]] std::pair<glm::vec2, glm::vec2> getTileBounds(glm::uvec2 tile) const
+    {
+        constexpr float unbounded = std::numeric_limits<float>::max();
+        const glm::uvec2 tile_count = getTileCount();
+
+        return {{tile.x == 0 ? lower_bound.x : -unbounded, tile.y == 0 ? lower_bound.y : -unbounded},
+                {tile.x + 1 == tile_count.x ? upper_bound.x : unbounded,
+                 tile.y + 1 == tile_count.y ? upper_bound.y : unbounded}};
+    }
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_TILE_GRID_HPP
@@ -0,0 +1,181 @@
+#ifndef PROCEDURALPLACEMENTLIB_VIRTUAL_TEXTURE_HPP
+#define PROCEDURALPLACEMENTLIB_VIRTUAL_TEXTURE_HPP
+
+#include "glutils/gl_types.hpp"
+
+#include "glm/vec2.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace placement {
+
+/// Format of the texels of a virtual texture. All formats have a single channel.
+enum class TexelFormat : std::uint32_t
+{
+    r8 = 0,     ///< 8-bit unsigned normalized.
+    r16 = 1,    ///< 16-bit unsigned normalized.
+    r32f = 2    ///< 32-bit floating point.
+};
+
+[[nodiscard]] constexpr std::size_t getTexelSize(TexelFormat format)
+{
+    switch (format)
+    {
+    case TexelFormat::r8: return 1;
+    case TexelFormat::r16: return 2;
+    case TexelFormat::r32f: return 4;
+    }
+    return 0;
+}
+
+/**
+ * @brief Layout of a virtual texture file.
+ *
+ * A virtual texture file starts with this structure, followed by the pages of the texture in row major order. Each
+ * page holds a square of page_size texels of the texture along each axis, surrounded by page_border texels taken from
+ * the neighbouring pages (or repeated from the edge of the texture), so that pages can be filtered independently. All
+ * pages have the same size in bytes, so the offset of a page is computed directly from its index. Values are stored
+ * in native byte order.
+ */
+struct VirtualTextureHeader
+{
+    static constexpr std::uint32_t magic_value = 0x54565050; // "PPVT"
+    static constexpr std::uint32_t current_version = 1;
+
+    std::uint32_t magic {magic_value};
+    std::uint32_t version {current_version};
+    glm::uvec2 size {0u};               ///< Dimensions of the whole texture, in texels.
+    std::uint32_t page_size {0};        ///< Texels along each axis of a page, excluding borders.
+    std::uint32_t page_border {0};      ///< Texels added to each side of a page.
+    TexelFormat format {TexelFormat::r8};
+    std::uint32_t reserved {0};
+
+    /// Number of pages along each axis.
+    [[nodiscard]] glm::uvec2 getPageCount() const
+    { return (size + page_size - 1u) / page_size; }
+
+    /// Texels along each axis of a page, including borders.
+    [[nodiscard]] std::uint32_t getStoredPageSize() const
+    { return page_size + 2 * page_border; }
+
+    [[nodiscard]] std::size_t getPageByteSize() const
+    { return static_cast<std::size_t>(getStoredPageSize()) * getStoredPageSize() * getTexelSize(format); }
+
+    [[nodiscard]] std::size_t getPageFileOffset(glm::uvec2 page) const
+    { return sizeof(VirtualTextureHeader) + (page.y * getPageCount().x + page.x) * getPageByteSize(); }
+};
+
+static_assert(sizeof(VirtualTextureHeader) == 32, "VirtualTextureHeader must not have padding");
+
+/**
+ * @brief Split a texture into pages and write it to a virtual texture file.
+ * @param texels Row major array of size.x * size.y texels of the given format.
+ * @param page_size Texels along each axis of a page. Pages have a border of one texel on each side.
+ */
+void writeVirtualTextureFile(const std::string &path, TexelFormat format, glm::uvec2 size, const void *texels,
+                             std::uint32_t page_size = 128);
+
+/**
+ * @brief A texture that is too big to be resident in GPU memory, streamed from disk one page at a time.
+ *
+ * Resident pages are stored in a page cache, a GL_TEXTURE_2D_ARRAY with one layer per page, and located through a page
+ * table, a GL_R32UI texture with one texel per page holding the cache layer of the page plus one, or zero if the page
+ * is not resident. Pages are read from disk by a background thread; since texture uploads need the GL context, loaded
+ * pages are only made resident by update(), which must be called from the thread that owns the context.
+ *
+ * When the cache is full, the least recently requested pages are evicted to make room for new ones. Pages requested
+ * by the last call to request() are never evicted.
+ *
+ * The placement compute shaders sample virtual textures with the same uv coordinates as regular textures, so a
+ * virtual texture can stand in for a heightmap or density map. See WorldData and DensityMap.
+ */
+class VirtualTexture
+{
+public:
+    /**
+     * @brief Open a virtual texture file and create the GL objects of the page cache.
+     * @param cache_capacity Maximum number of resident pages.
+     */
+    VirtualTexture(const std::string &path, std::uint32_t cache_capacity);
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture &operator=(const VirtualTexture&) = delete;
+
+    [[nodiscard]] const VirtualTextureHeader &getHeader() const { return m_header; }
+
+    /// Name of the GL_R32UI page table texture.
+    [[nodiscard]] GLuint getPageTable() const { return m_page_table; }
+
+    /// Name of the GL_TEXTURE_2D_ARRAY page cache texture.
+    [[nodiscard]] GLuint getPageCache() const { return m_page_cache; }
+
+    /**
+     * @brief Request all pages covering the texture region [uv_lower_bound, uv_upper_bound].
+     * Missing pages are queued to be loaded in the background, in order of distance to the center of the region.
+     * @return true if all the pages are already resident.
+     * @throw std::length_error if the region covers more pages than fit in the cache.
+     */
+    bool request(glm::vec2 uv_lower_bound, glm::vec2 uv_upper_bound);
+
+    /// Check if all the pages covering the texture region [uv_lower_bound, uv_upper_bound] are resident.
+    [[nodiscard]] bool isResident(glm::vec2 uv_lower_bound, glm::vec2 uv_upper_bound) const;
+
+    /// Upload pages loaded since the last call into the page cache. Must be called with the GL context current.
+    void update();
+
+    /// Request a region and block until it is resident, calling update() as pages are loaded.
+    void makeResident(glm::vec2 uv_lower_bound, glm::vec2 uv_upper_bound);
+
+    /// Number of pages currently resident in the cache.
+    [[nodiscard]] std::uint32_t getResidentPageCount() const;
+
+private:
+    struct LoadedPage
+    {
+        std::uint32_t index;
+        std::vector<std::byte> texels;
+    };
+
+    static constexpr std::uint32_t no_layer = ~0u;
+
+    [[nodiscard]] std::pair<glm::uvec2, glm::uvec2> m_getPageRange(glm::vec2 uv_lower_bound,
+                                                                   glm::vec2 uv_upper_bound) const;
+    [[nodiscard]] std::uint32_t m_allocateLayer();
+    void m_loaderMain();
+
+    std::string m_path;
+    VirtualTextureHeader m_header;
+    std::uint32_t m_cache_capacity;
+    GLuint m_page_table {0};
+    GLuint m_page_cache {0};
+
+    // only accessed by the owning thread
+    std::vector<std::uint32_t> m_page_layers;   // cache layer of each page, or no_layer
+    std::vector<std::uint64_t> m_page_stamps;   // value of m_request_stamp when each page was last requested
+    std::vector<bool> m_page_pending;           // whether each page has been queued and not uploaded yet
+    std::vector<std::uint32_t> m_layer_pages;   // page held by each cache layer, or no_layer
+    std::uint64_t m_request_stamp {0};
+
+    // shared with the loader thread
+    std::mutex m_mutex;
+    std::condition_variable m_load_condition;   // notified when pages are queued, or on shutdown
+    std::condition_variable m_ready_condition;  // notified when pages are loaded
+    std::deque<std::uint32_t> m_load_queue;
+    std::vector<LoadedPage> m_loaded_pages;
+    bool m_stop {false};
+
+    std::thread m_loader;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_VIRTUAL_TEXTURE_HPP
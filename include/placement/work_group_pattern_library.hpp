@@ -0,0 +1,85 @@
+#ifndef PROCEDURALPLACEMENTLIB_WORK_GROUP_PATTERN_LIBRARY_HPP
+#define PROCEDURALPLACEMENTLIB_WORK_GROUP_PATTERN_LIBRARY_HPP
+
+#include "glm/vec2.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace placement {
+
+/**
+ * @brief Precomputed candidate patterns of a work group, each a Poisson disk distribution of 8x8 positions that tiles
+ * the plane.
+ *
+ * The pipeline uploads the library once. The seed of a placement operation then selects one of the patterns, and one
+ * of its mirror images and toroidal shifts, in the generation kernel, so operations with different seeds cost the same
+ * as operations with a single one, and a few patterns give many distinct placements.
+ *
+ * Generating a library takes some time, so it can be cached in a file, see loadOrGenerate(). Values are stored in
+ * native byte order.
+ * @see PlacementPipeline::setPatternLibrary(), LayerData::seed
+ */
+class WorkGroupPatternLibrary
+{
+public:
+    /// Positions of the candidates of a work group, indexed by local invocation id, within [0, getBounds()).
+    using Pattern = std::array<std::array<glm::vec2, 8>, 8>;
+
+    static constexpr std::uint32_t default_pattern_count = 16;
+
+    /**
+     * @brief Generate a library of @p count patterns, from consecutive seeds of the disk distribution starting at
+     * @p first_seed. Seeds for which the distribution can't fit a whole pattern are skipped.
+     * @throw std::invalid_argument if @p count is 0.
+     */
+    [[nodiscard]]
+    static WorkGroupPatternLibrary generate(std::uint32_t count = default_pattern_count, std::uint32_t first_seed = 0);
+
+    /// @throw std::runtime_error if the file can't be read, or is not a pattern library file.
+    [[nodiscard]] static WorkGroupPatternLibrary load(const std::string &path);
+
+    /**
+     * @brief Load the library cached in @p path if it was generated with the same arguments, otherwise generate it and
+     * write it to @p path for next time. Failing to write the cache is not an error.
+     */
+    [[nodiscard]]
+    static WorkGroupPatternLibrary loadOrGenerate(const std::string &path,
+                                                  std::uint32_t count = default_pattern_count,
+                                                  std::uint32_t first_seed = 0);
+
+    /// The library of default_pattern_count patterns used by pipelines by default, generated on first use.
+    [[nodiscard]] static const WorkGroupPatternLibrary &getDefault();
+
+    /// @throw std::runtime_error if the file can't be written.
+    void save(const std::string &path) const;
+
+    [[nodiscard]] std::uint32_t getPatternCount() const { return static_cast<std::uint32_t>(m_patterns.size()); }
+
+    [[nodiscard]] std::uint32_t getFirstSeed() const { return m_first_seed; }
+
+    /// Dimensions of the square covered by each pattern, in units of the footprint.
+    [[nodiscard]] glm::vec2 getBounds() const { return m_bounds; }
+
+    /// All the patterns, contiguous, as laid out in the pattern buffer of the generation kernel.
+    [[nodiscard]] const std::vector<Pattern> &getPatterns() const { return m_patterns; }
+
+    /// The pattern selected by @p seed, with the mirroring and shift the generation kernel applies to it.
+    [[nodiscard]] Pattern getSeedPattern(std::uint32_t seed) const;
+
+private:
+    WorkGroupPatternLibrary(glm::vec2 bounds, std::uint32_t first_seed, std::vector<Pattern> patterns)
+        : m_bounds(bounds), m_first_seed(first_seed), m_patterns(std::move(patterns))
+    {}
+
+    glm::vec2 m_bounds;
+    std::uint32_t m_first_seed;
+    std::vector<Pattern> m_patterns;
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_WORK_GROUP_PATTERN_LIBRARY_HPP
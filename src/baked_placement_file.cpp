@@ -0,0 +1,204 @@
+#include "placement/baked_placement_file.hpp"
+#include "mapped_file.hpp"
+#include "gl_context.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace placement {
+
+constexpr std::uint64_t tile_alignment = 16;
+
+static std::uint64_t alignTileOffset(std::uint64_t offset)
+{
+    return (offset + tile_alignment - 1) / tile_alignment * tile_alignment;
+}
+
+BakedPlacementWriter::BakedPlacementWriter(std::uint32_t num_classes, glm::vec2 origin, glm::vec2 tile_size,
+                                           glm::uvec2 tile_count)
+{
+    if (!(tile_size.x > 0.0f && tile_size.y > 0.0f))
+        throw std::invalid_argument("tile size must be greater than zero");
+
+    if (num_classes == 0)
+        throw std::invalid_argument("number of classes must be greater than zero");
+
+    m_header.num_classes = num_classes;
+    m_header.origin = origin;
+    m_header.tile_size = tile_size;
+    m_header.tile_count = tile_count;
+
+    m_tiles.resize(static_cast<std::size_t>(tile_count.x) * tile_count.y);
+}
+
+void BakedPlacementWriter::setTile(glm::uvec2 tile, const Result &result)
+{
+    if (result.getNumClasses() > m_header.num_classes)
+        throw std::invalid_argument("result has more classes than the baked placement file");
+
+    setTile(tile, result.copyAllToHost());
+}
+
+void BakedPlacementWriter::setTile(glm::uvec2 tile, std::vector<ResultElement> elements)
+{
+    if (glm::any(glm::greaterThanEqual(tile, m_header.tile_count)))
+        throw std::out_of_range("tile outside of the grid");
+
+    for (const auto &element : elements)
+        if (element.class_index >= m_header.num_classes)
+            throw std::invalid_argument("element class index out of range");
+
+    std::stable_sort(elements.begin(), elements.end(), [](const ResultElement &a, const ResultElement &b)
+    { return a.class_index < b.class_index; });
+
+    m_tiles[m_header.getTileIndex(tile)] = std::move(elements);
+}
+
+void BakedPlacementWriter::write(const std::string &path) const
+{
+    std::ofstream file {path, std::ios::binary};
+    if (!file)
+        throw std::runtime_error("could not open baked placement file for writing: " + path);
+
+    const std::uint64_t counts_size = m_header.num_classes * sizeof(std::uint32_t);
+
+    // directory
+    std::vector<BakedTileEntry> directory;
+    directory.reserve(m_tiles.size());
+
+    std::uint64_t offset = sizeof(BakedPlacementHeader) + m_tiles.size() * sizeof(BakedTileEntry);
+    for (const auto &elements : m_tiles)
+    {
+        offset = alignTileOffset(offset);
+        directory.push_back({offset, counts_size + elements.size() * sizeof(ResultElement)});
+        offset += directory.back().size;
+    }
+
+    file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    file.write(reinterpret_cast<const char*>(directory.data()),
+               static_cast<std::streamsize>(directory.size() * sizeof(BakedTileEntry)));
+
+    // tiles
+    std::vector<std::uint32_t> counts(m_header.num_classes);
+    const char padding[tile_alignment] {};
+    for (std::size_t i = 0; i < m_tiles.size(); i++)
+    {
+        const auto position = static_cast<std::uint64_t>(file.tellp());
+        file.write(padding, static_cast<std::streamsize>(directory[i].offset - position));
+
+        std::fill(counts.begin(), counts.end(), 0);
+        for (const auto &element : m_tiles[i])
+            counts[element.class_index]++;
+
+        file.write(reinterpret_cast<const char*>(counts.data()), static_cast<std::streamsize>(counts_size));
+        file.write(reinterpret_cast<const char*>(m_tiles[i].data()),
+                   static_cast<std::streamsize>(m_tiles[i].size() * sizeof(ResultElement)));
+    }
+
+    if (!file)
+        throw std::runtime_error("error writing baked placement file: " + path);
+}
+
+BakedPlacementFile::TileView::TileView(std::uint32_t num_classes, const std::uint32_t *counts,
+                                       const ResultElement *elements)
+        : m_num_classes(num_classes), m_elements(elements)
+{
+    m_class_offsets.reserve(num_classes + 1);
+    m_class_offsets.emplace_back(0);
+    for (std::uint32_t i = 0; i < num_classes; i++)
+        m_class_offsets.emplace_back(m_class_offsets.back() + counts[i]);
+}
+
+BakedPlacementFile::BakedPlacementFile(const std::string &path)
+        : m_file(std::make_unique<MappedFile>(path)),
+          m_header(reinterpret_cast<const BakedPlacementHeader*>(m_file->data())),
+          m_directory(reinterpret_cast<const BakedTileEntry*>(m_file->data() + sizeof(BakedPlacementHeader)))
+{
+    const std::uint64_t file_size = m_file->size();
+
+    if (file_size < sizeof(BakedPlacementHeader) || m_header->magic != BakedPlacementHeader::magic_value
+        || m_header->version != BakedPlacementHeader::current_version)
+        throw std::runtime_error("not a baked placement file, or unsupported version: " + path);
+
+    const std::uint64_t tile_count = static_cast<std::uint64_t>(m_header->tile_count.x) * m_header->tile_count.y;
+    if (file_size < sizeof(BakedPlacementHeader) + tile_count * sizeof(BakedTileEntry))
+        throw std::runtime_error("truncated baked placement file: " + path);
+
+    // only the directory is checked here, so opening a file doesn't touch the data of any tile
+    const std::uint64_t counts_size = m_header->num_classes * sizeof(std::uint32_t);
+    for (std::uint64_t i = 0; i < tile_count; i++)
+    {
+        const BakedTileEntry &entry = m_directory[i];
+        if (entry.offset % tile_alignment != 0 || entry.size < counts_size || entry.offset > file_size
+            || entry.size > file_size - entry.offset)
+            throw std::runtime_error("invalid tile directory in baked placement file: " + path);
+    }
+}
+
+BakedPlacementFile::~BakedPlacementFile() = default;
+
+BakedPlacementFile::BakedPlacementFile(BakedPlacementFile&&) noexcept = default;
+
+BakedPlacementFile &BakedPlacementFile::operator=(BakedPlacementFile&&) noexcept = default;
+
+glm::uvec2 BakedPlacementFile::getTile(glm::vec2 position) const
+{
+    const glm::vec2 tile = glm::floor((position - m_header->origin) / m_header->tile_size);
+    return glm::uvec2(glm::clamp(tile, glm::vec2(0.0f), glm::vec2(m_header->tile_count) - 1.0f));
+}
+
+std::pair<glm::vec2, glm::vec2> BakedPlacementFile::getTileBounds(glm::uvec2 tile) const
+{
+    const glm::vec2 lower_bound = m_header->origin + glm::vec2(tile) * m_header->tile_size;
+    return {lower_bound, lower_bound + m_header->tile_size};
+}
+
+const BakedTileEntry &BakedPlacementFile::getTileEntry(glm::uvec2 tile) const
+{
+    if (glm::any(glm::greaterThanEqual(tile, m_header->tile_count)))
+        throw std::out_of_range("tile outside of the grid");
+
+    return m_directory[m_header->getTileIndex(tile)];
+}
+
+BakedPlacementFile::TileView BakedPlacementFile::getTileView(glm::uvec2 tile) const
+{
+    const BakedTileEntry &entry = getTileEntry(tile);
+    const std::byte *data = m_file->data() + entry.offset;
+    const std::uint64_t counts_size = m_header->num_classes * sizeof(std::uint32_t);
+
+    TileView view {m_header->num_classes, reinterpret_cast<const std::uint32_t*>(data),
+                   reinterpret_cast<const ResultElement*>(data + counts_size)};
+
+    if (entry.size != counts_size + view.getElementCount() * sizeof(ResultElement))
+        throw std::runtime_error("invalid tile data in baked placement file");
+
+    return view;
+}
+
+Result BakedPlacementFile::loadTile(glm::uvec2 tile) const
+{
+    // validates the tile data
+    static_cast<void>(getTileView(tile));
+
+    const BakedTileEntry &entry = getTileEntry(tile);
+    return Result(makeResultBuffer(m_header->num_classes, static_cast<GLsizeiptr>(entry.size),
+                                   m_file->data() + entry.offset));
+}
+
+std::uint32_t BakedPlacementFile::uploadTile(glm::uvec2 tile, GL::BufferHandle buffer, GLintptr offset) const
+{
+    const TileView view = getTileView(tile);
+    const std::uint32_t element_count = view.getElementCount();
+
+    if (element_count > 0)
+        gl.NamedBufferSubData(buffer.getName(), offset,
+                              static_cast<GLsizeiptr>(element_count * sizeof(ResultElement)), view.begin());
+
+    return element_count;
+}
+
+} // placement
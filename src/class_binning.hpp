@@ -0,0 +1,104 @@
+#ifndef PROCEDURALPLACEMENTLIB_CLASS_BINNING_HPP
+#define PROCEDURALPLACEMENTLIB_CLASS_BINNING_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace placement {
+
+/// Elements grouped by class, as produced by binByClass().
+template<class Element>
+struct ClassBins
+{
+    std::vector<Element> elements;
+
+    /// Index of the first element of each class, followed by the total number of elements.
+    std::vector<std::size_t> class_offsets;
+};
+
+/**
+ * @brief Group candidates by class, dropping those with a class index of @p class_count or more, i.e. rejected ones.
+ * The CPU counterpart of the indexation and copy kernels: a counting sort in two passes over contiguous blocks of
+ * candidates, one block per thread. The first pass counts the candidates of each class in each block, and the second
+ * scatters them to the offsets given by a scan of these counts, so the relative order of candidates is preserved.
+ * The vectors of @p bins are resized rather than reallocated, so bins reused across calls keep their capacity.
+ */
+template<class ExecutionPolicy, class Element>
+void binByClass(const ExecutionPolicy &policy, const std::vector<Element> &candidates, std::size_t class_count,
+                ClassBins<Element> &bins)
+{
+    constexpr bool sequential = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>;
+    const std::size_t block_count = sequential ? 1 : std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t block_size = (candidates.size() + block_count - 1) / block_count;
+
+    std::vector<std::size_t> blocks(block_count);
+    std::iota(blocks.begin(), blocks.end(), std::size_t(0));
+
+    const auto forEachCandidate = [&](std::size_t block, auto &&function)
+    {
+        const std::size_t end = std::min(candidates.size(), (block + 1) * block_size);
+        for (std::size_t i = block * block_size; i < end; i++)
+            if (candidates[i].class_index < class_count)
+                function(candidates[i]);
+    };
+
+    // counts[block * class_count + class_index]
+    std::vector<std::size_t> counts(block_count * class_count, 0);
+    const auto count = [&](std::size_t block)
+    {
+        std::size_t *block_counts = counts.data() + block * class_count;
+        forEachCandidate(block, [block_counts](const Element &candidate) { block_counts[candidate.class_index]++; });
+    };
+
+    // class-major, then block-major, so that each class is contiguous and the candidate order is kept
+    bins.class_offsets.resize(class_count + 1);
+    std::vector<std::size_t> block_offsets(counts.size());
+    const auto scan = [&]()
+    {
+        std::size_t offset = 0;
+        for (std::size_t class_index = 0; class_index < class_count; class_index++)
+        {
+            bins.class_offsets[class_index] = offset;
+            for (std::size_t block = 0; block < block_count; block++)
+            {
+                block_offsets[block * class_count + class_index] = offset;
+                offset += counts[block * class_count + class_index];
+            }
+        }
+        bins.class_offsets[class_count] = offset;
+    };
+
+    const auto scatter = [&](std::size_t block)
+    {
+        std::size_t *offsets = block_offsets.data() + block * class_count;
+        forEachCandidate(block, [&bins, offsets](const Element &candidate)
+        {
+            bins.elements[offsets[candidate.class_index]++] = candidate;
+        });
+    };
+
+    std::for_each(policy, blocks.begin(), blocks.end(), count);
+    scan();
+    bins.elements.resize(bins.class_offsets.back());
+    std::for_each(policy, blocks.begin(), blocks.end(), scatter);
+}
+
+/// @copydoc binByClass()
+template<class ExecutionPolicy, class Element>
+[[nodiscard]]
+ClassBins<Element> binByClass(const ExecutionPolicy &policy, const std::vector<Element> &candidates,
+                              std::size_t class_count)
+{
+    ClassBins<Element> bins;
+    binByClass(policy, candidates, class_count, bins);
+    return bins;
+}
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_CLASS_BINNING_HPP
@@ -0,0 +1,94 @@
+#include "placement/completion_queue.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace placement {
+
+void FutureResult::then(CompletionQueue &queue, std::function<void(Result)> continuation)
+{
+    queue.push(std::move(*this), std::move(continuation));
+}
+
+void CompletionQueue::push(FutureResult &&future_result, Continuation continuation)
+{
+    m_pending.push_back({std::move(future_result), std::move(continuation)});
+}
+
+std::size_t CompletionQueue::pollCompletions()
+{
+    // take the completed results out first, so that continuations can push new ones
+    std::vector<PendingResult> completed;
+    const auto it = std::stable_partition(m_pending.begin(), m_pending.end(), [](const PendingResult &pending)
+    {
+        return !pending.future_result.isReady();
+    });
+    std::move(it, m_pending.end(), std::back_inserter(completed));
+    m_pending.erase(it, m_pending.end());
+
+    for (std::size_t i = 0; i < completed.size(); i++)
+    {
+        try
+        {
+            completed[i].continuation(completed[i].future_result.readResult());
+        }
+        catch (...)
+        {
+            // the remaining continuations run on the next call
+            m_pending.insert(m_pending.begin(), std::make_move_iterator(completed.begin() + i + 1),
+                             std::make_move_iterator(completed.end()));
+            throw;
+        }
+    }
+
+    return completed.size();
+}
+
+void CompletionQueue::drain()
+{
+    while (!m_pending.empty())
+    {
+        m_pending.front().future_result.wait(std::chrono::nanoseconds::max());
+        pollCompletions();
+    }
+}
+
+std::optional<std::size_t> waitAny(const std::vector<FutureResult> &future_results, std::chrono::nanoseconds timeout)
+{
+    using clock = std::chrono::steady_clock;
+
+    // the first future is waited on in slices, in case others complete before it, e.g. in another context
+    constexpr std::chrono::nanoseconds wait_slice = std::chrono::milliseconds(1);
+
+    const auto start = clock::now();
+    while (true)
+    {
+        for (std::size_t i = 0; i < future_results.size(); i++)
+            if (future_results[i].isReady())
+                return i;
+
+        const std::chrono::nanoseconds elapsed = clock::now() - start;
+        if (future_results.empty() || elapsed >= timeout)
+            return std::nullopt;
+
+        if (future_results.front().wait(std::min(timeout - elapsed, wait_slice)))
+            return 0;
+    }
+}
+
+bool waitAll(const std::vector<FutureResult> &future_results, std::chrono::nanoseconds timeout)
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto start = clock::now();
+    for (const auto &future_result : future_results)
+    {
+        const std::chrono::nanoseconds elapsed = clock::now() - start;
+        if (!future_result.wait(elapsed < timeout ? timeout - elapsed : std::chrono::nanoseconds::zero()))
+            return false;
+    }
+
+    return true;
+}
+
+} // placement
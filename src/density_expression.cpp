@@ -0,0 +1,358 @@
+#include "placement/density_expression.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace placement {
+
+// noise functions, matching glsl::density_expression_source
+
+static std::uint32_t densityExpressionHash(glm::ivec2 cell, std::uint32_t seed)
+{
+    std::uint32_t h = static_cast<std::uint32_t>(cell.x) * 0x8da6b343u ^ static_cast<std::uint32_t>(cell.y) * 0xd8163841u
+                      ^ seed * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static float simplexNoiseCorner(glm::ivec2 cell, glm::vec2 offset, std::uint32_t seed)
+{
+    float t = 0.5f - glm::dot(offset, offset);
+    if (t <= 0.0f)
+        return 0.0f;
+
+    const float angle = static_cast<float>(densityExpressionHash(cell, seed) >> 8) * (6.28318530718f / 16777216.0f);
+    t *= t;
+    return t * t * glm::dot(glm::vec2(glm::cos(angle), glm::sin(angle)), offset);
+}
+
+float simplexNoise(glm::vec2 position, std::uint32_t seed)
+{
+    constexpr float F2 = 0.366025403784f;
+    constexpr float G2 = 0.211324865405f;
+
+    const glm::vec2 cell = glm::floor(position + (position.x + position.y) * F2);
+    const glm::vec2 x0 = position - cell + (cell.x + cell.y) * G2;
+    const glm::ivec2 i1 = x0.x > x0.y ? glm::ivec2(1, 0) : glm::ivec2(0, 1);
+    const glm::vec2 x1 = x0 - glm::vec2(i1) + G2;
+    const glm::vec2 x2 = x0 - 1.0f + 2.0f * G2;
+
+    const glm::ivec2 i0 {cell};
+    const float n = simplexNoiseCorner(i0, x0, seed) + simplexNoiseCorner(i0 + i1, x1, seed)
+                    + simplexNoiseCorner(i0 + 1, x2, seed);
+
+    return glm::clamp(70.0f * n, -1.0f, 1.0f);
+}
+
+float fractalNoise(glm::vec2 position, float frequency, std::uint32_t octaves, std::uint32_t seed)
+{
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    float total_amplitude = 0.0f;
+
+    for (std::uint32_t i = 0; i < octaves; i++)
+    {
+        sum += amplitude * simplexNoise(position * frequency, seed + i);
+        total_amplitude += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    return total_amplitude > 0.0f ? glm::clamp(0.5f + 0.5f * sum / total_amplitude, 0.0f, 1.0f) : 0.5f;
+}
+
+static float remap(float x, float in_min, float in_max, float out_min, float out_max)
+{
+    const float t = in_max != in_min ? (x - in_min) / (in_max - in_min) : (x >= in_max ? 1.0f : 0.0f);
+    return glm::mix(out_min, out_max, glm::clamp(t, 0.0f, 1.0f));
+}
+
+// graph construction
+
+// noise nodes store their octave count and seed in place of inputs
+static bool hasNodeInputs(DensityExpression::Operation operation)
+{
+    return operation != DensityExpression::Operation::noise;
+}
+
+DensityExpression::Node DensityExpression::m_addNode(NodeData node)
+{
+    if (hasNodeInputs(node.operation))
+        for (const std::uint32_t input : node.inputs)
+            if (input != no_input)
+                m_checkInput({input});
+
+    // parameters are compiled in as literals, and GLSL has none for infinities or NaNs
+    if (!std::all_of(node.parameters.begin(), node.parameters.end(), [](float p) { return std::isfinite(p); }))
+        throw std::invalid_argument("density expression parameters must be finite");
+
+    m_nodes.push_back(node);
+    m_source = m_generateGLSL();
+    return {static_cast<std::uint32_t>(m_nodes.size() - 1)};
+}
+
+void DensityExpression::m_checkInput(Node node) const
+{
+    if (node.index >= m_nodes.size())
+        throw std::invalid_argument("node does not belong to this density expression");
+}
+
+DensityExpression::Node DensityExpression::constant(float value)
+{
+    return m_addNode({Operation::constant, {no_input, no_input}, {value}});
+}
+
+DensityExpression::Node DensityExpression::altitude()
+{
+    return m_addNode({Operation::altitude});
+}
+
+DensityExpression::Node DensityExpression::slope()
+{
+    return m_addNode({Operation::slope});
+}
+
+DensityExpression::Node DensityExpression::curvature()
+{
+    return m_addNode({Operation::curvature});
+}
+
+DensityExpression::Node DensityExpression::noise(float frequency, std::uint32_t octaves, std::uint32_t seed)
+{
+    if (octaves == 0)
+        throw std::invalid_argument("noise needs at least one octave");
+
+    return m_addNode({Operation::noise, {octaves, seed}, {frequency}});
+}
+
+DensityExpression::Node DensityExpression::texture()
+{
+    return m_addNode({Operation::texture});
+}
+
+DensityExpression::Node DensityExpression::remap(Node x, float in_min, float in_max, float out_min, float out_max)
+{
+    return m_addNode({Operation::remap, {x.index, no_input}, {in_min, in_max, out_min, out_max}});
+}
+
+DensityExpression::Node DensityExpression::clamp(Node x, float min_value, float max_value)
+{
+    return m_addNode({Operation::clamp, {x.index, no_input}, {min_value, max_value}});
+}
+
+DensityExpression::Node DensityExpression::add(Node a, Node b)
+{
+    return m_addNode({Operation::add, {a.index, b.index}});
+}
+
+DensityExpression::Node DensityExpression::multiply(Node a, Node b)
+{
+    return m_addNode({Operation::multiply, {a.index, b.index}});
+}
+
+DensityExpression::Node DensityExpression::minimum(Node a, Node b)
+{
+    return m_addNode({Operation::minimum, {a.index, b.index}});
+}
+
+DensityExpression::Node DensityExpression::maximum(Node a, Node b)
+{
+    return m_addNode({Operation::maximum, {a.index, b.index}});
+}
+
+void DensityExpression::setOutput(Node node)
+{
+    m_checkInput(node);
+    m_output = node.index;
+    m_source = m_generateGLSL();
+}
+
+DensityExpression::Node DensityExpression::getOutput() const
+{
+    if (m_nodes.empty())
+        throw std::logic_error("empty density expression");
+
+    return {m_output.value_or(static_cast<std::uint32_t>(m_nodes.size() - 1))};
+}
+
+std::vector<bool> DensityExpression::m_getReachableNodes() const
+{
+    std::vector<bool> reachable(m_nodes.size(), false);
+    reachable[getOutput().index] = true;
+
+    // inputs always precede the nodes that use them
+    for (std::size_t i = m_nodes.size(); i-- > 0;)
+        if (reachable[i] && hasNodeInputs(m_nodes[i].operation))
+            for (const std::uint32_t input : m_nodes[i].inputs)
+                if (input != no_input)
+                    reachable[input] = true;
+
+    return reachable;
+}
+
+bool DensityExpression::usesHeightmap() const
+{
+    if (m_nodes.empty())
+        return false;
+
+    const auto reachable = m_getReachableNodes();
+    for (std::size_t i = 0; i < m_nodes.size(); i++)
+        if (reachable[i] && (m_nodes[i].operation == Operation::slope || m_nodes[i].operation == Operation::curvature))
+            return true;
+
+    return false;
+}
+
+bool DensityExpression::usesTexture() const
+{
+    if (m_nodes.empty())
+        return false;
+
+    const auto reachable = m_getReachableNodes();
+    for (std::size_t i = 0; i < m_nodes.size(); i++)
+        if (reachable[i] && m_nodes[i].operation == Operation::texture)
+            return true;
+
+    return false;
+}
+
+// code generation
+
+namespace {
+
+/// Float literal that parses back to exactly the same value.
+std::string glslFloat(float value)
+{
+    std::ostringstream stream;
+    stream << std::scientific << std::setprecision(9) << value;
+    return "(" + stream.str() + ")";
+}
+
+} // namespace
+
+const std::string &DensityExpression::compileGLSL() const
+{
+    if (m_nodes.empty())
+        throw std::logic_error("empty density expression");
+
+    return m_source;
+}
+
+std::string DensityExpression::m_generateGLSL() const
+{
+    const auto reachable = m_getReachableNodes();
+
+    std::ostringstream source;
+    source << "float evaluateDensityExpression(vec3 position, vec2 world_uv)\n{\n";
+
+    for (std::size_t i = 0; i < m_nodes.size(); i++)
+    {
+        if (!reachable[i])
+            continue;
+
+        const NodeData &node = m_nodes[i];
+        const std::string a = "v" + std::to_string(node.inputs[0]);
+        const std::string b = "v" + std::to_string(node.inputs[1]);
+        const auto parameter = [&](int index) { return glslFloat(node.parameters[index]); };
+
+        source << "    const float v" << i << " = ";
+        switch (node.operation)
+        {
+        case Operation::constant: source << parameter(0); break;
+        case Operation::altitude: source << "position.z"; break;
+        case Operation::slope: source << "densityExpressionSlope(world_uv)"; break;
+        case Operation::curvature: source << "densityExpressionCurvature(world_uv)"; break;
+        case Operation::noise:
+            source << "fractalNoise(position.xy, " << parameter(0) << ", " << node.inputs[0] << "u, "
+                   << node.inputs[1] << "u)";
+            break;
+        case Operation::texture: source << "sampleDensityTexture(world_uv)"; break;
+        case Operation::remap:
+            source << "densityExpressionRemap(" << a << ", " << parameter(0) << ", " << parameter(1) << ", "
+                   << parameter(2) << ", " << parameter(3) << ")";
+            break;
+        case Operation::clamp: source << "clamp(" << a << ", " << parameter(0) << ", " << parameter(1) << ")"; break;
+        case Operation::add: source << a << " + " << b; break;
+        case Operation::multiply: source << a << " * " << b; break;
+        case Operation::minimum: source << "min(" << a << ", " << b << ")"; break;
+        case Operation::maximum: source << "max(" << a << ", " << b << ")"; break;
+        }
+        source << ";\n";
+    }
+
+    source << "    return v" << getOutput().index << ";\n}\n";
+
+    return source.str();
+}
+
+// CPU evaluation
+
+float DensityExpression::evaluate(const Inputs &inputs, const Sampler &sample_height,
+                                  const Sampler &sample_texture) const
+{
+    const auto reachable = m_getReachableNodes();
+    std::vector<float> values(m_nodes.size(), 0.0f);
+
+    const glm::vec2 texel = 1.0f / inputs.heightmap_size;
+    const glm::vec2 dx {texel.x, 0.0f};
+    const glm::vec2 dy {0.0f, texel.y};
+    const glm::vec2 uv = inputs.world_uv;
+
+    for (std::size_t i = 0; i < m_nodes.size(); i++)
+    {
+        if (!reachable[i])
+            continue;
+
+        const NodeData &node = m_nodes[i];
+        const auto &p = node.parameters;
+        const float a = hasNodeInputs(node.operation) && node.inputs[0] != no_input ? values[node.inputs[0]] : 0.0f;
+        const float b = hasNodeInputs(node.operation) && node.inputs[1] != no_input ? values[node.inputs[1]] : 0.0f;
+
+        float &value = values[i];
+        switch (node.operation)
+        {
+        case Operation::constant: value = p[0]; break;
+        case Operation::altitude: value = inputs.position.z; break;
+        case Operation::slope:
+        {
+            const glm::vec2 gradient = glm::vec2(sample_height(uv + dx) - sample_height(uv - dx),
+                                                 sample_height(uv + dy) - sample_height(uv - dy))
+                                       * inputs.world_scale.z / (2.0f * texel * glm::vec2(inputs.world_scale));
+            value = glm::degrees(glm::atan(glm::length(gradient)));
+            break;
+        }
+        case Operation::curvature:
+        {
+            const glm::vec2 spacing = texel * glm::vec2(inputs.world_scale);
+            const float h = sample_height(uv);
+            const float d2x = sample_height(uv + dx) + sample_height(uv - dx) - 2.0f * h;
+            const float d2y = sample_height(uv + dy) + sample_height(uv - dy) - 2.0f * h;
+            value = (d2x / (spacing.x * spacing.x) + d2y / (spacing.y * spacing.y)) * inputs.world_scale.z;
+            break;
+        }
+        case Operation::noise:
+            value = fractalNoise(glm::vec2(inputs.position), p[0], node.inputs[0], node.inputs[1]);
+            break;
+        case Operation::texture: value = sample_texture(uv); break;
+        case Operation::remap: value = remap(a, p[0], p[1], p[2], p[3]); break;
+        case Operation::clamp: value = glm::clamp(a, p[0], p[1]); break;
+        case Operation::add: value = a + b; break;
+        case Operation::multiply: value = a * b; break;
+        case Operation::minimum: value = glm::min(a, b); break;
+        case Operation::maximum: value = glm::max(a, b); break;
+        }
+    }
+
+    return values[getOutput().index];
+}
+
+} // placement
@@ -0,0 +1,108 @@
+#include "placement/exclusion_zones.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <limits>
+
+namespace placement {
+
+static bool isFinite(glm::vec2 v)
+{
+    return !glm::any(glm::isnan(v)) && !glm::any(glm::isinf(v));
+}
+
+void ExclusionZones::addCircle(glm::vec2 center, float radius)
+{
+    if (!isFinite(center))
+        throw std::invalid_argument("center must be finite");
+    if (!(radius >= 0.0f) || std::isinf(radius))
+        throw std::invalid_argument("radius must be finite and not negative");
+
+    m_shapes.push_back({center, center, radius, ExclusionShape::capsule});
+}
+
+void ExclusionZones::addBox(glm::vec2 center, glm::vec2 half_extents, float rotation)
+{
+    if (!isFinite(center) || !std::isfinite(rotation))
+        throw std::invalid_argument("center and rotation must be finite");
+    if (!(half_extents.x > 0.0f && half_extents.y > 0.0f) || !isFinite(half_extents))
+        throw std::invalid_argument("box extents must be finite and greater than zero");
+
+    const glm::vec2 axis {glm::cos(rotation), glm::sin(rotation)};
+    m_shapes.push_back({center, axis * half_extents.x, half_extents.y, ExclusionShape::box});
+}
+
+void ExclusionZones::addPolyline(const std::vector<glm::vec2> &points, float width)
+{
+    if (!(width >= 0.0f) || std::isinf(width))
+        throw std::invalid_argument("width must be finite and not negative");
+    for (const glm::vec2 point : points)
+        if (!isFinite(point))
+            throw std::invalid_argument("points must be finite");
+
+    if (points.size() == 1)
+        addCircle(points.front(), 0.5f * width);
+
+    for (std::size_t i = 1; i < points.size(); i++)
+        m_shapes.push_back({points[i - 1], points[i], 0.5f * width, ExclusionShape::capsule});
+}
+
+static bool isInsideShape(const ExclusionShape &shape, glm::vec2 position)
+{
+    if (shape.type == ExclusionShape::box)
+    {
+        const float half_length = glm::length(shape.b);
+        const glm::vec2 axis = shape.b / half_length;
+        const glm::vec2 offset = position - shape.a;
+
+        return glm::abs(glm::dot(offset, axis)) <= half_length
+               && glm::abs(glm::dot(offset, glm::vec2(-axis.y, axis.x))) <= shape.radius;
+    }
+
+    const glm::vec2 segment = shape.b - shape.a;
+    const float length_sq = glm::dot(segment, segment);
+    const float t = length_sq > 0.0f ? glm::clamp(glm::dot(position - shape.a, segment) / length_sq, 0.0f, 1.0f) : 0.0f;
+    const glm::vec2 offset = position - (shape.a + t * segment);
+
+    return glm::dot(offset, offset) <= shape.radius * shape.radius;
+}
+
+bool ExclusionZones::isExcluded(glm::vec2 position) const
+{
+    for (const auto &shape : m_shapes)
+        if (isInsideShape(shape, position))
+            return true;
+
+    return false;
+}
+
+std::pair<glm::vec2, glm::vec2> ExclusionZones::getBounds(const ExclusionShape &shape)
+{
+    if (shape.type == ExclusionShape::box)
+    {
+        const glm::vec2 axis = glm::normalize(shape.b);
+        const glm::vec2 extent = glm::abs(shape.b) + glm::abs(glm::vec2(-axis.y, axis.x)) * shape.radius;
+        return {shape.a - extent, shape.a + extent};
+    }
+
+    return {glm::min(shape.a, shape.b) - shape.radius, glm::max(shape.a, shape.b) + shape.radius};
+}
+
+std::pair<glm::vec2, glm::vec2> ExclusionZones::getBounds(std::size_t first_shape) const
+{
+    glm::vec2 lower_bound {std::numeric_limits<float>::max()};
+    glm::vec2 upper_bound {std::numeric_limits<float>::lowest()};
+
+    for (std::size_t i = first_shape; i < m_shapes.size(); i++)
+    {
+        const auto [shape_lower_bound, shape_upper_bound] = getBounds(m_shapes[i]);
+        lower_bound = glm::min(lower_bound, shape_lower_bound);
+        upper_bound = glm::max(upper_bound, shape_upper_bound);
+    }
+
+    return {lower_bound, upper_bound};
+}
+
+} // placement
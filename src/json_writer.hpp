@@ -0,0 +1,51 @@
+#ifndef PROCEDURALPLACEMENTLIB_JSON_WRITER_HPP
+#define PROCEDURALPLACEMENTLIB_JSON_WRITER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+namespace placement::json {
+
+/// Write @p string as a JSON string, escaping quotes, backslashes and control characters.
+inline void writeString(std::ostream &out, const char *string)
+{
+    constexpr char hex_digits[] = "0123456789abcdef";
+
+    out << '"';
+    for (; *string; string++)
+    {
+        const auto c = static_cast<unsigned char>(*string);
+        switch (c)
+        {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\b': out << "\\b"; break;
+        case '\f': out << "\\f"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (c < 0x20)
+                out << "\\u00" << hex_digits[c >> 4] << hex_digits[c & 0xf];
+            else
+                out << *string;
+        }
+    }
+    out << '"';
+}
+
+/// JSON has no literals for infinities and NaN: infinities are clamped to the largest finite floats, and NaN is
+/// written as null.
+inline void writeNumber(std::ostream &out, float value)
+{
+    if (std::isnan(value))
+        out << "null";
+    else
+        out << std::clamp(value, std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max());
+}
+
+} // placement::json
+
+#endif //PROCEDURALPLACEMENTLIB_JSON_WRITER_HPP
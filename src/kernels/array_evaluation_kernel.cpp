@@ -0,0 +1,202 @@
+#include "placement/kernel/array_evaluation_kernel.hpp"
+#include "placement/kernel/evaluation_kernel.hpp"
+#include "glsl_exclusion_zones.hpp"
+#include "glsl_statistics.hpp"
+
+static constexpr auto version_string = "#version 450 core\n";
+
+static constexpr auto parameter_block_string = R"gl(
+// parameters that change with every dispatch, see ArrayEvaluationKernel::Parameters
+layout(std140) uniform ArrayEvaluationParameters
+{
+    vec2 u_lower_bound;
+    vec2 u_upper_bound;
+    uvec2 u_work_group_index_offset;
+    uint u_class_count;
+    bool u_test_exclusion_zones;
+    bool u_use_exclusion_mask;
+    uint u_class_index_offset;
+    bool u_collect_statistics;
+};
+)gl";
+
+static constexpr auto source_string = R"gl(
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2DArray u_density_map_array;
+uniform float u_dithering_matrix [gl_WorkGroupSize.x][gl_WorkGroupSize.y];
+
+struct Candidate {
+    vec3 position;
+    uint class_index;
+};
+
+// x: scale, y: offset, z: min value, w: max value of the density map of each class, indexed by class index
+layout(std430) restrict readonly
+buffer ClassParameterBuffer
+{
+    vec4 class_parameter_array[];
+};
+
+layout(std430) restrict
+buffer CandidateBuffer
+{
+    Candidate[gl_WorkGroupSize.x][gl_WorkGroupSize.y] candidate_array[];
+};
+
+layout(std430) restrict readonly
+buffer WorldUVBuffer
+{
+    vec2[gl_WorkGroupSize.x][gl_WorkGroupSize.y] world_uv_array[];
+};
+
+layout(std430) restrict
+buffer DensityBuffer
+{
+    float[gl_WorkGroupSize.x][gl_WorkGroupSize.y] density_array[];
+};
+
+void main()
+{
+    const uint array_index = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+
+    const vec2 world_uv = world_uv_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y];
+
+    const uvec2 threshold_matrix_index = (gl_LocalInvocationID.xy + u_work_group_index_offset + gl_WorkGroupID.xy)
+                                            % gl_WorkGroupSize.xy;
+    const float threshold = u_dithering_matrix[threshold_matrix_index.x][threshold_matrix_index.y];
+
+    const Candidate candidate = candidate_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y];
+    const vec2 position2d = candidate.position.xy;
+
+    const bool in_bounds = all(greaterThanEqual(position2d, u_lower_bound)) && all(lessThan(position2d, u_upper_bound));
+
+    float density = density_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y];
+    uint class_index = candidate.class_index;
+    bool excluded = false;
+
+    // the same sums, in the same order, as one EvaluationKernel dispatch per class. Once a class is assigned no later
+    // class can replace it, so the loop stops there.
+    for (uint i = 0; i < u_class_count && class_index > u_class_index_offset + i; i++)
+    {
+        const vec4 parameters = class_parameter_array[u_class_index_offset + i];
+        const float sample_value = texture(u_density_map_array, vec3(world_uv, float(i))).x;
+        density += clamp(sample_value * parameters.x + parameters.y, parameters.z, parameters.w);
+
+        if (i == 0 && u_test_exclusion_zones && isExcluded(array_index, position2d, world_uv))
+        {
+            density = EXCLUDED_DENSITY;
+            excluded = true;
+            break;
+        }
+
+        if (density > threshold && in_bounds)
+            class_index = u_class_index_offset + i;
+    }
+
+    density_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y] = density;
+    candidate_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y].class_index = class_index;
+
+    countCandidate(!in_bounds, excluded);
+}
+)gl";
+
+namespace placement {
+
+ArrayEvaluationKernel::ArrayEvaluationKernel() : ArrayEvaluationKernel(compile())
+{}
+
+PendingComputeShaderProgram ArrayEvaluationKernel::compile()
+{
+    return PendingComputeShaderProgram(std::vector<const char*>{version_string, parameter_block_string,
+                                                                glsl::exclusion_zones_source, glsl::statistics_source,
+                                                                source_string});
+}
+
+ArrayEvaluationKernel::ArrayEvaluationKernel(PendingComputeShaderProgram &&program)
+        : m_program(std::move(program)),
+          m_dithering_matrix(m_program.getUniformLocation("u_dithering_matrix[0][0]")),
+          m_density_map_array(m_program.getUniformLocation("u_density_map_array")),
+          m_exclusion_mask(m_program.getUniformLocation("u_exclusion_mask")),
+          m_parameter_block(m_program.getUniformBlockIndex("ArrayEvaluationParameters")),
+          m_class_parameter_buffer(m_program.getShaderStorageBlockIndex("ClassParameterBuffer")),
+          m_candidate_buffer(m_program.getShaderStorageBlockIndex("CandidateBuffer")),
+          m_world_uv_buffer(m_program.getShaderStorageBlockIndex("WorldUVBuffer")),
+          m_density_buffer(m_program.getShaderStorageBlockIndex("DensityBuffer")),
+          m_exclusion_shape_buffer(m_program.getShaderStorageBlockIndex("ExclusionShapeBuffer")),
+          m_exclusion_bin_buffer(m_program.getShaderStorageBlockIndex("ExclusionBinBuffer")),
+          m_statistics_buffer(m_program.getShaderStorageBlockIndex("StatisticsBuffer"))
+{
+    setDitheringMatrixColumns(EvaluationKernel::default_dithering_matrix);
+}
+
+void ArrayEvaluationKernel::operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset,
+                                       uint class_index_offset, uint class_count, glm::vec2 lower_bound,
+                                       glm::vec2 upper_bound, GLuint density_map_array_texture_unit,
+                                       GLuint class_parameter_buffer_binding_index,
+                                       GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                                       GLuint density_buffer_binding_index,
+                                       std::optional<GLuint> statistics_buffer_binding_index)
+{
+    m_dispatch(num_work_groups, {lower_bound, upper_bound, work_group_index_offset, class_count, 0, 0,
+                                 class_index_offset, statistics_buffer_binding_index ? 1u : 0u},
+               density_map_array_texture_unit, class_parameter_buffer_binding_index, candidate_buffer_binding_index,
+               world_uv_buffer_binding_index, density_buffer_binding_index, statistics_buffer_binding_index);
+}
+
+void ArrayEvaluationKernel::operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset,
+                                       uint class_index_offset, uint class_count, glm::vec2 lower_bound,
+                                       glm::vec2 upper_bound, GLuint density_map_array_texture_unit,
+                                       GLuint class_parameter_buffer_binding_index,
+                                       GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                                       GLuint density_buffer_binding_index,
+                                       GLuint exclusion_shape_buffer_binding_index,
+                                       GLuint exclusion_bin_buffer_binding_index,
+                                       std::optional<GLuint> exclusion_mask_texture_unit,
+                                       std::optional<GLuint> statistics_buffer_binding_index)
+{
+    if (exclusion_mask_texture_unit)
+        m_program.setUniform(m_exclusion_mask, static_cast<GLint>(*exclusion_mask_texture_unit));
+
+    m_program.setShaderStorageBlockBindingIndex(m_exclusion_shape_buffer, exclusion_shape_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_exclusion_bin_buffer, exclusion_bin_buffer_binding_index);
+
+    m_dispatch(num_work_groups, {lower_bound, upper_bound, work_group_index_offset, class_count, 1,
+                                 exclusion_mask_texture_unit.has_value() ? 1u : 0u, class_index_offset,
+                                 statistics_buffer_binding_index ? 1u : 0u},
+               density_map_array_texture_unit, class_parameter_buffer_binding_index, candidate_buffer_binding_index,
+               world_uv_buffer_binding_index, density_buffer_binding_index, statistics_buffer_binding_index);
+}
+
+void ArrayEvaluationKernel::setParameterBindingIndex(GLuint binding_index)
+{
+    m_program.setUniformBlockBindingIndex(m_parameter_block, binding_index);
+}
+
+void ArrayEvaluationKernel::m_dispatch(glm::uvec2 num_work_groups, const Parameters &parameters,
+                                       GLuint density_map_array_texture_unit,
+                                       GLuint class_parameter_buffer_binding_index,
+                                       GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                                       GLuint density_buffer_binding_index,
+                                       std::optional<GLuint> statistics_buffer_binding_index)
+{
+    static_assert(sizeof(Parameters) == 48, "parameters must match the std140 layout of the uniform block");
+
+    // parameters
+    m_parameter_buffer.bind(m_parameter_block.getBindingIndex(), parameters);
+
+    // textures
+    m_program.setUniform(m_density_map_array, static_cast<GLint>(density_map_array_texture_unit));
+
+    // shader storage buffer bindings
+    m_program.setShaderStorageBlockBindingIndex(m_class_parameter_buffer, class_parameter_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_candidate_buffer, candidate_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_world_uv_buffer, world_uv_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_density_buffer, density_buffer_binding_index);
+    if (statistics_buffer_binding_index)
+        m_program.setShaderStorageBlockBindingIndex(m_statistics_buffer, *statistics_buffer_binding_index);
+
+    m_program.dispatch({num_work_groups, 1});
+}
+
+} // placement
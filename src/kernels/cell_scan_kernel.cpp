@@ -0,0 +1,101 @@
+#include "placement/kernel/cell_scan_kernel.hpp"
+
+static constexpr auto source_string = R"gl(
+#version 450 core
+
+layout(local_size_x = 64) in;
+
+uniform uint u_cell_count;
+
+// x: index of the first element of the cell, y: number of elements in the cell.
+layout(std430) restrict
+buffer CellIndexBuffer
+{
+    uvec2 array[];
+} b_cell_index;
+
+shared uint s_scan_array[2 * gl_WorkGroupSize.x];
+shared uint s_running_total;
+
+void addUpLocalScanArray()
+{
+    for (uint group_size = 1; group_size < 2 * gl_WorkGroupSize.x; group_size <<= 1)
+    {
+        const uint group_index = (gl_LocalInvocationID.x / group_size) * 2 + 1;
+        const uint base_index = group_index * group_size;
+        const uint write_index = base_index + gl_LocalInvocationID.x % group_size;
+        const uint read_index = base_index - 1;
+
+        s_scan_array[write_index] += s_scan_array[read_index];
+
+        barrier();
+        memoryBarrierShared();
+    }
+}
+
+void main()
+{
+    const uint class_offset = gl_WorkGroupID.x * u_cell_count;
+    const uvec2 local_index = {gl_LocalInvocationID.x, gl_LocalInvocationID.x + gl_WorkGroupSize.x};
+
+    if (gl_LocalInvocationIndex == 0)
+        s_running_total = 0;
+
+    for (uint chunk_offset = 0; chunk_offset < u_cell_count; chunk_offset += 2 * gl_WorkGroupSize.x)
+    {
+        const uvec2 cell_rank = uvec2(chunk_offset) + local_index;
+        const bvec2 valid = lessThan(cell_rank, uvec2(u_cell_count));
+
+        const uvec2 count = {valid.x ? b_cell_index.array[class_offset + cell_rank.x].y : 0,
+                             valid.y ? b_cell_index.array[class_offset + cell_rank.y].y : 0};
+
+        s_scan_array[local_index.x] = count.x;
+        s_scan_array[local_index.y] = count.y;
+
+        barrier();
+        memoryBarrierShared();
+
+        addUpLocalScanArray();
+
+        // inclusive to exclusive scan
+        if (valid.x)
+            b_cell_index.array[class_offset + cell_rank.x].x = s_running_total + s_scan_array[local_index.x] - count.x;
+        if (valid.y)
+            b_cell_index.array[class_offset + cell_rank.y].x = s_running_total + s_scan_array[local_index.y] - count.y;
+
+        barrier();
+
+        if (gl_LocalInvocationIndex == 0)
+            s_running_total += s_scan_array[2 * gl_WorkGroupSize.x - 1];
+
+        barrier();
+        memoryBarrierShared();
+    }
+}
+)gl";
+
+namespace placement {
+
+CellScanKernel::CellScanKernel() : CellScanKernel(compile())
+{}
+
+PendingComputeShaderProgram CellScanKernel::compile()
+{
+    return PendingComputeShaderProgram(source_string);
+}
+
+CellScanKernel::CellScanKernel(PendingComputeShaderProgram &&program)
+        : m_program(std::move(program)),
+          m_cell_count(m_program.getUniformLocation("u_cell_count")),
+          m_cell_index_buffer(m_program.getShaderStorageBlockIndex("CellIndexBuffer"))
+{}
+
+void CellScanKernel::operator()(uint class_count, uint cell_count, GLuint cell_index_buffer_binding_index)
+{
+    m_program.setUniform(m_cell_count, cell_count);
+    m_program.setShaderStorageBlockBindingIndex(m_cell_index_buffer, cell_index_buffer_binding_index);
+
+    m_program.dispatch({class_count, 1, 1});
+}
+
+} // placement
@@ -6,22 +6,70 @@
 
 #include "glm/gtc/type_ptr.hpp"
 
+#include <cstring>
+
+// GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace placement {
+
+static bool hasParallelShaderCompile()
+{
+    // a process uses a single GL implementation, so check its extensions once
+    static const bool supported = []()
+    {
+        GLint extension_count = 0;
+        gl.GetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+        for (GLint i = 0; i < extension_count; i++)
+        {
+            const auto *name = reinterpret_cast<const char*>(gl.GetStringi(GL_EXTENSIONS, i));
+            if (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0
+                || std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0)
+                return true;
+        }
+        return false;
+    }();
+
+    return supported;
+}
+
+PendingComputeShaderProgram::PendingComputeShaderProgram(unsigned int count, const char **source_strings)
+    : m_shader(GL::ShaderHandle::Type::compute)
+{
+    // no status queries here, as they would wait for the compiler
+    m_shader.setSource(static_cast<GLsizei>(count), source_strings);
+    m_shader.compile();
+    m_program.attachShader(m_shader);
+    m_program.link();
+}
+
+bool PendingComputeShaderProgram::isReady() const
+{
+    if (!hasParallelShaderCompile())
+        return true;
+
+    GLint completed = GL_FALSE;
+    gl.GetProgramiv(m_program.getName(), GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
 ComputeShaderProgram::ComputeShaderProgram(unsigned int count, const char **source_strings)
+    : ComputeShaderProgram(PendingComputeShaderProgram(count, source_strings))
+{}
+
+ComputeShaderProgram::ComputeShaderProgram(PendingComputeShaderProgram &&pending)
+    : m_program(std::move(pending.m_program))
 {
     using namespace GL;
 
-    Shader shader{ShaderHandle::Type::compute};
-    shader.setSource(static_cast<GLsizei>(count), source_strings);
-    shader.compile();
-    if (!shader.getParameter(ShaderHandle::Parameter::compile_status))
-        throw GLError(shader.getInfoLog());
+    if (!pending.m_shader.getParameter(ShaderHandle::Parameter::compile_status))
+        throw GLError(pending.m_shader.getInfoLog());
 
-    m_program.attachShader(shader);
-    m_program.link();
     if (!m_program.getParameter(ProgramHandle::Parameter::link_status))
         throw GLError(m_program.getInfoLog());
-    m_program.detachShader(shader);
+    m_program.detachShader(pending.m_shader);
 }
 
 void ComputeShaderProgram::useProgram() const
@@ -53,6 +101,11 @@ ComputeShaderProgram::UniformLocation ComputeShaderProgram::getUniformLocation(c
     return value;
 }
 
+ComputeShaderProgram::UniformLocation ComputeShaderProgram::findUniformLocation(const char *name) const
+{
+    return UniformLocation {m_program.getResourceLocation(Interface::uniform, name)};
+}
+
 GLuint
 ComputeShaderProgram::m_queryInterFaceBlockBindingIndex(InterfaceBlockType block_type, GLuint resource_index) const
 {
@@ -1,12 +1,22 @@
 #include "placement/kernel/copy_kernel.hpp"
+#include "placement/kernel/indexation_kernel.hpp"
+#include "glsl_morton_rank.hpp"
 
-static constexpr auto source_string = R"gl(
-#version 430 core
+static_assert(placement::IndexationKernel::cell_capacity == 64, "CELL_CAPACITY must match the indexation kernel");
+
+static constexpr auto version_string = "#version 430 core\n";
 
+static constexpr auto source_string = R"gl(
 #define NULL_CLASS_INDEX 0xFFffFFff
+#define CELL_CAPACITY 64
 
 layout(local_size_x = 64) in;
 
+uniform bool u_read_cell_index;
+uniform uvec2 u_cell_grid_size;
+uniform bool u_structure_of_arrays;
+uniform bool u_compute_bounds;
+
 struct Candidate
 {
     vec3 position;
@@ -31,51 +41,241 @@ buffer OutputBuffer
         Candidate array[];
 } b_output;
 
+// the same range as OutputBuffer, written as four arrays of x, y, z and class_index when u_structure_of_arrays is set.
+layout(std430) restrict writeonly
+buffer OutputArrayBuffer
+{
+        uint array[];
+} b_output_arrays;
+
 layout(std430) restrict readonly
 buffer CountBuffer
 {
     uint array[];
 } b_count;
 
-void main()
+// x: index of the first element of the cell, y: number of elements in the cell.
+layout(std430) restrict readonly
+buffer CellIndexBuffer
 {
-    const uint candidate_index = gl_GlobalInvocationID.x;
-    if (candidate_index >= b_candidate.array.length())
-        return;
+    uvec2 array[];
+} b_cell_index;
+
+// a box for each class, followed by a box for each class in each cell if u_read_cell_index is set. The minimum corners
+// of all the boxes come first, followed by the maximum corners, as floats. See BoundsBuffer.
+layout(std430) restrict coherent
+buffer BoundsBuffer
+{
+    uint array[];
+} b_bounds;
+
+shared vec3 s_positions[gl_WorkGroupSize.x];
+shared uint s_classes[gl_WorkGroupSize.x];
+
+// offset of the cell a candidate belongs to, relative to the start of its class.
+uint readCellOffset(uint candidate_index, uint class_index)
+{
+    const uint cell_index = candidate_index / CELL_CAPACITY;
+    const uvec2 cell = uvec2(cell_index % u_cell_grid_size.x, cell_index / u_cell_grid_size.x);
+    const uint cell_count = u_cell_grid_size.x * u_cell_grid_size.y;
+
+    return b_cell_index.array[class_index * cell_count + getMortonRank(cell, u_cell_grid_size)].x;
+}
+
+void atomicMinFloat(uint index, float value)
+{
+    uint expected = b_bounds.array[index];
+    while (value < uintBitsToFloat(expected))
+    {
+        const uint previous = atomicCompSwap(b_bounds.array[index], expected, floatBitsToUint(value));
+        if (previous == expected)
+            break;
+        expected = previous;
+    }
+}
+
+void atomicMaxFloat(uint index, float value)
+{
+    uint expected = b_bounds.array[index];
+    while (value > uintBitsToFloat(expected))
+    {
+        const uint previous = atomicCompSwap(b_bounds.array[index], expected, floatBitsToUint(value));
+        if (previous == expected)
+            break;
+        expected = previous;
+    }
+}
+
+// grow the boxes of the classes in the work group, which is a single cell of the cell index. The positions of each
+// class are reduced in shared memory first, so that there is one set of atomics per class and work group.
+void reduceBounds(const Candidate candidate)
+{
+    const uint local_index = gl_LocalInvocationIndex;
+    s_positions[local_index] = candidate.position;
+    s_classes[local_index] = candidate.class_index;
+
+    memoryBarrierShared();
+    barrier();
 
-    const Candidate candidate = b_candidate.array[candidate_index];
     if (candidate.class_index == NULL_CLASS_INDEX)
         return;
 
-    const uint copy_index = b_index.array[candidate_index];
+    // the first invocation of each class reduces it
+    for (uint i = 0; i < local_index; i++)
+        if (s_classes[i] == candidate.class_index)
+            return;
+
+    vec3 lower = candidate.position;
+    vec3 upper = candidate.position;
+    for (uint i = local_index + 1; i < gl_WorkGroupSize.x; i++)
+    {
+        if (s_classes[i] == candidate.class_index)
+        {
+            lower = min(lower, s_positions[i]);
+            upper = max(upper, s_positions[i]);
+        }
+    }
+
+    const uint box_count = b_bounds.array.length() / 6;
+    const uint max_offset = 3 * box_count;
+    const uint class_offset = 3 * candidate.class_index;
+
+    for (uint i = 0; i < 3; i++)
+    {
+        atomicMinFloat(class_offset + i, lower[i]);
+        atomicMaxFloat(max_offset + class_offset + i, upper[i]);
+    }
+
+    if (u_read_cell_index)
+    {
+        // no other work group writes to the box of this cell
+        const uint cell_index = gl_WorkGroupID.x;
+        const uvec2 cell = uvec2(cell_index % u_cell_grid_size.x, cell_index / u_cell_grid_size.x);
+        const uint cell_count = u_cell_grid_size.x * u_cell_grid_size.y;
+        const uint class_count = box_count / (1 + cell_count);
+        const uint cell_offset = 3 * (class_count + candidate.class_index * cell_count
+                + getMortonRank(cell, u_cell_grid_size));
+
+        for (uint i = 0; i < 3; i++)
+        {
+            b_bounds.array[cell_offset + i] = floatBitsToUint(lower[i]);
+            b_bounds.array[max_offset + cell_offset + i] = floatBitsToUint(upper[i]);
+        }
+    }
+}
+
+void copyCandidate(const uint candidate_index, const Candidate candidate)
+{
+    uint copy_index = b_index.array[candidate_index];
+
+    if (u_read_cell_index)
+        copy_index += readCellOffset(candidate_index, candidate.class_index);
 
     uint index_offset = 0;
     for (uint class_index = 0; class_index < candidate.class_index; class_index++)
         index_offset += b_count.array[class_index];
 
-    b_output.array[copy_index + index_offset] = candidate;
+    const uint output_index = copy_index + index_offset;
+
+    if (u_structure_of_arrays)
+    {
+        const uint capacity = b_output_arrays.array.length() / 4;
+        b_output_arrays.array[output_index] = floatBitsToUint(candidate.position.x);
+        b_output_arrays.array[capacity + output_index] = floatBitsToUint(candidate.position.y);
+        b_output_arrays.array[2 * capacity + output_index] = floatBitsToUint(candidate.position.z);
+        b_output_arrays.array[3 * capacity + output_index] = candidate.class_index;
+    }
+    else
+        b_output.array[output_index] = candidate;
+}
+
+void main()
+{
+    // every invocation must reach the barrier of reduceBounds()
+    const uint candidate_index = gl_GlobalInvocationID.x;
+    const Candidate candidate = candidate_index < b_candidate.array.length()
+            ? b_candidate.array[candidate_index] : Candidate(vec3(0.0), uint(NULL_CLASS_INDEX));
+
+    if (candidate.class_index != NULL_CLASS_INDEX)
+        copyCandidate(candidate_index, candidate);
+
+    if (u_compute_bounds)
+        reduceBounds(candidate);
 }
 )gl";
 
 namespace placement {
-CopyKernel::CopyKernel() : m_program(source_string),
-                           m_candidate_buffer(m_program.getShaderStorageBlockIndex("CandidateBuffer")),
-                           m_count_buffer(m_program.getShaderStorageBlockIndex("CountBuffer")),
-                           m_index_buffer(m_program.getShaderStorageBlockIndex("IndexBuffer")),
-                           m_output_buffer(m_program.getShaderStorageBlockIndex("OutputBuffer"))
+CopyKernel::CopyKernel() : CopyKernel(compile())
+{}
+
+PendingComputeShaderProgram CopyKernel::compile()
+{
+    return PendingComputeShaderProgram(std::vector<const char*>{version_string, glsl::morton_rank_source,
+                                                                source_string});
+}
+
+CopyKernel::CopyKernel(PendingComputeShaderProgram &&program)
+        : m_program(std::move(program)),
+          m_read_cell_index(m_program.getUniformLocation("u_read_cell_index")),
+          m_cell_grid_size(m_program.getUniformLocation("u_cell_grid_size")),
+          m_structure_of_arrays(m_program.getUniformLocation("u_structure_of_arrays")),
+          m_compute_bounds(m_program.getUniformLocation("u_compute_bounds")),
+          m_candidate_buffer(m_program.getShaderStorageBlockIndex("CandidateBuffer")),
+          m_count_buffer(m_program.getShaderStorageBlockIndex("CountBuffer")),
+          m_index_buffer(m_program.getShaderStorageBlockIndex("IndexBuffer")),
+          m_output_buffer(m_program.getShaderStorageBlockIndex("OutputBuffer")),
+          m_output_array_buffer(m_program.getShaderStorageBlockIndex("OutputArrayBuffer")),
+          m_cell_index_buffer(m_program.getShaderStorageBlockIndex("CellIndexBuffer")),
+          m_bounds_buffer(m_program.getShaderStorageBlockIndex("BoundsBuffer"))
 {}
 
 void CopyKernel::operator()(uint num_work_groups,
                             GLuint candidate_buffer_binding_index,
                             GLuint count_buffer_binding_index,
                             GLuint index_buffer_binding_index,
-                            GLuint output_buffer_binding_index)
+                            GLuint output_buffer_binding_index,
+                            std::optional<GLuint> bounds_buffer_binding_index)
 {
+    m_program.setUniform(m_read_cell_index, 0);
+    m_setBoundsBuffer(bounds_buffer_binding_index);
+
     m_program.setShaderStorageBlockBindingIndex(m_candidate_buffer, candidate_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_count_buffer, count_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_index_buffer, index_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_output_buffer, output_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_output_array_buffer, output_buffer_binding_index);
+    m_program.setUniform(m_structure_of_arrays, m_layout == ResultLayout::structure_of_arrays ? 1 : 0);
 
     m_program.dispatch({num_work_groups, 1, 1});
 }
+
+void CopyKernel::operator()(uint num_work_groups, glm::uvec2 cell_grid_size,
+                            GLuint candidate_buffer_binding_index,
+                            GLuint count_buffer_binding_index,
+                            GLuint index_buffer_binding_index,
+                            GLuint cell_index_buffer_binding_index,
+                            GLuint output_buffer_binding_index,
+                            std::optional<GLuint> bounds_buffer_binding_index)
+{
+    m_program.setUniform(m_read_cell_index, 1);
+    m_setBoundsBuffer(bounds_buffer_binding_index);
+    m_program.setUniform(m_cell_grid_size, cell_grid_size);
+
+    m_program.setShaderStorageBlockBindingIndex(m_candidate_buffer, candidate_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_count_buffer, count_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_index_buffer, index_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_cell_index_buffer, cell_index_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_output_buffer, output_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_output_array_buffer, output_buffer_binding_index);
+    m_program.setUniform(m_structure_of_arrays, m_layout == ResultLayout::structure_of_arrays ? 1 : 0);
+
+    m_program.dispatch({num_work_groups, 1, 1});
+}
+
+void CopyKernel::m_setBoundsBuffer(std::optional<GLuint> bounds_buffer_binding_index)
+{
+    m_program.setUniform(m_compute_bounds, bounds_buffer_binding_index ? 1 : 0);
+    if (bounds_buffer_binding_index)
+        m_program.setShaderStorageBlockBindingIndex(m_bounds_buffer, *bounds_buffer_binding_index);
+}
 } // placement
\ No newline at end of file
@@ -1,18 +1,40 @@
 #include "placement/kernel/evaluation_kernel.hpp"
 #include "placement/density_map.hpp"
+#include "placement/virtual_texture.hpp"
+#include "placement/density_expression.hpp"
+#include "glsl_virtual_texture.hpp"
+#include "glsl_density_expression.hpp"
+#include "glsl_exclusion_zones.hpp"
+#include "glsl_statistics.hpp"
 
-static constexpr auto source_string = R"gl(
-#version 450 core
+static constexpr auto version_string = "#version 450 core\n";
+
+// declared ahead of the other sources, as u_world_scale is also read by density expressions
+static constexpr auto parameter_block_string = R"gl(
+// parameters that change with every dispatch, see EvaluationKernel::Parameters
+layout(std140) uniform EvaluationParameters
+{
+    vec4 u_density_map_params;
+    vec2 u_lower_bound;
+    vec2 u_upper_bound;
+    uvec2 u_work_group_index_offset;
+    vec2 u_density_map_size;
+    vec3 u_world_scale;
+    uint u_class_index;
+    bool u_virtual_density_map;
+    bool u_test_exclusion_zones;
+    bool u_use_exclusion_mask;
+    bool u_collect_statistics;
+};
+)gl";
 
+static constexpr auto source_string = R"gl(
 layout(local_size_x = 8, local_size_y = 8) in;
 
 uniform sampler2D u_density_map;
-uniform vec4 u_density_map_params;
-uniform uint u_class_index;
+uniform usampler2D u_density_map_page_table;
+uniform sampler2DArray u_density_map_page_cache;
 uniform float u_dithering_matrix [gl_WorkGroupSize.x][gl_WorkGroupSize.y];
-uniform vec2 u_lower_bound;
-uniform vec2 u_upper_bound;
-uniform uvec2 u_work_group_index_offset;
 
 struct Candidate {
     vec3 position;
@@ -37,14 +59,25 @@ buffer DensityBuffer
     float[gl_WorkGroupSize.x][gl_WorkGroupSize.y] density_array[];
 };
 
-float sampleDensityMap(vec2 world_uv)
+float sampleDensityTexture(vec2 world_uv)
+{
+    return u_virtual_density_map
+           ? sampleVirtualTexture(u_density_map_page_table, u_density_map_page_cache, u_density_map_size, world_uv)
+           : texture(u_density_map, world_uv).x;
+}
+
+float sampleDensityMap(vec3 position, vec2 world_uv)
 {
     const float scale = u_density_map_params.x;
     const float offset = u_density_map_params.y;
     const float min_value = u_density_map_params.z;
     const float max_value = u_density_map_params.w;
 
-    const float density = texture(u_density_map, world_uv).x;
+#ifdef DENSITY_EXPRESSION
+    const float density = evaluateDensityExpression(position, world_uv);
+#else
+    const float density = sampleDensityTexture(world_uv);
+#endif
 
     return clamp(density * scale + offset, min_value, max_value);
 }
@@ -59,15 +92,23 @@ void main()
                                             % gl_WorkGroupSize.xy;
     const float threshold = u_dithering_matrix[threshold_matrix_index.x][threshold_matrix_index.y];
 
-    const float density = density_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y]
-                        + sampleDensityMap(world_uv);
+    const vec3 position = candidate_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y].position;
+    const vec2 position2d = position.xy;
+
+    float density = density_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y]
+                  + sampleDensityMap(position, world_uv);
+
+    const bool excluded = u_test_exclusion_zones && isExcluded(array_index, position2d, world_uv);
+    if (excluded)
+        density = EXCLUDED_DENSITY;
 
     density_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y] = density;
 
-    const vec2 position2d = candidate_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y].position.xy;
     const bool above_lower_bound = all(greaterThanEqual(position2d, u_lower_bound));
     const bool below_upper_bound = all(lessThan(position2d, u_upper_bound));
 
+    countCandidate(!(above_lower_bound && below_upper_bound), excluded);
+
     const uint current_layer_index = candidate_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y].class_index;
 
     if (u_class_index < current_layer_index && density > threshold && above_lower_bound && below_upper_bound)
@@ -77,20 +118,68 @@ void main()
 
 namespace placement {
 
-EvaluationKernel::EvaluationKernel()
-        : m_program(source_string),
-          m_class_index(m_program.getUniformLocation("u_class_index")),
-          m_lower_bound(m_program.getUniformLocation("u_lower_bound")),
-          m_upper_bound(m_program.getUniformLocation("u_upper_bound")),
-          m_work_group_index_offset(m_program.getUniformLocation("u_work_group_index_offset")),
+EvaluationKernel::EvaluationKernel() : EvaluationKernel(compile())
+{}
+
+EvaluationKernel::EvaluationKernel(const DensityExpression &expression) : EvaluationKernel(compile(expression))
+{}
+
+PendingComputeShaderProgram EvaluationKernel::compile()
+{
+    return PendingComputeShaderProgram(std::vector<const char*>{version_string, parameter_block_string,
+                                                                glsl::virtual_texture_source,
+                                                                glsl::exclusion_zones_source, glsl::statistics_source,
+                                                                source_string});
+}
+
+PendingComputeShaderProgram EvaluationKernel::compile(const DensityExpression &expression)
+{
+    return PendingComputeShaderProgram(std::vector<const char*>{version_string, "#define DENSITY_EXPRESSION\n",
+                                                                parameter_block_string, glsl::virtual_texture_source,
+                                                                glsl::exclusion_zones_source, glsl::statistics_source,
+                                                                glsl::density_expression_source,
+                                                                expression.compileGLSL().c_str(), source_string});
+}
+
+// samplers only read through sampleDensityTexture() or by density expressions may be optimized out of programs
+// compiled for expressions that don't use them, hence findUniformLocation().
+EvaluationKernel::EvaluationKernel(PendingComputeShaderProgram &&program)
+        : m_program(std::move(program)),
           m_dithering_matrix(m_program.getUniformLocation("u_dithering_matrix[0][0]")),
-          m_density_map_params(m_program.getUniformLocation("u_density_map_params")),
-          m_density_map(m_program.getUniformLocation("u_density_map")),
+          m_density_map(m_program.findUniformLocation("u_density_map")),
+          m_density_map_page_table(m_program.findUniformLocation("u_density_map_page_table")),
+          m_density_map_page_cache(m_program.findUniformLocation("u_density_map_page_cache")),
+          m_exclusion_mask(m_program.getUniformLocation("u_exclusion_mask")),
+          m_heightmap(m_program.findUniformLocation("u_heightmap")),
+          m_parameter_block(m_program.getUniformBlockIndex("EvaluationParameters")),
           m_candidate_buffer(m_program.getShaderStorageBlockIndex("CandidateBuffer")),
           m_world_uv_buffer(m_program.getShaderStorageBlockIndex("WorldUVBuffer")),
-          m_density_buffer(m_program.getShaderStorageBlockIndex("DensityBuffer"))
+          m_density_buffer(m_program.getShaderStorageBlockIndex("DensityBuffer")),
+          m_exclusion_shape_buffer(m_program.getShaderStorageBlockIndex("ExclusionShapeBuffer")),
+          m_exclusion_bin_buffer(m_program.getShaderStorageBlockIndex("ExclusionBinBuffer")),
+          m_statistics_buffer(m_program.getShaderStorageBlockIndex("StatisticsBuffer"))
 {
     setDitheringMatrixColumns(default_dithering_matrix);
+
+    // samplers of different types must not share a texture unit, even if unused
+    setVirtualTextureUnits(default_page_table_texture_unit, default_page_cache_texture_unit);
+}
+
+void EvaluationKernel::setExpressionInputs(GLuint heightmap_texture_unit, glm::vec3 world_scale)
+{
+    m_program.setUniform(m_heightmap, static_cast<GLint>(heightmap_texture_unit));
+    m_world_scale = world_scale;
+}
+
+void EvaluationKernel::setParameterBindingIndex(GLuint binding_index)
+{
+    m_program.setUniformBlockBindingIndex(m_parameter_block, binding_index);
+}
+
+void EvaluationKernel::setVirtualTextureUnits(GLuint page_table_texture_unit, GLuint page_cache_texture_unit)
+{
+    m_program.setUniform(m_density_map_page_table, static_cast<GLint>(page_table_texture_unit));
+    m_program.setUniform(m_density_map_page_cache, static_cast<GLint>(page_cache_texture_unit));
 }
 
 constexpr auto wg_size = EvaluationKernel::work_group_size;
@@ -124,15 +213,61 @@ EvaluationKernel::operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_i
                              glm::vec2 lower_bound, glm::vec2 upper_bound,
                              GLuint density_map_texture_unit, const DensityMap& density_map,
                              GLuint candidate_buffer_binding_index,
-                             GLuint world_uv_buffer_binding_index, GLuint density_buffer_binding_index)
+                             GLuint world_uv_buffer_binding_index, GLuint density_buffer_binding_index,
+                             std::optional<GLuint> statistics_buffer_binding_index)
+{
+    m_dispatch(num_work_groups, work_group_index_offset, class_index, lower_bound, upper_bound,
+               density_map_texture_unit, density_map, candidate_buffer_binding_index, world_uv_buffer_binding_index,
+               density_buffer_binding_index, false, false, statistics_buffer_binding_index);
+}
+
+void
+EvaluationKernel::operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset, uint class_index,
+                             glm::vec2 lower_bound, glm::vec2 upper_bound,
+                             GLuint density_map_texture_unit, const DensityMap& density_map,
+                             GLuint candidate_buffer_binding_index,
+                             GLuint world_uv_buffer_binding_index, GLuint density_buffer_binding_index,
+                             GLuint exclusion_shape_buffer_binding_index, GLuint exclusion_bin_buffer_binding_index,
+                             std::optional<GLuint> exclusion_mask_texture_unit,
+                             std::optional<GLuint> statistics_buffer_binding_index)
 {
-    // uniforms
-    m_program.setUniform(m_class_index, class_index);
-    m_program.setUniform(m_lower_bound, lower_bound);
-    m_program.setUniform(m_upper_bound, upper_bound);
-    m_program.setUniform(m_density_map_params, {density_map.scale, density_map.offset,
-                                                density_map.min_value, density_map.max_value});
-    m_program.setUniform(m_work_group_index_offset, work_group_index_offset);
+    if (exclusion_mask_texture_unit)
+        m_program.setUniform(m_exclusion_mask, static_cast<GLint>(*exclusion_mask_texture_unit));
+
+    m_program.setShaderStorageBlockBindingIndex(m_exclusion_shape_buffer, exclusion_shape_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_exclusion_bin_buffer, exclusion_bin_buffer_binding_index);
+
+    m_dispatch(num_work_groups, work_group_index_offset, class_index, lower_bound, upper_bound,
+               density_map_texture_unit, density_map, candidate_buffer_binding_index, world_uv_buffer_binding_index,
+               density_buffer_binding_index, true, exclusion_mask_texture_unit.has_value(),
+               statistics_buffer_binding_index);
+}
+
+void EvaluationKernel::m_dispatch(glm::uvec2 num_work_groups, glm::uvec2 work_group_index_offset, uint class_index,
+                                  glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                  GLuint density_map_texture_unit, const DensityMap &density_map,
+                                  GLuint candidate_buffer_binding_index, GLuint world_uv_buffer_binding_index,
+                                  GLuint density_buffer_binding_index, bool test_exclusion_zones,
+                                  bool use_exclusion_mask, std::optional<GLuint> statistics_buffer_binding_index)
+{
+    static_assert(sizeof(Parameters) == 80, "parameters must match the std140 layout of the uniform block");
+
+    // parameters
+    const VirtualTexture *virtual_texture = density_map.virtual_texture;
+    const Parameters parameters {
+            {density_map.scale, density_map.offset, density_map.min_value, density_map.max_value},
+            lower_bound,
+            upper_bound,
+            work_group_index_offset,
+            virtual_texture ? glm::vec2(virtual_texture->getHeader().size) : glm::vec2(0.0f),
+            m_world_scale,
+            class_index,
+            virtual_texture ? 1u : 0u,
+            test_exclusion_zones ? 1u : 0u,
+            use_exclusion_mask ? 1u : 0u,
+            statistics_buffer_binding_index ? 1u : 0u};
+
+    m_parameter_buffer.bind(m_parameter_block.getBindingIndex(), parameters);
 
     // textures
     m_program.setUniform(m_density_map, static_cast<GLint>(density_map_texture_unit));
@@ -141,6 +276,8 @@ EvaluationKernel::operator()(glm::uvec2 num_work_groups, glm::uvec2 work_group_i
     m_program.setShaderStorageBlockBindingIndex(m_candidate_buffer, candidate_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_world_uv_buffer, world_uv_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_density_buffer, density_buffer_binding_index);
+    if (statistics_buffer_binding_index)
+        m_program.setShaderStorageBlockBindingIndex(m_statistics_buffer, *statistics_buffer_binding_index);
 
     m_program.dispatch({num_work_groups, 1});
 }
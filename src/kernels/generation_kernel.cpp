@@ -1,20 +1,39 @@
 #include "placement/kernel/generation_kernel.hpp"
+#include "placement/virtual_texture.hpp"
+#include "glsl_virtual_texture.hpp"
 
-static constexpr auto source_string = R"gl(
-#version 450 core
+static constexpr auto version_string = "#version 450 core\n";
 
+static constexpr auto source_string = R"gl(
 #define INVALID_INDEX 0xFFffFFff
 
 layout(local_size_x = 8, local_size_y = 8) in;
 
-uniform float u_footprint;
-uniform vec3 u_world_scale;
+// parameters that change with every dispatch, see GenerationKernel::Parameters
+layout(std140) uniform GenerationParameters
+{
+    vec3 u_world_scale;
+    float u_footprint;
+    uvec2 u_work_group_offset;
+    vec2 u_heightmap_size;
+    bool u_virtual_heightmap;
+    uint u_seed;
+};
+
 uniform vec2 u_work_group_scale;
-uniform uvec2 u_work_group_offset;
-uniform vec2 u_work_group_pattern[gl_WorkGroupSize.x][gl_WorkGroupSize.y];
 
 uniform sampler2D u_heightmap;
 
+uniform usampler2D u_heightmap_page_table;
+uniform sampler2DArray u_heightmap_page_cache;
+
+// patterns of a WorkGroupPatternLibrary, covering u_work_group_scale
+layout(std430) restrict readonly
+buffer PatternBuffer
+{
+    vec2[gl_WorkGroupSize.x][gl_WorkGroupSize.y] pattern_array[];
+};
+
 struct Candidate
 {
     vec3 position;
@@ -39,18 +58,47 @@ buffer DensityBuffer
     float[gl_WorkGroupSize.x][gl_WorkGroupSize.y] density_array[];
 };
 
+uint hashSeed(uint x)
+{
+    x ^= x >> 16u;
+    x *= 0x7feb352du;
+    x ^= x >> 15u;
+    x *= 0x846ca68bu;
+    x ^= x >> 16u;
+    return x;
+}
+
+// the pattern selected by the seed, mirrored and shifted, see WorkGroupPatternLibrary::getSeedPattern()
+vec2 patternPosition(uvec2 invocation)
+{
+    const uint hash = hashSeed(u_seed);
+    const uint shift_hash = hashSeed(hash);
+
+    vec2 position = pattern_array[hash % uint(pattern_array.length())][invocation.x][invocation.y];
+    if ((hash & 0x80000000u) != 0u && u_work_group_scale.x == u_work_group_scale.y)
+        position = position.yx;
+
+    const bvec2 mirror = bvec2((hash & 0x40000000u) != 0u, (hash & 0x20000000u) != 0u);
+    const vec2 shift = vec2(shift_hash & 0xFFFFu, shift_hash >> 16u) / 65536.0f * u_work_group_scale;
+
+    position = mix(position, u_work_group_scale - position, mirror) + shift;
+    return position - u_work_group_scale * vec2(greaterThanEqual(position, u_work_group_scale));
+}
+
 void main()
 {
     const uint array_index = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
 
     const uvec2 grid_index = gl_WorkGroupID.xy + u_work_group_offset;
-    const vec2 h_position = u_footprint * (u_work_group_pattern[gl_LocalInvocationID.x][gl_LocalInvocationID.y]
-                                         + grid_index * u_work_group_scale);
+    const vec2 h_position = u_footprint * (patternPosition(gl_LocalInvocationID.xy) + grid_index * u_work_group_scale);
 
     const vec2 world_uv = h_position / u_world_scale.xy;
     world_uv_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y] = world_uv;
 
-    const float height = texture(u_heightmap, world_uv).x * u_world_scale.z;
+    const float height = (u_virtual_heightmap
+                            ? sampleVirtualTexture(u_heightmap_page_table, u_heightmap_page_cache, u_heightmap_size,
+                                                   world_uv)
+                            : texture(u_heightmap, world_uv).x) * u_world_scale.z;
     candidate_array[array_index][gl_LocalInvocationID.x][gl_LocalInvocationID.y] = Candidate(vec3(h_position, height),
                                                                                              INVALID_INDEX);
 
@@ -60,34 +108,80 @@ void main()
 
 namespace placement {
 
-GenerationKernel::GenerationKernel()
-        : m_program(source_string),
-          m_footprint(m_program.getUniformLocation("u_footprint")),
-          m_world_scale(m_program.getUniformLocation("u_world_scale")),
+GenerationKernel::GenerationKernel() : GenerationKernel(compile())
+{}
+
+PendingComputeShaderProgram GenerationKernel::compile()
+{
+    return PendingComputeShaderProgram(std::vector<const char*>{version_string, glsl::virtual_texture_source,
+                                                                source_string});
+}
+
+GenerationKernel::GenerationKernel(PendingComputeShaderProgram &&program)
+        : m_program(std::move(program)),
           m_work_group_scale(m_program.getUniformLocation("u_work_group_scale")),
-          m_work_group_offset(m_program.getUniformLocation("u_work_group_offset")),
-          m_work_group_pattern(m_program.getUniformLocation("u_work_group_pattern[0][0]")),
           m_heightmap_tex(m_program.getUniformLocation("u_heightmap")),
+          m_heightmap_page_table(m_program.getUniformLocation("u_heightmap_page_table")),
+          m_heightmap_page_cache(m_program.getUniformLocation("u_heightmap_page_cache")),
+          m_parameter_block(m_program.getUniformBlockIndex("GenerationParameters")),
+          m_pattern_buf(m_program.getShaderStorageBlockIndex("PatternBuffer")),
           m_candidate_buf(m_program.getShaderStorageBlockIndex("CandidateBuffer")),
           m_world_uv_buf(m_program.getShaderStorageBlockIndex("WorldUVBuffer")),
           m_density_buf(m_program.getShaderStorageBlockIndex("DensityBuffer"))
-{}
+{
+    // samplers of different types must not share a texture unit, even if unused
+    setVirtualTextureUnits(default_page_table_texture_unit, default_page_cache_texture_unit);
+}
 
 void GenerationKernel::operator()(glm::uvec2 num_work_groups, glm::uvec2 group_offset, float footprint,
-                                  glm::vec3 world_scale, GLuint heightmap_texture_unit,
+                                  glm::vec3 world_scale, std::uint32_t seed, GLuint heightmap_texture_unit,
+                                  GLuint pattern_buffer_binding_index,
                                   GLuint candidate_buffer_binding_index,
                                   GLuint world_uv_buffer_binding_index,
                                   GLuint density_buffer_binding_index)
 {
-    // uniforms
-    m_program.setUniform(m_work_group_offset, group_offset);
-    m_program.setUniform(m_footprint, footprint);
-    m_program.setUniform(m_world_scale, world_scale);
-
-    // textures
     m_program.setUniform(m_heightmap_tex, static_cast<GLint>(heightmap_texture_unit));
 
+    m_dispatch(num_work_groups, {world_scale, footprint, group_offset, glm::vec2(0.0f), 0, seed},
+               pattern_buffer_binding_index, candidate_buffer_binding_index, world_uv_buffer_binding_index,
+               density_buffer_binding_index);
+}
+
+void GenerationKernel::operator()(glm::uvec2 num_work_groups, glm::uvec2 group_offset, float footprint,
+                                  glm::vec3 world_scale, std::uint32_t seed, const VirtualTexture &heightmap,
+                                  GLuint pattern_buffer_binding_index,
+                                  GLuint candidate_buffer_binding_index,
+                                  GLuint world_uv_buffer_binding_index,
+                                  GLuint density_buffer_binding_index)
+{
+    m_dispatch(num_work_groups,
+               {world_scale, footprint, group_offset, glm::vec2(heightmap.getHeader().size), 1, seed},
+               pattern_buffer_binding_index, candidate_buffer_binding_index, world_uv_buffer_binding_index,
+               density_buffer_binding_index);
+}
+
+void GenerationKernel::setVirtualTextureUnits(GLuint page_table_texture_unit, GLuint page_cache_texture_unit)
+{
+    m_program.setUniform(m_heightmap_page_table, static_cast<GLint>(page_table_texture_unit));
+    m_program.setUniform(m_heightmap_page_cache, static_cast<GLint>(page_cache_texture_unit));
+}
+
+void GenerationKernel::setParameterBindingIndex(GLuint binding_index)
+{
+    m_program.setUniformBlockBindingIndex(m_parameter_block, binding_index);
+}
+
+void GenerationKernel::m_dispatch(glm::uvec2 num_work_groups, const Parameters &parameters,
+                                  GLuint pattern_buffer_binding_index, GLuint candidate_buffer_binding_index,
+                                  GLuint world_uv_buffer_binding_index, GLuint density_buffer_binding_index)
+{
+    static_assert(sizeof(Parameters) == 48, "parameters must match the std140 layout of the uniform block");
+
+    // parameters
+    m_parameter_buffer.bind(m_parameter_block.getBindingIndex(), parameters);
+
     // ssbo bindings
+    m_program.setShaderStorageBlockBindingIndex(m_pattern_buf, pattern_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_candidate_buf, candidate_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_density_buf, density_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_world_uv_buf, world_uv_buffer_binding_index);
@@ -0,0 +1,109 @@
+#ifndef PROCEDURALPLACEMENTLIB_GLSL_DENSITY_EXPRESSION_HPP
+#define PROCEDURALPLACEMENTLIB_GLSL_DENSITY_EXPRESSION_HPP
+
+namespace placement::glsl {
+
+/**
+ * Functions used by the code generated by DensityExpression::compileGLSL(), to be inserted before it. Must match the
+ * CPU implementation in density_expression.cpp. The shader must declare the dimensions of the world as
+ * `vec3 u_world_scale` beforehand, and define `float sampleDensityTexture(vec2 world_uv)`.
+ */
+constexpr auto density_expression_source = R"gl(
+uniform sampler2D u_heightmap;
+
+float sampleDensityTexture(vec2 world_uv);
+
+uint densityExpressionHash(ivec2 cell, uint seed)
+{
+    uint h = uint(cell.x) * 0x8da6b343u ^ uint(cell.y) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+float simplexNoiseCorner(ivec2 cell, vec2 offset, uint seed)
+{
+    float t = 0.5 - dot(offset, offset);
+    if (t <= 0.0)
+        return 0.0;
+
+    const float angle = float(densityExpressionHash(cell, seed) >> 8) * (6.28318530718 / 16777216.0);
+    t *= t;
+    return t * t * dot(vec2(cos(angle), sin(angle)), offset);
+}
+
+float simplexNoise(vec2 position, uint seed)
+{
+    const float F2 = 0.366025403784;
+    const float G2 = 0.211324865405;
+
+    const vec2 cell = floor(position + (position.x + position.y) * F2);
+    const vec2 x0 = position - cell + (cell.x + cell.y) * G2;
+    const ivec2 i1 = x0.x > x0.y ? ivec2(1, 0) : ivec2(0, 1);
+    const vec2 x1 = x0 - vec2(i1) + G2;
+    const vec2 x2 = x0 - 1.0 + 2.0 * G2;
+
+    const ivec2 i0 = ivec2(cell);
+    const float n = simplexNoiseCorner(i0, x0, seed) + simplexNoiseCorner(i0 + i1, x1, seed)
+                  + simplexNoiseCorner(i0 + 1, x2, seed);
+
+    return clamp(70.0 * n, -1.0, 1.0);
+}
+
+float fractalNoise(vec2 position, float frequency, uint octaves, uint seed)
+{
+    float sum = 0.0;
+    float amplitude = 1.0;
+    float total_amplitude = 0.0;
+
+    for (uint i = 0; i < octaves; i++)
+    {
+        sum += amplitude * simplexNoise(position * frequency, seed + i);
+        total_amplitude += amplitude;
+        amplitude *= 0.5;
+        frequency *= 2.0;
+    }
+
+    return total_amplitude > 0.0 ? clamp(0.5 + 0.5 * sum / total_amplitude, 0.0, 1.0) : 0.5;
+}
+
+float densityExpressionSlope(vec2 uv)
+{
+    const vec2 texel = 1.0 / vec2(textureSize(u_heightmap, 0));
+    const vec2 dx = vec2(texel.x, 0.0);
+    const vec2 dy = vec2(0.0, texel.y);
+
+    const vec2 gradient = vec2(texture(u_heightmap, uv + dx).x - texture(u_heightmap, uv - dx).x,
+                               texture(u_heightmap, uv + dy).x - texture(u_heightmap, uv - dy).x)
+                        * u_world_scale.z / (2.0 * texel * u_world_scale.xy);
+
+    return degrees(atan(length(gradient)));
+}
+
+float densityExpressionCurvature(vec2 uv)
+{
+    const vec2 texel = 1.0 / vec2(textureSize(u_heightmap, 0));
+    const vec2 dx = vec2(texel.x, 0.0);
+    const vec2 dy = vec2(0.0, texel.y);
+    const vec2 spacing = texel * u_world_scale.xy;
+
+    const float h = texture(u_heightmap, uv).x;
+    const float d2x = texture(u_heightmap, uv + dx).x + texture(u_heightmap, uv - dx).x - 2.0 * h;
+    const float d2y = texture(u_heightmap, uv + dy).x + texture(u_heightmap, uv - dy).x - 2.0 * h;
+
+    return (d2x / (spacing.x * spacing.x) + d2y / (spacing.y * spacing.y)) * u_world_scale.z;
+}
+
+float densityExpressionRemap(float x, float in_min, float in_max, float out_min, float out_max)
+{
+    const float t = in_max != in_min ? (x - in_min) / (in_max - in_min) : (x >= in_max ? 1.0 : 0.0);
+    return mix(out_min, out_max, clamp(t, 0.0, 1.0));
+}
+)gl";
+
+} // placement::glsl
+
+#endif //PROCEDURALPLACEMENTLIB_GLSL_DENSITY_EXPRESSION_HPP
@@ -0,0 +1,76 @@
+#ifndef PROCEDURALPLACEMENTLIB_GLSL_EXCLUSION_ZONES_HPP
+#define PROCEDURALPLACEMENTLIB_GLSL_EXCLUSION_ZONES_HPP
+
+namespace placement::glsl {
+
+/**
+ * Exclusion zone and exclusion mask tests of the evaluation kernels (see placement::ExclusionZones). The shader must
+ * declare `bool u_use_exclusion_mask` beforehand.
+ */
+constexpr auto exclusion_zones_source = R"gl(
+uniform sampler2D u_exclusion_mask;
+
+// candidates inside an exclusion zone get this density, so they stay below the threshold for every class.
+#define EXCLUDED_DENSITY -3.0e38
+
+#define EXCLUSION_CAPSULE 0
+#define EXCLUSION_BOX 1
+
+struct ExclusionShape
+{
+    vec2 a;
+    vec2 b;
+    float radius;
+    uint type;
+};
+
+layout(std430) restrict readonly
+buffer ExclusionShapeBuffer
+{
+    ExclusionShape exclusion_shape_array[];
+};
+
+// shapes binned by work group: [array_index] and [array_index + 1] delimit the range of entries that hold the
+// indices of the shapes overlapping that work group.
+layout(std430) restrict readonly
+buffer ExclusionBinBuffer
+{
+    uint exclusion_bin_array[];
+};
+
+bool isInsideShape(ExclusionShape shape, vec2 position)
+{
+    if (shape.type == EXCLUSION_BOX)
+    {
+        const float half_length = length(shape.b);
+        const vec2 axis = shape.b / half_length;
+        const vec2 offset = position - shape.a;
+
+        return abs(dot(offset, axis)) <= half_length && abs(dot(offset, vec2(-axis.y, axis.x))) <= shape.radius;
+    }
+
+    const vec2 segment = shape.b - shape.a;
+    const float length_sq = dot(segment, segment);
+    const float t = length_sq > 0.0 ? clamp(dot(position - shape.a, segment) / length_sq, 0.0, 1.0) : 0.0;
+    const vec2 offset = position - (shape.a + t * segment);
+
+    return dot(offset, offset) <= shape.radius * shape.radius;
+}
+
+bool isExcluded(uint array_index, vec2 position, vec2 world_uv)
+{
+    if (u_use_exclusion_mask && texture(u_exclusion_mask, world_uv).x >= 0.5)
+        return true;
+
+    const uint bin_end = exclusion_bin_array[array_index + 1];
+    for (uint i = exclusion_bin_array[array_index]; i < bin_end; i++)
+        if (isInsideShape(exclusion_shape_array[exclusion_bin_array[i]], position))
+            return true;
+
+    return false;
+}
+)gl";
+
+} // placement::glsl
+
+#endif //PROCEDURALPLACEMENTLIB_GLSL_EXCLUSION_ZONES_HPP
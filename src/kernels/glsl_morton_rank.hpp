@@ -0,0 +1,45 @@
+#ifndef PROCEDURALPLACEMENTLIB_GLSL_MORTON_RANK_HPP
+#define PROCEDURALPLACEMENTLIB_GLSL_MORTON_RANK_HPP
+
+namespace placement::glsl {
+
+/// GLSL version of placement::getMortonRank(), to be inserted after the #version directive of a compute shader.
+constexpr auto morton_rank_source = R"gl(
+// number of cells of the grid that fall inside the square [lower, lower + side)
+uint countGridCells(uvec2 lower, uint side, uvec2 grid_size)
+{
+    const uvec2 upper = max(min(lower + side, grid_size), lower);
+    const uvec2 extent = upper - lower;
+    return extent.x * extent.y;
+}
+
+// position of a cell along the Z-order curve, skipping cells outside of the grid.
+uint getMortonRank(uvec2 cell, uvec2 grid_size)
+{
+    uint side = 1;
+    while (side < grid_size.x || side < grid_size.y)
+        side <<= 1;
+
+    uint rank = 0;
+    uvec2 origin = uvec2(0);
+
+    while (side > 1)
+    {
+        side >>= 1;
+
+        const uvec2 quadrant = uvec2(greaterThanEqual(cell - origin, uvec2(side)));
+        const uint quadrant_index = quadrant.x + 2 * quadrant.y;
+
+        for (uint i = 0; i < quadrant_index; i++)
+            rank += countGridCells(origin + uvec2(i & 1u, i >> 1u) * side, side, grid_size);
+
+        origin += quadrant * side;
+    }
+
+    return rank;
+}
+)gl";
+
+} // placement::glsl
+
+#endif //PROCEDURALPLACEMENTLIB_GLSL_MORTON_RANK_HPP
@@ -0,0 +1,53 @@
+#ifndef PROCEDURALPLACEMENTLIB_GLSL_STATISTICS_HPP
+#define PROCEDURALPLACEMENTLIB_GLSL_STATISTICS_HPP
+
+namespace placement::glsl {
+
+/**
+ * Candidate counters of the evaluation kernels (see placement::PlacementStatistics). The shader must declare
+ * `bool u_collect_statistics` beforehand. Counts are summed in shared memory, so each work group adds to the buffer
+ * once per counter.
+ */
+constexpr auto statistics_source = R"gl(
+layout(std430) restrict
+buffer StatisticsBuffer
+{
+    uint statistics_out_of_bounds_count;
+    uint statistics_excluded_count;
+};
+
+shared uint s_out_of_bounds_count;
+shared uint s_excluded_count;
+
+// must be reached by all the invocations of the work group; u_collect_statistics is uniform, so the barriers are too.
+void countCandidate(bool out_of_bounds, bool excluded)
+{
+    if (!u_collect_statistics)
+        return;
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        s_out_of_bounds_count = 0;
+        s_excluded_count = 0;
+    }
+    barrier();
+
+    if (out_of_bounds)
+        atomicAdd(s_out_of_bounds_count, 1u);
+    else if (excluded)
+        atomicAdd(s_excluded_count, 1u);
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        if (s_out_of_bounds_count > 0)
+            atomicAdd(statistics_out_of_bounds_count, s_out_of_bounds_count);
+        if (s_excluded_count > 0)
+            atomicAdd(statistics_excluded_count, s_excluded_count);
+    }
+}
+)gl";
+
+} // placement::glsl
+
+#endif //PROCEDURALPLACEMENTLIB_GLSL_STATISTICS_HPP
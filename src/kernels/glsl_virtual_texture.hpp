@@ -0,0 +1,32 @@
+#ifndef PROCEDURALPLACEMENTLIB_GLSL_VIRTUAL_TEXTURE_HPP
+#define PROCEDURALPLACEMENTLIB_GLSL_VIRTUAL_TEXTURE_HPP
+
+namespace placement::glsl {
+
+/// Virtual texture sampling (see placement::VirtualTexture), to be inserted after the #version directive of a shader.
+constexpr auto virtual_texture_source = R"gl(
+#define VIRTUAL_TEXTURE_PAGE_BORDER 1.0
+
+// sample the first channel of a virtual texture with the uv coordinates of the whole texture. Pages that are not
+// resident read as zero.
+float sampleVirtualTexture(usampler2D page_table, sampler2DArray page_cache, vec2 texture_size, vec2 uv)
+{
+    const ivec2 page_count = textureSize(page_table, 0);
+    const float stored_page_size = float(textureSize(page_cache, 0).x);
+    const float page_size = stored_page_size - 2.0 * VIRTUAL_TEXTURE_PAGE_BORDER;
+
+    const vec2 texel = clamp(uv, 0.0, 1.0) * texture_size;
+    const ivec2 page = min(ivec2(texel / page_size), page_count - 1);
+
+    const uint entry = texelFetch(page_table, page, 0).x;
+    if (entry == 0u)
+        return 0.0;
+
+    const vec2 page_texel = texel - vec2(page) * page_size + VIRTUAL_TEXTURE_PAGE_BORDER;
+    return texture(page_cache, vec3(page_texel / stored_page_size, float(entry - 1u))).x;
+}
+)gl";
+
+} // placement::glsl
+
+#endif //PROCEDURALPLACEMENTLIB_GLSL_VIRTUAL_TEXTURE_HPP
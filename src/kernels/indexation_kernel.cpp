@@ -1,12 +1,16 @@
 #include "placement/kernel/indexation_kernel.hpp"
+#include "glsl_morton_rank.hpp"
 
-static constexpr auto source_string = R"gl(
-#version 450 core
+static constexpr auto version_string = "#version 450 core\n";
 
+static constexpr auto source_string = R"gl(
 #define INVALID_INDEX 0xFFffFFff
 
 layout(local_size_x = 32) in;
 
+uniform bool u_write_cell_index;
+uniform uvec2 u_cell_grid_size;
+
 struct Candidate
 {
     vec3 position;
@@ -44,6 +48,24 @@ void writeIndex(uint array_index, uint value)
         b_index.array[array_index] = value;
 }
 
+// x: index of the first element of the cell, y: number of elements in the cell.
+layout(std430) restrict writeonly
+buffer CellIndexBuffer
+{
+    uvec2 array[];
+} b_cell_index;
+
+// each work group processes exactly the candidates of one generation work group, i.e. one cell.
+void writeCellCount(uint class_index, uint count)
+{
+    const uint cell_count = u_cell_grid_size.x * u_cell_grid_size.y;
+    if (gl_WorkGroupID.x >= cell_count)
+        return;
+
+    const uvec2 cell = uvec2(gl_WorkGroupID.x % u_cell_grid_size.x, gl_WorkGroupID.x / u_cell_grid_size.x);
+    b_cell_index.array[class_index * cell_count + getMortonRank(cell, u_cell_grid_size)].y = count;
+}
+
 shared uint s_index_array[2 * gl_WorkGroupSize.x];
 shared uint s_index_offset;
 
@@ -93,7 +115,16 @@ void main()
         addUpLocalIndexArray();
 
         if (gl_LocalInvocationIndex == 0)
-        s_index_offset = atomicAddToClassCount(i);
+        {
+            s_index_offset = atomicAddToClassCount(i);
+
+            // with a cell index, indices are relative to the start of the cell instead.
+            if (u_write_cell_index)
+            {
+                writeCellCount(i, s_index_array[2 * gl_WorkGroupSize.x - 1]);
+                s_index_offset = 0;
+            }
+        }
 
         barrier();
         memoryBarrierShared();
@@ -108,20 +139,49 @@ void main()
 )gl";
 
 namespace placement {
-IndexationKernel::IndexationKernel()
-        : m_program(source_string),
+IndexationKernel::IndexationKernel() : IndexationKernel(compile())
+{}
+
+PendingComputeShaderProgram IndexationKernel::compile()
+{
+    return PendingComputeShaderProgram(std::vector<const char*>{version_string, glsl::morton_rank_source,
+                                                                source_string});
+}
+
+IndexationKernel::IndexationKernel(PendingComputeShaderProgram &&program)
+        : m_program(std::move(program)),
+          m_write_cell_index(m_program.getUniformLocation("u_write_cell_index")),
+          m_cell_grid_size(m_program.getUniformLocation("u_cell_grid_size")),
           m_candidate_buffer(m_program.getShaderStorageBlockIndex("CandidateBuffer")),
           m_count_buffer(m_program.getShaderStorageBlockIndex("CountBuffer")),
-          m_index_buffer(m_program.getShaderStorageBlockIndex("IndexBuffer"))
+          m_index_buffer(m_program.getShaderStorageBlockIndex("IndexBuffer")),
+          m_cell_index_buffer(m_program.getShaderStorageBlockIndex("CellIndexBuffer"))
 {}
 
 void
 IndexationKernel::operator()(uint num_work_groups, uint candidate_buffer_binding_index, uint count_buffer_binding_index,
                              uint index_buffer_binding_index)
 {
+    m_program.setUniform(m_write_cell_index, 0);
+
+    m_program.setShaderStorageBlockBindingIndex(m_candidate_buffer, candidate_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_count_buffer, count_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_index_buffer, index_buffer_binding_index);
+
+    m_program.dispatch({num_work_groups, 1, 1});
+}
+
+void IndexationKernel::operator()(uint num_work_groups, glm::uvec2 cell_grid_size,
+                                  uint candidate_buffer_binding_index, uint count_buffer_binding_index,
+                                  uint index_buffer_binding_index, uint cell_index_buffer_binding_index)
+{
+    m_program.setUniform(m_write_cell_index, 1);
+    m_program.setUniform(m_cell_grid_size, cell_grid_size);
+
     m_program.setShaderStorageBlockBindingIndex(m_candidate_buffer, candidate_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_count_buffer, count_buffer_binding_index);
     m_program.setShaderStorageBlockBindingIndex(m_index_buffer, index_buffer_binding_index);
+    m_program.setShaderStorageBlockBindingIndex(m_cell_index_buffer, cell_index_buffer_binding_index);
 
     m_program.dispatch({num_work_groups, 1, 1});
 }
@@ -0,0 +1,72 @@
+#include "placement/kernel/parameter_buffer.hpp"
+#include "../gl_context.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace placement {
+
+ParameterBuffer::ParameterBuffer(GLsizeiptr size)
+{
+    GLint alignment;
+    gl.GetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_alignment = alignment;
+
+    // every segment starts at an aligned offset
+    m_segment_size = (size / static_cast<GLsizeiptr>(segment_count)) / m_alignment * m_alignment;
+    m_size = m_segment_size * static_cast<GLsizeiptr>(segment_count);
+
+    if (m_segment_size == 0)
+        throw std::invalid_argument("parameter buffer size is too small");
+
+    using SFlags = GL::Buffer::StorageFlags;
+    m_buffer.allocateImmutable(m_size, SFlags::map_write | SFlags::map_persistent | SFlags::map_coherent);
+
+    using AFlags = GL::Buffer::AccessFlags;
+    m_mapped_ptr = static_cast<std::byte*>(m_buffer.mapRange(0, m_size,
+                                                             AFlags::write | AFlags::persistent | AFlags::coherent));
+    if (!m_mapped_ptr)
+        throw std::runtime_error("GL memory mapping error!");
+}
+
+void ParameterBuffer::bind(GLuint binding_index, const void *data, GLsizeiptr size)
+{
+    if (size > m_segment_size)
+        throw std::length_error("parameter block is larger than a parameter buffer segment");
+
+    GLintptr offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+    if (offset + size > static_cast<GLintptr>(m_segment + 1) * m_segment_size)
+    {
+        m_advanceSegment();
+        offset = m_head;
+    }
+
+    std::memcpy(m_mapped_ptr + offset, data, size);
+    gl.BindBufferRange(GL_UNIFORM_BUFFER, binding_index, m_buffer.getName(), offset, size);
+
+    m_head = offset + size;
+    m_last_offset = offset;
+}
+
+void ParameterBuffer::m_advanceSegment()
+{
+    // commands reading the current segment have all been issued
+    m_segment_fences[m_segment] = GL::createFenceSync();
+
+    m_segment = (m_segment + 1) % segment_count;
+    m_head = static_cast<GLintptr>(m_segment) * m_segment_size;
+
+    if (auto &fence = m_segment_fences[m_segment])
+    {
+        using Status = GL::Sync::Status;
+        Status status;
+        do
+            status = fence->clientWait(true, std::chrono::nanoseconds::max());
+        while (status != Status::already_signaled && status != Status::condition_satisfied);
+
+        fence.reset();
+    }
+}
+
+} // placement
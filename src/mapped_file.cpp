@@ -0,0 +1,140 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace placement {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path)
+{
+    m_file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file_handle == INVALID_HANDLE_VALUE)
+    {
+        m_file_handle = nullptr;
+        throw std::runtime_error("could not open file: " + path);
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(m_file_handle, &file_size))
+    {
+        m_unmap();
+        throw std::runtime_error("could not query file size: " + path);
+    }
+    m_size = static_cast<std::size_t>(file_size.QuadPart);
+
+    // empty files can't be mapped
+    if (m_size == 0)
+        return;
+
+    m_mapping_handle = CreateFileMappingA(m_file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping_handle)
+        m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping_handle, FILE_MAP_READ, 0, 0, 0));
+
+    if (!m_data)
+    {
+        m_unmap();
+        throw std::runtime_error("could not map file: " + path);
+    }
+}
+
+void MappedFile::m_unmap() noexcept
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping_handle)
+        CloseHandle(m_mapping_handle);
+    if (m_file_handle)
+        CloseHandle(m_file_handle);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping_handle = nullptr;
+    m_file_handle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path)
+{
+    const int file_descriptor = open(path.c_str(), O_RDONLY);
+    if (file_descriptor < 0)
+        throw std::runtime_error("could not open file: " + path);
+
+    struct stat file_status {};
+    if (fstat(file_descriptor, &file_status) != 0)
+    {
+        close(file_descriptor);
+        throw std::runtime_error("could not query file size: " + path);
+    }
+    m_size = static_cast<std::size_t>(file_status.st_size);
+
+    // empty files can't be mapped
+    if (m_size > 0)
+    {
+        void *address = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        if (address == MAP_FAILED)
+        {
+            close(file_descriptor);
+            throw std::runtime_error("could not map file: " + path);
+        }
+        m_data = static_cast<const std::byte*>(address);
+    }
+
+    // the mapping stays valid after closing the file
+    close(file_descriptor);
+}
+
+void MappedFile::m_unmap() noexcept
+{
+    if (m_data)
+        munmap(const_cast<std::byte*>(m_data), m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    m_unmap();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0))
+#ifdef _WIN32
+        , m_file_handle(std::exchange(other.m_file_handle, nullptr)),
+          m_mapping_handle(std::exchange(other.m_mapping_handle, nullptr))
+#endif
+{}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        m_unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_file_handle = std::exchange(other.m_file_handle, nullptr);
+        m_mapping_handle = std::exchange(other.m_mapping_handle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+} // placement
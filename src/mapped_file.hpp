@@ -0,0 +1,39 @@
+#ifndef PROCEDURALPLACEMENTLIB_MAPPED_FILE_HPP
+#define PROCEDURALPLACEMENTLIB_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace placement {
+
+/// A read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    /// Map a file into memory. Throws std::runtime_error on failure.
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    [[nodiscard]] const std::byte *data() const { return m_data; }
+    [[nodiscard]] std::size_t size() const { return m_size; }
+
+private:
+    void m_unmap() noexcept;
+
+    const std::byte *m_data {nullptr};
+    std::size_t m_size {0};
+#ifdef _WIN32
+    void *m_file_handle {nullptr};
+    void *m_mapping_handle {nullptr};
+#endif
+};
+
+} // placement
+
+#endif //PROCEDURALPLACEMENTLIB_MAPPED_FILE_HPP
@@ -0,0 +1,72 @@
+#include "placement/placement_cache.hpp"
+
+#include <algorithm>
+
+namespace placement {
+
+namespace {
+
+Result computeOrderedPlacement(PlacementPipeline &pipeline, const WorldData &world_data, const LayerData &layer_data,
+                               glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    const auto element_order = pipeline.getElementOrder();
+    pipeline.setElementOrder(PlacementPipeline::ElementOrder::morton);
+
+    auto future_result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound);
+    pipeline.setElementOrder(element_order);
+
+    return future_result.readResult();
+}
+
+} // namespace
+
+PlacementCache::PlacementCache(PlacementPipeline &pipeline, const WorldData &world_data, const LayerData &layer_data,
+                               glm::vec2 lower_bound, glm::vec2 upper_bound)
+    : m_pipeline(pipeline),
+      m_world_data(world_data),
+      m_layer_data(layer_data),
+      m_lower_bound(lower_bound),
+      m_upper_bound(upper_bound),
+      m_result(computeOrderedPlacement(pipeline, world_data, layer_data, lower_bound, upper_bound))
+{}
+
+bool PlacementCache::m_usesTexture(GLuint texture) const
+{
+    if (texture == m_world_data.heightmap || texture == m_pipeline.getExclusionMask()
+        || texture == m_layer_data.density_map_array)
+        return true;
+
+    return std::any_of(m_layer_data.densitymaps.begin(), m_layer_data.densitymaps.end(),
+                       [texture](const DensityMap &density_map)
+                       { return !density_map.virtual_texture && density_map.texture == texture; });
+}
+
+void PlacementCache::markDirty(GLuint texture, glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    if (texture != 0 && m_usesTexture(texture))
+        markDirty(lower_bound, upper_bound);
+}
+
+void PlacementCache::markDirty(glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    // clip to the placement region, nothing outside of it is cached
+    lower_bound = glm::max(lower_bound, m_lower_bound);
+    upper_bound = glm::min(upper_bound, m_upper_bound);
+
+    if (glm::all(glm::lessThanEqual(lower_bound, upper_bound)))
+        m_dirty_regions.emplace_back(lower_bound, upper_bound);
+}
+
+const Result &PlacementCache::update()
+{
+    if (m_dirty_regions.empty())
+        return m_result;
+
+    m_result = m_pipeline.updatePlacement(m_world_data, m_layer_data, m_lower_bound, m_upper_bound, m_result,
+                                          m_dirty_regions).readResult();
+    m_dirty_regions.clear();
+
+    return m_result;
+}
+
+} // placement
@@ -0,0 +1,207 @@
+#include "placement/placement_instance_pool.hpp"
+
+#include "gl_context.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace placement {
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 5 * sizeof(std::uint32_t),
+              "DrawElementsIndirectCommand must match the layout read by glMultiDrawElementsIndirect");
+
+PlacementInstancePool::PlacementInstancePool(uint element_capacity, uint num_classes)
+    : m_element_capacity(element_capacity), m_num_classes(num_classes), m_meshes(num_classes),
+      m_command_lists(num_classes, DrawCommandList{0, 0})
+{
+    if (element_capacity == 0 || num_classes == 0)
+        throw std::invalid_argument("an instance pool must have room for at least one element and one class");
+
+    m_buffer.allocateImmutable(element_capacity * ResultElement::ssize, GL::Buffer::StorageFlags::none);
+    m_free_ranges.emplace(0, element_capacity);
+}
+
+std::optional<PlacementInstancePool::TileId> PlacementInstancePool::insert(const Result &result)
+{
+    if (result.getNumClasses() != m_num_classes)
+        throw std::invalid_argument("result and instance pool have different numbers of classes");
+
+    if (result.getLayout() != ResultLayout::array_of_structures)
+        throw std::invalid_argument("instance pools hold results with ResultLayout::array_of_structures only");
+
+    const uint element_count = result.getElementArrayLength();
+
+    uint element_offset = 0;
+    if (element_count > 0)
+    {
+        const std::optional<uint> allocation = m_allocate(element_count);
+        if (!allocation)
+            return std::nullopt;
+
+        element_offset = *allocation;
+        result.copyAll(getBuffer(), element_offset * ResultElement::ssize);
+    }
+
+    const TileId tile = m_next_tile_id++;
+    m_tiles.emplace(tile, Tile{element_offset, result.getIndexOffsets()});
+    m_commands_dirty = true;
+
+    return tile;
+}
+
+void PlacementInstancePool::erase(TileId tile)
+{
+    const auto it = m_tiles.find(tile);
+    if (it == m_tiles.end())
+        return;
+
+    m_free(it->second.element_offset, it->second.index_offsets.back());
+    m_tiles.erase(it);
+    m_commands_dirty = true;
+}
+
+void PlacementInstancePool::clear()
+{
+    m_tiles.clear();
+    m_free_ranges.clear();
+    m_free_ranges.emplace(0, m_element_capacity);
+    m_element_count = 0;
+    m_commands_dirty = true;
+}
+
+PlacementInstancePool::uint PlacementInstancePool::getTileElementOffset(TileId tile) const
+{
+    const auto it = m_tiles.find(tile);
+    if (it == m_tiles.end())
+        throw std::out_of_range("no such tile in the instance pool");
+
+    return it->second.element_offset;
+}
+
+const std::vector<PlacementInstancePool::uint> &PlacementInstancePool::getTileIndexOffsets(TileId tile) const
+{
+    const auto it = m_tiles.find(tile);
+    if (it == m_tiles.end())
+        throw std::out_of_range("no such tile in the instance pool");
+
+    return it->second.index_offsets;
+}
+
+PlacementInstancePool::uint PlacementInstancePool::getLargestFreeRange() const
+{
+    uint largest = 0;
+    for (const auto &[offset, count] : m_free_ranges)
+        largest = std::max(largest, count);
+
+    return largest;
+}
+
+void PlacementInstancePool::setClassMesh(uint class_index, MeshRange mesh)
+{
+    m_meshes.at(class_index) = mesh;
+    m_commands_dirty = true;
+}
+
+std::vector<DrawElementsIndirectCommand> PlacementInstancePool::makeDrawCommands(uint class_index) const
+{
+    const MeshRange &mesh = m_meshes.at(class_index);
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    if (mesh.index_count == 0)
+        return commands;
+
+    for (const auto &[id, tile] : m_tiles)
+    {
+        const uint instance_count = tile.index_offsets[class_index + 1] - tile.index_offsets[class_index];
+        if (instance_count > 0)
+            commands.push_back({mesh.index_count, instance_count, mesh.first_index, mesh.base_vertex,
+                                tile.element_offset + tile.index_offsets[class_index]});
+    }
+
+    return commands;
+}
+
+bool PlacementInstancePool::updateDrawCommands()
+{
+    if (!m_commands_dirty)
+        return false;
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    for (uint i = 0; i < m_num_classes; i++)
+    {
+        const std::vector<DrawElementsIndirectCommand> class_commands = makeDrawCommands(i);
+        m_command_lists[i] = {static_cast<GLintptr>(commands.size() * sizeof(DrawElementsIndirectCommand)),
+                              static_cast<GLsizei>(class_commands.size())};
+        commands.insert(commands.end(), class_commands.begin(), class_commands.end());
+    }
+
+    m_commands_dirty = false;
+
+    const auto size = static_cast<GLsizeiptr>(commands.size() * sizeof(DrawElementsIndirectCommand));
+    if (size == 0)
+        return true;
+
+    // grow geometrically, so that streaming tiles in and out doesn't reallocate the buffer every time
+    if (size > m_command_buffer_size)
+    {
+        m_command_buffer_size = std::max(size, 2 * m_command_buffer_size);
+        m_command_buffer = GL::Buffer();
+        m_command_buffer.allocateImmutable(m_command_buffer_size, GL::Buffer::StorageFlags::dynamic_storage);
+    }
+
+    gl.NamedBufferSubData(m_command_buffer.getName(), 0, size, commands.data());
+
+    return true;
+}
+
+std::optional<PlacementInstancePool::uint> PlacementInstancePool::m_allocate(uint element_count)
+{
+    auto best = m_free_ranges.end();
+    for (auto it = m_free_ranges.begin(); it != m_free_ranges.end(); ++it)
+        if (it->second >= element_count && (best == m_free_ranges.end() || it->second < best->second))
+            best = it;
+
+    if (best == m_free_ranges.end())
+        return std::nullopt;
+
+    const auto [offset, count] = *best;
+    m_free_ranges.erase(best);
+    if (count > element_count)
+        m_free_ranges.emplace(offset + element_count, count - element_count);
+
+    m_element_count += element_count;
+    return offset;
+}
+
+void PlacementInstancePool::m_free(uint element_offset, uint element_count)
+{
+    if (element_count == 0)
+        return;
+
+    m_element_count -= element_count;
+
+    auto next = m_free_ranges.lower_bound(element_offset);
+
+    // merge with the following range
+    if (next != m_free_ranges.end() && element_offset + element_count == next->first)
+    {
+        element_count += next->second;
+        next = m_free_ranges.erase(next);
+    }
+
+    // merge with the preceding range
+    if (next != m_free_ranges.begin())
+    {
+        const auto previous = std::prev(next);
+        if (previous->first + previous->second == element_offset)
+        {
+            previous->second += element_count;
+            return;
+        }
+    }
+
+    m_free_ranges.emplace_hint(next, element_offset, element_count);
+}
+
+} // placement
@@ -1,46 +1,127 @@
 #include "placement/placement_pipeline.hpp"
 #include "gl_context.hpp"
-#include "disk_distribution_generator.hpp"
 
 #include "glutils/guard.hpp"
 #include "glutils/buffer.hpp"
+#include "glutils/error.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
+#include <tuple>
 
 namespace placement {
 
 using Candidate = Result::Element;
 
+static_assert(GenerationKernel::work_group_size.x * GenerationKernel::work_group_size.y
+              == IndexationKernel::cell_capacity, "cells must contain the candidates of exactly one work group");
+
 PlacementPipeline::PlacementPipeline()
 {
+    m_generation_kernel.submit();
+    m_evaluation_kernel.submit();
+    m_indexation_kernel.submit();
+    m_copy_kernel.submit();
+
     setBaseTextureUnit(0);
     setBaseShaderStorageBindingPoint(0);
-    setRandomSeed(0);
+    setBaseUniformBufferBindingPoint(0);
+    setPatternLibrary(WorkGroupPatternLibrary::getDefault());
 }
 
-ResultBuffer PlacementPipeline::s_makeResultBuffer(uint candidate_count, uint class_count)
+bool PlacementPipeline::isReady() const
 {
-    constexpr GLsizeiptr result_element_size = sizeof(glm::vec4);
-    constexpr GLsizeiptr uint_size = sizeof(uint);
+    return m_generation_kernel.isReady() && m_evaluation_kernel.isReady() && m_indexation_kernel.isReady()
+           && m_copy_kernel.isReady();
+}
 
-    const auto size = class_count * uint_size + candidate_count * result_element_size;
+void PlacementPipeline::waitUntilReady()
+{
+    // link every kernel before throwing, so that all the logs are reported at once
+    std::string errors;
+    const auto wait = [&](auto &kernel)
+    {
+        try
+        {
+            static_cast<void>(m_getKernel(kernel));
+        }
+        catch (const GL::GLError &error)
+        {
+            errors += error.what();
+            errors += '\n';
+        }
+    };
+
+    wait(m_generation_kernel);
+    wait(m_evaluation_kernel);
+    wait(m_indexation_kernel);
+    wait(m_copy_kernel);
+
+    if (!errors.empty())
+        throw GL::GLError(errors);
+}
 
-    ResultBuffer result_buffer {class_count, size, GL::Buffer(), nullptr};
+void PlacementPipeline::setElementOrder(ElementOrder order)
+{
+    m_element_order = order;
+
+    // compile the cell scan kernel ahead of the first operation that needs it
+    if (order == ElementOrder::morton)
+        m_cell_scan_kernel.submit();
+}
+
+template<class Kernel>
+Kernel &PlacementPipeline::m_getKernel(DeferredKernel<Kernel> &kernel)
+{
+    if (Kernel *constructed = kernel.find())
+        return *constructed;
+
+    Kernel &k = kernel.get();
+    m_configure(k);
+    return k;
+}
+
+void PlacementPipeline::m_configure(GenerationKernel &kernel) const
+{
+    // virtual textures use units base + 2 and base + 3
+    kernel.setVirtualTextureUnits(m_base_tex_unit + 2, m_base_tex_unit + 3);
+    kernel.setParameterBindingIndex(m_base_uniform_binding_index);
+    kernel.setWorkGroupPatternBoundaries(m_work_group_scale);
+}
 
-    using SFlags = GL::Buffer::StorageFlags;
+void PlacementPipeline::m_configure(EvaluationKernel &kernel) const
+{
+    kernel.setVirtualTextureUnits(m_base_tex_unit + 2, m_base_tex_unit + 3);
+    kernel.setParameterBindingIndex(m_base_uniform_binding_index);
+}
 
-    GL::BufferHandle buffer = result_buffer.gl_object;
-    buffer.allocateImmutable(size, SFlags::map_read | SFlags::map_persistent | SFlags::map_coherent, nullptr);
+void PlacementPipeline::m_configure(ArrayEvaluationKernel &kernel) const
+{
+    kernel.setParameterBindingIndex(m_base_uniform_binding_index);
+}
 
-    using AFlags = GL::Buffer::AccessFlags;
-    result_buffer.mapped_ptr = static_cast<const std::byte*>(buffer.mapRange(0, size, AFlags::read | AFlags::coherent | AFlags::persistent));
+void PlacementPipeline::m_configureKernels()
+{
+    if (auto kernel = m_generation_kernel.find())
+        m_configure(*kernel);
+    if (auto kernel = m_evaluation_kernel.find())
+        m_configure(*kernel);
+    if (auto kernel = m_array_evaluation_kernel.find())
+        m_configure(*kernel);
+    for (auto &[source, kernel] : m_expression_kernels)
+        m_configure(kernel);
+}
 
-    if (!result_buffer.mapped_ptr)
-        throw std::runtime_error("GL memory mapping error!");
+ResultBuffer PlacementPipeline::s_makeResultBuffer(uint candidate_count, uint class_count, const CellGrid &cell_grid)
+{
+    constexpr GLsizeiptr result_element_size = sizeof(glm::vec4);
+    constexpr GLsizeiptr uint_size = sizeof(uint);
 
-    gl.ClearNamedBufferSubData(buffer.getName(), GL_R8, 0, class_count * uint_size, GL_RED,  GL_UNSIGNED_BYTE, nullptr);
+    const auto size = class_count * uint_size + candidate_count * result_element_size
+                      + ResultBuffer::getCellIndexBufferSize(class_count, cell_grid);
 
-    return result_buffer;
+    return makeResultBuffer(class_count, size, nullptr, cell_grid);
 }
 
 uint PlacementPipeline::m_getBindingIndex(uint buffer_index) const
@@ -50,10 +131,12 @@ uint PlacementPipeline::m_getBindingIndex(uint buffer_index) const
 
 namespace {
 
+/// Ranges of the buffers used between the stages of a placement operation, within storage reused across operations.
 struct TransientBuffer
 {
 public:
-    explicit TransientBuffer(uint candidate_count)
+    /// Reallocate @p storage if it is smaller than @p storage_size, and hand out ranges of it for @p candidate_count.
+    TransientBuffer(uint candidate_count, GL::Buffer &storage, GLsizeiptr &storage_size)
     {
         constexpr GLsizeiptr candidate_size = sizeof(float) * 4;
         m_candidate_range = allocate(candidate_count * candidate_size);
@@ -67,7 +150,13 @@ public:
         constexpr GLsizeiptr index_size = sizeof(uint);
         m_index_range = allocate(candidate_count * index_size);
 
-        m_buffer.allocateImmutable(m_size, GL::Buffer::StorageFlags::none);
+        if (storage_size < m_size)
+        {
+            storage = GL::Buffer();
+            storage.allocateImmutable(m_size, GL::Buffer::StorageFlags::none);
+            storage_size = m_size;
+        }
+        m_buffer = storage;
     }
 
     [[nodiscard]] GL::BufferHandle getBuffer() const { return m_buffer; }
@@ -81,7 +170,7 @@ public:
     [[nodiscard]] GL::Buffer::Range getIndexRange() const { return m_index_range; }
 
 private:
-    GL::Buffer m_buffer;
+    GL::BufferHandle m_buffer;
     GL::Buffer::Range m_candidate_range;
     GL::Buffer::Range m_density_range;
     GL::Buffer::Range m_world_uv_range;
@@ -104,12 +193,26 @@ enum BufferIndex
     density_buffer_index,
     index_buffer_index,
     count_buffer_index,
-    element_buffer_index
+    element_buffer_index,
+    cell_index_buffer_index,
+    exclusion_shape_buffer_index,
+    exclusion_bin_buffer_index,
+    class_parameter_buffer_index,
+    statistics_buffer_index,
+    pattern_buffer_index,
+    bounds_buffer_index
 };
 
-auto makeBindingArray(const TransientBuffer &transient_buffer, const ResultBuffer &result_buffer)
+using BufferBinding = std::pair<GL::BufferHandle, GL::Buffer::Range>;
+
+auto makeBindingArray(const TransientBuffer &transient_buffer, const ResultBuffer &result_buffer,
+                      const std::optional<BufferBinding> &exclusion_shape_binding,
+                      const std::optional<BufferBinding> &exclusion_bin_binding,
+                      const std::optional<BufferBinding> &class_parameter_binding,
+                      const std::optional<BufferBinding> &statistics_binding, const BufferBinding &pattern_binding,
+                      const std::optional<BufferBinding> &bounds_binding)
 {
-    std::array<std::pair<GL::BufferHandle, GL::Buffer::Range>, 6> array;
+    std::array<BufferBinding, PlacementPipeline::required_shader_storage_binding_points> array;
 
     array[candidate_buffer_index] = {transient_buffer.getBuffer(), transient_buffer.getCandidateRange()};
     array[world_uv_buffer_index] = {transient_buffer.getBuffer(), transient_buffer.getWorldUVRange()};
@@ -118,76 +221,925 @@ auto makeBindingArray(const TransientBuffer &transient_buffer, const ResultBuffe
     array[count_buffer_index] = {result_buffer.gl_object, result_buffer.getCountRange()};
     array[element_buffer_index] = {result_buffer.gl_object, result_buffer.getElementRange()};
 
+    // binding an empty range is an error, so the count section stands in for a missing cell index. It is never read.
+    if (result_buffer.getCellIndexBufferSize() > 0)
+        array[cell_index_buffer_index] = {result_buffer.gl_object, result_buffer.getCellIndexRange()};
+    else
+        array[cell_index_buffer_index] = {result_buffer.gl_object, result_buffer.getCountRange()};
+
+    array[exclusion_shape_buffer_index] = exclusion_shape_binding.value_or(array[count_buffer_index]);
+    array[exclusion_bin_buffer_index] = exclusion_bin_binding.value_or(array[count_buffer_index]);
+    array[class_parameter_buffer_index] = class_parameter_binding.value_or(array[count_buffer_index]);
+    array[statistics_buffer_index] = statistics_binding.value_or(array[count_buffer_index]);
+    array[pattern_buffer_index] = pattern_binding;
+    array[bounds_buffer_index] = bounds_binding.value_or(array[count_buffer_index]);
+
     return array;
 }
 
-void bindBuffers(uint base_index, const TransientBuffer& transient_buffer, const ResultBuffer& result_buffer)
+void bindBuffers(uint base_index, const TransientBuffer& transient_buffer, const ResultBuffer& result_buffer,
+                 const std::optional<BufferBinding> &exclusion_shape_binding,
+                 const std::optional<BufferBinding> &exclusion_bin_binding,
+                 const std::optional<BufferBinding> &class_parameter_binding,
+                 const std::optional<BufferBinding> &statistics_binding, const BufferBinding &pattern_binding,
+                 const std::optional<BufferBinding> &bounds_binding)
 {
-    const auto bindings = makeBindingArray(transient_buffer, result_buffer);
+    const auto bindings = makeBindingArray(transient_buffer, result_buffer, exclusion_shape_binding,
+                                           exclusion_bin_binding, class_parameter_binding, statistics_binding,
+                                           pattern_binding, bounds_binding);
 
     GL::Buffer::bindRanges(GL::Buffer::IndexedTarget::shader_storage, base_index, bindings.begin(), bindings.end());
 }
 
+/**
+ * Bind the ranges of the candidate, world uv and density buffers that hold candidates
+ * [first_candidate, first_candidate + candidate_count), and the exclusion bins of their work groups, if any. Layers
+ * start at whole work groups, whose data is always suitably aligned.
+ */
+void bindCandidateRanges(uint base_index, const TransientBuffer &transient_buffer, uint first_candidate,
+                         uint candidate_count, const std::optional<BufferBinding> &exclusion_bin_binding)
+{
+    const auto subrange = [&](GL::Buffer::Range range, GLsizeiptr element_size) -> BufferBinding
+    {
+        return {transient_buffer.getBuffer(), {range.offset + first_candidate * element_size,
+                                               candidate_count * element_size}};
+    };
+
+    const std::array<BufferBinding, 3> bindings {subrange(transient_buffer.getCandidateRange(), sizeof(float) * 4),
+                                                 subrange(transient_buffer.getWorldUVRange(), sizeof(float) * 2),
+                                                 subrange(transient_buffer.getDensityRange(), sizeof(float))};
+
+    static_assert(world_uv_buffer_index == candidate_buffer_index + 1
+                  && density_buffer_index == candidate_buffer_index + 2);
+    GL::Buffer::bindRanges(GL::Buffer::IndexedTarget::shader_storage, base_index + candidate_buffer_index,
+                           bindings.begin(), bindings.end());
+
+    if (exclusion_bin_binding)
+        GL::Buffer::bindRanges(GL::Buffer::IndexedTarget::shader_storage, base_index + exclusion_bin_buffer_index,
+                               &*exclusion_bin_binding, &*exclusion_bin_binding + 1);
+}
+
+/// Call @p f with each of the virtual textures used by a placement operation.
+template<typename F>
+void forEachVirtualTexture(const WorldData &world_data, const LayerData &layer_data, F &&f)
+{
+    if (world_data.virtual_heightmap)
+        f(*world_data.virtual_heightmap);
+
+    for (const auto &density_map : layer_data.densitymaps)
+        if (density_map.virtual_texture)
+            f(*density_map.virtual_texture);
+}
+
+/**
+ * Bin exclusion shapes by the work groups they overlap. The first num_work_groups + 1 entries of the returned array
+ * are offsets into the same array, delimiting the indices of the shapes that overlap each work group.
+ */
+std::vector<uint> binExclusionShapes(const std::vector<ExclusionShape> &shapes, glm::vec2 origin,
+                                     glm::vec2 work_group_bounds, glm::uvec2 num_work_groups)
+{
+    const uint bin_count = num_work_groups.x * num_work_groups.y;
+
+    // candidates may lie right on the boundary of their work group, so let shapes reach slightly further.
+    const glm::vec2 margin = 1e-3f * work_group_bounds;
+
+    // range of work groups overlapped by each shape, empty if the shape is outside the dispatch
+    std::vector<std::pair<glm::ivec2, glm::ivec2>> ranges;
+    ranges.reserve(shapes.size());
+    for (const auto &shape : shapes)
+    {
+        // clamped before the conversion, which is undefined for shapes too far away for the range of int. Clamping
+        // to one work group past each side keeps the range empty for shapes outside the dispatch.
+        const auto [lower_bound, upper_bound] = ExclusionZones::getBounds(shape);
+        const glm::vec2 lower = glm::floor((lower_bound - margin - origin) / work_group_bounds);
+        const glm::vec2 upper = glm::floor((upper_bound + margin - origin) / work_group_bounds);
+        ranges.emplace_back(glm::ivec2(glm::clamp(lower, glm::vec2(0.0f), glm::vec2(num_work_groups))),
+                            glm::ivec2(glm::clamp(upper, glm::vec2(-1.0f), glm::vec2(num_work_groups) - 1.0f)));
+    }
+
+    // counting sort of (bin, shape) pairs
+    std::vector<uint> bins(bin_count + 1, 0);
+    for (const auto &[lower, upper] : ranges)
+        for (int y = lower.y; y <= upper.y; y++)
+            for (int x = lower.x; x <= upper.x; x++)
+                bins[1 + y * num_work_groups.x + x]++;
+
+    bins[0] = bin_count + 1;
+    for (uint i = 1; i <= bin_count; i++)
+        bins[i] += bins[i - 1];
+
+    bins.resize(bins[bin_count]);
+
+    std::vector<uint> write_offsets(bins.begin(), bins.begin() + bin_count);
+    for (uint shape_index = 0; shape_index < ranges.size(); shape_index++)
+    {
+        const auto &[lower, upper] = ranges[shape_index];
+        for (int y = lower.y; y <= upper.y; y++)
+            for (int x = lower.x; x <= upper.x; x++)
+                bins[write_offsets[y * num_work_groups.x + x]++] = shape_index;
+    }
+
+    return bins;
+}
+
 } // namespace
 
 FutureResult PlacementPipeline::computePlacement(const WorldData &world_data, const LayerData &layer_data,
                                                  glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    m_recordRequest(world_data, &layer_data, 1, lower_bound, upper_bound);
+
+    const auto [work_group_offset, num_work_groups] = m_getWorkGroupRange(layer_data.footprint, lower_bound,
+                                                                          upper_bound);
+
+    return m_computePlacement(world_data, {{&layer_data, work_group_offset, num_work_groups}}, lower_bound,
+                              upper_bound, m_element_order == ElementOrder::morton, m_result_layout);
+}
+
+FutureResult PlacementPipeline::computePlacement(const WorldData &world_data, const std::vector<LayerData> &layers,
+                                                 glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    if (layers.empty())
+        throw std::invalid_argument("no layers to compute placement for");
+
+    if (m_element_order == ElementOrder::morton && layers.size() > 1)
+        throw std::invalid_argument("ElementOrder::morton is only supported for a single layer");
+
+    m_recordRequest(world_data, layers.data(), layers.size(), lower_bound, upper_bound);
+
+    std::vector<LayerDispatch> layer_dispatches;
+    layer_dispatches.reserve(layers.size());
+    for (const auto &layer_data : layers)
+    {
+        const auto [work_group_offset, num_work_groups] = m_getWorkGroupRange(layer_data.footprint, lower_bound,
+                                                                              upper_bound);
+        layer_dispatches.push_back({&layer_data, work_group_offset, num_work_groups});
+    }
+
+    return m_computePlacement(world_data, layer_dispatches, lower_bound, upper_bound,
+                              m_element_order == ElementOrder::morton, m_result_layout);
+}
+
+FutureResult PlacementPipeline::m_computePlacement(const WorldData &world_data,
+                                                   const std::vector<LayerDispatch> &layers,
+                                                   glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                                   bool use_cell_index, ResultLayout result_layout)
 {
     constexpr glm::uvec2 wg_size{GenerationKernel::work_group_size};
-    const glm::vec2 wg_bounds = m_work_group_scale * layer_data.footprint;
 
-    const glm::uvec2 work_group_offset{lower_bound / wg_bounds};
-    const glm::uvec3 num_work_groups = {1u + glm::uvec2((upper_bound - lower_bound) / wg_bounds), 1u};
+    // the candidates of each layer take consecutive ranges of the transient buffers, and its classes consecutive
+    // class indices, so that indexation and copy handle all layers at once
+    std::vector<uint> candidate_offsets;
+    std::vector<uint> class_offsets;
+    std::uint64_t total_candidate_count = 0;
+    uint class_count = 0;
+    for (const auto &layer : layers)
+    {
+        candidate_offsets.push_back(static_cast<uint>(total_candidate_count));
+        class_offsets.push_back(class_count);
+        total_candidate_count += std::uint64_t(layer.work_group_count.x) * layer.work_group_count.y
+                                 * wg_size.x * wg_size.y;
+        class_count += layer.layer_data->densitymaps.size();
+    }
 
-    const uint candidate_count = num_work_groups.x * num_work_groups.y * wg_size.x * wg_size.y;
+    if (total_candidate_count > std::numeric_limits<uint>::max() / sizeof(glm::vec4))
+        throw std::length_error("placement region is too large for a single dispatch, split it with a "
+                                "PlacementPlanner");
 
-    TransientBuffer transient_buffer {candidate_count};
+    const auto candidate_count = static_cast<uint>(total_candidate_count);
 
-    ResultBuffer result_buffer = s_makeResultBuffer(candidate_count, layer_data.densitymaps.size());
+    // invalid combinations are rejected before any work is done
+    for (const auto &layer : layers)
+        for (const auto &density_map : layer.layer_data->densitymaps)
+        {
+            if (layer.layer_data->density_map_array != 0 && (density_map.virtual_texture || density_map.expression))
+                throw std::invalid_argument("density map arrays can't be combined with virtual textures or "
+                                            "density expressions");
 
-    bindBuffers(m_base_binding_index, transient_buffer, result_buffer);
+            if (density_map.expression && density_map.expression->usesHeightmap() && world_data.virtual_heightmap)
+                throw std::logic_error("slope and curvature in density expressions need a regular heightmap");
+        }
 
-    // generation
-    gl.BindTextureUnit(m_base_tex_unit, world_data.heightmap);
-    m_generation_kernel(num_work_groups, work_group_offset, layer_data.footprint, world_data.scale, m_base_tex_unit,
-                        m_getBindingIndex(candidate_buffer_index), m_getBindingIndex(world_uv_buffer_index),
-                        m_getBindingIndex(density_buffer_index));
+    // the first operation waits for the kernels submitted by the constructor
+    IndexationKernel &indexation_kernel = m_getKernel(m_indexation_kernel);
+    CopyKernel &copy_kernel = m_getKernel(m_copy_kernel);
+
+    TraceContext trace;
+    if (m_trace_sink)
+    {
+        m_gpu_trace.collect(*m_trace_sink);
+        m_gpu_trace.calibrate();
+        trace = {m_trace_sink, ++m_request_count};
+    }
+
+    // GPU span of a stage, around the commands submitted by @p dispatch
+    const auto traceStage = [&](const char *name, auto &&dispatch)
+    {
+        if (!trace.sink)
+            return dispatch();
+
+        // the span must be ended for later ones to become available
+        const auto span = m_gpu_trace.begin(name, trace.request_id);
+        try
+        {
+            dispatch();
+        }
+        catch (...)
+        {
+            m_gpu_trace.end(span);
+            throw;
+        }
+        m_gpu_trace.end(span);
+    };
+
+    // virtual textures, each made resident once over the dispatch regions of all the layers that sample it, since
+    // requesting the region of a layer may evict pages that only the region of a previous layer covers
+    ScopedTraceSpan residency_span {trace, "make resident"};
+    struct ResidentRegion
+    {
+        VirtualTexture *texture;
+        glm::vec2 uv_lower_bound;
+        glm::vec2 uv_upper_bound;
+    };
+    std::vector<ResidentRegion> resident_regions;
+
+    for (const auto &[layer_data, work_group_offset, work_group_count] : layers)
+    {
+        const glm::vec2 wg_bounds = m_work_group_scale * layer_data->footprint;
+        const glm::vec2 world_size {world_data.scale};
+        const glm::vec2 uv_lower_bound = glm::vec2(work_group_offset) * wg_bounds / world_size;
+        const glm::vec2 uv_upper_bound = glm::vec2(work_group_offset + work_group_count) * wg_bounds / world_size;
+        forEachVirtualTexture(world_data, *layer_data, [&](VirtualTexture &texture)
+        {
+            const auto region = std::find_if(resident_regions.begin(), resident_regions.end(),
+                                             [&](const ResidentRegion &r) { return r.texture == &texture; });
+            if (region == resident_regions.end())
+                resident_regions.push_back({&texture, uv_lower_bound, uv_upper_bound});
+            else
+            {
+                region->uv_lower_bound = glm::min(region->uv_lower_bound, uv_lower_bound);
+                region->uv_upper_bound = glm::max(region->uv_upper_bound, uv_upper_bound);
+            }
+        });
+    }
+
+    for (const auto &[texture, uv_lower_bound, uv_upper_bound] : resident_regions)
+        texture->makeResident(uv_lower_bound, uv_upper_bound);
+
+    residency_span.end();
+
+    ScopedTraceSpan allocation_span {trace, "allocate buffers"};
+
+    // the transient buffer is reused by the next operation, once this one is done with it
     gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    TransientBuffer transient_buffer {candidate_count, m_transient_buffer, m_transient_buffer_size};
 
-    // evaluation
-    const uint class_count = layer_data.densitymaps.size();
-    for (std::size_t i = 0; i < class_count; i++)
+    // each cell of the index corresponds to a single generation work group, of the only layer
+    const glm::vec2 first_wg_bounds = m_work_group_scale * layers.front().layer_data->footprint;
+    const CellGrid cell_grid = use_cell_index ? CellGrid{glm::vec2(layers.front().work_group_offset) * first_wg_bounds,
+                                                         first_wg_bounds, layers.front().work_group_count}
+                                              : CellGrid{};
+
+    ResultBuffer result_buffer = s_makeResultBuffer(candidate_count, class_count, cell_grid);
+    result_buffer.layout = result_layout;
+
+    allocation_span.end();
+
+    ScopedTraceSpan upload_span {trace, "upload parameters"};
+
+    // exclusion zones, binned by the work groups of each layer
+    const bool test_exclusion_zones = !m_exclusion_zones.empty() || m_exclusion_mask != 0;
+    std::vector<GL::Buffer> exclusion_bin_buffers(layers.size());
+    std::vector<std::optional<BufferBinding>> exclusion_bin_bindings(layers.size());
+    std::optional<BufferBinding> exclusion_shape_binding;
+
+    if (test_exclusion_zones)
     {
-        gl.BindTextureUnit(m_base_tex_unit, layer_data.densitymaps[i].texture);
-        m_evaluation_kernel(num_work_groups, work_group_offset, i, lower_bound, upper_bound, m_base_tex_unit,
-                            layer_data.densitymaps[i],
-                            m_getBindingIndex(candidate_buffer_index),
-                            m_getBindingIndex(world_uv_buffer_index),
-                            m_getBindingIndex(density_buffer_index));
-        gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        for (std::size_t i = 0; i < layers.size(); i++)
+        {
+            const auto &[layer_data, work_group_offset, work_group_count] = layers[i];
+            const glm::vec2 wg_bounds = m_work_group_scale * layer_data->footprint;
+
+            const auto bins = binExclusionShapes(m_exclusion_zones.getShapes(),
+                                                 glm::vec2(work_group_offset) * wg_bounds, wg_bounds,
+                                                 work_group_count);
+            const auto bins_size = static_cast<GLsizeiptr>(bins.size() * sizeof(uint));
+            exclusion_bin_buffers[i].allocateImmutable(bins_size, GL::Buffer::StorageFlags::none, bins.data());
+            exclusion_bin_bindings[i] = BufferBinding{exclusion_bin_buffers[i], {0, bins_size}};
+        }
+
+        if (!m_exclusion_zones.empty())
+        {
+            const auto shapes_size = static_cast<GLsizeiptr>(m_exclusion_zones.size() * sizeof(ExclusionShape));
+            exclusion_shape_binding = BufferBinding{m_exclusion_shape_buffer, {0, shapes_size}};
+        }
     }
 
-    // indexation
-    m_indexation_kernel(IndexationKernel::calculateNumWorkGroups(candidate_count),
+    // per-class density map parameters, read by the single dispatch evaluating a density map array
+    GL::Buffer class_parameter_buffer;
+    std::optional<BufferBinding> class_parameter_binding;
+
+    const bool use_density_map_array = std::any_of(layers.begin(), layers.end(), [](const LayerDispatch &layer)
+    {
+        return layer.layer_data->density_map_array != 0 && !layer.layer_data->densitymaps.empty();
+    });
+
+    if (use_density_map_array)
+    {
+        // indexed by class, across all layers
+        std::vector<glm::vec4> class_parameters;
+        class_parameters.reserve(class_count);
+        for (const auto &layer : layers)
+            for (const auto &density_map : layer.layer_data->densitymaps)
+                class_parameters.emplace_back(density_map.scale, density_map.offset, density_map.min_value,
+                                              density_map.max_value);
+
+        const auto class_parameters_size = static_cast<GLsizeiptr>(class_parameters.size() * sizeof(glm::vec4));
+        class_parameter_buffer.allocateImmutable(class_parameters_size, GL::Buffer::StorageFlags::none,
+                                                 class_parameters.data());
+        class_parameter_binding = BufferBinding{class_parameter_buffer, {0, class_parameters_size}};
+    }
+
+    // candidate counters, plus a copy of the count section made once the result is complete
+    std::shared_ptr<StatisticsBuffer> statistics;
+    std::optional<BufferBinding> statistics_binding;
+
+    if (m_collect_statistics)
+    {
+        PlacementStatistics issued;
+        issued.operation_count = 1;
+        issued.candidate_count = candidate_count;
+        issued.element_capacity = result_buffer.getElementCapacity();
+        issued.class_element_counts.resize(class_count);
+
+        statistics = makeStatisticsBuffer(std::move(issued));
+        statistics_binding = BufferBinding{statistics->gl_object, {0, StatisticsBuffer::count_offset}};
+    }
+
+    // boxes of the classes, and of the classes in each cell, grown by the copy kernel
+    std::shared_ptr<BoundsBuffer> bounds;
+    std::optional<BufferBinding> bounds_binding;
+
+    if (m_compute_bounds && class_count > 0)
+    {
+        bounds = makeBoundsBuffer(class_count, use_cell_index ? cell_grid.getCellCount() : 0);
+        bounds_binding = BufferBinding{bounds->gl_object, {0, bounds->getSize()}};
+    }
+
+    bindBuffers(m_base_binding_index, transient_buffer, result_buffer, exclusion_shape_binding,
+                exclusion_bin_bindings.front(), class_parameter_binding, statistics_binding,
+                BufferBinding{m_pattern_buffer, {0, m_pattern_buffer_size}}, bounds_binding);
+
+    if (m_exclusion_mask != 0)
+        gl.BindTextureUnit(m_base_tex_unit + 1, m_exclusion_mask);
+
+    upload_span.end();
+
+    ScopedTraceSpan dispatch_span {trace, "dispatch"};
+
+    for (std::size_t i = 0; i < layers.size(); i++)
+    {
+        const auto &[layer_data, work_group_offset, work_group_count] = layers[i];
+        const uint layer_candidate_count = work_group_count.x * work_group_count.y * wg_size.x * wg_size.y;
+
+        if (layers.size() > 1)
+            bindCandidateRanges(m_base_binding_index, transient_buffer, candidate_offsets[i], layer_candidate_count,
+                                exclusion_bin_bindings[i]);
+
+        traceStage("generate", [&]()
+        {
+            m_generateCandidates(world_data, *layer_data, work_group_offset, work_group_count);
+        });
+        traceStage("evaluate", [&]()
+        {
+            m_evaluateCandidates(world_data, *layer_data, class_offsets[i], lower_bound, upper_bound,
+                                 work_group_offset, work_group_count, test_exclusion_zones);
+        });
+    }
+
+    // indexation and copy see the candidates of all layers
+    if (layers.size() > 1)
+        bindCandidateRanges(m_base_binding_index, transient_buffer, 0, candidate_count, std::nullopt);
+
+    copy_kernel.setResultLayout(result_layout);
+
+    const std::optional<GLuint> bounds_binding_index =
+            bounds ? std::optional<GLuint>(m_getBindingIndex(bounds_buffer_index)) : std::nullopt;
+
+    if (use_cell_index)
+    {
+        CellScanKernel &cell_scan_kernel = m_getKernel(m_cell_scan_kernel);
+
+        traceStage("index", [&]()
+        {
+            // indexation
+            indexation_kernel(IndexationKernel::calculateNumWorkGroups(candidate_count), cell_grid.size,
+                              m_getBindingIndex(candidate_buffer_index), m_getBindingIndex(count_buffer_index),
+                              m_getBindingIndex(index_buffer_index), m_getBindingIndex(cell_index_buffer_index));
+            gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            // cell offsets
+            cell_scan_kernel(class_count, cell_grid.getCellCount(), m_getBindingIndex(cell_index_buffer_index));
+            gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        });
+
+        // copy
+        traceStage("copy", [&]()
+        {
+            copy_kernel(CopyKernel::calculateNumWorkGroups(candidate_count), cell_grid.size,
                         m_getBindingIndex(candidate_buffer_index), m_getBindingIndex(count_buffer_index),
-                        m_getBindingIndex(index_buffer_index));
-    gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                        m_getBindingIndex(index_buffer_index), m_getBindingIndex(cell_index_buffer_index),
+                        m_getBindingIndex(element_buffer_index), bounds_binding_index);
+        });
+    }
+    else
+    {
+        // indexation
+        traceStage("index", [&]()
+        {
+            indexation_kernel(IndexationKernel::calculateNumWorkGroups(candidate_count),
+                              m_getBindingIndex(candidate_buffer_index), m_getBindingIndex(count_buffer_index),
+                              m_getBindingIndex(index_buffer_index));
+            gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        });
+
+        // copy
+        traceStage("copy", [&]()
+        {
+            copy_kernel(CopyKernel::calculateNumWorkGroups(candidate_count),
+                        m_getBindingIndex(candidate_buffer_index), m_getBindingIndex(count_buffer_index),
+                        m_getBindingIndex(index_buffer_index), m_getBindingIndex(element_buffer_index),
+                        bounds_binding_index);
+        });
+    }
+
+    if (statistics && class_count > 0)
+    {
+        gl.MemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        GL::Buffer::copy(result_buffer.gl_object, statistics->gl_object, result_buffer.getCountBufferOffset(),
+                         StatisticsBuffer::count_offset, result_buffer.getCountBufferSize());
+    }
 
-    // copy
-    m_copy_kernel(CopyKernel::calculateNumWorkGroups(candidate_count), m_getBindingIndex(candidate_buffer_index),
-                  m_getBindingIndex(count_buffer_index), m_getBindingIndex(index_buffer_index),
-                  m_getBindingIndex(element_buffer_index));
+    // fences signal in order, so the statistics are complete once the result is
+    if (statistics)
+    {
+        m_collectStatistics();
+        m_pending_statistics.emplace_back(statistics, GL::createFenceSync());
+    }
 
     // fence
     auto fence = GL::createFenceSync();
     gl.Flush();
 
-    return {std::move(result_buffer), std::move(fence)};
+    dispatch_span.end();
+
+    return {std::move(result_buffer), std::move(fence), std::move(statistics), std::move(bounds), std::move(trace)};
+}
+
+void PlacementPipeline::m_generateCandidates(const WorldData &world_data, const LayerData &layer_data,
+                                             glm::uvec2 work_group_offset, glm::uvec2 work_group_count)
+{
+    const glm::uvec3 num_work_groups = {work_group_count, 1u};
+    const std::uint32_t seed = layer_data.seed.value_or(m_random_seed);
+    GenerationKernel &generation_kernel = m_getKernel(m_generation_kernel);
+
+    if (world_data.virtual_heightmap)
+    {
+        gl.BindTextureUnit(m_base_tex_unit + 2, world_data.virtual_heightmap->getPageTable());
+        gl.BindTextureUnit(m_base_tex_unit + 3, world_data.virtual_heightmap->getPageCache());
+        generation_kernel(num_work_groups, work_group_offset, layer_data.footprint, world_data.scale, seed,
+                          *world_data.virtual_heightmap, m_getBindingIndex(pattern_buffer_index),
+                          m_getBindingIndex(candidate_buffer_index), m_getBindingIndex(world_uv_buffer_index),
+                          m_getBindingIndex(density_buffer_index));
+    }
+    else
+    {
+        gl.BindTextureUnit(m_base_tex_unit, world_data.heightmap);
+        generation_kernel(num_work_groups, work_group_offset, layer_data.footprint, world_data.scale, seed,
+                          m_base_tex_unit, m_getBindingIndex(pattern_buffer_index),
+                          m_getBindingIndex(candidate_buffer_index), m_getBindingIndex(world_uv_buffer_index),
+                          m_getBindingIndex(density_buffer_index));
+    }
+    gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void PlacementPipeline::m_evaluateCandidates(const WorldData &world_data, const LayerData &layer_data,
+                                             uint class_offset, glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                             glm::uvec2 work_group_offset, glm::uvec2 work_group_count,
+                                             bool test_exclusion_zones)
+{
+    const glm::uvec3 num_work_groups = {work_group_count, 1u};
+    const uint class_count = layer_data.densitymaps.size();
+
+    if (layer_data.density_map_array != 0 && class_count > 0)
+    {
+        // all classes at once, sampling slice i of the array for class i
+        ArrayEvaluationKernel &array_evaluation_kernel = m_getKernel(m_array_evaluation_kernel);
+        gl.BindTextureUnit(m_base_tex_unit, layer_data.density_map_array);
+
+        const std::optional<GLuint> statistics_binding =
+                m_collect_statistics ? std::optional<GLuint>(m_getBindingIndex(statistics_buffer_index)) : std::nullopt;
+
+        if (test_exclusion_zones)
+            array_evaluation_kernel(num_work_groups, work_group_offset, class_offset, class_count, lower_bound,
+                                    upper_bound, m_base_tex_unit,
+                                    m_getBindingIndex(class_parameter_buffer_index),
+                                    m_getBindingIndex(candidate_buffer_index),
+                                    m_getBindingIndex(world_uv_buffer_index),
+                                    m_getBindingIndex(density_buffer_index),
+                                    m_getBindingIndex(exclusion_shape_buffer_index),
+                                    m_getBindingIndex(exclusion_bin_buffer_index),
+                                    m_exclusion_mask != 0 ? std::optional<GLuint>(m_base_tex_unit + 1)
+                                                          : std::nullopt,
+                                    statistics_binding);
+        else
+            array_evaluation_kernel(num_work_groups, work_group_offset, class_offset, class_count, lower_bound,
+                                    upper_bound, m_base_tex_unit,
+                                    m_getBindingIndex(class_parameter_buffer_index),
+                                    m_getBindingIndex(candidate_buffer_index),
+                                    m_getBindingIndex(world_uv_buffer_index),
+                                    m_getBindingIndex(density_buffer_index), statistics_binding);
+        gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        return;
+    }
+
+    for (std::size_t i = 0; i < class_count; i++)
+    {
+        const DensityMap &density_map = layer_data.densitymaps[i];
+
+        if (const VirtualTexture *virtual_texture = density_map.virtual_texture)
+        {
+            gl.BindTextureUnit(m_base_tex_unit + 2, virtual_texture->getPageTable());
+            gl.BindTextureUnit(m_base_tex_unit + 3, virtual_texture->getPageCache());
+        }
+        else
+            gl.BindTextureUnit(m_base_tex_unit, density_map.texture);
+
+        EvaluationKernel &evaluation_kernel = density_map.expression ? m_getExpressionKernel(*density_map.expression)
+                                                                     : m_getKernel(m_evaluation_kernel);
+        if (density_map.expression)
+        {
+            // a virtual heightmap has been rejected upfront
+            if (density_map.expression->usesHeightmap())
+                gl.BindTextureUnit(m_base_tex_unit + 4, world_data.heightmap);
+            evaluation_kernel.setExpressionInputs(m_base_tex_unit + 4, world_data.scale);
+        }
+
+        // candidates are counted once, by the first evaluation
+        const std::optional<GLuint> statistics_binding =
+                m_collect_statistics && i == 0 ? std::optional<GLuint>(m_getBindingIndex(statistics_buffer_index))
+                                               : std::nullopt;
+
+        // excluded candidates are rejected for all classes by the first evaluation
+        if (test_exclusion_zones && i == 0)
+            evaluation_kernel(num_work_groups, work_group_offset, class_offset + i, lower_bound, upper_bound,
+                              m_base_tex_unit, density_map,
+                              m_getBindingIndex(candidate_buffer_index),
+                              m_getBindingIndex(world_uv_buffer_index),
+                              m_getBindingIndex(density_buffer_index),
+                              m_getBindingIndex(exclusion_shape_buffer_index),
+                              m_getBindingIndex(exclusion_bin_buffer_index),
+                              m_exclusion_mask != 0 ? std::optional<GLuint>(m_base_tex_unit + 1) : std::nullopt,
+                              statistics_binding);
+        else
+            evaluation_kernel(num_work_groups, work_group_offset, class_offset + i, lower_bound, upper_bound,
+                              m_base_tex_unit, density_map,
+                              m_getBindingIndex(candidate_buffer_index),
+                              m_getBindingIndex(world_uv_buffer_index),
+                              m_getBindingIndex(density_buffer_index), statistics_binding);
+        gl.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+FutureResult PlacementPipeline::updatePlacement(const WorldData &world_data, const LayerData &layer_data,
+                                                glm::vec2 lower_bound, glm::vec2 upper_bound, const Result &previous,
+                                                const std::vector<Rectangle> &dirty_regions)
+{
+    const glm::vec2 wg_bounds = m_work_group_scale * layer_data.footprint;
+    const auto [work_group_offset, num_work_groups] = m_getWorkGroupRange(layer_data.footprint, lower_bound,
+                                                                          upper_bound);
+
+    if (!previous.hasCellIndex())
+        throw std::invalid_argument("incremental updates need a result computed with ElementOrder::morton");
+
+    const CellGrid &grid = previous.getCellGrid();
+    if (grid.size != num_work_groups || grid.cell_size != wg_bounds
+        || previous.getNumClasses() != layer_data.densitymaps.size())
+        throw std::invalid_argument("previous result does not match the placement region");
+
+    // dirty cells, i.e. work groups, as [lower, upper) ranges
+    std::vector<std::pair<glm::uvec2, glm::uvec2>> ranges;
+    for (const auto &[dirty_lower_bound, dirty_upper_bound] : dirty_regions)
+    {
+        const glm::vec2 lower = glm::floor((dirty_lower_bound - grid.origin) / wg_bounds);
+        const glm::vec2 upper = glm::floor((dirty_upper_bound - grid.origin) / wg_bounds) + 1.0f;
+
+        const glm::uvec2 lower_cell {glm::clamp(lower, glm::vec2(0.0f), glm::vec2(grid.size))};
+        const glm::uvec2 upper_cell {glm::clamp(upper, glm::vec2(0.0f), glm::vec2(grid.size))};
+
+        if (glm::all(glm::lessThan(lower_cell, upper_cell)))
+            ranges.emplace_back(lower_cell, upper_cell);
+    }
+
+    // merge overlapping ranges, so that no work group is computed twice
+    for (bool merged = true; merged;)
+    {
+        merged = false;
+        for (std::size_t i = 0; i < ranges.size() && !merged; i++)
+            for (std::size_t j = i + 1; j < ranges.size() && !merged; j++)
+            {
+                auto &[lower_i, upper_i] = ranges[i];
+                const auto &[lower_j, upper_j] = ranges[j];
+                if (glm::all(glm::lessThan(lower_i, upper_j)) && glm::all(glm::lessThan(lower_j, upper_i)))
+                {
+                    lower_i = glm::min(lower_i, lower_j);
+                    upper_i = glm::max(upper_i, upper_j);
+                    ranges.erase(ranges.begin() + static_cast<std::ptrdiff_t>(j));
+                    merged = true;
+                }
+            }
+    }
+
+    // the patches are spliced once they are all ready, so that the update doesn't block
+    std::vector<FutureResultPatch> patches;
+    patches.reserve(ranges.size());
+    for (const auto &[lower_cell, upper_cell] : ranges)
+        patches.push_back({m_computePlacement(world_data, {{&layer_data, work_group_offset + lower_cell,
+                                                            upper_cell - lower_cell}},
+                                              lower_bound, upper_bound, true, previous.getLayout()),
+                           lower_cell});
+
+    return spliceResults(previous, std::move(patches));
+}
+
+TileGrid PlacementPipeline::makeTileGrid(float footprint, glm::vec2 lower_bound, glm::vec2 upper_bound,
+                                         glm::uvec2 tile_size) const
+{
+    if (glm::any(glm::equal(tile_size, glm::uvec2(0u))))
+        throw std::invalid_argument("tiles must contain at least one work group");
+
+    const auto [work_group_offset, num_work_groups] = m_getWorkGroupRange(footprint, lower_bound, upper_bound);
+
+    return {lower_bound, upper_bound, m_work_group_scale * footprint, work_group_offset, num_work_groups, tile_size};
+}
+
+FutureResult PlacementPipeline::computeTile(const WorldData &world_data, const LayerData &layer_data,
+                                            const TileGrid &grid, glm::uvec2 tile)
+{
+    if (grid.work_group_bounds != m_work_group_scale * layer_data.footprint)
+        throw std::invalid_argument("tile grid does not match the footprint or random seed");
+
+    if (glm::any(glm::greaterThanEqual(tile, grid.getTileCount())))
+        throw std::invalid_argument("tile lies outside of the tile grid");
+
+    const auto [work_group_offset, num_work_groups] = grid.getTileWorkGroupRange(tile);
+    const auto [lower_bound, upper_bound] = grid.getTileBounds(tile);
+
+    return m_computePlacement(world_data, {{&layer_data, work_group_offset, num_work_groups}}, lower_bound,
+                              upper_bound, m_element_order == ElementOrder::morton, m_result_layout);
+}
+
+const PlacementStatistics &PlacementPipeline::getStatistics()
+{
+    m_collectStatistics();
+    return m_statistics;
+}
+
+void PlacementPipeline::m_collectStatistics()
+{
+    // operations complete in submission order
+    auto it = m_pending_statistics.begin();
+    for (; it != m_pending_statistics.end(); ++it)
+    {
+        const auto status = it->second.clientWait(false, std::chrono::nanoseconds::zero());
+        if (status != GL::Sync::Status::already_signaled && status != GL::Sync::Status::condition_satisfied)
+            break;
+
+        m_statistics += it->first->read();
+    }
+    m_pending_statistics.erase(m_pending_statistics.begin(), it);
+}
+
+void PlacementPipeline::resetStatistics()
+{
+    m_statistics = {};
+    m_pending_statistics.clear();
+}
+
+void PlacementPipeline::setTraceSink(std::shared_ptr<TraceSink> sink)
+{
+    flushTrace();
+    m_gpu_trace.clear();
+    m_trace_sink = std::move(sink);
+}
+
+void PlacementPipeline::flushTrace()
+{
+    if (m_trace_sink)
+        m_gpu_trace.collect(*m_trace_sink);
+}
+
+void PlacementPipeline::m_recordRequest(const WorldData &world_data, const LayerData *layers, std::size_t layer_count,
+                                        glm::vec2 lower_bound, glm::vec2 upper_bound) const
+{
+    if (!m_request_recorder)
+        return;
+
+    RecordedRequest request {m_request_recorder->getTime(), world_data.scale, lower_bound, upper_bound,
+                             m_element_order == ElementOrder::morton, {}};
+
+    for (std::size_t i = 0; i < layer_count; i++)
+    {
+        RecordedLayer &layer = request.layers.emplace_back();
+        layer.footprint = layers[i].footprint;
+        layer.seed = layers[i].seed.value_or(m_random_seed);
+
+        for (const auto &density_map : layers[i].densitymaps)
+            layer.density_maps.push_back({density_map.texture, density_map.scale, density_map.offset,
+                                          density_map.min_value, density_map.max_value,
+                                          density_map.virtual_texture != nullptr, density_map.expression != nullptr});
+    }
+
+    m_request_recorder->record(std::move(request));
+}
+
+PlacementPipeline::GPUTraceRecorder::GPUTraceRecorder(GPUTraceRecorder &&other) noexcept
+    : m_pending_spans(std::move(other.m_pending_spans)),
+      m_free_queries(std::move(other.m_free_queries)),
+      m_cpu_reference(other.m_cpu_reference),
+      m_gpu_reference(other.m_gpu_reference)
+{
+    other.m_pending_spans.clear();
+    other.m_free_queries.clear();
+}
+
+PlacementPipeline::GPUTraceRecorder &PlacementPipeline::GPUTraceRecorder::operator=(GPUTraceRecorder &&other) noexcept
+{
+    std::swap(m_pending_spans, other.m_pending_spans);
+    std::swap(m_free_queries, other.m_free_queries);
+    m_cpu_reference = other.m_cpu_reference;
+    m_gpu_reference = other.m_gpu_reference;
+    return *this;
+}
+
+PlacementPipeline::GPUTraceRecorder::~GPUTraceRecorder()
+{
+    clear();
+    if (!m_free_queries.empty())
+        gl.DeleteQueries(static_cast<GLsizei>(m_free_queries.size()), m_free_queries.data());
+}
+
+void PlacementPipeline::GPUTraceRecorder::calibrate()
+{
+    GLint64 gpu_time;
+    gl.GetInteger64v(GL_TIMESTAMP, &gpu_time);
+    m_cpu_reference = TraceSpan::Clock::now();
+    m_gpu_reference = gpu_time;
+}
+
+GLuint PlacementPipeline::GPUTraceRecorder::m_acquireQuery()
+{
+    if (m_free_queries.empty())
+    {
+        GLuint query;
+        gl.CreateQueries(GL_TIMESTAMP, 1, &query);
+        return query;
+    }
+
+    const GLuint query = m_free_queries.back();
+    m_free_queries.pop_back();
+    return query;
+}
+
+std::size_t PlacementPipeline::GPUTraceRecorder::begin(const char *name, std::uint64_t request_id)
+{
+    const GLuint begin_query = m_acquireQuery();
+    gl.QueryCounter(begin_query, GL_TIMESTAMP);
+
+    m_pending_spans.push_back({name, request_id, begin_query, m_acquireQuery(), m_cpu_reference, m_gpu_reference});
+    return m_pending_spans.size() - 1;
+}
+
+void PlacementPipeline::GPUTraceRecorder::end(std::size_t span)
+{
+    gl.QueryCounter(m_pending_spans[span].end_query, GL_TIMESTAMP);
+}
+
+void PlacementPipeline::GPUTraceRecorder::collect(TraceSink &sink)
+{
+    // timestamps become available in submission order
+    auto it = m_pending_spans.begin();
+    for (; it != m_pending_spans.end(); ++it)
+    {
+        GLint available;
+        gl.GetQueryObjectiv(it->end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 begin_time, end_time;
+        gl.GetQueryObjectui64v(it->begin_query, GL_QUERY_RESULT, &begin_time);
+        gl.GetQueryObjectui64v(it->end_query, GL_QUERY_RESULT, &end_time);
+
+        const auto toHostTime = [&](GLuint64 gpu_time)
+        {
+            const std::chrono::nanoseconds offset {static_cast<std::int64_t>(gpu_time) - it->gpu_reference};
+            return it->cpu_reference + std::chrono::duration_cast<TraceSpan::Clock::duration>(offset);
+        };
+
+        sink.addSpan({it->name, it->request_id, TraceSpan::Timeline::gpu, {}, toHostTime(begin_time),
+                      toHostTime(end_time)});
+
+        m_free_queries.push_back(it->begin_query);
+        m_free_queries.push_back(it->end_query);
+    }
+    m_pending_spans.erase(m_pending_spans.begin(), it);
+}
+
+void PlacementPipeline::GPUTraceRecorder::clear()
+{
+    for (const auto &span : m_pending_spans)
+    {
+        m_free_queries.push_back(span.begin_query);
+        m_free_queries.push_back(span.end_query);
+    }
+    m_pending_spans.clear();
+}
+
+void PlacementPipeline::releaseTransientBuffer()
+{
+    m_transient_buffer = GL::Buffer();
+    m_transient_buffer_size = 0;
+}
+
+void PlacementPipeline::setExclusionZones(ExclusionZones exclusion_zones)
+{
+    m_exclusion_zones = std::move(exclusion_zones);
+    m_exclusion_shape_buffer = GL::Buffer();
+
+    if (m_exclusion_zones.empty())
+        return;
+
+    const auto &shapes = m_exclusion_zones.getShapes();
+    m_exclusion_shape_buffer.allocateImmutable(static_cast<GLsizeiptr>(shapes.size() * sizeof(ExclusionShape)),
+                                               GL::Buffer::StorageFlags::none, shapes.data());
+}
+
+bool PlacementPipeline::requestResidency(const WorldData &world_data, const LayerData &layer_data,
+                                         glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    const auto [dispatch_lower_bound, dispatch_upper_bound] = m_getDispatchBounds(layer_data.footprint, lower_bound,
+                                                                                  upper_bound);
+    const glm::vec2 world_size {world_data.scale};
+
+    bool resident = true;
+    forEachVirtualTexture(world_data, layer_data, [&](VirtualTexture &texture)
+    {
+        texture.update();
+        resident &= texture.request(dispatch_lower_bound / world_size, dispatch_upper_bound / world_size);
+    });
+
+    return resident;
+}
+
+std::pair<glm::uvec2, glm::uvec2> PlacementPipeline::m_getWorkGroupRange(float footprint, glm::vec2 lower_bound,
+                                                                         glm::vec2 upper_bound) const
+{
+    const glm::vec2 wg_bounds = m_work_group_scale * footprint;
+
+    const glm::uvec2 work_group_offset{lower_bound / wg_bounds};
+    const glm::uvec2 num_work_groups = 1u + glm::uvec2((upper_bound - lower_bound) / wg_bounds);
+
+    return {work_group_offset, num_work_groups};
+}
+
+std::pair<glm::vec2, glm::vec2> PlacementPipeline::m_getDispatchBounds(float footprint, glm::vec2 lower_bound,
+                                                                       glm::vec2 upper_bound) const
+{
+    const glm::vec2 wg_bounds = m_work_group_scale * footprint;
+    const auto [work_group_offset, num_work_groups] = m_getWorkGroupRange(footprint, lower_bound, upper_bound);
+
+    return {glm::vec2(work_group_offset) * wg_bounds, glm::vec2(work_group_offset + num_work_groups) * wg_bounds};
 }
 
 void PlacementPipeline::setBaseTextureUnit(GLuint index)
 {
     m_base_tex_unit = index;
+    m_configureKernels();
+}
+
+EvaluationKernel &PlacementPipeline::m_getExpressionKernel(const DensityExpression &expression)
+{
+    const std::string &source = expression.compileGLSL();
+
+    auto it = m_expression_kernels.find(source);
+    if (it == m_expression_kernels.end())
+    {
+        it = m_expression_kernels.emplace(std::piecewise_construct, std::forward_as_tuple(source),
+                                          std::forward_as_tuple(expression)).first;
+        m_configure(it->second);
+    }
+
+    return it->second;
 }
 
 void PlacementPipeline::setBaseShaderStorageBindingPoint(GLuint index)
@@ -195,22 +1147,27 @@ void PlacementPipeline::setBaseShaderStorageBindingPoint(GLuint index)
     m_base_binding_index = index;
 }
 
-void PlacementPipeline::setRandomSeed(uint seed)
+void PlacementPipeline::setBaseUniformBufferBindingPoint(GLuint index)
 {
-    constexpr auto wg_size = GenerationKernel::work_group_size;
+    m_base_uniform_binding_index = index;
 
-    DiskDistributionGenerator generator{1.0f, wg_size * 2u};
-    generator.setSeed(seed);
-    generator.setMaxAttempts(100);
-    m_work_group_scale = generator.getGrid().getBounds();
-    m_generation_kernel.setWorkGroupPatternBoundaries(m_work_group_scale);
+    // dispatches run one at a time, so all kernels share a single binding point
+    m_configureKernels();
+}
+
+void PlacementPipeline::setPatternLibrary(const WorkGroupPatternLibrary &library)
+{
+    constexpr auto wg_size = GenerationKernel::work_group_size;
+    static_assert(sizeof(WorkGroupPatternLibrary::Pattern) == wg_size.x * wg_size.y * sizeof(glm::vec2),
+                  "patterns must have a position for each invocation of a work group");
 
-    std::array<std::array<glm::vec2, wg_size.y>, wg_size.x> positions;
-    for (auto &column: positions)
-        for (auto &cell: column)
-            cell = generator.generate();
+    const auto &patterns = library.getPatterns();
+    m_pattern_buffer_size = static_cast<GLsizeiptr>(patterns.size() * sizeof(WorkGroupPatternLibrary::Pattern));
+    m_pattern_buffer = GL::Buffer();
+    m_pattern_buffer.allocateImmutable(m_pattern_buffer_size, GL::Buffer::StorageFlags::none, patterns.data());
 
-    m_generation_kernel.setWorkGroupPatternColumns(positions);
+    m_work_group_scale = library.getBounds();
+    m_configureKernels();
 }
 
 } // placement
\ No newline at end of file
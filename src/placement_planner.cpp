@@ -0,0 +1,134 @@
+#include "placement/placement_planner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace placement {
+
+namespace {
+
+/// Largest number of work groups dispatched along each axis by a chunk, within the minimum GL guarantees.
+constexpr uint max_chunk_side = 65535;
+
+/// Largest number of work groups in a chunk, so that the byte sizes of its buffers fit in 32 bits.
+constexpr uint max_chunk_work_groups = std::numeric_limits<uint>::max() / sizeof(glm::vec4)
+                                       / (GenerationKernel::work_group_size.x * GenerationKernel::work_group_size.y);
+
+} // namespace
+
+PlacementPlanner::PlacementPlanner(PlacementPipeline &pipeline, GLsizeiptr memory_budget, uint max_chunks_in_flight)
+    : m_pipeline(pipeline), m_memory_budget(memory_budget), m_max_chunks_in_flight(max_chunks_in_flight)
+{
+    if (max_chunks_in_flight == 0)
+        throw std::invalid_argument("at least one chunk must be in flight");
+}
+
+GLsizeiptr PlacementPlanner::getChunkMemoryRequirement(glm::uvec2 work_group_count, uint class_count) const
+{
+    const glm::uvec3 num_work_groups {work_group_count, 1u};
+    const auto wg_size = GenerationKernel::work_group_size;
+    const auto candidate_count = static_cast<uint>(work_group_count.x * wg_size.x * work_group_count.y * wg_size.y);
+
+    // shared by all the chunks
+    const GLsizeiptr transient_size = GenerationKernel::getCandidateBufferSizeRequirement(num_work_groups)
+                                      + GenerationKernel::getWorldUVBufferSizeRequirement(num_work_groups)
+                                      + GenerationKernel::getDensityBufferMemoryRequirement(num_work_groups)
+                                      + IndexationKernel::getIndexBufferMemoryRequirement(candidate_count);
+
+    // one per chunk in flight, with a cell per work group in morton order
+    GLsizeiptr result_size = IndexationKernel::getCountBufferMemoryRequirement(class_count)
+                             + GenerationKernel::getCandidateBufferSizeRequirement(num_work_groups);
+    if (m_pipeline.getElementOrder() == PlacementPipeline::ElementOrder::morton)
+        result_size += IndexationKernel::getCellIndexBufferMemoryRequirement(class_count,
+                                                                             work_group_count.x * work_group_count.y);
+
+    return transient_size + m_max_chunks_in_flight * result_size;
+}
+
+TileGrid PlacementPlanner::plan(const LayerData &layer_data, glm::vec2 lower_bound, glm::vec2 upper_bound) const
+{
+    const auto class_count = static_cast<uint>(layer_data.densitymaps.size());
+
+    // apart from the class counts, the requirement is linear in the number of work groups
+    const GLsizeiptr fixed_size = getChunkMemoryRequirement({0u, 0u}, class_count);
+    const GLsizeiptr work_group_size = getChunkMemoryRequirement({1u, 1u}, class_count) - fixed_size;
+    if (m_memory_budget < fixed_size + work_group_size)
+        throw std::invalid_argument("memory budget is too small for a single work group");
+
+    const auto max_work_groups = static_cast<uint>(std::min<GLsizeiptr>((m_memory_budget - fixed_size)
+                                                                        / work_group_size, max_chunk_work_groups));
+
+    // as square as the region allows, so that chunks read few texels outside of their bounds
+    TileGrid grid = m_pipeline.makeTileGrid(layer_data.footprint, lower_bound, upper_bound, glm::uvec2(1u));
+    const glm::uvec2 region_size = glm::max(grid.work_group_count, glm::uvec2(1u));
+    const auto side = static_cast<uint>(std::sqrt(static_cast<double>(max_work_groups)));
+
+    glm::uvec2 tile_size;
+    tile_size.x = std::clamp(side, 1u, std::min(region_size.x, max_chunk_side));
+    tile_size.y = std::clamp(max_work_groups / tile_size.x, 1u, std::min(region_size.y, max_chunk_side));
+    tile_size.x = std::clamp(max_work_groups / tile_size.y, 1u, std::min(region_size.x, max_chunk_side));
+
+    grid.tile_size = tile_size;
+    return grid;
+}
+
+void PlacementPlanner::computePlacement(const WorldData &world_data, const LayerData &layer_data,
+                                        glm::vec2 lower_bound, glm::vec2 upper_bound, const Sink &sink)
+{
+    const TileGrid grid = plan(layer_data, lower_bound, upper_bound);
+    const glm::uvec2 chunk_count = grid.getTileCount();
+
+    // chunks complete in submission order, so the oldest one is waited on before issuing another
+    std::deque<std::pair<glm::uvec2, FutureResult>> in_flight;
+    const auto retire = [&]()
+    {
+        auto [chunk, future_result] = std::move(in_flight.front());
+        in_flight.pop_front();
+        sink(chunk, future_result.readResult());
+    };
+
+    for (uint y = 0; y < chunk_count.y; y++)
+        for (uint x = 0; x < chunk_count.x; x++)
+        {
+            if (in_flight.size() == m_max_chunks_in_flight)
+                retire();
+
+            const glm::uvec2 chunk {x, y};
+            in_flight.emplace_back(chunk, m_pipeline.computeTile(world_data, layer_data, grid, chunk));
+        }
+
+    while (!in_flight.empty())
+        retire();
+}
+
+Result PlacementPlanner::computePlacement(const WorldData &world_data, const LayerData &layer_data,
+                                          glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    // chunk results are sized for all of their candidates, their compacted copies only for their elements
+    std::vector<FutureResult> compacted;
+    computePlacement(world_data, layer_data, lower_bound, upper_bound, [&compacted](glm::uvec2, Result result)
+    {
+        compacted.push_back(mergeResults({&result}));
+    });
+
+    if (compacted.empty())
+        return m_pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+    std::vector<Result> chunks;
+    chunks.reserve(compacted.size());
+    for (auto &future_result : compacted)
+        chunks.push_back(future_result.readResult());
+
+    std::vector<const Result*> results;
+    results.reserve(chunks.size());
+    for (const auto &chunk : chunks)
+        results.push_back(&chunk);
+
+    return mergeResults(results).readResult();
+}
+
+} // placement
@@ -2,11 +2,149 @@
 
 #include "gl_context.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PLACEMENT_STREAMING_STORES
+#endif
+
 namespace placement {
 
 constexpr GLintptr uint_size = sizeof(GLuint);
 
-Result::Result(ResultBuffer &&buffer) : m_buffer(std::move(buffer))
+/// memcpy, but with non-temporal stores for large copies, so that copying results doesn't evict the destination.
+static void streamingCopy(void *destination, const void *source, std::size_t size)
+{
+    if (size == 0)
+        return;
+
+#ifdef PLACEMENT_STREAMING_STORES
+    constexpr std::size_t streaming_threshold = 1u << 16;
+    auto *dst = static_cast<std::byte*>(destination);
+    const auto *src = static_cast<const std::byte*>(source);
+
+    if (size >= streaming_threshold)
+    {
+        // copy up to the first 16 byte aligned destination address normally
+        const std::size_t head = (16 - reinterpret_cast<std::uintptr_t>(dst) % 16) % 16;
+        std::memcpy(dst, src, head);
+        dst += head;
+        src += head;
+        size -= head;
+
+        for (; size >= 16; size -= 16, dst += 16, src += 16)
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst),
+                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+        _mm_sfence();
+    }
+
+    std::memcpy(dst, src, size);
+#else
+    std::memcpy(destination, source, size);
+#endif
+}
+
+ResultBuffer makeResultBuffer(unsigned int num_classes, GLsizeiptr size, const void *data, const CellGrid &cell_grid)
+{
+    ResultBuffer result_buffer {num_classes, size, GL::Buffer(), nullptr, cell_grid};
+
+    using SFlags = GL::Buffer::StorageFlags;
+
+    GL::BufferHandle buffer = result_buffer.gl_object;
+    buffer.allocateImmutable(size, SFlags::map_read | SFlags::map_persistent | SFlags::map_coherent, data);
+
+    using AFlags = GL::Buffer::AccessFlags;
+    result_buffer.mapped_ptr = static_cast<const std::byte*>(buffer.mapRange(0, size, AFlags::read | AFlags::coherent | AFlags::persistent));
+
+    if (!result_buffer.mapped_ptr)
+        throw std::runtime_error("GL memory mapping error!");
+
+    if (!data)
+        gl.ClearNamedBufferSubData(buffer.getName(), GL_R8, 0, num_classes * uint_size, GL_RED,  GL_UNSIGNED_BYTE, nullptr);
+
+    return result_buffer;
+}
+
+std::shared_ptr<StatisticsBuffer> makeStatisticsBuffer(PlacementStatistics issued)
+{
+    auto statistics = std::make_shared<StatisticsBuffer>();
+
+    using SFlags = GL::Buffer::StorageFlags;
+    using AFlags = GL::Buffer::AccessFlags;
+
+    const std::vector<std::uint32_t> zeros(2 + issued.class_element_counts.size(), 0);
+    const auto size = static_cast<GLsizeiptr>(zeros.size() * sizeof(std::uint32_t));
+
+    GL::BufferHandle buffer = statistics->gl_object;
+    buffer.allocateImmutable(size, SFlags::map_read | SFlags::map_persistent | SFlags::map_coherent, zeros.data());
+    statistics->mapped_ptr = static_cast<const std::uint32_t*>(buffer.mapRange(0, size, AFlags::read
+                                                                                        | AFlags::coherent
+                                                                                        | AFlags::persistent));
+    if (!statistics->mapped_ptr)
+        throw std::runtime_error("GL memory mapping error!");
+
+    statistics->issued = std::move(issued);
+    return statistics;
+}
+
+PlacementStatistics StatisticsBuffer::read() const
+{
+    PlacementStatistics statistics = issued;
+    statistics.out_of_bounds_count = mapped_ptr[0];
+    statistics.excluded_count = mapped_ptr[1];
+
+    for (std::size_t i = 0; i < statistics.class_element_counts.size(); i++)
+        statistics.class_element_counts[i] = mapped_ptr[2 + i];
+
+    statistics.rejected_count = statistics.candidate_count - statistics.out_of_bounds_count
+                                - statistics.excluded_count - statistics.getElementCount();
+    return statistics;
+}
+
+std::shared_ptr<BoundsBuffer> makeBoundsBuffer(std::uint32_t class_count, std::uint32_t cell_count)
+{
+    auto bounds = std::make_shared<BoundsBuffer>();
+    bounds->class_count = class_count;
+    bounds->cell_count = cell_count;
+
+    using SFlags = GL::Buffer::StorageFlags;
+    using AFlags = GL::Buffer::AccessFlags;
+
+    const GLsizeiptr size = bounds->getSize();
+    GL::BufferHandle buffer = bounds->gl_object;
+    buffer.allocateImmutable(size, SFlags::map_read | SFlags::map_persistent | SFlags::map_coherent);
+    bounds->mapped_ptr = static_cast<const float*>(buffer.mapRange(0, size, AFlags::read | AFlags::coherent
+                                                                            | AFlags::persistent));
+    if (!bounds->mapped_ptr)
+        throw std::runtime_error("GL memory mapping error!");
+
+    // empty boxes, which the copy kernel grows
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+    const float min_corner[3] {infinity, infinity, infinity};
+    const float max_corner[3] {-infinity, -infinity, -infinity};
+    const GLintptr max_offset = bounds->getMaxCornerOffset();
+    gl.ClearNamedBufferSubData(buffer.getName(), GL_RGB32F, 0, max_offset, GL_RGB, GL_FLOAT, min_corner);
+    gl.ClearNamedBufferSubData(buffer.getName(), GL_RGB32F, max_offset, max_offset, GL_RGB, GL_FLOAT, max_corner);
+
+    return bounds;
+}
+
+ElementBounds BoundsBuffer::read(std::uint32_t box_index) const
+{
+    const float *min = mapped_ptr + 3 * box_index;
+    const float *max = mapped_ptr + 3 * (getBoxCount() + box_index);
+    return {{min[0], min[1], min[2]}, {max[0], max[1], max[2]}};
+}
+
+Result::Result(ResultBuffer &&buffer, std::shared_ptr<const StatisticsBuffer> statistics,
+               std::shared_ptr<const BoundsBuffer> bounds)
+    : m_buffer(std::move(buffer)), m_statistics(std::move(statistics)), m_bounds(std::move(bounds))
 {
     using clock = std::chrono::steady_clock;
 
@@ -26,12 +164,56 @@ Result::Result(ResultBuffer &&buffer) : m_buffer(std::move(buffer))
     }
 }
 
+std::optional<PlacementStatistics> Result::getStatistics() const
+{
+    if (!m_statistics)
+        return std::nullopt;
+
+    return m_statistics->read();
+}
+
+ElementBounds Result::getClassBounds(Result::uint class_index) const
+{
+    if (!m_bounds)
+        throw std::logic_error("result has no bounds");
+
+    if (class_index >= getNumClasses())
+        throw std::out_of_range("class index out of range");
+
+    return m_bounds->read(class_index);
+}
+
+ElementBounds Result::getCellBounds(Result::uint class_index, Result::uint cell_rank) const
+{
+    if (!m_bounds || m_bounds->cell_count == 0)
+        throw std::logic_error("result has no cell bounds");
+
+    if (class_index >= getNumClasses() || cell_rank >= m_bounds->cell_count)
+        throw std::out_of_range("cell bounds out of range");
+
+    return m_bounds->read(m_bounds->class_count + class_index * m_bounds->cell_count + cell_rank);
+}
+
 Result::uint Result::copyClassRange(Result::uint begin_class, Result::uint end_class, GL::BufferHandle buffer,
                                     GLintptr offset) const
 {
     constexpr GLsizeiptr element_size = sizeof(Element);
     const auto element_count = getClassRangeElementCount(begin_class, end_class);
 
+    if (m_buffer.layout == ResultLayout::structure_of_arrays)
+    {
+        const GLsizeiptr array_size = element_count * uint_size;
+        for (uint component = 0; component < 4; component++)
+            GL::Buffer::copy(m_buffer.gl_object,
+                             buffer,
+                             m_buffer.getElementBufferOffset()
+                             + (component * m_buffer.getElementCapacity() + getClassIndexOffset(begin_class)) * uint_size,
+                             offset + component * array_size,
+                             array_size);
+
+        return element_count;
+    }
+
     GL::Buffer::copy(m_buffer.gl_object,
                      buffer,
                      getElementArrayBufferOffset() + getClassIndexOffset(begin_class) * element_size,
@@ -41,11 +223,81 @@ Result::uint Result::copyClassRange(Result::uint begin_class, Result::uint end_c
     return element_count;
 }
 
+Result::uint Result::copyClassRangeToHost(Result::uint begin_class, Result::uint end_class, Element *out) const
+{
+    const uint element_count = getClassRangeElementCount(begin_class, end_class);
+
+    if (m_buffer.layout == ResultLayout::structure_of_arrays)
+    {
+        const ElementArrays arrays = getElementArrays(begin_class, end_class);
+        for (uint i = 0; i < element_count; i++)
+            out[i] = {{arrays.x[i], arrays.y[i], arrays.z[i]}, arrays.class_index[i]};
+
+        return element_count;
+    }
+
+    streamingCopy(out, m_buffer.getElementDataBegin() + getClassIndexOffset(begin_class),
+                  element_count * sizeof(Element));
+
+    return element_count;
+}
+
+Result::uint Result::copyClassRangeToHost(Result::uint begin_class, Result::uint end_class,
+                                          float *x, float *y, float *z) const
+{
+    const uint element_count = getClassRangeElementCount(begin_class, end_class);
+
+    if (m_buffer.layout == ResultLayout::structure_of_arrays)
+    {
+        const ElementArrays arrays = getElementArrays(begin_class, end_class);
+        streamingCopy(x, arrays.x.data(), element_count * sizeof(float));
+        streamingCopy(y, arrays.y.data(), element_count * sizeof(float));
+        streamingCopy(z, arrays.z.data(), element_count * sizeof(float));
+
+        return element_count;
+    }
+
+    const Element *elements = m_buffer.getElementDataBegin() + getClassIndexOffset(begin_class);
+    for (uint i = 0; i < element_count; i++)
+    {
+        x[i] = elements[i].position.x;
+        y[i] = elements[i].position.y;
+        z[i] = elements[i].position.z;
+    }
+
+    return element_count;
+}
+
+ArrayView<Result::Element> Result::getElements(Result::uint begin_class, Result::uint end_class) const
+{
+    if (m_buffer.layout != ResultLayout::array_of_structures)
+        throw std::logic_error("result elements are not stored as an array of structures");
+
+    return {m_buffer.getElementDataBegin() + getClassIndexOffset(begin_class),
+            getClassRangeElementCount(begin_class, end_class)};
+}
+
+ElementArrays Result::getElementArrays(Result::uint begin_class, Result::uint end_class) const
+{
+    if (m_buffer.layout != ResultLayout::structure_of_arrays)
+        throw std::logic_error("result elements are not stored as a structure of arrays");
+
+    const std::size_t offset = getClassIndexOffset(begin_class);
+    const std::size_t count = getClassRangeElementCount(begin_class, end_class);
+
+    const auto component = [&](uint index) { return m_buffer.getComponentDataBegin(index) + offset; };
+
+    return {{reinterpret_cast<const float*>(component(0)), count},
+            {reinterpret_cast<const float*>(component(1)), count},
+            {reinterpret_cast<const float*>(component(2)), count},
+            {component(3), count}};
+}
+
 std::vector<Result::Element> Result::copyAllToHost() const
 {
     std::vector<Element> vector {getElementArrayLength()};
 
-    copyAllToHost(vector.begin());
+    copyClassRangeToHost(0, getNumClasses(), vector.data());
 
     return vector;
 }
@@ -54,27 +306,412 @@ std::vector<Result::Element> Result::copyClassToHost(Result::uint class_index) c
 {
     std::vector<Element> vector {getClassElementCount(class_index)};
 
-    copyClassToHost(class_index, vector.begin());
+    copyClassRangeToHost(class_index, class_index + 1, vector.data());
 
     return vector;
 }
 
-FutureResult::FutureResult(ResultBuffer &&result_buffer, GL::Sync &&sync) : m_buffer(std::move(result_buffer)),
-                                                                            m_sync(std::move(sync))
+CellIndexEntry Result::getCellIndexEntry(Result::uint class_index, Result::uint cell_rank) const
+{
+    if (!hasCellIndex())
+        throw std::logic_error("result has no cell index");
+
+    if (class_index >= getNumClasses() || cell_rank >= m_buffer.cell_grid.getCellCount())
+        throw std::out_of_range("cell index entry out of range");
+
+    const std::uint32_t *entry = m_buffer.getCellIndexDataBegin()
+                                 + 2 * (class_index * m_buffer.cell_grid.getCellCount() + cell_rank);
+
+    return {entry[0], entry[1]};
+}
+
+FutureResult::FutureResult(ResultBuffer &&result_buffer, GL::Sync &&sync,
+                           std::shared_ptr<const StatisticsBuffer> statistics,
+                           std::shared_ptr<const BoundsBuffer> bounds, TraceContext trace)
+    : m_buffer(std::move(result_buffer)), m_sync(std::move(sync)), m_statistics(std::move(statistics)),
+      m_bounds(std::move(bounds)), m_trace(std::move(trace))
+{}
+
+FutureResult::FutureResult(std::vector<FutureResult> &&dependencies,
+                           std::function<FutureResult(std::vector<Result>)> combine)
+    : m_buffer{}, m_dependencies(std::move(dependencies)), m_combine(std::move(combine))
 {}
 
 bool FutureResult::wait(std::chrono::nanoseconds timeout) const
 {
-    const auto status = m_sync.clientWait(false, timeout);
+    // the operations issued by m_combine are short compared to those it waits for, so they aren't waited on here
+    if (m_combine)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto &dependency : m_dependencies)
+        {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start);
+            if (!dependency.wait(elapsed < timeout ? timeout - elapsed : std::chrono::nanoseconds::zero()))
+                return false;
+        }
+        return true;
+    }
+
+    const auto status = m_sync->clientWait(false, timeout);
     return status == GL::Sync::Status::already_signaled || status == GL::Sync::Status::condition_satisfied;
 }
 
 Result FutureResult::readResult()
 {
-    while (!wait(std::chrono::nanoseconds::max()))
-        /* wait */;
+    if (m_combine)
+    {
+        std::vector<Result> results;
+        results.reserve(m_dependencies.size());
+        for (auto &dependency : m_dependencies)
+            results.push_back(dependency.readResult());
+        m_dependencies.clear();
+
+        return std::exchange(m_combine, nullptr)(std::move(results)).readResult();
+    }
+
+    {
+        ScopedTraceSpan span {m_trace, "fence wait"};
+        while (!wait(std::chrono::nanoseconds::max()))
+            /* wait */;
+    }
+
+    ScopedTraceSpan span {m_trace, "read result"};
+    return Result(moveResultBuffer(), std::move(m_statistics), std::move(m_bounds));
+}
+
+namespace {
+
+/// A contiguous range of elements copied from a source result into a spliced result.
+struct CopyRun
+{
+    const Result *source;
+    std::uint32_t source_index;
+    std::uint32_t index;
+    std::uint32_t count;
+};
+
+void appendRun(std::vector<CopyRun> &runs, const CopyRun &run)
+{
+    if (run.count == 0)
+        return;
+
+    // merge with the previous run if both are contiguous in the source and in the destination
+    if (!runs.empty())
+    {
+        CopyRun &last = runs.back();
+        if (last.source == run.source && last.source_index + last.count == run.source_index
+            && last.index + last.count == run.index)
+        {
+            last.count += run.count;
+            return;
+        }
+    }
+
+    runs.push_back(run);
+}
+
+/**
+ * Allocate a result and fill it with the count section and cell index in @p header, followed by the elements copied by
+ * @p runs, all on the GPU.
+ */
+FutureResult assembleResult(std::uint32_t class_count, const CellGrid &grid, ResultLayout layout,
+                            const std::vector<std::uint32_t> &header, const std::vector<CopyRun> &runs,
+                            std::uint32_t element_count)
+{
+    using uint = std::uint32_t;
+
+    const GLsizeiptr header_count_size = class_count * uint_size;
+    const GLsizeiptr cell_index_size = ResultBuffer::getCellIndexBufferSize(class_count, grid);
+    const GLsizeiptr size = header_count_size + element_count * ResultBuffer::element_ssize + cell_index_size;
+
+    // GL doesn't allow empty buffers; without classes or elements, the padding is an empty value section
+    ResultBuffer buffer = makeResultBuffer(class_count, std::max(size, ResultBuffer::uint_ssize), nullptr, grid);
+    buffer.layout = layout;
+
+    // without classes there is no header
+    if (!header.empty())
+    {
+        GL::Buffer header_buffer;
+        header_buffer.allocateImmutable(static_cast<GLsizeiptr>(header.size() * sizeof(uint)),
+                                        GL::Buffer::StorageFlags::none, header.data());
+        GL::Buffer::copy(header_buffer, buffer.gl_object, 0, buffer.getCountBufferOffset(), header_count_size);
+        if (cell_index_size > 0)
+            GL::Buffer::copy(header_buffer, buffer.gl_object, header_count_size, buffer.getCellIndexBufferOffset(),
+                             cell_index_size);
+    }
+
+    for (const CopyRun &run : runs)
+    {
+        const ResultBuffer &source = run.source->getBuffer();
+
+        if (buffer.layout == ResultLayout::structure_of_arrays)
+        {
+            for (uint component = 0; component < 4; component++)
+                GL::Buffer::copy(source.gl_object, buffer.gl_object,
+                                 source.getElementBufferOffset()
+                                 + (component * source.getElementCapacity() + run.source_index) * uint_size,
+                                 buffer.getElementBufferOffset()
+                                 + (component * buffer.getElementCapacity() + run.index) * uint_size,
+                                 run.count * uint_size);
+        }
+        else
+            GL::Buffer::copy(source.gl_object, buffer.gl_object,
+                             source.getElementBufferOffset() + run.source_index * ResultBuffer::element_ssize,
+                             buffer.getElementBufferOffset() + run.index * ResultBuffer::element_ssize,
+                             run.count * ResultBuffer::element_ssize);
+    }
+
+    auto fence = GL::createFenceSync();
+    gl.Flush();
+
+    return {std::move(buffer), std::move(fence)};
+}
+
+} // namespace
+
+FutureResult spliceResults(const Result &base, const std::vector<ResultPatch> &patches)
+{
+    using uint = std::uint32_t;
+
+    if (!base.hasCellIndex())
+        throw std::invalid_argument("results can only be spliced if they have a cell index");
+
+    const CellGrid &grid = base.getCellGrid();
+    const uint cell_count = grid.getCellCount();
+    const uint class_count = base.getNumClasses();
+
+    // cells of the base result replaced by a patch, as (base rank, patch index, patch rank)
+    struct PatchedCell
+    {
+        uint rank;
+        uint patch_index;
+        uint patch_rank;
+    };
+    std::vector<PatchedCell> patched_cells;
+
+    for (uint patch_index = 0; patch_index < patches.size(); patch_index++)
+    {
+        const ResultPatch &patch = patches[patch_index];
+        const CellGrid &patch_grid = patch.result->getCellGrid();
+
+        if (!patch.result->hasCellIndex() || patch.result->getNumClasses() != class_count
+            || patch.result->getLayout() != base.getLayout() || patch_grid.cell_size != grid.cell_size)
+            throw std::invalid_argument("patch does not match the base result");
+
+        if (glm::any(glm::greaterThan(patch.lower_cell + patch_grid.size, grid.size)))
+            throw std::invalid_argument("patch lies outside of the base result");
+
+        for (uint y = 0; y < patch_grid.size.y; y++)
+            for (uint x = 0; x < patch_grid.size.x; x++)
+                patched_cells.push_back({grid.getCellRank(patch.lower_cell + glm::uvec2(x, y)), patch_index,
+                                         patch_grid.getCellRank({x, y})});
+    }
+
+    // sort by rank, keeping only the last patch of each cell
+    std::stable_sort(patched_cells.begin(), patched_cells.end(),
+                     [](const PatchedCell &l, const PatchedCell &r) { return l.rank < r.rank; });
+    std::reverse(patched_cells.begin(), patched_cells.end());
+    patched_cells.erase(std::unique(patched_cells.begin(), patched_cells.end(),
+                                    [](const PatchedCell &l, const PatchedCell &r) { return l.rank == r.rank; }),
+                        patched_cells.end());
+    std::reverse(patched_cells.begin(), patched_cells.end());
+
+    // the count section followed by the cell index of the new result
+    std::vector<uint> header(class_count + 2 * class_count * cell_count);
+    uint *const counts = header.data();
+    auto *const cell_index = reinterpret_cast<CellIndexEntry*>(header.data() + class_count);
+    const auto *const base_cell_index = reinterpret_cast<const CellIndexEntry*>(base.getBuffer().getCellIndexDataBegin());
+
+    std::vector<CopyRun> runs;
+    uint class_offset = 0;
+
+    for (uint class_index = 0; class_index < class_count; class_index++)
+    {
+        const CellIndexEntry *base_entries = base_cell_index + class_index * cell_count;
+        CellIndexEntry *entries = cell_index + class_index * cell_count;
+        const uint base_class_offset = base.getClassIndexOffset(class_index);
+
+        uint count = 0;
+        uint rank = 0;
+        auto patched_cell = patched_cells.begin();
+
+        while (rank < cell_count)
+        {
+            // unchanged cells up to the next patched one are copied as a single run
+            const uint end_rank = patched_cell != patched_cells.end() ? patched_cell->rank : cell_count;
+            if (end_rank > rank)
+            {
+                const uint begin = base_entries[rank].offset;
+                for (; rank < end_rank; rank++)
+                    entries[rank] = {base_entries[rank].offset - begin + count, base_entries[rank].count};
+
+                const uint run_count = base_entries[end_rank - 1].offset + base_entries[end_rank - 1].count - begin;
+                appendRun(runs, {&base, base_class_offset + begin, class_offset + count, run_count});
+                count += run_count;
+            }
+
+            if (patched_cell == patched_cells.end())
+                continue;
+
+            const Result &patch = *patches[patched_cell->patch_index].result;
+            const CellIndexEntry entry = patch.getCellIndexEntry(class_index, patched_cell->patch_rank);
+            entries[rank] = {count, entry.count};
+            appendRun(runs, {&patch, patch.getClassIndexOffset(class_index) + entry.offset, class_offset + count,
+                             entry.count});
+            count += entry.count;
+
+            rank++;
+            ++patched_cell;
+        }
+
+        counts[class_index] = count;
+        class_offset += count;
+    }
+
+    return assembleResult(class_count, grid, base.getLayout(), header, runs, class_offset);
+}
+
+FutureResult spliceResults(const Result &base, std::vector<FutureResultPatch> patches)
+{
+    if (!base.hasCellIndex())
+        throw std::invalid_argument("results can only be spliced if they have a cell index");
+
+    std::vector<FutureResult> future_results;
+    std::vector<glm::uvec2> lower_cells;
+    future_results.reserve(patches.size());
+    lower_cells.reserve(patches.size());
+    for (auto &patch : patches)
+    {
+        future_results.push_back(std::move(patch.result));
+        lower_cells.push_back(patch.lower_cell);
+    }
+
+    return {std::move(future_results), [&base, lower_cells](std::vector<Result> results)
+    {
+        std::vector<ResultPatch> result_patches;
+        result_patches.reserve(results.size());
+        for (std::size_t i = 0; i < results.size(); i++)
+            result_patches.push_back({&results[i], lower_cells[i]});
+
+        return spliceResults(base, result_patches);
+    }};
+}
+
+FutureResult mergeResults(const std::vector<const Result*> &results)
+{
+    using uint = std::uint32_t;
+
+    if (results.empty())
+        throw std::invalid_argument("no results to merge");
+
+    const Result &first = *results.front();
+    const uint class_count = first.getNumClasses();
+    const bool has_cell_index = first.hasCellIndex();
+
+    for (const Result *result : results)
+        if (result->getNumClasses() != class_count || result->getLayout() != first.getLayout()
+            || result->hasCellIndex() != has_cell_index
+            || (has_cell_index && result->getCellGrid().cell_size != first.getCellGrid().cell_size))
+            throw std::invalid_argument("results do not match");
+
+    std::vector<CopyRun> runs;
+    uint class_offset = 0;
+
+    if (!has_cell_index)
+    {
+        // the elements of each class, one result after another
+        std::vector<uint> counts(class_count);
+        for (uint class_index = 0; class_index < class_count; class_index++)
+        {
+            for (const Result *result : results)
+            {
+                const uint count = result->getClassElementCount(class_index);
+                appendRun(runs, {result, result->getClassIndexOffset(class_index), class_offset + counts[class_index],
+                                 count});
+                counts[class_index] += count;
+            }
+            class_offset += counts[class_index];
+        }
+
+        return assembleResult(class_count, CellGrid{}, first.getLayout(), counts, runs, class_offset);
+    }
+
+    // the cell grid covering all the results, whose cells must be aligned
+    const glm::vec2 cell_size = first.getCellGrid().cell_size;
+    glm::vec2 origin = first.getCellGrid().origin;
+    for (const Result *result : results)
+        origin = glm::min(origin, result->getCellGrid().origin);
+
+    std::vector<glm::uvec2> lower_cells;
+    lower_cells.reserve(results.size());
+    glm::uvec2 grid_size {0u};
+    for (const Result *result : results)
+    {
+        const CellGrid &result_grid = result->getCellGrid();
+        const glm::vec2 offset = (result_grid.origin - origin) / cell_size;
+        const glm::vec2 lower_cell = glm::round(offset);
+
+        // allow for the rounding of origins computed from cell coordinates, which grows with the offset
+        if (glm::any(glm::greaterThan(glm::abs(offset - lower_cell), glm::vec2(1e-3f) + offset * 1e-5f)))
+            throw std::invalid_argument("cell grids are not aligned");
+
+        lower_cells.emplace_back(lower_cell);
+        grid_size = glm::max(grid_size, lower_cells.back() + result_grid.size);
+    }
+
+    const CellGrid grid {origin, cell_size, grid_size};
+    const uint cell_count = grid.getCellCount();
+
+    // the result and rank within it of each cell of the merged grid, if any
+    struct SourceCell
+    {
+        const Result *result;
+        uint rank;
+    };
+    std::vector<SourceCell> source_cells(cell_count, {nullptr, 0});
+
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const CellGrid &result_grid = results[i]->getCellGrid();
+        for (uint y = 0; y < result_grid.size.y; y++)
+            for (uint x = 0; x < result_grid.size.x; x++)
+            {
+                SourceCell &source_cell = source_cells[grid.getCellRank(lower_cells[i] + glm::uvec2(x, y))];
+                if (source_cell.result)
+                    throw std::invalid_argument("results overlap");
+
+                source_cell = {results[i], result_grid.getCellRank({x, y})};
+            }
+    }
+
+    std::vector<uint> header(class_count + 2 * class_count * cell_count);
+    uint *const counts = header.data();
+    auto *const cell_index = reinterpret_cast<CellIndexEntry*>(header.data() + class_count);
+
+    for (uint class_index = 0; class_index < class_count; class_index++)
+    {
+        CellIndexEntry *entries = cell_index + class_index * cell_count;
+        uint count = 0;
+
+        for (uint rank = 0; rank < cell_count; rank++)
+        {
+            const auto [result, source_rank] = source_cells[rank];
+            const CellIndexEntry entry = result ? result->getCellIndexEntry(class_index, source_rank)
+                                                : CellIndexEntry{0, 0};
+
+            entries[rank] = {count, entry.count};
+            if (result)
+                appendRun(runs, {result, result->getClassIndexOffset(class_index) + entry.offset,
+                                 class_offset + count, entry.count});
+            count += entry.count;
+        }
+
+        counts[class_index] = count;
+        class_offset += count;
+    }
 
-    return Result(moveResultBuffer());
+    return assembleResult(class_count, grid, first.getLayout(), header, runs, class_offset);
 }
 
 } // placement
\ No newline at end of file
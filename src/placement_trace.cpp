@@ -0,0 +1,96 @@
+#include "placement/placement_trace.hpp"
+
+#include "json_writer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+namespace placement {
+
+void ChromeTraceWriter::addSpan(const TraceSpan &span)
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    m_spans.push_back(span);
+}
+
+std::size_t ChromeTraceWriter::getSpanCount() const
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    return m_spans.size();
+}
+
+void ChromeTraceWriter::clear()
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    m_spans.clear();
+}
+
+void ChromeTraceWriter::write(std::ostream &out) const
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+
+    // track 0 is the GPU, tracks 1 and above are host threads in order of their first span
+    std::vector<std::thread::id> threads;
+    const auto getTrack = [&](const TraceSpan &span) -> std::size_t
+    {
+        if (span.timeline == TraceSpan::Timeline::gpu)
+            return 0;
+
+        const auto it = std::find(threads.begin(), threads.end(), span.thread);
+        if (it != threads.end())
+            return it - threads.begin() + 1;
+
+        threads.push_back(span.thread);
+        return threads.size();
+    };
+
+    // complete events, in microseconds
+    const auto toMicroseconds = [](TraceSpan::Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+
+    bool first = true;
+    for (const auto &span : m_spans)
+    {
+        out << (first ? "\n" : ",\n") << "{\"name\":";
+        json::writeString(out, span.name);
+        out << ",\"cat\":\"" << (span.timeline == TraceSpan::Timeline::gpu ? "gpu" : "cpu") << "\""
+            << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << getTrack(span)
+            << ",\"ts\":" << toMicroseconds(span.begin - m_time_zero)
+            << ",\"dur\":" << toMicroseconds(span.end - span.begin)
+            << ",\"args\":{\"request\":" << span.request_id << "}}";
+        first = false;
+    }
+
+    // track names
+    out << (first ? "\n" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":0,"args":{"name":"GPU"}})";
+    for (std::size_t i = 0; i < threads.size(); i++)
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1
+            << ",\"args\":{\"name\":\"CPU " << i << "\"}}";
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void ChromeTraceWriter::writeFile(const std::filesystem::path &path) const
+{
+    std::ofstream file {path};
+    if (!file.is_open())
+        throw std::runtime_error("could not open trace file for writing: " + path.string());
+
+    write(file);
+
+    if (!file)
+        throw std::runtime_error("error writing trace file: " + path.string());
+}
+
+} // placement
@@ -0,0 +1,117 @@
+#include "placement/request_recorder.hpp"
+
+#include "json_writer.hpp"
+
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+
+namespace placement {
+
+void RequestRecorder::record(RecordedRequest request)
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    m_requests.push_back(std::move(request));
+}
+
+std::size_t RequestRecorder::getRequestCount() const
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    return m_requests.size();
+}
+
+std::vector<RecordedRequest> RequestRecorder::getRequests() const
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    return m_requests;
+}
+
+void RequestRecorder::clear()
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+    m_requests.clear();
+}
+
+template<typename Vector>
+static void writeVector(std::ostream &out, const Vector &v)
+{
+    out << '[';
+    for (int i = 0; i < Vector::length(); i++)
+    {
+        out << (i == 0 ? "" : ",");
+        json::writeNumber(out, v[i]);
+    }
+    out << ']';
+}
+
+static const char *writeBool(bool value)
+{
+    return value ? "true" : "false";
+}
+
+void RequestRecorder::write(std::ostream &out) const
+{
+    std::lock_guard<std::mutex> lock {m_mutex};
+
+    // enough digits to read back the same floats
+    const auto precision = out.precision(9);
+    out << "{\"version\":1,\"requests\":[";
+
+    bool first = true;
+    for (const auto &request : m_requests)
+    {
+        out << (first ? "\n" : ",\n") << "{\"time_ms\":"
+            << std::chrono::duration<double, std::milli>(request.time).count() << ",\"world_scale\":";
+        writeVector(out, request.world_scale);
+        out << ",\"lower_bound\":";
+        writeVector(out, request.lower_bound);
+        out << ",\"upper_bound\":";
+        writeVector(out, request.upper_bound);
+        out << ",\"morton\":" << writeBool(request.morton) << ",\"layers\":[";
+
+        for (std::size_t i = 0; i < request.layers.size(); i++)
+        {
+            const RecordedLayer &layer = request.layers[i];
+            out << (i == 0 ? "" : ",") << "{\"footprint\":";
+            json::writeNumber(out, layer.footprint);
+            out << ",\"seed\":" << layer.seed << ",\"density_maps\":[";
+
+            for (std::size_t j = 0; j < layer.density_maps.size(); j++)
+            {
+                const RecordedDensityMap &density_map = layer.density_maps[j];
+                out << (j == 0 ? "" : ",") << "{\"texture\":" << density_map.texture << ",\"scale\":";
+                json::writeNumber(out, density_map.scale);
+                out << ",\"offset\":";
+                json::writeNumber(out, density_map.offset);
+                out << ",\"min_value\":";
+                json::writeNumber(out, density_map.min_value);
+                out << ",\"max_value\":";
+                json::writeNumber(out, density_map.max_value);
+                out << ",\"virtual_texture\":" << writeBool(density_map.virtual_texture)
+                    << ",\"expression\":" << writeBool(density_map.expression) << '}';
+            }
+
+            out << "]}";
+        }
+
+        out << "]}";
+        first = false;
+    }
+
+    out << "\n]}\n";
+    out.precision(precision);
+}
+
+void RequestRecorder::writeFile(const std::filesystem::path &path) const
+{
+    std::ofstream file {path};
+    if (!file.is_open())
+        throw std::runtime_error("could not open request recording for writing: " + path.string());
+
+    write(file);
+
+    if (!file)
+        throw std::runtime_error("error writing request recording: " + path.string());
+}
+
+} // placement
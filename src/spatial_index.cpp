@@ -0,0 +1,225 @@
+#include "placement/spatial_index.hpp"
+#include "placement/placement_result.hpp"
+
+#include "glm/glm.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace placement {
+
+SpatialIndex::SpatialIndex(const Result &result, float footprint)
+{
+    std::vector<glm::vec2> positions;
+    positions.reserve(result.getElementArrayLength());
+
+    if (result.getLayout() == ResultLayout::structure_of_arrays)
+    {
+        const ElementArrays arrays = result.getElementArrays();
+        for (std::size_t i = 0; i < arrays.x.size(); i++)
+            positions.emplace_back(arrays.x[i], arrays.y[i]);
+    }
+    else
+        for (const ResultElement &element : result.getElements())
+            positions.emplace_back(element.position);
+
+    m_build(positions, footprint);
+}
+
+SpatialIndex::SpatialIndex(const std::vector<glm::vec2> &positions, float footprint)
+{
+    m_build(positions, footprint);
+}
+
+void SpatialIndex::m_build(const std::vector<glm::vec2> &positions, float footprint)
+{
+    if (!(footprint > 0.0f))
+        throw std::invalid_argument("footprint must be greater than zero");
+
+    if (positions.empty())
+        return;
+
+    glm::vec2 lower_bound {std::numeric_limits<float>::max()};
+    glm::vec2 upper_bound {std::numeric_limits<float>::lowest()};
+    for (const glm::vec2 position : positions)
+    {
+        if (glm::any(glm::isnan(position)) || glm::any(glm::isinf(position)))
+            throw std::invalid_argument("positions must be finite");
+
+        lower_bound = glm::min(lower_bound, position);
+        upper_bound = glm::max(upper_bound, position);
+    }
+
+    // cells of one footprint hold at most four elements, but sparse results spread over a large area would create
+    // mostly empty cells. Cap the number of cells at roughly two per element, and at 2n + 1 along each axis, so that
+    // positions along a line, which have no area, don't get one footprint-sized cell per step either.
+    const glm::vec2 extent = glm::min(upper_bound - lower_bound, glm::vec2(std::numeric_limits<float>::max()));
+    const float double_count = 2.0f * static_cast<float>(positions.size());
+    const float min_cell_size = glm::max(glm::sqrt(extent.x / double_count * extent.y),
+                                         glm::max(extent.x, extent.y) / double_count);
+
+    m_origin = lower_bound;
+    m_cell_size = glm::max(footprint, min_cell_size);
+    m_grid_size = glm::uvec2(extent / m_cell_size) + 1u;
+
+    // counting sort by cell
+    m_cell_offsets.assign(m_grid_size.x * m_grid_size.y + 1, 0);
+
+    std::vector<Index> cells;
+    cells.reserve(positions.size());
+    for (const glm::vec2 position : positions)
+    {
+        const glm::ivec2 cell = m_getCell(position);
+        cells.emplace_back(cell.y * m_grid_size.x + cell.x);
+        m_cell_offsets[cells.back() + 1]++;
+    }
+
+    for (std::size_t i = 1; i < m_cell_offsets.size(); i++)
+        m_cell_offsets[i] += m_cell_offsets[i - 1];
+
+    m_positions.resize(positions.size());
+    m_indices.resize(positions.size());
+
+    std::vector<Index> write_offsets(m_cell_offsets.begin(), m_cell_offsets.end() - 1);
+    for (Index i = 0; i < positions.size(); i++)
+    {
+        const Index write_index = write_offsets[cells[i]]++;
+        m_positions[write_index] = positions[i];
+        m_indices[write_index] = i;
+    }
+}
+
+glm::ivec2 SpatialIndex::m_getCell(glm::vec2 position) const
+{
+    // clamped before the conversion, which is undefined for values out of the range of int, e.g. with a huge or
+    // infinite radius; NaN, which clamping would let through, maps to the first cell
+    glm::vec2 cell = glm::floor((position - m_origin) / m_cell_size);
+    cell = glm::mix(cell, glm::vec2(0.0f), glm::isnan(cell));
+    return glm::ivec2(glm::clamp(cell, glm::vec2(0.0f), glm::vec2(m_grid_size - 1u)));
+}
+
+void SpatialIndex::queryRadius(glm::vec2 center, float radius, std::vector<Index> &out) const
+{
+    if (m_indices.empty() || !(radius >= 0.0f) || glm::any(glm::isnan(center)))
+        return;
+
+    const glm::ivec2 lower_cell = m_getCell(center - radius);
+    const glm::ivec2 upper_cell = m_getCell(center + radius);
+    const float radius_sq = radius * radius;
+
+    for (int y = lower_cell.y; y <= upper_cell.y; y++)
+    {
+        for (int x = lower_cell.x; x <= upper_cell.x; x++)
+        {
+            const Index cell = y * m_grid_size.x + x;
+            for (Index i = m_cell_offsets[cell]; i < m_cell_offsets[cell + 1]; i++)
+            {
+                const glm::vec2 offset = m_positions[i] - center;
+                if (glm::dot(offset, offset) <= radius_sq)
+                    out.emplace_back(m_indices[i]);
+            }
+        }
+    }
+}
+
+void SpatialIndex::queryBox(glm::vec2 lower_bound, glm::vec2 upper_bound, std::vector<Index> &out) const
+{
+    if (m_indices.empty() || glm::any(glm::greaterThanEqual(lower_bound, upper_bound)))
+        return;
+
+    const glm::ivec2 lower_cell = m_getCell(lower_bound);
+    const glm::ivec2 upper_cell = m_getCell(upper_bound);
+
+    for (int y = lower_cell.y; y <= upper_cell.y; y++)
+    {
+        for (int x = lower_cell.x; x <= upper_cell.x; x++)
+        {
+            const Index cell = y * m_grid_size.x + x;
+            for (Index i = m_cell_offsets[cell]; i < m_cell_offsets[cell + 1]; i++)
+            {
+                const glm::vec2 position = m_positions[i];
+                if (glm::all(glm::greaterThanEqual(position, lower_bound)) && glm::all(glm::lessThan(position, upper_bound)))
+                    out.emplace_back(m_indices[i]);
+            }
+        }
+    }
+}
+
+std::optional<SpatialIndex::Index> SpatialIndex::nearest(glm::vec2 point, float max_distance) const
+{
+    if (m_indices.empty() || !(max_distance >= 0.0f) || glm::any(glm::isnan(point)))
+        return {};
+
+    const glm::ivec2 grid_size {m_grid_size};
+    const glm::ivec2 start_cell = m_getCell(point);
+
+    std::optional<Index> best_index;
+    float best_distance_sq = max_distance * max_distance;
+
+    const auto visit_cell = [&](glm::ivec2 cell)
+    {
+        if (glm::any(glm::lessThan(cell, glm::ivec2(0))) || glm::any(glm::greaterThanEqual(cell, grid_size)))
+            return;
+
+        // skip cells that can't contain anything closer than the current best
+        const glm::vec2 cell_lower_bound = m_origin + glm::vec2(cell) * m_cell_size;
+        const glm::vec2 box_offset = glm::max(glm::max(cell_lower_bound - point, point - cell_lower_bound - m_cell_size),
+                                              glm::vec2(0.0f));
+        if (glm::dot(box_offset, box_offset) > best_distance_sq)
+            return;
+
+        const Index cell_index = cell.y * m_grid_size.x + cell.x;
+        for (Index i = m_cell_offsets[cell_index]; i < m_cell_offsets[cell_index + 1]; i++)
+        {
+            const glm::vec2 offset = m_positions[i] - point;
+            const float distance_sq = glm::dot(offset, offset);
+            if (distance_sq <= best_distance_sq)
+            {
+                best_distance_sq = distance_sq;
+                best_index = m_indices[i];
+            }
+        }
+    };
+
+    const int max_ring = glm::max(grid_size.x, grid_size.y);
+
+    // visit rings of cells around the start cell, until no unvisited cell can hold a closer element
+    for (int ring = 0; ring <= max_ring; ring++)
+    {
+        if (ring > 0)
+        {
+            // every unvisited cell is outside of the box covered by previous rings
+            const glm::vec2 inner_lower_bound = m_origin + glm::vec2(start_cell - (ring - 1)) * m_cell_size;
+            const glm::vec2 inner_upper_bound = m_origin + glm::vec2(start_cell + ring) * m_cell_size;
+
+            if (glm::all(glm::greaterThanEqual(point, inner_lower_bound))
+                && glm::all(glm::lessThanEqual(point, inner_upper_bound)))
+            {
+                const glm::vec2 edge_distance = glm::min(point - inner_lower_bound, inner_upper_bound - point);
+                const float min_distance = glm::min(edge_distance.x, edge_distance.y);
+
+                if (min_distance * min_distance > best_distance_sq)
+                    break;
+            }
+        }
+
+        for (int y = start_cell.y - ring; y <= start_cell.y + ring; y++)
+        {
+            if (y == start_cell.y - ring || y == start_cell.y + ring)
+            {
+                for (int x = start_cell.x - ring; x <= start_cell.x + ring; x++)
+                    visit_cell({x, y});
+            }
+            else
+            {
+                visit_cell({start_cell.x - ring, y});
+                if (ring > 0)
+                    visit_cell({start_cell.x + ring, y});
+            }
+        }
+    }
+
+    return best_index;
+}
+
+} // placement
@@ -0,0 +1,142 @@
+#include "placement/threaded_placement_pipeline.hpp"
+
+namespace placement {
+
+ThreadedPlacementPipeline::ThreadedPlacementPipeline(ContextFunction make_context_current,
+                                                     ContextFunction release_context)
+{
+    m_worker = std::thread(&ThreadedPlacementPipeline::m_workerMain, this, std::move(make_context_current),
+                           std::move(release_context));
+}
+
+ThreadedPlacementPipeline::~ThreadedPlacementPipeline()
+{
+    {
+        std::lock_guard lock {m_mutex};
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    m_worker.join();
+}
+
+std::future<Result> ThreadedPlacementPipeline::computePlacement(const WorldData &world_data,
+                                                                const LayerData &layer_data,
+                                                                glm::vec2 lower_bound, glm::vec2 upper_bound)
+{
+    return submit([world_data, layer_data, lower_bound, upper_bound](PlacementPipeline &pipeline)
+                  {
+                      return pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound);
+                  });
+}
+
+std::future<Result> ThreadedPlacementPipeline::submit(Operation operation)
+{
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+
+    m_push([this, operation = std::move(operation), promise]()
+           {
+               try
+               {
+                   m_completions.push(operation(m_getPipeline()),
+                                      [promise](Result result) { promise->set_value(std::move(result)); });
+               }
+               catch (...)
+               {
+                   promise->set_exception(std::current_exception());
+               }
+           });
+
+    return future;
+}
+
+std::future<void> ThreadedPlacementPipeline::configure(std::function<void(PlacementPipeline&)> function)
+{
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+
+    m_push([this, function = std::move(function), promise]()
+           {
+               try
+               {
+                   function(m_getPipeline());
+                   promise->set_value();
+               }
+               catch (...)
+               {
+                   promise->set_exception(std::current_exception());
+               }
+           });
+
+    return future;
+}
+
+void ThreadedPlacementPipeline::m_push(Task task)
+{
+    {
+        std::lock_guard lock {m_mutex};
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+PlacementPipeline &ThreadedPlacementPipeline::m_getPipeline()
+{
+    if (m_construction_error)
+        std::rethrow_exception(m_construction_error);
+
+    return *m_pipeline;
+}
+
+void ThreadedPlacementPipeline::m_workerMain(ContextFunction make_context_current, ContextFunction release_context)
+{
+    // errors are reported by the futures of the requests, including those of the context
+    bool context_current = false;
+    try
+    {
+        make_context_current();
+        context_current = true;
+        m_pipeline.emplace();
+    }
+    catch (...)
+    {
+        m_construction_error = std::current_exception();
+    }
+
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock lock {m_mutex};
+
+            // wake up periodically to check the fences of pending results
+            const auto has_task = [this] { return m_stop || !m_tasks.empty(); };
+            if (m_completions.empty())
+                m_condition.wait(lock, has_task);
+            else
+                m_condition.wait_for(lock, poll_interval, has_task);
+
+            if (m_stop && m_tasks.empty())
+                break;
+
+            if (!m_tasks.empty())
+            {
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+        }
+
+        if (task)
+            task();
+
+        m_completions.pollCompletions();
+    }
+
+    m_completions.drain();
+    m_pipeline.reset();
+
+    if (release_context && context_current)
+        release_context();
+}
+
+} // placement
@@ -0,0 +1,365 @@
+#include "placement/virtual_texture.hpp"
+#include "gl_context.hpp"
+
+#include "glm/glm.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace placement {
+
+namespace {
+
+struct GLTexelFormat
+{
+    GLenum internal_format;
+    GLenum format;
+    GLenum type;
+};
+
+GLTexelFormat getGLTexelFormat(TexelFormat format)
+{
+    switch (format)
+    {
+    case TexelFormat::r8: return {GL_R8, GL_RED, GL_UNSIGNED_BYTE};
+    case TexelFormat::r16: return {GL_R16, GL_RED, GL_UNSIGNED_SHORT};
+    case TexelFormat::r32f: return {GL_R32F, GL_RED, GL_FLOAT};
+    }
+    throw std::invalid_argument("invalid texel format");
+}
+
+} // namespace
+
+void writeVirtualTextureFile(const std::string &path, TexelFormat format, glm::uvec2 size, const void *texels,
+                             std::uint32_t page_size)
+{
+    if (page_size == 0 || size.x == 0 || size.y == 0)
+        throw std::invalid_argument("texture and page dimensions must be greater than zero");
+
+    VirtualTextureHeader header;
+    header.size = size;
+    header.page_size = page_size;
+    header.page_border = 1;
+    header.format = format;
+
+    std::ofstream file {path, std::ios::binary};
+    if (!file)
+        throw std::runtime_error("could not open virtual texture file for writing: " + path);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const std::size_t texel_size = getTexelSize(format);
+    const auto *source = static_cast<const std::byte*>(texels);
+    const glm::ivec2 max_texel = glm::ivec2(size) - 1;
+    const auto stored_page_size = static_cast<int>(header.getStoredPageSize());
+
+    std::vector<std::byte> page_data(header.getPageByteSize());
+    const glm::uvec2 page_count = header.getPageCount();
+
+    for (std::uint32_t page_y = 0; page_y < page_count.y; page_y++)
+    {
+        for (std::uint32_t page_x = 0; page_x < page_count.x; page_x++)
+        {
+            // the first texel of the page, border included, may lie outside of the texture
+            const glm::ivec2 origin = glm::ivec2(page_x, page_y) * static_cast<int>(page_size)
+                                      - static_cast<int>(header.page_border);
+
+            std::byte *dest = page_data.data();
+            for (int y = 0; y < stored_page_size; y++)
+            {
+                for (int x = 0; x < stored_page_size; x++)
+                {
+                    const glm::ivec2 texel = glm::clamp(origin + glm::ivec2(x, y), glm::ivec2(0), max_texel);
+                    std::memcpy(dest, source + (texel.y * static_cast<std::size_t>(size.x) + texel.x) * texel_size,
+                                texel_size);
+                    dest += texel_size;
+                }
+            }
+
+            file.write(reinterpret_cast<const char*>(page_data.data()), static_cast<std::streamsize>(page_data.size()));
+        }
+    }
+
+    if (!file)
+        throw std::runtime_error("error writing virtual texture file: " + path);
+}
+
+VirtualTexture::VirtualTexture(const std::string &path, std::uint32_t cache_capacity)
+        : m_path(path), m_cache_capacity(cache_capacity)
+{
+    std::ifstream file {path, std::ios::binary};
+    if (!file.read(reinterpret_cast<char*>(&m_header), sizeof(m_header)))
+        throw std::runtime_error("could not read virtual texture file: " + path);
+
+    if (m_header.magic != VirtualTextureHeader::magic_value || m_header.version != VirtualTextureHeader::current_version)
+        throw std::runtime_error("not a virtual texture file, or unsupported version: " + path);
+
+    // the border is hardcoded in the compute shaders, see glsl_virtual_texture.hpp
+    if (m_header.page_border != 1 || m_header.page_size == 0)
+        throw std::runtime_error("unsupported virtual texture page layout: " + path);
+
+    if (cache_capacity == 0)
+        throw std::invalid_argument("cache capacity must be greater than zero");
+
+    const glm::uvec2 page_count = m_header.getPageCount();
+    const std::uint32_t total_page_count = page_count.x * page_count.y;
+
+    m_page_layers.assign(total_page_count, no_layer);
+    m_page_stamps.assign(total_page_count, 0);
+    m_page_pending.assign(total_page_count, false);
+    m_layer_pages.assign(cache_capacity, no_layer);
+
+    // page table
+    gl.CreateTextures(GL_TEXTURE_2D, 1, &m_page_table);
+    gl.TextureStorage2D(m_page_table, 1, GL_R32UI, static_cast<GLsizei>(page_count.x),
+                        static_cast<GLsizei>(page_count.y));
+    gl.TextureParameteri(m_page_table, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    gl.TextureParameteri(m_page_table, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    const std::uint32_t empty_entry = 0;
+    gl.ClearTexImage(m_page_table, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &empty_entry);
+
+    // page cache
+    const auto stored_page_size = static_cast<GLsizei>(m_header.getStoredPageSize());
+    gl.CreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_page_cache);
+    gl.TextureStorage3D(m_page_cache, 1, getGLTexelFormat(m_header.format).internal_format, stored_page_size,
+                        stored_page_size, static_cast<GLsizei>(cache_capacity));
+    gl.TextureParameteri(m_page_cache, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl.TextureParameteri(m_page_cache, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl.TextureParameteri(m_page_cache, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl.TextureParameteri(m_page_cache, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    m_loader = std::thread(&VirtualTexture::m_loaderMain, this);
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    {
+        std::lock_guard lock {m_mutex};
+        m_stop = true;
+    }
+    m_load_condition.notify_all();
+    m_loader.join();
+
+    gl.DeleteTextures(1, &m_page_table);
+    gl.DeleteTextures(1, &m_page_cache);
+}
+
+void VirtualTexture::m_loaderMain()
+{
+    std::ifstream file {m_path, std::ios::binary};
+
+    while (true)
+    {
+        std::uint32_t page_index;
+        {
+            std::unique_lock lock {m_mutex};
+            m_load_condition.wait(lock, [this] { return m_stop || !m_load_queue.empty(); });
+
+            if (m_stop)
+                return;
+
+            page_index = m_load_queue.front();
+            m_load_queue.pop_front();
+        }
+
+        const glm::uvec2 page {page_index % m_header.getPageCount().x, page_index / m_header.getPageCount().x};
+
+        // a page with no texels signals a read error
+        LoadedPage loaded_page {page_index, std::vector<std::byte>(m_header.getPageByteSize())};
+        file.seekg(static_cast<std::streamoff>(m_header.getPageFileOffset(page)));
+        if (!file.read(reinterpret_cast<char*>(loaded_page.texels.data()),
+                       static_cast<std::streamsize>(loaded_page.texels.size())))
+        {
+            loaded_page.texels.clear();
+            file.clear();
+        }
+
+        {
+            std::lock_guard lock {m_mutex};
+            m_loaded_pages.push_back(std::move(loaded_page));
+        }
+        m_ready_condition.notify_all();
+    }
+}
+
+std::pair<glm::uvec2, glm::uvec2> VirtualTexture::m_getPageRange(glm::vec2 uv_lower_bound,
+                                                                 glm::vec2 uv_upper_bound) const
+{
+    const glm::vec2 page_count {m_header.getPageCount()};
+    const glm::vec2 scale = glm::vec2(m_header.size) / static_cast<float>(m_header.page_size);
+
+    const glm::vec2 lower = glm::clamp(glm::floor(uv_lower_bound * scale), glm::vec2(0.0f), page_count - 1.0f);
+    const glm::vec2 upper = glm::clamp(glm::floor(uv_upper_bound * scale), glm::vec2(0.0f), page_count - 1.0f);
+
+    return {glm::uvec2(lower), glm::uvec2(upper)};
+}
+
+bool VirtualTexture::request(glm::vec2 uv_lower_bound, glm::vec2 uv_upper_bound)
+{
+    const auto [lower, upper] = m_getPageRange(uv_lower_bound, uv_upper_bound);
+    const glm::uvec2 extent = upper - lower + 1u;
+
+    if (extent.x * extent.y > m_cache_capacity)
+        throw std::length_error("requested region does not fit in the page cache");
+
+    m_request_stamp++;
+
+    std::vector<std::uint32_t> missing_pages;
+    const std::uint32_t row_length = m_header.getPageCount().x;
+    for (std::uint32_t y = lower.y; y <= upper.y; y++)
+    {
+        for (std::uint32_t x = lower.x; x <= upper.x; x++)
+        {
+            const std::uint32_t page_index = y * row_length + x;
+            m_page_stamps[page_index] = m_request_stamp;
+
+            if (m_page_layers[page_index] == no_layer && !m_page_pending[page_index])
+            {
+                m_page_pending[page_index] = true;
+                missing_pages.push_back(page_index);
+            }
+        }
+    }
+
+    if (missing_pages.empty())
+        return isResident(uv_lower_bound, uv_upper_bound);
+
+    // load pages closest to the center of the region first
+    const glm::vec2 center = 0.5f * glm::vec2(lower + upper);
+    const auto distance = [center, row_length](std::uint32_t page_index)
+    {
+        const glm::vec2 offset = glm::vec2(page_index % row_length, page_index / row_length) - center;
+        return glm::dot(offset, offset);
+    };
+    std::sort(missing_pages.begin(), missing_pages.end(),
+              [&](std::uint32_t a, std::uint32_t b) { return distance(a) < distance(b); });
+
+    {
+        std::lock_guard lock {m_mutex};
+        m_load_queue.insert(m_load_queue.end(), missing_pages.begin(), missing_pages.end());
+    }
+    m_load_condition.notify_one();
+
+    return false;
+}
+
+bool VirtualTexture::isResident(glm::vec2 uv_lower_bound, glm::vec2 uv_upper_bound) const
+{
+    const auto [lower, upper] = m_getPageRange(uv_lower_bound, uv_upper_bound);
+    const std::uint32_t row_length = m_header.getPageCount().x;
+
+    for (std::uint32_t y = lower.y; y <= upper.y; y++)
+        for (std::uint32_t x = lower.x; x <= upper.x; x++)
+            if (m_page_layers[y * row_length + x] == no_layer)
+                return false;
+
+    return true;
+}
+
+std::uint32_t VirtualTexture::m_allocateLayer()
+{
+    const auto free_layer = std::find(m_layer_pages.begin(), m_layer_pages.end(), no_layer);
+    if (free_layer != m_layer_pages.end())
+        return static_cast<std::uint32_t>(free_layer - m_layer_pages.begin());
+
+    // evict the least recently requested page, unless it was part of the last request
+    const auto lru_layer = std::min_element(m_layer_pages.begin(), m_layer_pages.end(),
+                                            [this](std::uint32_t a, std::uint32_t b)
+                                            { return m_page_stamps[a] < m_page_stamps[b]; });
+    const std::uint32_t evicted_page = *lru_layer;
+
+    if (m_page_stamps[evicted_page] == m_request_stamp)
+        return no_layer;
+
+    const glm::uvec2 page_count = m_header.getPageCount();
+    const std::uint32_t empty_entry = 0;
+    gl.TextureSubImage2D(m_page_table, 0, static_cast<GLint>(evicted_page % page_count.x),
+                         static_cast<GLint>(evicted_page / page_count.x), 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                         &empty_entry);
+
+    m_page_layers[evicted_page] = no_layer;
+    *lru_layer = no_layer;
+
+    return static_cast<std::uint32_t>(lru_layer - m_layer_pages.begin());
+}
+
+void VirtualTexture::update()
+{
+    std::vector<LoadedPage> loaded_pages;
+    {
+        std::lock_guard lock {m_mutex};
+        loaded_pages.swap(m_loaded_pages);
+    }
+
+    if (loaded_pages.empty())
+        return;
+
+    const GLTexelFormat texel_format = getGLTexelFormat(m_header.format);
+    const auto stored_page_size = static_cast<GLsizei>(m_header.getStoredPageSize());
+    const glm::uvec2 page_count = m_header.getPageCount();
+
+    // rows of a page are tightly packed
+    GLint unpack_alignment;
+    gl.GetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+    gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    bool read_error = false;
+    for (const LoadedPage &page : loaded_pages)
+    {
+        m_page_pending[page.index] = false;
+
+        if (page.texels.empty())
+        {
+            read_error = true;
+            continue;
+        }
+
+        // pages that are no longer needed may be dropped if the cache is full
+        const std::uint32_t layer = m_allocateLayer();
+        if (layer == no_layer)
+            continue;
+
+        gl.TextureSubImage3D(m_page_cache, 0, 0, 0, static_cast<GLint>(layer), stored_page_size, stored_page_size, 1,
+                             texel_format.format, texel_format.type, page.texels.data());
+
+        const std::uint32_t table_entry = layer + 1;
+        gl.TextureSubImage2D(m_page_table, 0, static_cast<GLint>(page.index % page_count.x),
+                             static_cast<GLint>(page.index / page_count.x), 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                             &table_entry);
+
+        m_page_layers[page.index] = layer;
+        m_layer_pages[layer] = page.index;
+    }
+
+    gl.PixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+
+    if (read_error)
+        throw std::runtime_error("error reading virtual texture file: " + m_path);
+}
+
+void VirtualTexture::makeResident(glm::vec2 uv_lower_bound, glm::vec2 uv_upper_bound)
+{
+    if (request(uv_lower_bound, uv_upper_bound))
+        return;
+
+    while (!isResident(uv_lower_bound, uv_upper_bound))
+    {
+        {
+            std::unique_lock lock {m_mutex};
+            m_ready_condition.wait(lock, [this] { return !m_loaded_pages.empty(); });
+        }
+
+        update();
+    }
+}
+
+std::uint32_t VirtualTexture::getResidentPageCount() const
+{
+    return static_cast<std::uint32_t>(std::count_if(m_layer_pages.begin(), m_layer_pages.end(),
+                                                    [](std::uint32_t page) { return page != no_layer; }));
+}
+
+} // placement
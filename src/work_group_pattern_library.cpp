@@ -0,0 +1,180 @@
+#include "placement/work_group_pattern_library.hpp"
+#include "disk_distribution_generator.hpp"
+
+#include "glm/glm.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace placement {
+
+namespace {
+
+/// Header of a pattern library file, followed by the patterns.
+struct PatternLibraryHeader
+{
+    static constexpr std::uint32_t magic_value = 0x50575050; // "PPWP"
+    static constexpr std::uint32_t current_version = 1;
+
+    std::uint32_t magic {magic_value};
+    std::uint32_t version {current_version};
+    std::uint32_t pattern_count {0};
+    std::uint32_t first_seed {0};
+    glm::vec2 bounds {0.0f};
+};
+
+static_assert(sizeof(PatternLibraryHeader) == 24, "PatternLibraryHeader must not have padding");
+static_assert(sizeof(WorkGroupPatternLibrary::Pattern) == 8 * 8 * sizeof(glm::vec2),
+              "patterns must be tightly packed, like the std430 array of the generation kernel");
+
+/// Must match hashSeed() in the generation kernel.
+std::uint32_t hashSeed(std::uint32_t x)
+{
+    x ^= x >> 16u;
+    x *= 0x7feb352du;
+    x ^= x >> 15u;
+    x *= 0x846ca68bu;
+    x ^= x >> 16u;
+    return x;
+}
+
+bool tryGeneratePattern(std::uint32_t seed, WorkGroupPatternLibrary::Pattern &pattern, glm::vec2 &bounds)
+{
+    // twice as many grid cells as candidates along each axis
+    DiskDistributionGenerator generator{1.0f, glm::uvec2(16)};
+    generator.setSeed(seed);
+    generator.setMaxAttempts(100);
+    bounds = generator.getGrid().getBounds();
+
+    try
+    {
+        for (auto &column : pattern)
+            for (auto &position : column)
+                position = generator.generate();
+    }
+    catch (const std::runtime_error&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+WorkGroupPatternLibrary WorkGroupPatternLibrary::generate(std::uint32_t count, std::uint32_t first_seed)
+{
+    if (count == 0)
+        throw std::invalid_argument("a pattern library must have at least one pattern");
+
+    glm::vec2 bounds {0.0f};
+    std::vector<Pattern> patterns(count);
+
+    std::uint32_t seed = first_seed;
+    for (auto &pattern : patterns)
+        while (!tryGeneratePattern(seed++, pattern, bounds))
+        {}
+
+    return {bounds, first_seed, std::move(patterns)};
+}
+
+WorkGroupPatternLibrary WorkGroupPatternLibrary::load(const std::string &path)
+{
+    std::ifstream file {path, std::ios::binary};
+    if (!file)
+        throw std::runtime_error("could not open pattern library file: " + path);
+
+    PatternLibraryHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != PatternLibraryHeader::magic_value
+        || header.version != PatternLibraryHeader::current_version || header.pattern_count == 0)
+        throw std::runtime_error("not a pattern library file, or unsupported version: " + path);
+
+    std::vector<Pattern> patterns(header.pattern_count);
+    file.read(reinterpret_cast<char*>(patterns.data()),
+              static_cast<std::streamsize>(patterns.size() * sizeof(Pattern)));
+    if (!file)
+        throw std::runtime_error("truncated pattern library file: " + path);
+
+    return {header.bounds, header.first_seed, std::move(patterns)};
+}
+
+WorkGroupPatternLibrary WorkGroupPatternLibrary::loadOrGenerate(const std::string &path, std::uint32_t count,
+                                                                std::uint32_t first_seed)
+{
+    try
+    {
+        WorkGroupPatternLibrary library = load(path);
+        if (library.getPatternCount() == count && library.getFirstSeed() == first_seed)
+            return library;
+    }
+    catch (const std::runtime_error&)
+    {
+        // missing or invalid, regenerate it
+    }
+
+    WorkGroupPatternLibrary library = generate(count, first_seed);
+
+    try
+    {
+        library.save(path);
+    }
+    catch (const std::runtime_error&)
+    {
+        // the cache is an optimization only
+    }
+
+    return library;
+}
+
+const WorkGroupPatternLibrary &WorkGroupPatternLibrary::getDefault()
+{
+    static const WorkGroupPatternLibrary library = generate();
+    return library;
+}
+
+void WorkGroupPatternLibrary::save(const std::string &path) const
+{
+    std::ofstream file {path, std::ios::binary};
+    if (!file)
+        throw std::runtime_error("could not open pattern library file for writing: " + path);
+
+    PatternLibraryHeader header;
+    header.pattern_count = getPatternCount();
+    header.first_seed = m_first_seed;
+    header.bounds = m_bounds;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(m_patterns.data()),
+               static_cast<std::streamsize>(m_patterns.size() * sizeof(Pattern)));
+
+    if (!file)
+        throw std::runtime_error("error writing pattern library file: " + path);
+}
+
+WorkGroupPatternLibrary::Pattern WorkGroupPatternLibrary::getSeedPattern(std::uint32_t seed) const
+{
+    // see patternPosition() in the generation kernel. The patterns tile the plane, so mirrored and shifted copies do
+    // too, and keep the minimum separation of candidates across work groups.
+    const std::uint32_t hash = hashSeed(seed);
+    const std::uint32_t shift_hash = hashSeed(hash);
+
+    const bool transpose = (hash & 0x80000000u) != 0 && m_bounds.x == m_bounds.y;
+    const glm::bvec2 mirror {(hash & 0x40000000u) != 0, (hash & 0x20000000u) != 0};
+    const glm::vec2 shift = glm::vec2(shift_hash & 0xFFFFu, shift_hash >> 16u) / 65536.0f * m_bounds;
+
+    Pattern pattern = m_patterns[hash % getPatternCount()];
+    for (auto &column : pattern)
+        for (auto &position : column)
+        {
+            if (transpose)
+                position = {position.y, position.x};
+
+            position = glm::mix(position, m_bounds - position, mirror) + shift;
+            position -= m_bounds * glm::vec2(glm::greaterThanEqual(position, m_bounds));
+        }
+
+    return pattern;
+}
+
+} // placement
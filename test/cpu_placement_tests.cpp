@@ -0,0 +1,137 @@
+#include "../example/cpu-placement.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace placement;
+using namespace placement::cpu;
+
+namespace {
+
+/// Elements sorted by position, to compare sets of elements computed in different orders.
+std::vector<ResultElement> sorted(std::vector<ResultElement> elements)
+{
+    std::sort(elements.begin(), elements.end(), [](const ResultElement &l, const ResultElement &r)
+    {
+        return std::tie(l.position.x, l.position.y, l.position.z) < std::tie(r.position.x, r.position.y, r.position.z);
+    });
+    return elements;
+}
+
+bool equalElements(const std::vector<ResultElement> &l, const std::vector<ResultElement> &r)
+{
+    return std::equal(l.begin(), l.end(), r.begin(), r.end(), [](const ResultElement &a, const ResultElement &b)
+    {
+        return a.position == b.position && a.class_index == b.class_index;
+    });
+}
+
+} // namespace
+
+TEST_CASE("CPU PlacementPipeline::forEachTile", "[cpu][tiles]")
+{
+    const GrayscaleImage heightmap {"assets/textures/grayscale/heightmap.png"};
+    const GrayscaleImage white {"assets/textures/grayscale/white.png"};
+    const WorldData world_data {{10.f, 10.f, 1.f}, &heightmap};
+    const LayerData layer_data {0.05f, {{&white, .3f, 0.f, 0.f, 1.f}, {&white, .2f, 0.f, 0.f, 1.f}}};
+
+    const glm::vec2 lower_bound {1.f, 2.f};
+    const glm::vec2 upper_bound {6.f, 5.f};
+
+    PlacementPipeline pipeline;
+    const Result expected = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    REQUIRE(expected.getElementArrayLength() > 0);
+
+    SECTION("Same elements and statistics as computePlacement()")
+    {
+        for (const auto &[tile_size, thread_count] : {std::pair<glm::uvec2, uint>{{1, 1}, 1}, {{3, 5}, 1},
+                                                      {{4, 4}, 4}, {{64, 64}, 2}})
+        {
+            CAPTURE(tile_size.x, tile_size.y, thread_count);
+
+            std::vector<std::vector<ResultElement>> class_elements(layer_data.densitymaps.size());
+            std::set<std::pair<uint, uint>> tiles;
+            bool duplicate_tile = false;
+
+            const PlacementStatistics statistics = pipeline.forEachTile(
+                    world_data, layer_data, lower_bound, upper_bound,
+                    [&](glm::uvec2 tile, const ClassBins<ResultElement> &bins)
+                    {
+                        duplicate_tile |= !tiles.emplace(tile.x, tile.y).second;
+                        for (std::size_t i = 0; i < class_elements.size(); i++)
+                            class_elements[i].insert(class_elements[i].end(),
+                                                     bins.elements.begin() + bins.class_offsets[i],
+                                                     bins.elements.begin() + bins.class_offsets[i + 1]);
+                    },
+                    tile_size, thread_count);
+
+            CHECK_FALSE(duplicate_tile);
+
+            for (uint i = 0; i < expected.getNumClasses(); i++)
+            {
+                CAPTURE(i);
+                const auto [begin, end] = expected.getClassElements(i);
+                CHECK(equalElements(sorted(class_elements[i]), sorted(std::vector<ResultElement>(begin, end))));
+            }
+
+            const PlacementStatistics &expected_statistics = expected.getStatistics();
+            CHECK(statistics.operation_count == expected_statistics.operation_count);
+            CHECK(statistics.candidate_count == expected_statistics.candidate_count);
+            CHECK(statistics.out_of_bounds_count == expected_statistics.out_of_bounds_count);
+            CHECK(statistics.excluded_count == expected_statistics.excluded_count);
+            CHECK(statistics.rejected_count == expected_statistics.rejected_count);
+            CHECK(statistics.element_capacity == expected_statistics.element_capacity);
+            CHECK(statistics.class_element_counts == expected_statistics.class_element_counts);
+        }
+    }
+
+    SECTION("Scratch memory is reused")
+    {
+        // with a single thread, every tile is binned into the same scratch bins
+        std::set<const ClassBins<ResultElement>*> scratch;
+        uint tile_count = 0;
+        static_cast<void>(pipeline.forEachTile(world_data, layer_data, lower_bound, upper_bound,
+                                               [&](glm::uvec2, const ClassBins<ResultElement> &bins)
+                                               {
+                                                   scratch.insert(&bins);
+                                                   tile_count++;
+                                               },
+                                               {2, 2}, 1));
+        CHECK(tile_count > 1);
+        CHECK(scratch.size() == 1);
+    }
+
+    SECTION("Errors")
+    {
+        const auto ignore = [](glm::uvec2, const ClassBins<ResultElement>&) {};
+        CHECK_THROWS_AS(pipeline.forEachTile(world_data, layer_data, lower_bound, upper_bound, ignore, {0, 4}),
+                        std::invalid_argument);
+
+        CHECK_THROWS_AS(pipeline.forEachTile({world_data.scale, nullptr}, layer_data, lower_bound, upper_bound,
+                                             ignore), std::logic_error);
+
+        // an exception thrown by the sink reaches the caller, from any thread, and no tile is computed after it
+        for (const uint thread_count : {1u, 4u})
+        {
+            CAPTURE(thread_count);
+            uint tile_count = 0;
+            CHECK_THROWS_AS(pipeline.forEachTile(world_data, layer_data, lower_bound, upper_bound,
+                                                 [&](glm::uvec2, const ClassBins<ResultElement>&)
+                                                 {
+                                                     if (++tile_count == 2)
+                                                         throw std::runtime_error("sink error");
+                                                 },
+                                                 {1, 1}, thread_count),
+                            std::runtime_error);
+
+            if (thread_count == 1)
+                CHECK(tile_count == 2);
+        }
+    }
+}
@@ -1,7 +1,17 @@
 #include "placement/placement.hpp"
 #include "placement/placement_pipeline.hpp"
+#include "placement/placement_cache.hpp"
+#include "placement/placement_planner.hpp"
+#include "placement/threaded_placement_pipeline.hpp"
+#include "placement/completion_queue.hpp"
+#include "placement/spatial_index.hpp"
+#include "placement/virtual_texture.hpp"
+#include "placement/baked_placement_file.hpp"
+#include "placement/placement_instance_pool.hpp"
+#include "placement/density_expression.hpp"
 
 #include "../src/disk_distribution_generator.hpp"
+#include "../src/class_binning.hpp"
 
 #include "glutils/debug.hpp"
 
@@ -15,6 +25,11 @@
 #include <map>
 #include <execution>
 #include <thread>
+#include <numeric>
+#include <random>
+#include <cstdio>
+#include <sstream>
+#include <limits>
 
 // included here to make it available to catch.hpp
 #include "ostream_operators.hpp"
@@ -589,6 +604,1979 @@ TEST_CASE("PlacementPipeline (multiclass)", "[pipeline][multiclass]")
     }
 }
 
+TEST_CASE("PlacementPipeline (multiple layers)", "[pipeline][multilayer]")
+{
+    using Element = Result::Element;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+
+    const std::vector<LayerData> layers {{0.03f, {{white_texture, .5f}, {white_texture, .4f}}},
+                                         {0.01f, {{white_texture, .3f}}},
+                                         {0.005f, {{white_texture, .2f}, {white_texture, .1f}}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    SECTION("Same results as one call per layer")
+    {
+        const auto result = pipeline.computePlacement(world_data, layers, lower_bound, upper_bound).readResult();
+        REQUIRE(result.getNumClasses() == 5);
+
+        for (std::size_t layer_index = 0; layer_index < layers.size(); layer_index++)
+        {
+            CAPTURE(layer_index);
+            const auto [begin_class, end_class] = getLayerClassRange(layers, layer_index);
+            const auto layer_result = pipeline.computePlacement(world_data, layers[layer_index], lower_bound,
+                                                                upper_bound).readResult();
+            REQUIRE(end_class - begin_class == layer_result.getNumClasses());
+            REQUIRE(layer_result.getElementArrayLength() > 0);
+
+            auto expected = layer_result.copyAllToHost();
+            for (auto &element : expected)
+                element.class_index += begin_class;
+
+            std::vector<Element> elements(result.getClassRangeElementCount(begin_class, end_class));
+            result.copyClassRangeToHost(begin_class, end_class, elements.begin());
+
+            std::sort(expected.begin(), expected.end(), elementCompare);
+            std::sort(elements.begin(), elements.end(), elementCompare);
+
+            const auto diffs = findDifferences(expected, elements);
+            CAPTURE(diffs);
+            CHECK(diffs.empty());
+        }
+    }
+
+    SECTION("Invalid arguments")
+    {
+        CHECK_THROWS_AS(pipeline.computePlacement(world_data, std::vector<LayerData>{}, lower_bound, upper_bound),
+                        std::invalid_argument);
+
+        pipeline.setElementOrder(PlacementPipeline::ElementOrder::morton);
+        CHECK_THROWS_AS(pipeline.computePlacement(world_data, layers, lower_bound, upper_bound),
+                        std::invalid_argument);
+        CHECK(pipeline.computePlacement(world_data, std::vector<LayerData>{layers[1]}, lower_bound, upper_bound)
+                      .readResult().hasCellIndex());
+    }
+}
+
+TEST_CASE("PlacementPipeline (morton order)", "[pipeline][morton]")
+{
+    using namespace placement;
+    using Element = Result::Element;
+
+    constexpr float footprint = 0.01f;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{footprint, {{white_texture, .4f}, {white_texture, .3f}, {white_texture, .2f}}};
+
+    const float lower_bound_x = GENERATE(take(2, random(0.f, .3f)));
+    const float lower_bound_y = GENERATE(take(2, random(0.f, .3f)));
+    const float size_x = GENERATE(take(2, random(.1f, .7f)));
+    const glm::vec2 lower_bound{lower_bound_x, lower_bound_y};
+    const glm::vec2 upper_bound = lower_bound + glm::vec2{size_x, .5f};
+    CAPTURE(lower_bound, upper_bound);
+
+    const auto unordered = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+    pipeline.setElementOrder(PlacementPipeline::ElementOrder::morton);
+    const auto ordered = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+    REQUIRE_FALSE(unordered.hasCellIndex());
+    REQUIRE(ordered.hasCellIndex());
+    REQUIRE(ordered.getIndexOffsets() == unordered.getIndexOffsets());
+
+    SECTION("Same elements")
+    {
+        auto unordered_elements = unordered.copyAllToHost();
+        auto ordered_elements = ordered.copyAllToHost();
+
+        std::sort(unordered_elements.begin(), unordered_elements.end(), elementCompare);
+        std::sort(ordered_elements.begin(), ordered_elements.end(), elementCompare);
+
+        const auto diffs = findDifferences(unordered_elements, ordered_elements);
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    SECTION("Cell index")
+    {
+        const CellGrid &grid = ordered.getCellGrid();
+        const auto elements = ordered.copyAllToHost();
+
+        std::vector<uint> ranks;
+        for (uint y = 0; y < grid.size.y; y++)
+            for (uint x = 0; x < grid.size.x; x++)
+                ranks.emplace_back(grid.getCellRank({x, y}));
+
+        std::sort(ranks.begin(), ranks.end());
+        std::vector<uint> expected_ranks(grid.getCellCount());
+        std::iota(expected_ranks.begin(), expected_ranks.end(), 0u);
+        REQUIRE(ranks == expected_ranks);
+
+        std::vector<Element> misplaced;
+
+        for (uint class_index = 0; class_index < ordered.getNumClasses(); class_index++)
+        {
+            uint expected_offset = 0;
+
+            for (uint y = 0; y < grid.size.y; y++)
+            {
+                for (uint x = 0; x < grid.size.x; x++)
+                {
+                    const uint rank = grid.getCellRank({x, y});
+                    const CellIndexEntry entry = ordered.getCellIndexEntry(class_index, rank);
+                    const uint begin = ordered.getClassIndexOffset(class_index) + entry.offset;
+
+                    // allow for rounding differences between the CPU and the GPU
+                    const glm::vec2 margin = grid.cell_size * 1e-4f;
+                    const glm::vec2 cell_lower_bound = grid.getCellLowerBound({x, y}) - margin;
+                    const glm::vec2 cell_upper_bound = grid.getCellUpperBound({x, y}) + margin;
+
+                    for (uint i = begin; i < begin + entry.count; i++)
+                    {
+                        const glm::vec2 position = elements[i].position;
+                        if (elements[i].class_index != class_index
+                            || glm::any(glm::lessThan(position, cell_lower_bound))
+                            || glm::any(glm::greaterThanEqual(position, cell_upper_bound)))
+                            misplaced.emplace_back(elements[i]);
+                    }
+                }
+            }
+
+            // entries must be contiguous when visited in rank order
+            for (uint rank = 0; rank < grid.getCellCount(); rank++)
+            {
+                const CellIndexEntry entry = ordered.getCellIndexEntry(class_index, rank);
+                CHECK(entry.offset == expected_offset);
+                expected_offset += entry.count;
+            }
+
+            CHECK(expected_offset == ordered.getClassElementCount(class_index));
+        }
+
+        CAPTURE(misplaced);
+        CHECK(misplaced.empty());
+    }
+}
+
+TEST_CASE("PlacementPipeline (tiles)", "[pipeline][tiles]")
+{
+    constexpr float footprint = 0.01f;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{footprint, {{white_texture, .4f}, {white_texture, .3f}, {white_texture, .2f}}};
+
+    const glm::vec2 lower_bound{.13f, .21f};
+    const glm::vec2 upper_bound{.67f, .52f};
+
+    const bool morton = GENERATE(false, true);
+    CAPTURE(morton);
+    if (morton)
+        pipeline.setElementOrder(PlacementPipeline::ElementOrder::morton);
+
+    const auto reference = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    REQUIRE(reference.getElementArrayLength() > 0);
+
+    const TileGrid grid = pipeline.makeTileGrid(footprint, lower_bound, upper_bound, {3, 2});
+    const glm::uvec2 tile_count = grid.getTileCount();
+    REQUIRE(tile_count.x * tile_count.y > 1);
+
+    std::vector<Result> tiles;
+    for (uint y = 0; y < tile_count.y; y++)
+        for (uint x = 0; x < tile_count.x; x++)
+            tiles.push_back(pipeline.computeTile(world_data, layer_data, grid, {x, y}).readResult());
+
+    std::vector<const Result*> tile_pointers;
+    for (const auto &tile : tiles)
+        tile_pointers.push_back(&tile);
+
+    SECTION("Merged tiles match a single call")
+    {
+        const auto merged = mergeResults(tile_pointers).readResult();
+        CHECK(merged.getIndexOffsets() == reference.getIndexOffsets());
+
+        auto expected_elements = reference.copyAllToHost();
+        auto merged_elements = merged.copyAllToHost();
+        std::sort(expected_elements.begin(), expected_elements.end(), elementCompare);
+        std::sort(merged_elements.begin(), merged_elements.end(), elementCompare);
+
+        const auto diffs = findDifferences(expected_elements, merged_elements);
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+
+        REQUIRE(merged.hasCellIndex() == morton);
+        if (morton)
+        {
+            CHECK(merged.getCellGrid().size == reference.getCellGrid().size);
+            CHECK(merged.getCellGrid().origin == reference.getCellGrid().origin);
+
+            std::vector<uint> expected_counts;
+            std::vector<uint> merged_counts;
+            for (uint class_index = 0; class_index < reference.getNumClasses(); class_index++)
+                for (uint rank = 0; rank < reference.getCellGrid().getCellCount(); rank++)
+                {
+                    expected_counts.push_back(reference.getCellIndexEntry(class_index, rank).count);
+                    merged_counts.push_back(merged.getCellIndexEntry(class_index, rank).count);
+                }
+            CHECK(merged_counts == expected_counts);
+        }
+    }
+
+    SECTION("Invalid arguments")
+    {
+        CHECK_THROWS_AS(pipeline.makeTileGrid(footprint, lower_bound, upper_bound, {0, 2}), std::invalid_argument);
+        CHECK_THROWS_AS(pipeline.computeTile(world_data, layer_data, grid, tile_count), std::invalid_argument);
+
+        layer_data.footprint *= 2.f;
+        CHECK_THROWS_AS(pipeline.computeTile(world_data, layer_data, grid, {0, 0}), std::invalid_argument);
+
+        if (morton)
+            CHECK_THROWS_AS(mergeResults({&tiles[0], &tiles[0]}), std::invalid_argument);
+    }
+}
+
+TEST_CASE("mergeResults and spliceResults (no classes)", "[tiles]")
+{
+    const std::array<std::uint32_t, 4> zeros {};
+    const Result empty {makeResultBuffer(0, sizeof(zeros), zeros.data())};
+
+    const Result merged = mergeResults({&empty, &empty}).readResult();
+    CHECK(merged.getNumClasses() == 0);
+    CHECK(merged.getElementArrayLength() == 0);
+
+    const Result indexed {makeResultBuffer(0, sizeof(zeros), zeros.data(), CellGrid{{0.f, 0.f}, {1.f, 1.f}, {2, 2}})};
+    REQUIRE(indexed.hasCellIndex());
+
+    const Result spliced = spliceResults(indexed, std::vector<ResultPatch>{}).readResult();
+    CHECK(spliced.getNumClasses() == 0);
+    CHECK(spliced.getElementArrayLength() == 0);
+
+    const auto makeIndexed = [&](glm::vec2 origin, glm::vec2 cell_size)
+    { return Result {makeResultBuffer(0, sizeof(zeros), zeros.data(), CellGrid{origin, cell_size, {2, 2}})}; };
+
+    const Result adjacent = makeIndexed({2.f, 0.f}, {1.f, 1.f});
+    const Result merged_indexed = mergeResults({&indexed, &adjacent}).readResult();
+    CHECK(merged_indexed.getCellGrid().size == glm::uvec2(4, 2));
+
+    const Result misaligned = makeIndexed({2.5f, 0.f}, {1.f, 1.f});
+    CHECK_THROWS_AS(mergeResults({&indexed, &misaligned}), std::invalid_argument);
+
+    const Result scaled = makeIndexed({2.f, 0.f}, {2.f, 2.f});
+    CHECK_THROWS_AS(mergeResults({&indexed, &scaled}), std::invalid_argument);
+}
+
+TEST_CASE("PlacementPlanner", "[pipeline][planner]")
+{
+    constexpr float footprint = 0.01f;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{footprint, {{white_texture, .4f}, {white_texture, .3f}}};
+
+    const glm::vec2 lower_bound{.13f, .21f};
+    const glm::vec2 upper_bound{.67f, .52f};
+
+    const bool morton = GENERATE(false, true);
+    CAPTURE(morton);
+    if (morton)
+        pipeline.setElementOrder(PlacementPipeline::ElementOrder::morton);
+
+    const auto reference = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    REQUIRE(reference.getElementArrayLength() > 0);
+    pipeline.releaseTransientBuffer();
+
+    // room for chunks of 4x4 work groups at most
+    PlacementPlanner sizing_planner {pipeline, 0};
+    const GLsizeiptr budget = sizing_planner.getChunkMemoryRequirement({4, 4}, 2);
+    PlacementPlanner planner {pipeline, budget};
+
+    const TileGrid grid = planner.plan(layer_data, lower_bound, upper_bound);
+    CHECK(grid.tile_size.x * grid.tile_size.y <= 16);
+    CHECK(planner.getChunkMemoryRequirement(grid.tile_size, 2) <= budget);
+    const glm::uvec2 chunk_count = grid.getTileCount();
+    REQUIRE(chunk_count.x * chunk_count.y > 1);
+
+    SECTION("Sink")
+    {
+        std::vector<glm::uvec2> chunks;
+        std::vector<Result> results;
+        planner.computePlacement(world_data, layer_data, lower_bound, upper_bound,
+                                 [&](glm::uvec2 chunk, Result result)
+                                 {
+                                     chunks.push_back(chunk);
+                                     results.push_back(std::move(result));
+                                 });
+
+        REQUIRE(chunks.size() == chunk_count.x * chunk_count.y);
+        CHECK(chunks.front() == glm::uvec2(0u));
+        CHECK(chunks.back() == chunk_count - 1u);
+
+        std::size_t element_count = 0;
+        for (const auto &result : results)
+            element_count += result.getElementArrayLength();
+        CHECK(element_count == reference.getElementArrayLength());
+    }
+
+    SECTION("Assembled result matches a single call")
+    {
+        const auto result = planner.computePlacement(world_data, layer_data, lower_bound, upper_bound);
+        CHECK(result.getIndexOffsets() == reference.getIndexOffsets());
+        CHECK(result.hasCellIndex() == morton);
+
+        auto expected_elements = reference.copyAllToHost();
+        auto elements = result.copyAllToHost();
+        std::sort(expected_elements.begin(), expected_elements.end(), elementCompare);
+        std::sort(elements.begin(), elements.end(), elementCompare);
+
+        const auto diffs = findDifferences(expected_elements, elements);
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    CHECK(pipeline.getTransientBufferSize() <= budget);
+
+    SECTION("Insufficient budget")
+    {
+        PlacementPlanner small_planner {pipeline, sizing_planner.getChunkMemoryRequirement({1, 1}, 2) - 1};
+        CHECK_THROWS_AS(small_planner.plan(layer_data, lower_bound, upper_bound), std::invalid_argument);
+        CHECK_THROWS_AS(PlacementPlanner(pipeline, budget, 0), std::invalid_argument);
+    }
+}
+
+TEST_CASE("PlacementPipeline (exclusion zones)", "[pipeline][exclusion]")
+{
+    using namespace placement;
+    using Element = Result::Element;
+
+    constexpr float footprint = 0.01f;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    const GLuint black_texture = s_texture_loader["assets/textures/grayscale/black.png"];
+    LayerData layer_data{footprint, {{white_texture, .4f}, {white_texture, .3f}, {white_texture, .2f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    const auto reference = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    REQUIRE(reference.getElementArrayLength() > 0);
+
+    const auto sortedElements = [](const Result &result)
+    {
+        auto elements = result.copyAllToHost();
+        std::sort(elements.begin(), elements.end(), elementCompare);
+        return elements;
+    };
+
+    SECTION("Shapes")
+    {
+        ExclusionZones exclusion_zones;
+        exclusion_zones.addCircle({.2f, .3f}, .05f);
+        exclusion_zones.addBox({.45f, .35f}, {.08f, .02f}, .7f);
+        exclusion_zones.addPolyline({{.1f, .45f}, {.3f, .4f}, {.5f, .48f}}, .03f);
+        exclusion_zones.addCircle({5.f, 5.f}, 1.f);
+
+        pipeline.setExclusionZones(exclusion_zones);
+        const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+        CHECK(result.getElementArrayLength() < reference.getElementArrayLength());
+
+        std::vector<Element> expected;
+        for (const auto &element : sortedElements(reference))
+            if (!exclusion_zones.isExcluded(glm::vec2(element.position)))
+                expected.push_back(element);
+
+        const auto diffs = findDifferences(expected, sortedElements(result));
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    SECTION("Shapes outside of the placement region")
+    {
+        ExclusionZones exclusion_zones;
+        exclusion_zones.addCircle({.8f, .8f}, .1f);
+        exclusion_zones.addBox({-.5f, .3f}, {.2f, .2f});
+        // far enough that its work group range is out of the range of int
+        exclusion_zones.addCircle({1e30f, -1e30f}, 1e20f);
+        exclusion_zones.addPolyline({{-3e38f, .3f}, {-1e38f, .3f}}, 1e37f);
+
+        pipeline.setExclusionZones(exclusion_zones);
+        const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+        CHECK(result.getIndexOffsets() == reference.getIndexOffsets());
+        const auto diffs = findDifferences(sortedElements(reference), sortedElements(result));
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    SECTION("Non-finite shapes")
+    {
+        constexpr float infinity = std::numeric_limits<float>::infinity();
+        constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+
+        ExclusionZones exclusion_zones;
+        CHECK_THROWS_AS(exclusion_zones.addCircle({.2f, .3f}, infinity), std::invalid_argument);
+        CHECK_THROWS_AS(exclusion_zones.addCircle({.2f, .3f}, nan), std::invalid_argument);
+        CHECK_THROWS_AS(exclusion_zones.addCircle({infinity, .3f}, .05f), std::invalid_argument);
+        CHECK_THROWS_AS(exclusion_zones.addBox({.45f, nan}, {.08f, .02f}), std::invalid_argument);
+        CHECK_THROWS_AS(exclusion_zones.addBox({.45f, .35f}, {infinity, .02f}), std::invalid_argument);
+        CHECK_THROWS_AS(exclusion_zones.addBox({.45f, .35f}, {.08f, .02f}, nan), std::invalid_argument);
+        CHECK_THROWS_AS(exclusion_zones.addPolyline({{.1f, .45f}, {-infinity, .4f}}, .03f), std::invalid_argument);
+        CHECK_THROWS_AS(exclusion_zones.addPolyline({{.1f, .45f}, {.3f, .4f}}, infinity), std::invalid_argument);
+        CHECK(exclusion_zones.empty());
+    }
+
+    SECTION("Mask")
+    {
+        pipeline.setExclusionMask(black_texture);
+        const auto unmasked = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+        const auto diffs = findDifferences(sortedElements(reference), sortedElements(unmasked));
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+
+        pipeline.setExclusionMask(white_texture);
+        const auto masked = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+        CHECK(masked.getElementArrayLength() == 0);
+    }
+
+    SECTION("Edit bounds")
+    {
+        ExclusionZones exclusion_zones;
+        exclusion_zones.addCircle({.2f, .3f}, .05f);
+
+        const auto first_edited_shape = exclusion_zones.size();
+        exclusion_zones.addBox({.45f, .35f}, {.08f, .02f}, .7f);
+        exclusion_zones.addCircle({.5f, .25f}, .01f);
+
+        const auto [edit_lower_bound, edit_upper_bound] = exclusion_zones.getBounds(first_edited_shape);
+        CHECK(edit_lower_bound.x > .25f);
+        CHECK(edit_upper_bound.x <= .53f);
+
+        const auto [empty_lower_bound, empty_upper_bound] = exclusion_zones.getBounds(exclusion_zones.size());
+        CHECK(glm::any(glm::greaterThan(empty_lower_bound, empty_upper_bound)));
+    }
+}
+
+TEST_CASE("PlacementPipeline (statistics)", "[pipeline][statistics]")
+{
+    using namespace placement;
+
+    constexpr float footprint = 0.01f;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{footprint, {{white_texture, .4f}, {white_texture, .3f}, {white_texture, .2f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    ExclusionZones exclusion_zones;
+    exclusion_zones.addCircle({.2f, .3f}, .05f);
+    pipeline.setExclusionZones(exclusion_zones);
+
+    SECTION("Disabled by default")
+    {
+        CHECK_FALSE(pipeline.getStatisticsEnabled());
+        const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+        CHECK_FALSE(result.getStatistics().has_value());
+        CHECK(pipeline.getStatistics().operation_count == 0);
+    }
+
+    SECTION("Counts")
+    {
+        pipeline.setStatisticsEnabled(true);
+        const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+        const auto statistics = result.getStatistics();
+        REQUIRE(statistics.has_value());
+        CHECK(statistics->operation_count == 1);
+        CHECK(statistics->out_of_bounds_count > 0);
+        CHECK(statistics->excluded_count > 0);
+        CHECK(statistics->candidate_count == statistics->out_of_bounds_count + statistics->excluded_count
+                                             + statistics->rejected_count + statistics->getElementCount());
+
+        REQUIRE(statistics->class_element_counts.size() == result.getNumClasses());
+        for (uint i = 0; i < result.getNumClasses(); i++)
+            CHECK(statistics->class_element_counts[i] == result.getClassElementCount(i));
+
+        CHECK(statistics->getFillRatio() > 0.0);
+        CHECK(statistics->getFillRatio() <= 1.0);
+
+        const auto &total = pipeline.getStatistics();
+        CHECK(total.operation_count == 1);
+        CHECK(total.candidate_count == statistics->candidate_count);
+        CHECK(total.class_element_counts == statistics->class_element_counts);
+
+        pipeline.resetStatistics();
+        CHECK(pipeline.getStatistics().operation_count == 0);
+    }
+}
+
+TEST_CASE("PlacementPipeline (bounds)", "[pipeline][bounds]")
+{
+    using namespace placement;
+    using Element = Result::Element;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    const GLuint black_texture = s_texture_loader["assets/textures/grayscale/black.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {black_texture, 1.f}, {white_texture, .2f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    // the exact extremes of some elements, as the kernel only compares positions
+    const auto getElementBounds = [](auto begin, auto end)
+    {
+        constexpr float infinity = std::numeric_limits<float>::infinity();
+        ElementBounds bounds {glm::vec3(infinity), glm::vec3(-infinity)};
+        for (auto it = begin; it != end; ++it)
+        {
+            bounds.min = glm::min(bounds.min, it->position);
+            bounds.max = glm::max(bounds.max, it->position);
+        }
+        return bounds;
+    };
+
+    SECTION("Disabled by default")
+    {
+        CHECK_FALSE(pipeline.getBoundsEnabled());
+        const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+        CHECK_FALSE(result.hasBounds());
+        CHECK_THROWS_AS(result.getClassBounds(0), std::logic_error);
+    }
+
+    SECTION("Classes")
+    {
+        pipeline.setBoundsEnabled(true);
+        const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+        REQUIRE(result.hasBounds());
+        REQUIRE_FALSE(result.hasCellIndex());
+        CHECK_THROWS_AS(result.getCellBounds(0, 0), std::logic_error);
+
+        for (uint i = 0; i < result.getNumClasses(); i++)
+        {
+            CAPTURE(i);
+            const std::vector<Element> elements = result.copyClassToHost(i);
+            const ElementBounds expected = getElementBounds(elements.begin(), elements.end());
+            const ElementBounds bounds = result.getClassBounds(i);
+
+            CHECK(bounds.isEmpty() == elements.empty());
+            CHECK(bounds.min == expected.min);
+            CHECK(bounds.max == expected.max);
+        }
+
+        CHECK(result.getClassBounds(1).isEmpty());
+    }
+
+    SECTION("Cells")
+    {
+        pipeline.setBoundsEnabled(true);
+        pipeline.setElementOrder(PlacementPipeline::ElementOrder::morton);
+        const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+        REQUIRE(result.hasBounds());
+        REQUIRE(result.hasCellIndex());
+
+        const uint cell_count = result.getCellGrid().getCellCount();
+        for (uint i = 0; i < result.getNumClasses(); i++)
+        {
+            const std::vector<Element> elements = result.copyClassToHost(i);
+            for (uint rank = 0; rank < cell_count; rank++)
+            {
+                CAPTURE(i, rank);
+                const CellIndexEntry entry = result.getCellIndexEntry(i, rank);
+                const auto begin = elements.begin() + entry.offset;
+                const ElementBounds expected = getElementBounds(begin, begin + entry.count);
+                const ElementBounds bounds = result.getCellBounds(i, rank);
+
+                CHECK(bounds.isEmpty() == (entry.count == 0));
+                CHECK(bounds.min == expected.min);
+                CHECK(bounds.max == expected.max);
+            }
+        }
+    }
+}
+
+TEST_CASE("PlacementPipeline (trace)", "[pipeline][trace]")
+{
+    using namespace placement;
+
+    struct SpanCollector final : TraceSink
+    {
+        std::vector<TraceSpan> spans;
+
+        void addSpan(const TraceSpan &span) override { spans.push_back(span); }
+
+        [[nodiscard]] bool hasSpan(const char *name, TraceSpan::Timeline timeline, std::uint64_t request_id) const
+        {
+            return std::any_of(spans.begin(), spans.end(), [&](const TraceSpan &span)
+            {
+                return std::string(span.name) == name && span.timeline == timeline && span.request_id == request_id;
+            });
+        }
+    };
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {white_texture, .3f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    SECTION("Untraced")
+    {
+        auto future_result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound);
+        CHECK(future_result.getRequestId() == 0);
+        CHECK_FALSE(pipeline.getTraceSink());
+    }
+
+    SECTION("CPU and GPU spans")
+    {
+        const auto collector = std::make_shared<SpanCollector>();
+        pipeline.setTraceSink(collector);
+
+        auto first = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound);
+        auto second = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound);
+        const auto request_id = second.getRequestId();
+        CHECK(first.getRequestId() != 0);
+        CHECK(request_id != first.getRequestId());
+
+        static_cast<void>(first.readResult());
+        static_cast<void>(second.readResult());
+        pipeline.flushTrace();
+
+        using Timeline = TraceSpan::Timeline;
+        for (const char *name : {"allocate buffers", "upload parameters", "dispatch", "fence wait", "read result"})
+        {
+            CAPTURE(name);
+            CHECK(collector->hasSpan(name, Timeline::cpu, request_id));
+        }
+
+        for (const char *name : {"generate", "evaluate", "index", "copy"})
+        {
+            CAPTURE(name);
+            CHECK(collector->hasSpan(name, Timeline::gpu, request_id));
+        }
+
+        for (const auto &span : collector->spans)
+            CHECK(span.begin <= span.end);
+    }
+
+    SECTION("Chrome trace format")
+    {
+        ChromeTraceWriter writer;
+        {
+            ScopedTraceSpan span {&writer, "frame"};
+        }
+        const auto now = TraceSpan::Clock::now();
+        writer.addSpan({"copy", 3, TraceSpan::Timeline::gpu, {}, now, now + std::chrono::microseconds(20)});
+        CHECK(writer.getSpanCount() == 2);
+
+        std::ostringstream stream;
+        stream.precision(7);
+        writer.write(stream);
+        const auto json = stream.str();
+
+        // the format of the stream is left as it was
+        CHECK(stream.precision() == 7);
+        CHECK_FALSE(stream.flags() & std::ios::fixed);
+
+        CHECK(json.find(R"("name":"frame","cat":"cpu","ph":"X","pid":1,"tid":1)") != std::string::npos);
+        CHECK(json.find(R"("name":"copy","cat":"gpu","ph":"X","pid":1,"tid":0)") != std::string::npos);
+        CHECK(json.find(R"("dur":20.000,"args":{"request":3})") != std::string::npos);
+        CHECK(json.find(R"("args":{"name":"GPU"})") != std::string::npos);
+
+        // names are escaped, including control characters
+        writer.clear();
+        writer.addSpan({"\"tile\"\t\n\x01", 0, TraceSpan::Timeline::cpu, {}, now, now});
+        std::ostringstream escaped;
+        writer.write(escaped);
+        CHECK(escaped.str().find(R"("name":"\"tile\"\t\n\u0001",)") != std::string::npos);
+
+        writer.clear();
+        CHECK(writer.getSpanCount() == 0);
+    }
+}
+
+TEST_CASE("PlacementPipeline (request recorder)", "[pipeline][recorder]")
+{
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 2.f, 3.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f, .1f, .2f, .9f}, {white_texture, .3f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    auto recorder = std::make_shared<RequestRecorder>();
+    pipeline.setRandomSeed(7);
+    pipeline.setRequestRecorder(recorder);
+    CHECK(pipeline.getRequestRecorder() == recorder);
+
+    static_cast<void>(pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult());
+
+    LayerData seeded_layer_data{0.02f, {{white_texture, .5f}}};
+    seeded_layer_data.seed = 42;
+    static_cast<void>(pipeline.computePlacement(world_data, {layer_data, seeded_layer_data}, lower_bound,
+                                                upper_bound).readResult());
+
+    pipeline.setRequestRecorder(nullptr);
+    static_cast<void>(pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult());
+
+    const auto requests = recorder->getRequests();
+    REQUIRE(requests.size() == 2);
+    CHECK(requests[0].time <= requests[1].time);
+
+    const RecordedRequest &request = requests[0];
+    CHECK(request.world_scale == world_data.scale);
+    CHECK(request.lower_bound == lower_bound);
+    CHECK(request.upper_bound == upper_bound);
+    CHECK_FALSE(request.morton);
+    REQUIRE(request.layers.size() == 1);
+    CHECK(request.layers[0].footprint == layer_data.footprint);
+    CHECK(request.layers[0].seed == 7);
+    REQUIRE(request.layers[0].density_maps.size() == 2);
+
+    const RecordedDensityMap &density_map = request.layers[0].density_maps[0];
+    CHECK(density_map.texture == white_texture);
+    CHECK(density_map.scale == .4f);
+    CHECK(density_map.offset == .1f);
+    CHECK(density_map.min_value == .2f);
+    CHECK(density_map.max_value == .9f);
+    CHECK_FALSE(density_map.virtual_texture);
+    CHECK_FALSE(density_map.expression);
+
+    REQUIRE(requests[1].layers.size() == 2);
+    CHECK(requests[1].layers[0].seed == 7);
+    CHECK(requests[1].layers[1].seed == 42);
+    CHECK(requests[1].layers[1].footprint == seeded_layer_data.footprint);
+
+    std::ostringstream stream;
+    recorder->write(stream);
+    const auto json = stream.str();
+
+    CHECK(json.rfind(R"({"version":1,"requests":[)", 0) == 0);
+    CHECK(json.find(R"("lower_bound":[0.100000001,0.200000003])") != std::string::npos);
+    CHECK(json.find(R"("seed":42,)") != std::string::npos);
+    CHECK(json.find(R"("virtual_texture":false,"expression":false)") != std::string::npos);
+
+    recorder->clear();
+    CHECK(recorder->getRequestCount() == 0);
+
+    // JSON has no literals for infinities and NaN
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+    recorder->record({{}, world_data.scale, lower_bound, upper_bound, false,
+                      {{.01f, 0, {{white_texture, std::numeric_limits<float>::quiet_NaN(), 0.f, -infinity, infinity,
+                                   false, false}}}}});
+    std::ostringstream unbounded_stream;
+    recorder->write(unbounded_stream);
+    const auto unbounded_json = unbounded_stream.str();
+
+    CHECK(unbounded_json.find(R"("scale":null,"offset":0,"min_value":-3.40282347e+38,"max_value":3.40282347e+38)")
+          != std::string::npos);
+    CHECK(unbounded_json.find("inf") == std::string::npos);
+    CHECK(unbounded_json.find("nan") == std::string::npos);
+}
+
+TEST_CASE("PlacementPipeline (deferred compilation)", "[pipeline][compilation]")
+{
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {white_texture, .3f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    PlacementPipeline waited;
+    waited.waitUntilReady();
+    CHECK(waited.isReady());
+
+    // the first operation waits for the kernels by itself
+    PlacementPipeline unwaited;
+    unwaited.setElementOrder(PlacementPipeline::ElementOrder::morton);
+    waited.setElementOrder(PlacementPipeline::ElementOrder::morton);
+
+    const Result expected = waited.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    const Result result = unwaited.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    CHECK(unwaited.isReady());
+
+    REQUIRE(result.getNumClasses() == expected.getNumClasses());
+    for (uint i = 0; i < result.getNumClasses(); i++)
+        CHECK(result.getClassElementCount(i) == expected.getClassElementCount(i));
+}
+
+TEST_CASE("PlacementPipeline (seeds)", "[pipeline][seed]")
+{
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {white_texture, .3f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    const auto sortedElements = [&](const LayerData &layer)
+    {
+        auto elements = pipeline.computePlacement(world_data, layer, lower_bound, upper_bound).readResult()
+                .copyAllToHost();
+        std::sort(elements.begin(), elements.end(), elementCompare);
+        return elements;
+    };
+
+    pipeline.setRandomSeed(5);
+    const auto pipeline_seed = sortedElements(layer_data);
+    REQUIRE_FALSE(pipeline_seed.empty());
+
+    SECTION("A layer seed overrides the seed of the pipeline")
+    {
+        pipeline.setRandomSeed(0);
+        LayerData seeded = layer_data;
+        seeded.seed = 5;
+
+        const auto diffs = findDifferences(pipeline_seed, sortedElements(seeded));
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+
+        CHECK(sortedElements(layer_data) != pipeline_seed);
+    }
+
+    SECTION("Layers of an operation use their own seeds")
+    {
+        pipeline.setRandomSeed(0);
+        std::vector<LayerData> layers {layer_data, layer_data};
+        layers[0].seed = 5;
+        layers[1].seed = 6;
+
+        const Result result = pipeline.computePlacement(world_data, layers, lower_bound, upper_bound).readResult();
+        auto first_layer = result.copyAllToHost();
+        first_layer.erase(std::remove_if(first_layer.begin(), first_layer.end(),
+                                         [](const Result::Element &element) { return element.class_index >= 2; }),
+                          first_layer.end());
+        std::sort(first_layer.begin(), first_layer.end(), elementCompare);
+
+        const auto diffs = findDifferences(pipeline_seed, first_layer);
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    SECTION("Pattern library")
+    {
+        pipeline.setPatternLibrary(WorkGroupPatternLibrary::generate(4, 100));
+        CHECK(sortedElements(layer_data) != pipeline_seed);
+
+        pipeline.setPatternLibrary(WorkGroupPatternLibrary::getDefault());
+        const auto diffs = findDifferences(pipeline_seed, sortedElements(layer_data));
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+}
+
+TEST_CASE("PlacementPipeline (density map array)", "[pipeline][density_map_array]")
+{
+    using Element = Result::Element;
+
+    constexpr glm::uvec2 texture_size {16, 16};
+    constexpr uint class_count = 3;
+
+    // gradients along x and y, and a constant
+    std::vector<std::uint8_t> texels(class_count * texture_size.x * texture_size.y);
+    for (uint y = 0; y < texture_size.y; y++)
+        for (uint x = 0; x < texture_size.x; x++)
+        {
+            const uint i = y * texture_size.x + x;
+            texels[i] = static_cast<std::uint8_t>(x * 255 / (texture_size.x - 1));
+            texels[texture_size.x * texture_size.y + i] = static_cast<std::uint8_t>(y * 255 / (texture_size.y - 1));
+            texels[2 * texture_size.x * texture_size.y + i] = 96;
+        }
+
+    const auto setSampling = [](GLuint texture)
+    {
+        gl.TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gl.TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        gl.TextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gl.TextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    };
+
+    gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLuint array_texture;
+    gl.CreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array_texture);
+    gl.TextureStorage3D(array_texture, 1, GL_R8, texture_size.x, texture_size.y, class_count);
+    gl.TextureSubImage3D(array_texture, 0, 0, 0, 0, texture_size.x, texture_size.y, class_count, GL_RED,
+                         GL_UNSIGNED_BYTE, texels.data());
+    setSampling(array_texture);
+
+    std::array<GLuint, class_count> textures {};
+    gl.CreateTextures(GL_TEXTURE_2D, class_count, textures.data());
+    for (uint i = 0; i < class_count; i++)
+    {
+        gl.TextureStorage2D(textures[i], 1, GL_R8, texture_size.x, texture_size.y);
+        gl.TextureSubImage2D(textures[i], 0, 0, 0, texture_size.x, texture_size.y, GL_RED, GL_UNSIGNED_BYTE,
+                             texels.data() + i * texture_size.x * texture_size.y);
+        setSampling(textures[i]);
+    }
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    LayerData layer_data{0.01f, {{textures[0], .5f}, {textures[1], .4f, .1f}, {textures[2], 1.f, 0.f, .2f, .3f}}};
+    LayerData array_layer_data = layer_data;
+    array_layer_data.density_map_array = array_texture;
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    const auto sortedElements = [](const Result &result)
+    {
+        auto elements = result.copyAllToHost();
+        std::sort(elements.begin(), elements.end(), elementCompare);
+        return elements;
+    };
+
+    const bool exclusion = GENERATE(false, true);
+    if (exclusion)
+    {
+        ExclusionZones exclusion_zones;
+        exclusion_zones.addCircle({.3f, .35f}, .08f);
+        pipeline.setExclusionZones(exclusion_zones);
+    }
+    CAPTURE(exclusion);
+
+    SECTION("Same result as one dispatch per class")
+    {
+        const auto expected = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+        const auto result = pipeline.computePlacement(world_data, array_layer_data, lower_bound, upper_bound)
+                .readResult();
+
+        REQUIRE(expected.getElementArrayLength() > 0);
+        CHECK(result.getIndexOffsets() == expected.getIndexOffsets());
+
+        const auto diffs = findDifferences(sortedElements(expected), sortedElements(result));
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    SECTION("Density expressions")
+    {
+        DensityExpression expression;
+        expression.texture();
+        array_layer_data.densitymaps[1].expression = &expression;
+
+        CHECK_THROWS_AS(pipeline.computePlacement(world_data, array_layer_data, lower_bound, upper_bound),
+                        std::invalid_argument);
+    }
+
+    gl.DeleteTextures(class_count, textures.data());
+    gl.DeleteTextures(1, &array_texture);
+}
+
+TEST_CASE("DensityExpression", "[density_expression]")
+{
+    using Element = Result::Element;
+
+    SECTION("CPU evaluation")
+    {
+        const DensityExpression::Inputs inputs {{10.f, 20.f, 5.f}, {.1f, .2f}, {100.f, 100.f, 10.f}, {64.f, 64.f}};
+
+        DensityExpression expression;
+        const auto altitude = expression.altitude();
+        CHECK(expression.evaluate(inputs) == 5.f);
+
+        expression.remap(altitude, 0.f, 10.f, 1.f, 3.f);
+        CHECK(expression.evaluate(inputs) == Approx(2.f));
+
+        expression.remap(altitude, 10.f, 0.f);
+        CHECK(expression.evaluate(inputs) == Approx(.5f));
+
+        expression.remap(altitude, 6.f, 6.f);
+        CHECK(expression.evaluate(inputs) == 0.f);
+
+        const auto maximum = expression.maximum(expression.constant(.25f), expression.clamp(altitude, 0.f, .1f));
+        CHECK(expression.evaluate(inputs) == .25f);
+
+        expression.multiply(maximum, expression.texture());
+        CHECK(expression.usesTexture());
+        CHECK_FALSE(expression.usesHeightmap());
+        CHECK(expression.evaluate(inputs, {}, [](glm::vec2) { return .5f; }) == .125f);
+
+        // flat terrain, then a constant slope of 45 degrees along x
+        const auto slope = expression.slope();
+        CHECK(expression.usesHeightmap());
+        CHECK(expression.evaluate(inputs, [](glm::vec2) { return .5f; }) == Approx(0.f).margin(1e-4));
+        CHECK(expression.evaluate(inputs, [](glm::vec2 uv) { return uv.x * 10.f; }) == Approx(45.f));
+
+        expression.setOutput(slope);
+        CHECK_FALSE(expression.usesTexture());
+
+        DensityExpression other;
+        CHECK_THROWS_AS(expression.setOutput(other.constant(1.f)), std::invalid_argument);
+        CHECK_THROWS_AS(DensityExpression().getOutput(), std::logic_error);
+
+        // parameters are compiled into the shader, which has no literal for them
+        constexpr float infinity = std::numeric_limits<float>::infinity();
+        constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+        const auto output = expression.getOutput().index;
+        CHECK_THROWS_AS(expression.constant(infinity), std::invalid_argument);
+        CHECK_THROWS_AS(expression.noise(nan), std::invalid_argument);
+        CHECK_THROWS_AS(expression.remap(altitude, 0.f, 1.f, -infinity), std::invalid_argument);
+        CHECK_THROWS_AS(expression.clamp(altitude, nan, 1.f), std::invalid_argument);
+        CHECK(expression.getOutput().index == output);
+    }
+
+    SECTION("Noise")
+    {
+        DensityExpression expression;
+        expression.noise(.3f, 4, 7);
+
+        for (int i = 0; i < 100; i++)
+        {
+            const glm::vec3 position {i * 1.7f, i * -.9f, 0.f};
+            const float value = expression.evaluate({position, {}, {1.f, 1.f, 1.f}, {1.f, 1.f}});
+            CHECK(value >= 0.f);
+            CHECK(value <= 1.f);
+            CHECK(value == fractalNoise(glm::vec2(position), .3f, 4, 7));
+        }
+
+        CHECK(simplexNoise({.5f, .5f}, 0) != simplexNoise({.5f, .5f}, 1));
+    }
+
+    SECTION("GLSL generation")
+    {
+        DensityExpression expression;
+        const auto unused = expression.curvature();
+        const auto altitude = expression.altitude();
+        expression.remap(altitude, 0.f, 1.f);
+
+        const std::string source = expression.compileGLSL();
+        CHECK(source.find("evaluateDensityExpression") != std::string::npos);
+        CHECK(source.find("densityExpressionCurvature") == std::string::npos);
+        CHECK_FALSE(expression.usesHeightmap());
+
+        expression.setOutput(unused);
+        CHECK(expression.compileGLSL().find("densityExpressionCurvature") != std::string::npos);
+    }
+
+    SECTION("PlacementPipeline")
+    {
+        PlacementPipeline pipeline;
+        WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+        const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+        LayerData layer_data{0.01f, {{white_texture}}};
+
+        const glm::vec2 lower_bound{.1f, .2f};
+        const glm::vec2 upper_bound{.6f, .5f};
+
+        const auto sortedElements = [&]()
+        {
+            auto elements = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult()
+                    .copyAllToHost();
+            std::sort(elements.begin(), elements.end(), elementCompare);
+            return elements;
+        };
+
+        const auto reference = sortedElements();
+        REQUIRE(!reference.empty());
+
+        DensityExpression expression;
+        layer_data.densitymaps[0].expression = &expression;
+
+        SECTION("Texture")
+        {
+            expression.texture();
+            const auto diffs = findDifferences(reference, sortedElements());
+            CAPTURE(diffs);
+            CHECK(diffs.empty());
+        }
+
+        SECTION("Altitude")
+        {
+            constexpr float min_altitude = .5f;
+            expression.remap(expression.altitude(), min_altitude, min_altitude);
+
+            std::vector<Element> expected;
+            std::copy_if(reference.begin(), reference.end(), std::back_inserter(expected),
+                         [](const Element &element) { return element.position.z >= min_altitude; });
+            REQUIRE(expected.size() < reference.size());
+
+            const auto diffs = findDifferences(expected, sortedElements());
+            CAPTURE(diffs);
+            CHECK(diffs.empty());
+        }
+
+        SECTION("Kernel cache")
+        {
+            expression.texture();
+            const auto first = sortedElements();
+            CHECK(findDifferences(first, sortedElements()).empty());
+            CHECK(pipeline.getExpressionKernelCount() == 1);
+
+            expression.multiply(expression.getOutput(), expression.constant(.5f));
+            CHECK(sortedElements().size() < first.size());
+            CHECK(pipeline.getExpressionKernelCount() == 2);
+
+            pipeline.clearExpressionKernels();
+            CHECK(pipeline.getExpressionKernelCount() == 0);
+            CHECK(sortedElements().size() < first.size());
+            CHECK(pipeline.getExpressionKernelCount() == 1);
+        }
+
+        SECTION("Slope")
+        {
+            expression.remap(expression.slope(), 30.f, 25.f);
+            const auto elements = sortedElements();
+            CHECK(elements.size() <= reference.size());
+            CHECK(std::includes(reference.begin(), reference.end(), elements.begin(), elements.end(), elementCompare));
+        }
+    }
+}
+
+TEST_CASE("PlacementPipeline (structure of arrays)", "[pipeline][soa]")
+{
+    using namespace placement;
+    using Element = Result::Element;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {white_texture, .3f}, {white_texture, .2f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    const auto element_order = GENERATE(PlacementPipeline::ElementOrder::unspecified,
+                                         PlacementPipeline::ElementOrder::morton);
+    pipeline.setElementOrder(element_order);
+
+    const auto reference = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    REQUIRE(reference.getLayout() == ResultLayout::array_of_structures);
+    REQUIRE(reference.getElementArrayLength() > 0);
+
+    pipeline.setResultLayout(ResultLayout::structure_of_arrays);
+    const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+    REQUIRE(result.getLayout() == ResultLayout::structure_of_arrays);
+    REQUIRE(result.getIndexOffsets() == reference.getIndexOffsets());
+    CHECK_THROWS_AS(result.getElements(), std::logic_error);
+    CHECK_THROWS_AS(reference.getElementArrays(), std::logic_error);
+
+    const auto class_index = GENERATE(0u, 1u, 2u);
+
+    std::vector<Element> expected = reference.copyClassToHost(class_index);
+    std::sort(expected.begin(), expected.end(), elementCompare);
+
+    SECTION("Views")
+    {
+        const ElementArrays arrays = result.getClassElementArrays(class_index);
+        REQUIRE(arrays.x.size() == expected.size());
+        REQUIRE(arrays.class_index.size() == expected.size());
+
+        std::vector<Element> elements;
+        for (std::size_t i = 0; i < arrays.x.size(); i++)
+            elements.push_back({{arrays.x[i], arrays.y[i], arrays.z[i]}, arrays.class_index[i]});
+        std::sort(elements.begin(), elements.end(), elementCompare);
+
+        const auto diffs = findDifferences(expected, elements);
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    SECTION("Copy to host")
+    {
+        std::vector<Element> elements = result.copyClassToHost(class_index);
+        std::sort(elements.begin(), elements.end(), elementCompare);
+
+        const auto diffs = findDifferences(expected, elements);
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+
+        // both layouts deinterleave into the same arrays
+        const auto count = reference.getClassElementCount(class_index);
+        std::vector<float> soa_x(count), soa_y(count), soa_z(count);
+        std::vector<float> aos_x(count), aos_y(count), aos_z(count);
+        CHECK(result.copyClassRangeToHost(class_index, class_index + 1, soa_x.data(), soa_y.data(), soa_z.data()) == count);
+        CHECK(reference.copyClassRangeToHost(class_index, class_index + 1, aos_x.data(), aos_y.data(), aos_z.data()) == count);
+
+        std::sort(soa_x.begin(), soa_x.end());
+        std::sort(aos_x.begin(), aos_x.end());
+        CHECK(soa_x == aos_x);
+    }
+
+    SECTION("Copy to GL buffer")
+    {
+        const auto count = result.getClassElementCount(class_index);
+
+        GL::Buffer buffer;
+        const auto buffer_size = static_cast<GLsizeiptr>(count * sizeof(Element));
+        buffer.allocateImmutable(std::max<GLsizeiptr>(buffer_size, 1), GL::Buffer::StorageFlags::none);
+        CHECK(result.copyClass(class_index, buffer) == count);
+
+        std::vector<std::uint32_t> words(count * 4);
+        if (count > 0)
+            buffer.read(0, buffer_size, words.data());
+
+        const ElementArrays arrays = result.getClassElementArrays(class_index);
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            CHECK(words[i] == reinterpret_cast<const std::uint32_t&>(arrays.x[i]));
+            CHECK(words[count + i] == reinterpret_cast<const std::uint32_t&>(arrays.y[i]));
+            CHECK(words[2 * count + i] == reinterpret_cast<const std::uint32_t&>(arrays.z[i]));
+            CHECK(words[3 * count + i] == class_index);
+        }
+    }
+}
+
+TEST_CASE("PlacementCache", "[pipeline][incremental]")
+{
+    using Element = Result::Element;
+
+    constexpr glm::uvec2 texture_size {4, 4};
+    constexpr float footprint = 0.01f;
+
+    std::vector<std::uint8_t> texels(texture_size.x * texture_size.y, 255);
+
+    GLuint texture;
+    gl.CreateTextures(GL_TEXTURE_2D, 1, &texture);
+    gl.TextureStorage2D(texture, 1, GL_R8, texture_size.x, texture_size.y);
+    gl.TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    gl.TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl.TextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl.TextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    const auto uploadTexels = [&]()
+    {
+        gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        gl.TextureSubImage2D(texture, 0, 0, 0, texture_size.x, texture_size.y, GL_RED, GL_UNSIGNED_BYTE,
+                             texels.data());
+    };
+    uploadTexels();
+
+    // set the texels in [lower, upper) and return the world space rectangle they cover
+    const auto editTexels = [&](glm::uvec2 lower, glm::uvec2 upper, std::uint8_t value)
+    {
+        for (uint y = lower.y; y < upper.y; y++)
+            for (uint x = lower.x; x < upper.x; x++)
+                texels[y * texture_size.x + x] = value;
+        uploadTexels();
+
+        return std::make_pair(glm::vec2(lower) / glm::vec2(texture_size), glm::vec2(upper) / glm::vec2(texture_size));
+    };
+
+    PlacementPipeline pipeline;
+    const ResultLayout layout = GENERATE(ResultLayout::array_of_structures, ResultLayout::structure_of_arrays);
+    pipeline.setResultLayout(layout);
+
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    LayerData layer_data{footprint, {{texture, .6f}, {texture, .4f}}};
+
+    const glm::vec2 lower_bound {.05f, .1f};
+    const glm::vec2 upper_bound {.9f, .8f};
+
+    PlacementCache cache {pipeline, world_data, layer_data, lower_bound, upper_bound};
+    REQUIRE(cache.getResult().hasCellIndex());
+    REQUIRE(cache.getResult().getLayout() == layout);
+    REQUIRE_FALSE(cache.isDirty());
+
+    SECTION("Edits")
+    {
+        const auto [lower_0, upper_0] = editTexels({0, 0}, {2, 2}, 0);
+        cache.markDirty(texture, lower_0, upper_0);
+        const auto [lower_1, upper_1] = editTexels({3, 1}, {4, 3}, 128);
+        cache.markDirty(texture, lower_1, upper_1);
+        REQUIRE(cache.isDirty());
+
+        const Result &updated = cache.update();
+        CHECK_FALSE(cache.isDirty());
+
+        pipeline.setElementOrder(PlacementPipeline::ElementOrder::morton);
+        const auto expected = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+
+        REQUIRE(updated.getLayout() == layout);
+        REQUIRE(updated.getCellGrid().size == expected.getCellGrid().size);
+        CHECK(updated.getIndexOffsets() == expected.getIndexOffsets());
+
+        for (uint class_index = 0; class_index < expected.getNumClasses(); class_index++)
+            for (uint rank = 0; rank < expected.getCellGrid().getCellCount(); rank++)
+            {
+                CAPTURE(class_index, rank);
+                const CellIndexEntry updated_entry = updated.getCellIndexEntry(class_index, rank);
+                const CellIndexEntry expected_entry = expected.getCellIndexEntry(class_index, rank);
+                CHECK(updated_entry.offset == expected_entry.offset);
+                CHECK(updated_entry.count == expected_entry.count);
+            }
+
+        auto updated_elements = updated.copyAllToHost();
+        auto expected_elements = expected.copyAllToHost();
+        std::sort(updated_elements.begin(), updated_elements.end(), elementCompare);
+        std::sort(expected_elements.begin(), expected_elements.end(), elementCompare);
+
+        const auto diffs = findDifferences(expected_elements, updated_elements);
+        CAPTURE(diffs);
+        CHECK(diffs.empty());
+    }
+
+    SECTION("Unused texture")
+    {
+        cache.markDirty(s_texture_loader["assets/textures/grayscale/black.png"], {0.f, 0.f}, {1.f, 1.f});
+        CHECK_FALSE(cache.isDirty());
+
+        // outside of the placement region
+        cache.markDirty(texture, {.95f, .95f}, {1.f, 1.f});
+        CHECK_FALSE(cache.isDirty());
+    }
+
+    SECTION("Invalid previous result")
+    {
+        const auto unordered = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+        CHECK_THROWS_AS(pipeline.updatePlacement(world_data, layer_data, lower_bound, upper_bound, unordered, {}),
+                        std::invalid_argument);
+
+        CHECK_THROWS_AS(pipeline.updatePlacement(world_data, layer_data, lower_bound, {.5f, .5f}, cache.getResult(),
+                                                 {}),
+                        std::invalid_argument);
+    }
+
+    gl.DeleteTextures(1, &texture);
+}
+
+TEST_CASE("CompletionQueue", "[pipeline][completion]")
+{
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {white_texture, .3f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    const auto expected = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult();
+    REQUIRE(expected.getElementArrayLength() > 0);
+
+    SECTION("Continuations")
+    {
+        CompletionQueue queue;
+        std::vector<std::size_t> completion_order;
+
+        constexpr std::size_t request_count = 4;
+        for (std::size_t i = 0; i < request_count; i++)
+            pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound)
+                    .then(queue, [&, i](Result result)
+                    {
+                        CHECK(result.getIndexOffsets() == expected.getIndexOffsets());
+                        completion_order.push_back(i);
+
+                        // continuations may queue further work
+                        if (i == 0)
+                            pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound)
+                                    .then(queue, [&](Result) { completion_order.push_back(request_count); });
+                    });
+        CHECK(queue.size() == request_count);
+
+        queue.drain();
+        CHECK(queue.empty());
+        CHECK(completion_order == std::vector<std::size_t>{0, 1, 2, 3, 4});
+        CHECK(queue.pollCompletions() == 0);
+    }
+
+    SECTION("waitAny and waitAll")
+    {
+        CHECK_FALSE(waitAny({}, std::chrono::nanoseconds::zero()).has_value());
+        CHECK(waitAll({}));
+
+        std::vector<FutureResult> future_results;
+        for (int i = 0; i < 3; i++)
+            future_results.push_back(pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound));
+
+        const auto first = waitAny(future_results);
+        REQUIRE(first.has_value());
+        CHECK(*first < future_results.size());
+        CHECK(future_results[*first].isReady());
+
+        REQUIRE(waitAll(future_results));
+        for (auto &future_result : future_results)
+            CHECK(future_result.readResult().getIndexOffsets() == expected.getIndexOffsets());
+    }
+}
+
+TEST_CASE("ThreadedPlacementPipeline", "[pipeline][threaded]")
+{
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {white_texture, .3f}}};
+
+    const glm::vec2 lower_bound{.1f, .2f};
+    const glm::vec2 upper_bound{.6f, .5f};
+
+    const auto sortedElements = [](const Result &result)
+    {
+        auto elements = result.copyAllToHost();
+        std::sort(elements.begin(), elements.end(), elementCompare);
+        return elements;
+    };
+
+    // textures must be complete before the worker context uses them
+    gl.Finish();
+
+    GLFWwindow *worker_window = glfwCreateWindow(1, 1, "TEST WORKER", nullptr, glfwGetCurrentContext());
+    REQUIRE(worker_window);
+
+    {
+        ThreadedPlacementPipeline threaded_pipeline {[worker_window] { glfwMakeContextCurrent(worker_window); },
+                                                     [] { glfwMakeContextCurrent(nullptr); }};
+
+        SECTION("Same result as PlacementPipeline")
+        {
+            pipeline.setRandomSeed(7);
+            const auto expected = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound)
+                    .readResult();
+            REQUIRE(expected.getElementArrayLength() > 0);
+
+            threaded_pipeline.configure([](PlacementPipeline &worker_pipeline) { worker_pipeline.setRandomSeed(7); });
+
+            // queue several requests before waiting for any of them
+            std::vector<std::future<Result>> futures;
+            for (int i = 0; i < 4; i++)
+                futures.push_back(threaded_pipeline.computePlacement(world_data, layer_data, lower_bound,
+                                                                     upper_bound));
+
+            for (auto &future : futures)
+            {
+                const Result result = future.get();
+                CHECK(result.getIndexOffsets() == expected.getIndexOffsets());
+
+                const auto diffs = findDifferences(sortedElements(expected), sortedElements(result));
+                CAPTURE(diffs);
+                CHECK(diffs.empty());
+            }
+        }
+
+        SECTION("Errors")
+        {
+            auto future = threaded_pipeline.submit([](PlacementPipeline&) -> FutureResult
+                                                   { throw std::invalid_argument("test"); });
+            CHECK_THROWS_AS(future.get(), std::invalid_argument);
+
+            // the worker keeps serving requests
+            CHECK(threaded_pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).get()
+                          .getElementArrayLength() > 0);
+        }
+    }
+
+    // a context that can't be made current is reported like a pipeline that can't be constructed
+    bool released = false;
+    {
+        ThreadedPlacementPipeline failed_pipeline {[] { throw std::runtime_error("no context"); },
+                                                   [&released] { released = true; }};
+        CHECK_THROWS_AS(failed_pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).get(),
+                        std::runtime_error);
+    }
+    CHECK_FALSE(released);
+
+    glfwDestroyWindow(worker_window);
+}
+
+TEST_CASE("VirtualTexture", "[virtual_texture]")
+{
+    using namespace placement;
+
+    constexpr glm::uvec2 texture_size {300, 200};
+    constexpr std::uint32_t page_size = 64;
+    const std::string path = "virtual_texture_test.ppvt";
+
+    // a gradient along both axes, and a constant texture
+    std::vector<std::uint8_t> gradient_texels(texture_size.x * texture_size.y);
+    for (uint y = 0; y < texture_size.y; y++)
+        for (uint x = 0; x < texture_size.x; x++)
+            gradient_texels[y * texture_size.x + x] = static_cast<std::uint8_t>((x + 2 * y) % 256);
+
+    writeVirtualTextureFile(path, TexelFormat::r8, texture_size, gradient_texels.data(), page_size);
+
+    const auto makeTexture = [&](const std::vector<std::uint8_t> &texels)
+    {
+        GLuint texture;
+        gl.CreateTextures(GL_TEXTURE_2D, 1, &texture);
+        gl.TextureStorage2D(texture, 1, GL_R8, texture_size.x, texture_size.y);
+        gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        gl.TextureSubImage2D(texture, 0, 0, 0, texture_size.x, texture_size.y, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+        gl.TextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        gl.TextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        gl.TextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gl.TextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    };
+
+    SECTION("Page cache")
+    {
+        VirtualTexture texture {path, 4};
+        REQUIRE(texture.getHeader().getPageCount() == glm::uvec2(5, 4));
+        CHECK(texture.getResidentPageCount() == 0);
+
+        CHECK_THROWS_AS(texture.request({0.f, 0.f}, {1.f, 1.f}), std::length_error);
+
+        const glm::vec2 page_uv = glm::vec2(page_size) / glm::vec2(texture_size);
+
+        texture.makeResident({0.f, 0.f}, 1.5f * page_uv);
+        CHECK(texture.isResident({0.f, 0.f}, 1.5f * page_uv));
+        CHECK(texture.getResidentPageCount() == 4);
+
+        // requesting the same region again doesn't load anything
+        CHECK(texture.request({0.f, 0.f}, page_uv * 0.5f));
+
+        // the least recently requested pages are evicted
+        texture.makeResident(glm::vec2(3.f, 2.f) * page_uv, glm::vec2(3.5f, 2.5f) * page_uv);
+        CHECK(texture.getResidentPageCount() == 4);
+        CHECK(texture.isResident({0.f, 0.f}, page_uv * 0.5f));
+        CHECK_FALSE(texture.isResident({0.f, 0.f}, 1.5f * page_uv));
+    }
+
+    SECTION("Placement")
+    {
+        constexpr float footprint = 0.01f;
+        const GLuint gradient_texture = makeTexture(gradient_texels);
+        const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+
+        const std::string white_path = "virtual_texture_test_white.ppvt";
+        const std::vector<std::uint8_t> white_texels(texture_size.x * texture_size.y, 255);
+        writeVirtualTextureFile(white_path, TexelFormat::r8, texture_size, white_texels.data(), page_size);
+
+        VirtualTexture virtual_heightmap {path, 20};
+        VirtualTexture virtual_density_map {white_path, 20};
+
+        PlacementPipeline pipeline;
+        WorldData world_data{{1.f, 1.f, 1.f}, gradient_texture};
+        LayerData layer_data{footprint, {{white_texture, .4f}, {white_texture, .3f}}};
+
+        const glm::vec2 lower_bound{.2f, .3f};
+        const glm::vec2 upper_bound{.5f, .6f};
+
+        auto reference = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult()
+                .copyAllToHost();
+
+        world_data.virtual_heightmap = &virtual_heightmap;
+        layer_data.densitymaps[1].virtual_texture = &virtual_density_map;
+
+        CHECK_FALSE(pipeline.requestResidency(world_data, layer_data, lower_bound, upper_bound));
+        auto result = pipeline.computePlacement(world_data, layer_data, lower_bound, upper_bound).readResult()
+                .copyAllToHost();
+        CHECK(pipeline.requestResidency(world_data, layer_data, lower_bound, upper_bound));
+
+        std::sort(reference.begin(), reference.end(), elementCompare);
+        std::sort(result.begin(), result.end(), elementCompare);
+
+        REQUIRE(result.size() == reference.size());
+        for (std::size_t i = 0; i < result.size(); i++)
+        {
+            CAPTURE(i);
+            CHECK(result[i].class_index == reference[i].class_index);
+            CHECK(glm::vec2(result[i].position) == glm::vec2(reference[i].position));
+            CHECK(result[i].position.z == Approx(reference[i].position.z).margin(1e-3));
+        }
+
+        gl.DeleteTextures(1, &gradient_texture);
+        std::remove(white_path.c_str());
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("BakedPlacementFile", "[baked]")
+{
+    using namespace placement;
+
+    constexpr float footprint = 0.01f;
+    constexpr glm::uvec2 tile_count {3, 2};
+    constexpr glm::vec2 tile_size {.2f, .25f};
+    constexpr glm::vec2 origin {.1f, .05f};
+    const std::string path = "baked_placement_test.ppbk";
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{footprint, {{white_texture, .4f}, {white_texture, .3f}, {white_texture, .2f}}};
+
+    BakedPlacementWriter writer {3, origin, tile_size, tile_count};
+
+    // the last tile is left empty
+    std::vector<std::vector<Result::Element>> expected_tiles(tile_count.x * tile_count.y);
+    for (uint y = 0; y < tile_count.y; y++)
+    {
+        for (uint x = 0; x < tile_count.x; x++)
+        {
+            if (x == tile_count.x - 1 && y == tile_count.y - 1)
+                continue;
+
+            const glm::vec2 lower_bound = origin + glm::vec2(x, y) * tile_size;
+            const auto result = pipeline.computePlacement(world_data, layer_data, lower_bound,
+                                                          lower_bound + tile_size).readResult();
+            writer.setTile({x, y}, result);
+            expected_tiles[y * tile_count.x + x] = result.copyAllToHost();
+        }
+    }
+
+    writer.write(path);
+
+    {
+        const BakedPlacementFile file {path};
+        REQUIRE(file.getNumClasses() == 3);
+        REQUIRE(file.getTileCount() == tile_count);
+
+        CHECK(file.getTile(origin + 1.5f * tile_size) == glm::uvec2(1, 1));
+        CHECK(file.getTile(glm::vec2(-1.f)) == glm::uvec2(0, 0));
+        CHECK_THROWS_AS(file.getTileView(tile_count), std::out_of_range);
+
+        for (uint y = 0; y < tile_count.y; y++)
+        {
+            for (uint x = 0; x < tile_count.x; x++)
+            {
+                CAPTURE(x, y);
+                const auto &expected = expected_tiles[y * tile_count.x + x];
+
+                const auto view = file.getTileView({x, y});
+                REQUIRE(view.getElementCount() == expected.size());
+                CHECK(std::equal(view.begin(), view.end(), expected.begin()));
+
+                const auto [class_begin, class_end] = view.getClassElements(1);
+                CHECK(std::all_of(class_begin, class_end, [](const Result::Element &e) { return e.class_index == 1; }));
+
+                const Result result = file.loadTile({x, y});
+                CHECK(result.getElementArrayLength() == expected.size());
+                CHECK(result.copyAllToHost() == expected);
+                for (uint class_index = 0; class_index < 3; class_index++)
+                    CHECK(result.getClassIndexOffset(class_index) == view.getClassIndexOffset(class_index));
+
+                if (expected.empty())
+                    continue;
+
+                GL::Buffer buffer;
+                buffer.allocateImmutable(static_cast<GLsizeiptr>(expected.size() * sizeof(Result::Element)),
+                                         GL::Buffer::StorageFlags::dynamic_storage);
+                CHECK(file.uploadTile({x, y}, buffer) == expected.size());
+
+                std::vector<Result::Element> uploaded(expected.size());
+                gl.GetNamedBufferSubData(buffer.getName(), 0, uploaded.size() * sizeof(Result::Element),
+                                         uploaded.data());
+                CHECK(uploaded == expected);
+            }
+        }
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("PlacementInstancePool", "[instance_pool]")
+{
+    using namespace placement;
+    using Element = Result::Element;
+    using uint = PlacementInstancePool::uint;
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/heightmap.png"]};
+    const GLuint white_texture = s_texture_loader["assets/textures/grayscale/white.png"];
+    LayerData layer_data{0.01f, {{white_texture, .4f}, {white_texture, .3f}}};
+
+    std::vector<Result> results;
+    for (float x : {0.f, .2f, .4f})
+        results.push_back(pipeline.computePlacement(world_data, layer_data, {x, 0.f}, {x + .2f, .2f}).readResult());
+
+    uint total_count = 0;
+    for (const auto &result : results)
+        total_count += result.getElementArrayLength();
+    REQUIRE(results[0].getElementArrayLength() > 0);
+
+    PlacementInstancePool pool {total_count, 2};
+    CHECK(pool.getLargestFreeRange() == total_count);
+
+    const auto readPool = [&](uint offset, uint count)
+    {
+        std::vector<Element> elements(count);
+        gl.GetNamedBufferSubData(pool.getBuffer().getName(), offset * sizeof(Element), count * sizeof(Element),
+                                 elements.data());
+        return elements;
+    };
+
+    std::vector<PlacementInstancePool::TileId> tiles;
+    for (const auto &result : results)
+    {
+        const auto tile = pool.insert(result);
+        REQUIRE(tile.has_value());
+        tiles.push_back(*tile);
+    }
+
+    CHECK(pool.getTileCount() == 3);
+    CHECK(pool.getElementCount() == total_count);
+    CHECK(pool.getLargestFreeRange() == 0);
+
+    SECTION("Elements")
+    {
+        for (std::size_t i = 0; i < results.size(); i++)
+        {
+            CAPTURE(i);
+            CHECK(pool.getTileIndexOffsets(tiles[i]) == results[i].getIndexOffsets());
+            CHECK(readPool(pool.getTileElementOffset(tiles[i]), results[i].getElementArrayLength())
+                  == results[i].copyAllToHost());
+        }
+    }
+
+    SECTION("Full")
+    {
+        CHECK_FALSE(pool.insert(results[0]).has_value());
+        CHECK(pool.getTileCount() == 3);
+    }
+
+    SECTION("Reuse")
+    {
+        pool.erase(tiles[1]);
+        pool.erase(tiles[0]);
+        CHECK_FALSE(pool.contains(tiles[0]));
+        CHECK(pool.getElementCount() == results[2].getElementArrayLength());
+
+        // the freed ranges are adjacent, and merged
+        CHECK(pool.getLargestFreeRange() == results[0].getElementArrayLength() + results[1].getElementArrayLength());
+
+        const auto tile = pool.insert(results[1]);
+        REQUIRE(tile.has_value());
+        CHECK(pool.getTileElementOffset(*tile) == 0);
+        CHECK(readPool(0, results[1].getElementArrayLength()) == results[1].copyAllToHost());
+
+        pool.clear();
+        CHECK(pool.getTileCount() == 0);
+        CHECK(pool.getLargestFreeRange() == total_count);
+    }
+
+    SECTION("Draw commands")
+    {
+        CHECK(pool.makeDrawCommands(0).empty());
+
+        pool.setClassMesh(0, {36, 6, 2});
+        const auto commands = pool.makeDrawCommands(0);
+
+        std::vector<DrawElementsIndirectCommand> expected;
+        for (std::size_t i = 0; i < results.size(); i++)
+            if (results[i].getClassElementCount(0) > 0)
+                expected.push_back({36, results[i].getClassElementCount(0), 6, 2,
+                                    pool.getTileElementOffset(tiles[i]) + results[i].getClassIndexOffset(0)});
+
+        REQUIRE(commands.size() == expected.size());
+        for (std::size_t i = 0; i < commands.size(); i++)
+        {
+            CAPTURE(i);
+            CHECK(commands[i].count == expected[i].count);
+            CHECK(commands[i].instance_count == expected[i].instance_count);
+            CHECK(commands[i].first_index == expected[i].first_index);
+            CHECK(commands[i].base_vertex == expected[i].base_vertex);
+            CHECK(commands[i].base_instance == expected[i].base_instance);
+        }
+
+        CHECK(pool.updateDrawCommands());
+        CHECK_FALSE(pool.updateDrawCommands());
+
+        const auto list = pool.getDrawCommandList(0);
+        CHECK(list.offset == 0);
+        CHECK(list.count == static_cast<GLsizei>(commands.size()));
+        CHECK(pool.getDrawCommandList(1).count == 0);
+
+        std::vector<DrawElementsIndirectCommand> uploaded(commands.size());
+        gl.GetNamedBufferSubData(pool.getDrawCommandBuffer().getName(), list.offset,
+                                 uploaded.size() * sizeof(DrawElementsIndirectCommand), uploaded.data());
+        for (std::size_t i = 0; i < commands.size(); i++)
+            CHECK(uploaded[i].base_instance == commands[i].base_instance);
+
+        pool.erase(tiles[0]);
+        CHECK(pool.updateDrawCommands());
+    }
+}
+
+TEST_CASE("SpatialIndex", "[spatial_index]")
+{
+    using namespace placement;
+    using Index = SpatialIndex::Index;
+
+    const float footprint = GENERATE(take(2, random(0.01f, 0.05f)));
+    CAPTURE(footprint);
+
+    PlacementPipeline pipeline;
+    WorldData world_data{{1.f, 1.f, 1.f}, s_texture_loader["assets/textures/grayscale/black.png"]};
+    const GLuint gradient_texture = s_texture_loader["assets/textures/grayscale/radial_gradient.png"];
+    LayerData layer_data{footprint, {{gradient_texture, .5f}, {gradient_texture, .5f}}};
+
+    const auto result = pipeline.computePlacement(world_data, layer_data, glm::vec2(0.f), glm::vec2(1.f)).readResult();
+    const auto elements = result.copyAllToHost();
+    REQUIRE(!elements.empty());
+
+    const SpatialIndex index {result, footprint};
+    REQUIRE(index.size() == elements.size());
+
+    std::default_random_engine random_engine {Catch::rngSeed()};
+    std::uniform_real_distribution<float> position_dist {-0.1f, 1.1f};
+    std::uniform_real_distribution<float> radius_dist {0.0f, 0.2f};
+
+    std::vector<glm::vec2> query_points;
+    for (int i = 0; i < 100; i++)
+        query_points.emplace_back(position_dist(random_engine), position_dist(random_engine));
+
+    const auto sorted = [](std::vector<Index> indices)
+    {
+        std::sort(indices.begin(), indices.end());
+        return indices;
+    };
+
+    SECTION("queryRadius")
+    {
+        for (const glm::vec2 point : query_points)
+        {
+            const float radius = radius_dist(random_engine);
+
+            std::vector<Index> expected;
+            for (Index i = 0; i < elements.size(); i++)
+                if (glm::distance(glm::vec2(elements[i].position), point) <= radius)
+                    expected.emplace_back(i);
+
+            CAPTURE(point, radius);
+            CHECK(sorted(index.queryRadius(point, radius)) == expected);
+        }
+
+        const auto batched = index.queryRadius(std::execution::par, query_points, 0.1f);
+        REQUIRE(batched.size() == query_points.size());
+        for (std::size_t i = 0; i < query_points.size(); i++)
+            CHECK(sorted(batched[i]) == sorted(index.queryRadius(query_points[i], 0.1f)));
+    }
+
+    SECTION("queryBox")
+    {
+        for (const glm::vec2 point : query_points)
+        {
+            const glm::vec2 upper_bound = point + glm::vec2(radius_dist(random_engine), radius_dist(random_engine));
+
+            std::vector<Index> expected;
+            for (Index i = 0; i < elements.size(); i++)
+            {
+                const glm::vec2 position = elements[i].position;
+                if (glm::all(glm::greaterThanEqual(position, point)) && glm::all(glm::lessThan(position, upper_bound)))
+                    expected.emplace_back(i);
+            }
+
+            CAPTURE(point, upper_bound);
+            CHECK(sorted(index.queryBox(point, upper_bound)) == expected);
+        }
+    }
+
+    SECTION("nearest")
+    {
+        for (const glm::vec2 point : query_points)
+        {
+            float min_distance = std::numeric_limits<float>::infinity();
+            for (const auto &element : elements)
+                min_distance = std::min(min_distance, glm::distance(glm::vec2(element.position), point));
+
+            const auto nearest = index.nearest(point);
+            REQUIRE(nearest.has_value());
+
+            CAPTURE(point);
+            CHECK(glm::distance(glm::vec2(elements[*nearest].position), point) == Approx(min_distance));
+        }
+
+        const auto batched = index.nearest(std::execution::par, query_points);
+        for (std::size_t i = 0; i < query_points.size(); i++)
+            CHECK(batched[i] == index.nearest(query_points[i]));
+
+        CHECK_FALSE(index.nearest(glm::vec2(-10.f), 1.f).has_value());
+    }
+
+    SECTION("Non-finite arguments")
+    {
+        constexpr float infinity = std::numeric_limits<float>::infinity();
+        constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+
+        CHECK(index.queryRadius(glm::vec2(.5f), infinity).size() == elements.size());
+        CHECK(index.queryRadius(glm::vec2(.5f), 1e30f).size() == elements.size());
+        CHECK(index.queryBox(glm::vec2(-infinity), glm::vec2(infinity)).size() == elements.size());
+        CHECK(index.queryRadius(glm::vec2(nan), 1.f).empty());
+        CHECK(index.queryRadius(glm::vec2(.5f), nan).empty());
+        CHECK(index.nearest(glm::vec2(1e30f, -1e30f)).has_value());
+        CHECK_FALSE(index.nearest(glm::vec2(nan)).has_value());
+
+        CHECK_THROWS_AS(SpatialIndex({{0.f, 0.f}, {nan, 1.f}}, footprint), std::invalid_argument);
+        CHECK_THROWS_AS(SpatialIndex({{0.f, 0.f}, {infinity, 1.f}}, footprint), std::invalid_argument);
+    }
+
+    SECTION("Collinear positions")
+    {
+        // no area, so the cell size must not fall back to the footprint along the whole extent
+        const SpatialIndex endpoints {{{0.f, 0.f}, {1e6f, 0.f}}, footprint};
+        CHECK(endpoints.getGridSize().x <= 5);
+        CHECK(endpoints.getGridSize().y == 1);
+        CHECK(endpoints.queryRadius({1e6f, 0.f}, 1.f) == std::vector<Index>{1});
+
+        const SpatialIndex single {std::vector<glm::vec2>{{.5f, .5f}}, footprint};
+        CHECK(single.getGridSize() == glm::uvec2(1));
+        CHECK(single.nearest({.5f, .5f}) == Index{0});
+
+        std::vector<glm::vec2> column;
+        for (int i = 0; i < 1000; i++)
+            column.emplace_back(.5f, 1000.f * static_cast<float>(i));
+
+        const SpatialIndex column_index {column, footprint};
+        CHECK(column_index.getGridSize().x == 1);
+        CHECK(column_index.getGridSize().y <= 2 * column.size() + 1);
+        CHECK(sorted(column_index.queryRadius({.5f, 500000.f}, 1500.f)) == std::vector<Index>{499, 500, 501});
+        CHECK(column_index.nearest({.5f, 123400.f}) == Index{123});
+    }
+}
+
+TEST_CASE("ParameterBuffer", "[kernel]")
+{
+    constexpr GLsizeiptr size = 4096;
+    constexpr GLuint binding_index = 3;
+
+    ParameterBuffer buffer {size};
+    REQUIRE(buffer.getSize() <= size);
+    REQUIRE(buffer.getSize() > 0);
+
+    GLint alignment;
+    gl.GetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    // enough blocks to wrap around the buffer a few times
+    std::array<std::uint32_t, 20> block {};
+    std::vector<GLintptr> offsets;
+    for (std::uint32_t i = 0; i < 200; i++)
+    {
+        block.fill(i);
+        buffer.bind(binding_index, block);
+
+        const GLintptr offset = buffer.getLastOffset();
+        CAPTURE(i, offset);
+        CHECK(offset % alignment == 0);
+        CHECK(offset + static_cast<GLintptr>(sizeof(block)) <= buffer.getSize());
+        offsets.push_back(offset);
+
+        GLint bound_buffer;
+        gl.GetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, binding_index, &bound_buffer);
+        CHECK(static_cast<GLuint>(bound_buffer) == buffer.getBuffer().getName());
+
+        std::array<std::uint32_t, 20> contents {};
+        gl.GetNamedBufferSubData(buffer.getBuffer().getName(), offset, sizeof(contents), contents.data());
+        CHECK(contents == block);
+    }
+
+    CHECK(std::count(offsets.begin(), offsets.end(), offsets.front()) > 1);
+
+    std::vector<std::byte> large_block(buffer.getSize());
+    CHECK_THROWS_AS(buffer.bind(binding_index, large_block.data(), buffer.getSize()), std::length_error);
+}
+
 TEST_CASE("GenerationKernel", "[generation][kernel]")
 {
     GenerationKernel kernel;
@@ -633,8 +2621,18 @@ TEST_CASE("GenerationKernel", "[generation][kernel]")
     buffer.bindRange(GL::Buffer::IndexedTarget::shader_storage, world_uv_binding_index, world_uv_range);
     buffer.bindRange(GL::Buffer::IndexedTarget::shader_storage, density_binding_index, density_range);
 
-    kernel(wg_count, /*work group index offset*/ {0, 0}, footprint, world_scale,
-           height_texture_unit, candidate_binding_index, world_uv_binding_index, density_binding_index);
+    const auto &pattern_library = WorkGroupPatternLibrary::getDefault();
+    const auto &patterns = pattern_library.getPatterns();
+    const GL::Buffer::Range pattern_range{0, static_cast<GLsizeiptr>(patterns.size() * sizeof(patterns.front()))};
+    GL::Buffer pattern_buffer;
+    pattern_buffer.allocateImmutable(pattern_range.size, GL::Buffer::StorageFlags::none, patterns.data());
+
+    constexpr uint pattern_binding_index = 3;
+    pattern_buffer.bindRange(GL::Buffer::IndexedTarget::shader_storage, pattern_binding_index, pattern_range);
+    kernel.setWorkGroupPatternBoundaries(pattern_library.getBounds());
+
+    kernel(wg_count, /*work group index offset*/ {0, 0}, footprint, world_scale, /*seed*/ 0, height_texture_unit,
+           pattern_binding_index, candidate_binding_index, world_uv_binding_index, density_binding_index);
     gl.MemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
 
     std::vector<Result::Element> candidates;
@@ -1092,6 +3090,107 @@ TEST_CASE("CopyKernel", "[copy][kernel]")
     CHECK(results == expected_results);
 }
 
+TEST_CASE("binByClass")
+{
+    constexpr uint class_count = 5;
+    constexpr uint invalid_index = -1u;
+
+    std::mt19937 generator {GENERATE(take(3, random(0u, -1u)))};
+    std::uniform_int_distribution<uint> class_distribution {0, class_count};
+
+    std::vector<Result::Element> candidates(10000);
+    for (std::size_t i = 0; i < candidates.size(); i++)
+    {
+        const uint class_index = class_distribution(generator);
+        candidates[i] = {glm::vec3(static_cast<float>(i)), class_index == class_count ? invalid_index : class_index};
+    }
+
+    // a stable sort by class, without the rejected candidates
+    std::vector<Result::Element> expected;
+    std::copy_if(candidates.begin(), candidates.end(), std::back_inserter(expected),
+                 [](const Result::Element &candidate) { return candidate.class_index != invalid_index; });
+    std::stable_sort(expected.begin(), expected.end(), [](const Result::Element &l, const Result::Element &r)
+    { return l.class_index < r.class_index; });
+
+    const auto check = [&](const ClassBins<Result::Element> &bins)
+    {
+        CHECK(bins.elements == expected);
+        REQUIRE(bins.class_offsets.size() == class_count + 1);
+        CHECK(bins.class_offsets.back() == expected.size());
+        for (uint class_index = 0; class_index < class_count; class_index++)
+        {
+            const auto begin = bins.elements.begin() + bins.class_offsets[class_index];
+            const auto end = bins.elements.begin() + bins.class_offsets[class_index + 1];
+            CHECK(std::all_of(begin, end, [class_index](const Result::Element &element)
+            { return element.class_index == class_index; }));
+        }
+    };
+
+    check(binByClass(std::execution::seq, candidates, class_count));
+    check(binByClass(std::execution::par_unseq, candidates, class_count));
+}
+
+TEST_CASE("WorkGroupPatternLibrary", "[pattern]")
+{
+    const auto library = WorkGroupPatternLibrary::generate(4, 40);
+    REQUIRE(library.getPatternCount() == 4);
+    CHECK(library.getFirstSeed() == 40);
+
+    const glm::vec2 bounds = library.getBounds();
+
+    // the minimum separation of the disk distribution, also across the edges of the repeated pattern
+    const auto checkPattern = [&](const WorkGroupPatternLibrary::Pattern &pattern)
+    {
+        std::vector<glm::vec2> positions;
+        for (const auto &column : pattern)
+            for (glm::vec2 position : column)
+            {
+                CHECK(glm::all(glm::greaterThanEqual(position, glm::vec2(0.0f))));
+                CHECK(glm::all(glm::lessThan(position, bounds)));
+                positions.push_back(position);
+            }
+
+        for (std::size_t i = 0; i < positions.size(); i++)
+            for (std::size_t j = 0; j < i; j++)
+                for (int x = -1; x <= 1; x++)
+                    for (int y = -1; y <= 1; y++)
+                        CHECK(glm::distance(positions[i], positions[j] + glm::vec2(x, y) * bounds) > 1.0f);
+    };
+
+    for (const auto &pattern : library.getPatterns())
+        checkPattern(pattern);
+
+    for (std::uint32_t seed : {0u, 1u, 2u, 12345u})
+    {
+        CAPTURE(seed);
+        checkPattern(library.getSeedPattern(seed));
+    }
+
+    CHECK(library.getSeedPattern(1) != library.getSeedPattern(2));
+
+    SECTION("Cache file")
+    {
+        const std::string path = "pattern_library_test.ppwp";
+        std::remove(path.c_str());
+
+        const auto generated = WorkGroupPatternLibrary::loadOrGenerate(path, 4, 40);
+        CHECK(generated.getPatterns() == library.getPatterns());
+
+        const auto loaded = WorkGroupPatternLibrary::load(path);
+        CHECK(loaded.getPatterns() == library.getPatterns());
+        CHECK(loaded.getBounds() == bounds);
+
+        // different arguments replace the cached library
+        CHECK(WorkGroupPatternLibrary::loadOrGenerate(path, 2, 40).getPatternCount() == 2);
+        CHECK(WorkGroupPatternLibrary::load(path).getPatternCount() == 2);
+
+        std::remove(path.c_str());
+        CHECK_THROWS_AS(WorkGroupPatternLibrary::load(path), std::runtime_error);
+    }
+
+    CHECK_THROWS_AS(WorkGroupPatternLibrary::generate(0), std::invalid_argument);
+}
+
 TEST_CASE("DiskDistributionGenerator")
 {
     const uint seed = GENERATE(take(10, random(0u, -1u)));
@@ -1424,11 +3523,7 @@ std::vector<Result::Element> computePlacement(const ExecutionPolicy &policy,
                                     });
                   });
 
-    std::sort(policy, candidates.begin(), candidates.end(),
-              [](const Result::Element &l, const Result::Element &r)
-              { return l.class_index < r.class_index; });
-
-    return candidates;
+    return binByClass(policy, candidates, layer_data.densitymaps.size()).elements;
 }
 
 TEST_CASE("Benchmark", "[.][benchmark]")